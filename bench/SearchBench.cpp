@@ -0,0 +1,108 @@
+// Times the two search kernels over a synthetic vault: FuzzyMatcher scoring
+// every entry name, and SearchBuffer scanning one column for a substring.
+//
+//   search_bench [entries]   (default 100000)
+//
+// Entries are generated from a fixed seed, so runs are comparable across
+// builds and machines.
+#include "FuzzyMatcher.h"
+#include "model/SearchBuffer.hpp"
+#include <QElapsedTimer>
+#include <QString>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator> // Required for std::size
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+constexpr int kRounds = 5; // Best of, to skip warm-up and scheduling noise
+
+const char *const kWords[] = { "mail", "bank", "cloud", "github", "work", "home", "router", "server", "shop",
+                               "forum", "vpn", "backup", "admin", "music", "photos", "travel", "wiki", "status" };
+const char *const kPatterns[] = { "gh", "mailsrv", "bankadm", "xyzzy" };
+const char *const kNeedles[] = { "github", "admin.example", "zzzz" };
+
+struct Entry {
+    QString name;
+    std::string nameUtf8; // Case-folded, as MainWindow fills the search buffer
+    std::string url;
+};
+
+std::vector<Entry> makeEntries(int count)
+{
+    std::mt19937 random(20260101);
+    std::uniform_int_distribution<std::size_t> word(0, std::size(kWords) - 1);
+    std::vector<Entry> entries(std::size_t(count));
+    for (int i = 0; i < count; ++i) {
+        Entry &entry = entries[std::size_t(i)];
+        const std::string name = std::string(kWords[word(random)]) + ' ' + kWords[word(random)] + ' ' + std::to_string(i);
+        entry.name = QString::fromStdString(name);
+        entry.nameUtf8 = name;
+        entry.url = "https://" + std::string(kWords[word(random)]) + '.' + kWords[word(random)] + ".example/login";
+    }
+    return entries;
+}
+
+// Best time of kRounds runs of body, in nanoseconds
+template <typename Body>
+qint64 bestOf(Body body)
+{
+    qint64 best = -1;
+    for (int round = 0; round < kRounds; ++round) {
+        QElapsedTimer timer;
+        timer.start();
+        body();
+        const qint64 elapsed = timer.nsecsElapsed();
+        if (best < 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const int count = argc > 1 ? std::atoi(argv[1]) : 100000;
+    if (count < 1) {
+        std::fprintf(stderr, "Usage: search_bench [entries]\n");
+        return 1;
+    }
+    const std::vector<Entry> entries = makeEntries(count);
+
+    std::printf("%d entries\n\nFuzzyMatcher::score over names\n", count);
+    for (const char *pattern : kPatterns) {
+        const FuzzyMatcher matcher(QString::fromLatin1(pattern));
+        int matches = 0;
+        const qint64 ns = bestOf([&]() {
+            matches = 0;
+            for (const Entry &entry : entries) {
+                matches += matcher.score(entry.name) != FuzzyMatcher::kNoMatch;
+            }
+        });
+        std::printf("  %-12s %8.1f ns/entry  %7d matches\n", pattern, double(ns) / count, matches);
+    }
+
+    ArcaneLock::SearchBuffer buffer(2);
+    std::size_t textBytes = 0;
+    for (const Entry &entry : entries) {
+        const std::string_view fields[] = { entry.nameUtf8, entry.url };
+        buffer.appendEntry(fields);
+        textBytes += entry.url.size() + 1;
+    }
+    std::printf("\nSearchBuffer::find over urls (%s kernel, %zu bytes)\n", ArcaneLock::SearchBuffer::kernelName(), textBytes);
+    std::vector<std::uint32_t> hits;
+    for (const char *needle : kNeedles) {
+        const qint64 ns = bestOf([&]() {
+            hits.clear();
+            buffer.find(1, needle, &hits);
+        });
+        std::printf("  %-14s %8.2f GB/s  %7zu matches\n", needle, double(textBytes) / double(ns), hits.size());
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include "Attachment.h"
+#include "CustomField.h" // Required for CustomFieldCodec, which escapes the name
+
+namespace {
+
+bool isHex(QByteArrayView text, qsizetype length)
+{
+    if (text.size() != length) {
+        return false;
+    }
+    for (char c : text) {
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Splits off the text up to the next space
+QByteArrayView takeToken(QByteArrayView *rest)
+{
+    const qsizetype space = rest->indexOf(' ');
+    const QByteArrayView token = space < 0 ? *rest : rest->first(space);
+    *rest = space < 0 ? QByteArrayView() : rest->sliced(space + 1);
+    return token;
+}
+
+} // namespace
+
+namespace AttachmentCodec {
+
+QString encode(const Attachment &attachment)
+{
+    QString line;
+    line.reserve(64 + 64 + 24 + attachment.name.size());
+    line += attachment.key.view();
+    line += u' ';
+    line += QString::fromLatin1(attachment.contentHash.toHex());
+    line += u' ';
+    line += QString::number(attachment.size);
+    line += u' ';
+    line += CustomFieldCodec::escape(attachment.name);
+    return line;
+}
+
+bool decode(QByteArrayView value, Attachment *attachment)
+{
+    QByteArrayView rest = value;
+    const QByteArrayView key = takeToken(&rest);
+    const QByteArrayView hash = takeToken(&rest);
+    const QByteArrayView size = takeToken(&rest);
+    bool sizeOk = false;
+    const qint64 bytes = QByteArray(size.data(), size.size()).toLongLong(&sizeOk);
+    if (!isHex(key, 64) || !isHex(hash, 64) || !sizeOk || bytes < 0 || rest.isEmpty()) {
+        return false;
+    }
+    attachment->key = SecureString::fromUtf8(key);
+    attachment->contentHash = QByteArray::fromHex(QByteArray(hash.data(), hash.size()));
+    attachment->size = bytes;
+    attachment->name = QString::fromUtf8(CustomFieldCodec::unescape(rest));
+    return true;
+}
+
+} // namespace AttachmentCodec
@@ -0,0 +1,31 @@
+#ifndef ATTACHMENT_H
+#define ATTACHMENT_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+#include <vector>
+#include "SecureString.h"
+
+// A file kept with an entry. The record only holds this reference; the content
+// is an encrypted blob in the vault's AttachmentStore, read when the attachment
+// is opened or exported, so large files never weigh on loading or searching.
+struct Attachment {
+    QString name;           // File name, without directories
+    qint64 size = 0;        // Bytes of content
+    QByteArray contentHash; // BLAKE2b-256 of the content; entries attaching the same file share its blob
+    SecureString key;       // Hex of the blob's 32-byte key; the blob's file name is derived from it
+};
+
+using AttachmentList = std::vector<Attachment>;
+
+// Attachments are written as "attachment: <key> <content hash> <size> <name>"
+// lines, which readers from before attachments skip as an unknown tag.
+namespace AttachmentCodec {
+
+QString encode(const Attachment &attachment);
+bool decode(QByteArrayView value, Attachment *attachment);
+
+} // namespace AttachmentCodec
+
+#endif // ATTACHMENT_H
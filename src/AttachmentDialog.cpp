@@ -0,0 +1,76 @@
+#include "AttachmentDialog.h"
+#include <QDialogButtonBox>
+#include <QKeyEvent> // Required for QKeyEvent
+#include <QLabel>
+#include <QLocale>
+#include <QPushButton>
+#include <QVBoxLayout>
+
+AttachmentDialog::AttachmentDialog(const QString &entryName, QWidget *parent)
+    : QDialog(parent)
+{
+    setWindowTitle(tr("Attachments of %1").arg(entryName));
+    setMinimumSize(480, 300);
+
+    m_listWidget = new QListWidget(this);
+    connect(m_listWidget, &QListWidget::itemDoubleClicked, this,
+            [this](QListWidgetItem *item) { emit openRequested(m_listWidget->row(item)); });
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(this);
+    QPushButton *addButton = buttons->addButton(tr("&Add..."), QDialogButtonBox::ActionRole);
+    QPushButton *openButton = buttons->addButton(tr("&Open"), QDialogButtonBox::ActionRole);
+    QPushButton *exportButton = buttons->addButton(tr("&Export..."), QDialogButtonBox::ActionRole);
+    QPushButton *removeButton = buttons->addButton(tr("&Delete"), QDialogButtonBox::ActionRole);
+    buttons->addButton(QDialogButtonBox::Close);
+    for (QPushButton *button : {addButton, openButton, exportButton, removeButton}) {
+        button->setAutoDefault(false); // Enter opens the selected attachment
+    }
+    connect(addButton, &QPushButton::clicked, this, &AttachmentDialog::addRequested);
+    connect(openButton, &QPushButton::clicked, this, [this] { emit openRequested(m_listWidget->currentRow()); });
+    connect(exportButton, &QPushButton::clicked, this, [this] { emit exportRequested(m_listWidget->currentRow()); });
+    connect(removeButton, &QPushButton::clicked, this, [this] { emit removeRequested(m_listWidget->currentRow()); });
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(new QLabel(tr("a: add   Enter/o: open   e: export   d: delete   Esc: close"), this));
+    layout->addWidget(m_listWidget);
+    layout->addWidget(buttons);
+    setLayout(layout);
+    m_listWidget->setFocus();
+}
+
+void AttachmentDialog::setAttachments(const AttachmentList &attachments)
+{
+    const int row = m_listWidget->currentRow();
+    m_listWidget->clear();
+    for (const Attachment &attachment : attachments) {
+        m_listWidget->addItem(QString("%1  (%2)").arg(attachment.name, QLocale().formattedDataSize(attachment.size)));
+    }
+    if (m_listWidget->count() > 0) {
+        m_listWidget->setCurrentRow(qBound(0, row, m_listWidget->count() - 1));
+    }
+}
+
+void AttachmentDialog::keyPressEvent(QKeyEvent *event)
+{
+    const int row = m_listWidget->currentRow();
+    switch (event->key()) {
+    case Qt::Key_A:
+        emit addRequested();
+        break;
+    case Qt::Key_Return:
+    case Qt::Key_Enter:
+    case Qt::Key_O:
+        emit openRequested(row);
+        break;
+    case Qt::Key_E:
+        emit exportRequested(row);
+        break;
+    case Qt::Key_D:
+    case Qt::Key_Delete:
+        emit removeRequested(row);
+        break;
+    default:
+        QDialog::keyPressEvent(event); // Call base class implementation for other keys
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef ATTACHMENTDIALOG_H
+#define ATTACHMENTDIALOG_H
+
+#include <QDialog>
+#include <QListWidget>
+#include "Attachment.h"
+
+// The attachments of one entry. The dialog only lists them; adding, opening,
+// exporting and removing are requested through the signals and done by the
+// main window, which then passes the new list to setAttachments().
+// Keys: a adds, Enter or o opens, e exports, d or Delete removes.
+class AttachmentDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit AttachmentDialog(const QString &entryName, QWidget *parent = nullptr);
+    void setAttachments(const AttachmentList &attachments);
+
+signals:
+    void addRequested();
+    void openRequested(int row);
+    void exportRequested(int row);
+    void removeRequested(int row);
+
+protected:
+    void keyPressEvent(QKeyEvent *event) override;
+
+private:
+    QListWidget *m_listWidget;
+};
+
+#endif // ATTACHMENTDIALOG_H
@@ -0,0 +1,297 @@
+#include "AttachmentStore.h"
+#include "VaultFile.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QIODevice>
+#include <QSaveFile>
+#include <vector>
+#include <sodium.h> // Required for libsodium cryptography
+
+namespace {
+
+const char kMagic[] = "ALBLOBv1";
+constexpr qint64 kMagicSize = sizeof kMagic - 1;
+constexpr int kKeyBytes = crypto_secretstream_xchacha20poly1305_KEYBYTES;
+constexpr int kBlobIdBytes = 16;
+// Key of the hash that turns attachment keys into blob names
+const char kBlobIdKey[] = "ArcaneLock attachment blob id";
+constexpr qint64 kCipherChunkSize = AttachmentStore::kChunkSize + crypto_secretstream_xchacha20poly1305_ABYTES;
+
+QString tr(const char *text)
+{
+    return QCoreApplication::translate("AttachmentStore", text);
+}
+
+void setError(QString *errorMessage, const QString &message)
+{
+    if (errorMessage) {
+        *errorMessage = message;
+    }
+}
+
+// Decodes the hex key of an attachment; the caller wipes key
+bool keyBytes(const SecureString &hex, unsigned char *key)
+{
+    const QStringView view = hex.view();
+    if (view.size() != 2 * kKeyBytes) {
+        return false;
+    }
+    for (int i = 0; i < kKeyBytes; ++i) {
+        int nibbles[2];
+        for (int j = 0; j < 2; ++j) {
+            const char16_t c = view[2 * i + j].unicode();
+            nibbles[j] = c >= u'0' && c <= u'9' ? c - u'0' : c >= u'a' && c <= u'f' ? c - u'a' + 10 : -1;
+            if (nibbles[j] < 0) {
+                sodium_memzero(key, kKeyBytes);
+                return false;
+            }
+        }
+        key[i] = static_cast<unsigned char>(nibbles[0] << 4 | nibbles[1]);
+    }
+    return true;
+}
+
+// Buffers for plaintext that are wiped when they go
+class WipedBuffer
+{
+public:
+    explicit WipedBuffer(qint64 size) : m_data(size_t(size)) {}
+    ~WipedBuffer() { sodium_memzero(m_data.data(), m_data.size()); }
+    unsigned char *data() { return m_data.data(); }
+    char *chars() { return reinterpret_cast<char *>(m_data.data()); }
+
+private:
+    std::vector<unsigned char> m_data;
+};
+
+} // namespace
+
+AttachmentStore::AttachmentStore(const QString &vaultPath)
+    : m_directory(vaultPath + QStringLiteral(".attachments"))
+{
+}
+
+SecureString AttachmentStore::newKey()
+{
+    unsigned char key[kKeyBytes];
+    char hex[2 * kKeyBytes + 1];
+    crypto_secretstream_xchacha20poly1305_keygen(key);
+    sodium_bin2hex(hex, sizeof hex, key, sizeof key);
+    const SecureString text = SecureString::fromUtf8(QByteArrayView(hex, 2 * kKeyBytes));
+    sodium_memzero(key, sizeof key);
+    sodium_memzero(hex, sizeof hex);
+    return text;
+}
+
+bool AttachmentStore::hashFile(const QString &filePath, QByteArray *contentHash, qint64 *size, QString *errorMessage)
+{
+    if (!VaultFile::initCrypto(errorMessage)) {
+        return false;
+    }
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        setError(errorMessage, tr("Cannot read file %1:\n%2.").arg(filePath, file.errorString()));
+        return false;
+    }
+    crypto_generichash_state state;
+    crypto_generichash_init(&state, nullptr, 0, crypto_generichash_BYTES);
+    WipedBuffer buffer(kChunkSize);
+    qint64 total = 0;
+    for (;;) {
+        const qint64 read = file.read(buffer.chars(), kChunkSize);
+        if (read < 0) {
+            setError(errorMessage, tr("Cannot read file %1:\n%2.").arg(filePath, file.errorString()));
+            return false;
+        }
+        if (read == 0) {
+            break;
+        }
+        crypto_generichash_update(&state, buffer.data(), size_t(read));
+        total += read;
+    }
+    contentHash->resize(crypto_generichash_BYTES);
+    crypto_generichash_final(&state, reinterpret_cast<unsigned char *>(contentHash->data()), crypto_generichash_BYTES);
+    *size = total;
+    return true;
+}
+
+QString AttachmentStore::blobPath(const Attachment &attachment) const
+{
+    unsigned char key[kKeyBytes];
+    if (!keyBytes(attachment.key, key)) {
+        return QString();
+    }
+    unsigned char id[kBlobIdBytes];
+    crypto_generichash(id, sizeof id, key, sizeof key, reinterpret_cast<const unsigned char *>(kBlobIdKey),
+                       sizeof kBlobIdKey - 1);
+    sodium_memzero(key, sizeof key);
+    const QString name = QString::fromLatin1(QByteArray(reinterpret_cast<const char *>(id), sizeof id).toHex());
+    return m_directory + u'/' + name.left(2) + u'/' + name;
+}
+
+bool AttachmentStore::contains(const Attachment &attachment) const
+{
+    const QString path = blobPath(attachment);
+    return !path.isEmpty() && QFileInfo::exists(path);
+}
+
+bool AttachmentStore::add(const QString &filePath, const Attachment &attachment, QString *errorMessage) const
+{
+    if (!VaultFile::initCrypto(errorMessage)) {
+        return false;
+    }
+    const QString path = blobPath(attachment);
+    if (path.isEmpty()) {
+        setError(errorMessage, tr("The attachment %1 has an invalid key.").arg(attachment.name));
+        return false;
+    }
+    if (QFileInfo::exists(path)) {
+        return true; // Same key, same content: blobs are written once
+    }
+    QFile input(filePath);
+    if (!input.open(QIODevice::ReadOnly)) {
+        setError(errorMessage, tr("Cannot read file %1:\n%2.").arg(filePath, input.errorString()));
+        return false;
+    }
+    if (!QDir().mkpath(QFileInfo(path).absolutePath())) {
+        setError(errorMessage, tr("Cannot create the attachment directory %1.").arg(m_directory));
+        return false;
+    }
+    // Complete or absent: a blob cut short by a crash would otherwise pass for stored
+    QSaveFile output(path);
+    if (!output.open(QIODevice::WriteOnly)) {
+        setError(errorMessage, tr("Cannot write file %1:\n%2.").arg(path, output.errorString()));
+        return false;
+    }
+
+    crypto_secretstream_xchacha20poly1305_state state;
+    unsigned char header[crypto_secretstream_xchacha20poly1305_HEADERBYTES];
+    unsigned char key[kKeyBytes];
+    keyBytes(attachment.key, key);
+    crypto_secretstream_xchacha20poly1305_init_push(&state, header, key);
+    sodium_memzero(key, sizeof key);
+    bool ok = output.write(kMagic, kMagicSize) == kMagicSize
+              && output.write(reinterpret_cast<const char *>(header), sizeof header) == qint64(sizeof header);
+
+    WipedBuffer plain(kChunkSize);
+    std::vector<unsigned char> cipher(size_t(kCipherChunkSize));
+    bool last = false;
+    while (ok && !last) {
+        // The final chunk carries the FINAL tag, so a blob that lost its end is
+        // told apart from a shorter file; an empty file is one empty final chunk
+        const qint64 read = input.read(plain.chars(), kChunkSize);
+        if (read < 0) {
+            ok = false;
+            break;
+        }
+        last = read < kChunkSize || input.atEnd();
+        unsigned long long cipherSize = 0;
+        crypto_secretstream_xchacha20poly1305_push(&state, cipher.data(), &cipherSize, plain.data(),
+                                                   static_cast<unsigned long long>(read), nullptr, 0,
+                                                   last ? crypto_secretstream_xchacha20poly1305_TAG_FINAL : 0);
+        ok = output.write(reinterpret_cast<const char *>(cipher.data()), qint64(cipherSize)) == qint64(cipherSize);
+    }
+    sodium_memzero(&state, sizeof state);
+    if (!ok || !output.commit()) {
+        output.cancelWriting();
+        setError(errorMessage, input.error() != QFileDevice::NoError
+                                   ? tr("Cannot read file %1:\n%2.").arg(filePath, input.errorString())
+                                   : tr("Cannot write file %1:\n%2.").arg(path, output.errorString()));
+        return false;
+    }
+    return true;
+}
+
+bool AttachmentStore::extract(const Attachment &attachment, QIODevice *output, QString *errorMessage) const
+{
+    if (!VaultFile::initCrypto(errorMessage)) {
+        return false;
+    }
+    const QString path = blobPath(attachment);
+    QFile input(path);
+    if (path.isEmpty() || !input.open(QIODevice::ReadOnly)) {
+        setError(errorMessage, tr("The content of %1 is missing from %2.").arg(attachment.name, m_directory));
+        return false;
+    }
+    const QString damaged = tr("The content of %1 is damaged or incomplete.").arg(attachment.name);
+    unsigned char header[crypto_secretstream_xchacha20poly1305_HEADERBYTES];
+    unsigned char key[kKeyBytes];
+    if (input.read(kMagicSize) != QByteArray(kMagic)
+        || input.read(reinterpret_cast<char *>(header), sizeof header) != qint64(sizeof header)
+        || !keyBytes(attachment.key, key)) {
+        setError(errorMessage, damaged);
+        return false;
+    }
+    crypto_secretstream_xchacha20poly1305_state state;
+    const int initialized = crypto_secretstream_xchacha20poly1305_init_pull(&state, header, key);
+    sodium_memzero(key, sizeof key);
+    if (initialized != 0) {
+        setError(errorMessage, damaged);
+        return false;
+    }
+
+    WipedBuffer plain(kChunkSize);
+    std::vector<unsigned char> cipher(size_t(kCipherChunkSize));
+    bool final = false;
+    bool ok = true;
+    while (ok && !final) {
+        const qint64 read = input.read(reinterpret_cast<char *>(cipher.data()), kCipherChunkSize);
+        unsigned long long plainSize = 0;
+        unsigned char tag = 0;
+        if (read < crypto_secretstream_xchacha20poly1305_ABYTES
+            || crypto_secretstream_xchacha20poly1305_pull(&state, plain.data(), &plainSize, &tag, cipher.data(),
+                                                          static_cast<unsigned long long>(read), nullptr, 0) != 0) {
+            setError(errorMessage, damaged);
+            ok = false;
+            break;
+        }
+        final = tag == crypto_secretstream_xchacha20poly1305_TAG_FINAL;
+        if (!final && read < kCipherChunkSize) {
+            setError(errorMessage, damaged); // A short chunk is only valid at the end
+            ok = false;
+        } else if (output->write(plain.chars(), qint64(plainSize)) != qint64(plainSize)) {
+            setError(errorMessage, tr("Cannot write %1:\n%2.").arg(attachment.name, output->errorString()));
+            ok = false;
+        }
+    }
+    sodium_memzero(&state, sizeof state);
+    if (ok && !input.atEnd()) {
+        setError(errorMessage, damaged); // Data after the final chunk
+        ok = false;
+    }
+    return ok;
+}
+
+bool AttachmentStore::mirror(const QString &fromVaultPath, const QString &toVaultPath, int *copied,
+                             QString *errorMessage)
+{
+    *copied = 0;
+    const QString from = AttachmentStore(fromVaultPath).directory();
+    const QString to = AttachmentStore(toVaultPath).directory();
+    if (!QFileInfo(from).isDir()) {
+        return true;
+    }
+    QDirIterator it(from, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QString source = it.next();
+        const QString relative = QDir(from).relativeFilePath(source);
+        const QString target = to + u'/' + relative;
+        if (it.fileName().size() != 2 * kBlobIdBytes || QFileInfo::exists(target)) {
+            continue; // Already there, or a temporary file of a write in progress
+        }
+        // Copied under another name first, so a blob is never seen half there
+        const QString partial = target + QStringLiteral(".part");
+        QFile::remove(partial);
+        if (!QDir().mkpath(QFileInfo(target).absolutePath()) || !QFile::copy(source, partial)
+            || !QFile::rename(partial, target)) {
+            QFile::remove(partial);
+            setError(errorMessage, tr("Cannot copy attachment %1 to %2.").arg(source, to));
+            return false;
+        }
+        ++*copied;
+    }
+    return true;
+}
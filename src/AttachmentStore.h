@@ -0,0 +1,58 @@
+#ifndef ATTACHMENTSTORE_H
+#define ATTACHMENTSTORE_H
+
+#include <QByteArray>
+#include <QString>
+#include "Attachment.h"
+#include "SecureString.h"
+
+class QIODevice;
+
+// Encrypted attachment blobs of one vault, kept beside it in
+// "<vault file>.attachments".
+//
+// Every attachment has its own random key, stored only in its reference in the
+// (encrypted) vault. The blob's file name is a keyed BLAKE2b of that key, so the
+// directory shows neither names nor contents, and a blob is useless without the
+// vault that references it. Entries attaching the same content reuse the key of
+// the first (see AttachmentStore::newKey), which makes them share one blob.
+//
+// Blobs use libsodium's secretstream in chunks of kChunkSize: adding, opening
+// and exporting run in constant memory whatever the file size, and a blob that
+// was truncated, reordered or tampered with fails to decrypt rather than
+// yielding partial content. Blobs never change once written, so syncing them is
+// copying the missing ones (mirror()). Nothing deletes blobs yet: one that no
+// entry references any more stays until the directory is cleaned by hand.
+//
+// Functions taking an errorMessage fill it with a translated, user-facing
+// message when they fail.
+class AttachmentStore
+{
+public:
+    static constexpr qint64 kChunkSize = 64 * 1024;
+
+    explicit AttachmentStore(const QString &vaultPath);
+    QString directory() const { return m_directory; }
+
+    static SecureString newKey();
+
+    // Size and BLAKE2b-256 of a file, read a chunk at a time
+    static bool hashFile(const QString &filePath, QByteArray *contentHash, qint64 *size, QString *errorMessage);
+
+    bool contains(const Attachment &attachment) const;
+    // Encrypts filePath into the blob of attachment.key, unless that blob is already stored
+    bool add(const QString &filePath, const Attachment &attachment, QString *errorMessage) const;
+    // Decrypts the blob into output a chunk at a time. Fails, after writing what
+    // decrypted, if the blob is damaged or cut short.
+    bool extract(const Attachment &attachment, QIODevice *output, QString *errorMessage) const;
+
+    // Copies the blobs fromVaultPath has and toVaultPath lacks
+    static bool mirror(const QString &fromVaultPath, const QString &toVaultPath, int *copied, QString *errorMessage);
+
+private:
+    QString blobPath(const Attachment &attachment) const;
+
+    QString m_directory;
+};
+
+#endif // ATTACHMENTSTORE_H
@@ -0,0 +1,154 @@
+#include "AuditDialog.h"
+#include <QHeaderView>
+#include <QKeyEvent> // Required for QKeyEvent
+#include <QLabel>
+#include <QSortFilterProxyModel>
+#include <QVBoxLayout>
+
+namespace {
+
+enum Column { PathColumn, IssuesColumn, StrengthColumn, ReuseColumn, AgeColumn, ColumnCount };
+
+constexpr int kRowRole = Qt::UserRole + 1;    // Index into the dialog's rows
+constexpr int kIssuesRole = Qt::UserRole + 2; // PasswordAudit::Issue flags
+
+} // namespace
+
+// Rows with any of the chosen issues whose path contains the filter text
+class AuditFilterModel : public QSortFilterProxyModel
+{
+public:
+    using QSortFilterProxyModel::QSortFilterProxyModel;
+
+    void setFilter(unsigned issues, const QString &text)
+    {
+        m_issues = issues;
+        m_text = text;
+        invalidateFilter();
+    }
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override
+    {
+        const QModelIndex path = sourceModel()->index(sourceRow, PathColumn, sourceParent);
+        return (path.data(kIssuesRole).toUInt() & m_issues) != 0
+               && path.data().toString().contains(m_text, Qt::CaseInsensitive);
+    }
+
+private:
+    unsigned m_issues = PasswordAudit::kAllIssues;
+    QString m_text;
+};
+
+AuditDialog::AuditDialog(std::vector<Row> rows, int entryCount, bool breachesChecked, QWidget *parent)
+    : QDialog(parent), m_rows(std::move(rows))
+{
+    setWindowTitle(tr("Password Audit"));
+    setMinimumSize(720, 420);
+
+    int reused = 0, weak = 0, stale = 0, breached = 0, groups = 0;
+    m_model = new QStandardItemModel(int(m_rows.size()), ColumnCount, this);
+    m_model->setHorizontalHeaderLabels({tr("Entry"), tr("Issues"), tr("Strength"), tr("Same password"), tr("Age")});
+    for (int i = 0; i < int(m_rows.size()); ++i) {
+        const PasswordAudit::Finding &finding = m_rows[std::size_t(i)].finding;
+        reused += (finding.issues & PasswordAudit::Reused) ? 1 : 0;
+        weak += (finding.issues & PasswordAudit::Weak) ? 1 : 0;
+        stale += (finding.issues & PasswordAudit::Stale) ? 1 : 0;
+        breached += (finding.issues & PasswordAudit::Breached) ? 1 : 0;
+        groups = qMax(groups, finding.reuseGroup + 1);
+
+        auto *path = new QStandardItem(m_rows[std::size_t(i)].path);
+        path->setData(path->text(), Qt::UserRole); // The sort role of every column
+        path->setData(i, kRowRole);
+        path->setData(finding.issues, kIssuesRole);
+        auto *strength = new QStandardItem(PasswordAudit::strengthName(finding.strength));
+        strength->setData(finding.bits, Qt::UserRole); // Sorts by the estimate, not the name
+        auto *reuse = new QStandardItem(finding.reuseCount > 1
+                                            ? tr("%1 entries (group %2)").arg(finding.reuseCount).arg(finding.reuseGroup + 1)
+                                            : QString());
+        reuse->setData(finding.reuseCount > 1 ? finding.reuseGroup : -1, Qt::UserRole); // Groups sort together
+        auto *age = new QStandardItem(finding.ageDays < 0 ? tr("unknown") : tr("%n day(s)", nullptr, finding.ageDays));
+        age->setData(finding.ageDays, Qt::UserRole);
+        m_model->setItem(i, PathColumn, path);
+        auto *issues = new QStandardItem(PasswordAudit::describeIssues(finding.issues));
+        issues->setData(issues->text(), Qt::UserRole);
+        m_model->setItem(i, IssuesColumn, issues);
+        m_model->setItem(i, StrengthColumn, strength);
+        m_model->setItem(i, ReuseColumn, reuse);
+        m_model->setItem(i, AgeColumn, age);
+    }
+
+    m_filterModel = new AuditFilterModel(this);
+    m_filterModel->setSourceModel(m_model);
+    m_filterModel->setSortRole(Qt::UserRole);
+
+    m_tableView = new QTableView(this);
+    m_tableView->setModel(m_filterModel);
+    m_tableView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_tableView->setSelectionMode(QAbstractItemView::SingleSelection);
+    m_tableView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_tableView->verticalHeader()->hide();
+    m_tableView->horizontalHeader()->setSectionResizeMode(PathColumn, QHeaderView::Stretch);
+    m_tableView->setSortingEnabled(true);
+    m_tableView->sortByColumn(ReuseColumn, Qt::DescendingOrder);
+
+    m_issueFilter = new QComboBox(this);
+    m_issueFilter->addItem(tr("All issues"), PasswordAudit::kAllIssues);
+    m_issueFilter->addItem(tr("Reused"), unsigned(PasswordAudit::Reused));
+    m_issueFilter->addItem(tr("Weak"), unsigned(PasswordAudit::Weak));
+    m_issueFilter->addItem(tr("Stale"), unsigned(PasswordAudit::Stale));
+    m_issueFilter->addItem(tr("Breached"), unsigned(PasswordAudit::Breached));
+    m_pathFilter = new QLineEdit(this);
+    m_pathFilter->setPlaceholderText(tr("Filter by path"));
+
+    QHBoxLayout *filterLayout = new QHBoxLayout();
+    filterLayout->addWidget(m_issueFilter);
+    filterLayout->addWidget(m_pathFilter, 1);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    QString summary = tr("%1 entries checked: %2 share a password in %3 groups, %4 weak, %5 stale.")
+                          .arg(entryCount).arg(reused).arg(groups).arg(weak).arg(stale);
+    if (breachesChecked) {
+        summary += u' ';
+        summary += tr("%n found in known breaches.", nullptr, breached);
+    }
+    layout->addWidget(new QLabel(summary, this));
+    layout->addLayout(filterLayout);
+    layout->addWidget(m_tableView);
+    setLayout(layout);
+
+    connect(m_issueFilter, &QComboBox::currentIndexChanged, this, &AuditDialog::updateFilter);
+    connect(m_pathFilter, &QLineEdit::textChanged, this, &AuditDialog::updateFilter);
+    connect(m_tableView, &QTableView::doubleClicked, this, &AuditDialog::onRowActivated);
+    m_tableView->setFocus();
+    m_tableView->selectRow(0);
+}
+
+void AuditDialog::updateFilter()
+{
+    m_filterModel->setFilter(m_issueFilter->currentData().toUInt(), m_pathFilter->text());
+}
+
+void AuditDialog::onRowActivated(const QModelIndex &index)
+{
+    if (!index.isValid()) {
+        return;
+    }
+    const QModelIndex path = m_filterModel->mapToSource(index).siblingAtColumn(PathColumn);
+    m_selectedItem = m_rows[std::size_t(path.data(kRowRole).toInt())].item;
+    accept();
+}
+
+void AuditDialog::keyPressEvent(QKeyEvent *event)
+{
+    if (event->key() == Qt::Key_Return || event->key() == Qt::Key_Enter) {
+        if (m_pathFilter->hasFocus()) {
+            m_tableView->setFocus(); // Enter in the filter moves to the matches
+            m_tableView->selectRow(0);
+        } else {
+            onRowActivated(m_tableView->currentIndex());
+        }
+    } else {
+        QDialog::keyPressEvent(event); // Call base class implementation for other keys
+    }
+}
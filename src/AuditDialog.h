@@ -0,0 +1,47 @@
+#ifndef AUDITDIALOG_H
+#define AUDITDIALOG_H
+
+#include <QDialog>
+#include <QComboBox>
+#include <QLineEdit>
+#include <QTableView>
+#include <QStandardItemModel>
+#include <vector>
+#include "PasswordAudit.h"
+
+class AuditFilterModel;
+
+// Report of a password audit: one row per entry with a finding, filtered by
+// issue and path. Enter or a double-click closes it on that entry.
+class AuditDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    struct Row {
+        QStandardItem *item; // The entry in the main window's model
+        QString path;
+        PasswordAudit::Finding finding;
+    };
+
+    AuditDialog(std::vector<Row> rows, int entryCount, bool breachesChecked, QWidget *parent = nullptr);
+    QStandardItem *selectedItem() const { return m_selectedItem; }
+
+protected:
+    void keyPressEvent(QKeyEvent *event) override;
+
+private slots:
+    void onRowActivated(const QModelIndex &index);
+    void updateFilter();
+
+private:
+    std::vector<Row> m_rows;
+    QStandardItemModel *m_model;
+    AuditFilterModel *m_filterModel;
+    QTableView *m_tableView;
+    QComboBox *m_issueFilter;
+    QLineEdit *m_pathFilter;
+    QStandardItem *m_selectedItem = nullptr;
+};
+
+#endif // AUDITDIALOG_H
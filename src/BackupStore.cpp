@@ -0,0 +1,380 @@
+#include "BackupStore.h"
+#include "VaultFile.h"
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QSaveFile>
+#include <QSet>
+#include <array>
+#include <sodium.h> // Required for libsodium cryptography
+
+namespace {
+
+const char kHeader[] = "ALOCK_BACKUP_V1";
+constexpr int kHeaderSize = sizeof kHeader - 1;
+const char kKdfContext[crypto_kdf_CONTEXTBYTES + 1] = "ALBackup";
+constexpr quint32 kManifestVersion = 1;
+
+// Cut points: no chunk under kMinChunk or over kMaxChunk. Past the minimum the
+// stricter mask applies until kAverageChunk and the looser one after it, which
+// keeps most chunks near the average (FastCDC's normalized chunking).
+constexpr int kMinChunk = 2 * 1024;
+constexpr int kAverageChunk = 8 * 1024;
+constexpr int kMaxChunk = 32 * 1024;
+constexpr quint64 kMaskBeforeAverage = ((quint64(1) << 15) - 1) << 49;
+constexpr quint64 kMaskAfterAverage = ((quint64(1) << 11) - 1) << 53;
+
+// Fixed random table of the gear hash. It must never change: the cut points,
+// and with them the chunk ids, of every store depend on it.
+constexpr std::array<quint64, 256> makeGearTable()
+{
+    std::array<quint64, 256> table{};
+    quint64 state = 0x4172636c6f636b31; // splitmix64
+    for (quint64 &value : table) {
+        state += 0x9e3779b97f4a7c15;
+        quint64 z = state;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        value = z ^ (z >> 31);
+    }
+    return table;
+}
+
+constexpr std::array<quint64, 256> kGear = makeGearTable();
+
+// Length of the chunk that starts at data
+qsizetype cutPoint(const unsigned char *data, qsizetype size)
+{
+    if (size <= kMinChunk) {
+        return size;
+    }
+    const qsizetype end = qMin<qsizetype>(size, kMaxChunk);
+    const qsizetype average = qMin<qsizetype>(end, kAverageChunk);
+    quint64 hash = 0;
+    qsizetype i = kMinChunk;
+    for (; i < average; ++i) {
+        hash = (hash << 1) + kGear[data[i]];
+        if (!(hash & kMaskBeforeAverage)) {
+            return i + 1;
+        }
+    }
+    for (; i < end; ++i) {
+        hash = (hash << 1) + kGear[data[i]];
+        if (!(hash & kMaskAfterAverage)) {
+            return i + 1;
+        }
+    }
+    return end;
+}
+
+QString tr(const char *text)
+{
+    return QCoreApplication::translate("BackupStore", text);
+}
+
+void setError(QString *errorMessage, const QString &message)
+{
+    if (errorMessage) {
+        *errorMessage = message;
+    }
+}
+
+const unsigned char *bytes(const QByteArray &data)
+{
+    return reinterpret_cast<const unsigned char *>(data.constData());
+}
+
+unsigned char *bytes(QByteArray *data)
+{
+    return reinterpret_cast<unsigned char *>(data->data());
+}
+
+QByteArray keyCheck(const unsigned char *manifestKey)
+{
+    QByteArray check(32, Qt::Uninitialized);
+    crypto_generichash(bytes(&check), size_t(check.size()), reinterpret_cast<const unsigned char *>(kHeader),
+                       kHeaderSize, manifestKey, 32);
+    return check;
+}
+
+bool writeFile(const QString &filePath, const QByteArray &content, QString *errorMessage)
+{
+    // Complete or absent: a chunk cut short by a crash would otherwise pass for stored
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(content) != content.size() || !file.commit()) {
+        setError(errorMessage, tr("Cannot write file %1:\n%2.").arg(filePath, file.errorString()));
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+BackupStore::~BackupStore()
+{
+    sodium_memzero(m_idKey, sizeof m_idKey);
+    sodium_memzero(m_chunkKey, sizeof m_chunkKey);
+    sodium_memzero(m_manifestKey, sizeof m_manifestKey);
+}
+
+bool BackupStore::open(const QString &directory, const QByteArray &passwordUtf8, QString *errorMessage)
+{
+    if (!VaultFile::initCrypto(errorMessage)) {
+        return false;
+    }
+    const QDir dir(directory);
+    if (!dir.mkpath(QStringLiteral("chunks")) || !dir.mkpath(QStringLiteral("snapshots"))) {
+        setError(errorMessage, tr("Cannot create the backup store in %1.").arg(directory));
+        return false;
+    }
+
+    const QString configPath = dir.filePath(QStringLiteral("config"));
+    VaultFile::Envelope envelope; // Only the salt, for VaultFile::deriveKey
+    QByteArray storedCheck;
+    QFile config(configPath);
+    const bool exists = config.exists();
+    if (exists) {
+        if (!config.open(QIODevice::ReadOnly)) {
+            setError(errorMessage, tr("Cannot open file %1:\n%2.").arg(configPath, config.errorString()));
+            return false;
+        }
+        const QByteArray content = config.readAll();
+        if (!content.startsWith(kHeader) || content.size() != kHeaderSize + crypto_pwhash_SALTBYTES + 32) {
+            setError(errorMessage, tr("%1 is not an ArcaneLock backup store.").arg(directory));
+            return false;
+        }
+        envelope.salt = content.mid(kHeaderSize, crypto_pwhash_SALTBYTES);
+        storedCheck = content.mid(kHeaderSize + crypto_pwhash_SALTBYTES);
+    } else {
+        envelope.salt.resize(crypto_pwhash_SALTBYTES);
+        randombytes_buf(envelope.salt.data(), size_t(envelope.salt.size()));
+    }
+
+    unsigned char masterKey[VaultFile::kKeyBytes];
+    if (!VaultFile::deriveKey(envelope, passwordUtf8, masterKey)) {
+        setError(errorMessage, tr("Key derivation failed."));
+        return false;
+    }
+    crypto_kdf_derive_from_key(m_idKey, sizeof m_idKey, 1, kKdfContext, masterKey);
+    crypto_kdf_derive_from_key(m_chunkKey, sizeof m_chunkKey, 2, kKdfContext, masterKey);
+    crypto_kdf_derive_from_key(m_manifestKey, sizeof m_manifestKey, 3, kKdfContext, masterKey);
+    sodium_memzero(masterKey, sizeof masterKey);
+
+    const QByteArray check = keyCheck(m_manifestKey);
+    if (exists) {
+        if (sodium_memcmp(check.constData(), storedCheck.constData(), size_t(check.size())) != 0) {
+            setError(errorMessage, tr("Incorrect master password for the backup store."));
+            return false;
+        }
+    } else if (!writeFile(configPath, QByteArray(kHeader, kHeaderSize) + envelope.salt + check, errorMessage)) {
+        return false;
+    }
+    m_directory = directory;
+    return true;
+}
+
+QString BackupStore::chunkPath(const QByteArray &id) const
+{
+    const QString hex = QString::fromLatin1(id.toHex());
+    return m_directory + QLatin1String("/chunks/") + hex.left(2) + u'/' + hex;
+}
+
+QString BackupStore::snapshotPath(const QString &snapshotId) const
+{
+    return m_directory + QLatin1String("/snapshots/") + snapshotId;
+}
+
+bool BackupStore::backup(const QByteArray &plaintext, const QString &vaultName, Snapshot *snapshot, Stats *stats,
+                         QString *errorMessage)
+{
+    *stats = Stats();
+    QByteArray ids;
+    QByteArray ciphertext;
+    ciphertext.reserve(kMaxChunk + crypto_secretbox_MACBYTES);
+    QSet<QString> madeDirectories;
+    const unsigned char *data = bytes(plaintext);
+    for (qsizetype offset = 0; offset < plaintext.size();) {
+        const qsizetype length = cutPoint(data + offset, plaintext.size() - offset);
+        QByteArray id(kIdBytes, Qt::Uninitialized);
+        crypto_generichash(bytes(&id), kIdBytes, data + offset, size_t(length), m_idKey, sizeof m_idKey);
+        ids.append(id);
+
+        const QString path = chunkPath(id);
+        if (!QFile::exists(path)) {
+            // The id is a keyed hash of the plaintext, so its first bytes make a
+            // nonce that repeats only for the same chunk under the same key
+            ciphertext.resize(length + crypto_secretbox_MACBYTES);
+            crypto_secretbox_easy(bytes(&ciphertext), data + offset, quint64(length), bytes(id), m_chunkKey);
+            const QString subdirectory = path.left(path.lastIndexOf(u'/'));
+            if (!madeDirectories.contains(subdirectory)) {
+                QDir().mkpath(subdirectory);
+                madeDirectories.insert(subdirectory);
+            }
+            if (!writeFile(path, ciphertext, errorMessage)) {
+                return false;
+            }
+            ++stats->newChunks;
+            stats->newBytes += ciphertext.size();
+        }
+        offset += length;
+    }
+
+    snapshot->created = QDateTime::currentDateTimeUtc();
+    snapshot->vaultName = vaultName;
+    snapshot->size = plaintext.size();
+    snapshot->chunkCount = int(ids.size() / kIdBytes);
+    const QString stamp = snapshot->created.toString(QStringLiteral("yyyyMMdd-HHmmss-zzz"));
+    snapshot->id = stamp;
+    for (int n = 2; QFile::exists(snapshotPath(snapshot->id)); ++n) {
+        snapshot->id = stamp + u'-' + QString::number(n);
+    }
+
+    QByteArray manifest;
+    QDataStream out(&manifest, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << kManifestVersion << vaultName << snapshot->created.toMSecsSinceEpoch() << snapshot->size << ids;
+    QByteArray sealed(crypto_secretbox_NONCEBYTES + manifest.size() + crypto_secretbox_MACBYTES, Qt::Uninitialized);
+    randombytes_buf(sealed.data(), crypto_secretbox_NONCEBYTES);
+    crypto_secretbox_easy(bytes(&sealed) + crypto_secretbox_NONCEBYTES, bytes(manifest), quint64(manifest.size()),
+                          bytes(sealed), m_manifestKey);
+    // Written last: a backup interrupted before this point leaves only unreferenced chunks
+    return writeFile(snapshotPath(snapshot->id), sealed, errorMessage);
+}
+
+bool BackupStore::readManifest(const QString &snapshotId, Snapshot *snapshot, QByteArray *ids,
+                               QString *errorMessage) const
+{
+    const QString path = snapshotPath(snapshotId);
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        setError(errorMessage, tr("Cannot open file %1:\n%2.").arg(path, file.errorString()));
+        return false;
+    }
+    const QByteArray sealed = file.readAll();
+    QByteArray manifest(qMax<qsizetype>(0, sealed.size() - crypto_secretbox_NONCEBYTES - crypto_secretbox_MACBYTES),
+                        Qt::Uninitialized);
+    if (sealed.size() < crypto_secretbox_NONCEBYTES + crypto_secretbox_MACBYTES
+        || crypto_secretbox_open_easy(bytes(&manifest), bytes(sealed) + crypto_secretbox_NONCEBYTES,
+                                      quint64(sealed.size() - crypto_secretbox_NONCEBYTES), bytes(sealed),
+                                      m_manifestKey) != 0) {
+        setError(errorMessage, tr("Backup %1 is damaged.").arg(snapshotId));
+        return false;
+    }
+
+    QDataStream in(manifest);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 version = 0;
+    qint64 createdMsecs = 0;
+    in >> version >> snapshot->vaultName >> createdMsecs >> snapshot->size >> *ids;
+    if (in.status() != QDataStream::Ok || version != kManifestVersion || ids->size() % kIdBytes != 0) {
+        setError(errorMessage, tr("Backup %1 is damaged.").arg(snapshotId));
+        return false;
+    }
+    snapshot->id = snapshotId;
+    snapshot->created = QDateTime::fromMSecsSinceEpoch(createdMsecs).toUTC();
+    snapshot->chunkCount = int(ids->size() / kIdBytes);
+    return true;
+}
+
+bool BackupStore::snapshots(QList<Snapshot> *snapshots, QString *errorMessage) const
+{
+    snapshots->clear();
+    const QStringList ids = QDir(m_directory + QLatin1String("/snapshots")).entryList(QDir::Files, QDir::Name);
+    for (const QString &id : ids) {
+        Snapshot snapshot;
+        QByteArray chunkIds;
+        if (!readManifest(id, &snapshot, &chunkIds, errorMessage)) {
+            return false;
+        }
+        snapshots->append(snapshot);
+    }
+    return true;
+}
+
+bool BackupStore::restore(const QString &snapshotId, QByteArray *plaintext, QString *errorMessage) const
+{
+    Snapshot snapshot;
+    QByteArray ids;
+    if (!readManifest(snapshotId, &snapshot, &ids, errorMessage)) {
+        return false;
+    }
+    plaintext->resize(snapshot.size); // Decrypted in place; no other copy of a chunk is made
+    qsizetype offset = 0;
+    for (qsizetype at = 0; at < ids.size(); at += kIdBytes) {
+        const QByteArray id = ids.mid(at, kIdBytes);
+        const QString path = chunkPath(id);
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            setError(errorMessage, tr("Backup %1 is missing chunk %2.").arg(snapshotId, QString::fromLatin1(id.toHex())));
+            return false;
+        }
+        const QByteArray ciphertext = file.readAll();
+        const qsizetype length = ciphertext.size() - crypto_secretbox_MACBYTES;
+        QByteArray check(kIdBytes, Qt::Uninitialized);
+        const bool ok = length >= 0 && offset + length <= plaintext->size()
+                        && crypto_secretbox_open_easy(bytes(plaintext) + offset, bytes(ciphertext),
+                                                      quint64(ciphertext.size()), bytes(id), m_chunkKey) == 0
+                        && crypto_generichash(bytes(&check), kIdBytes, bytes(*plaintext) + offset, size_t(length),
+                                              m_idKey, sizeof m_idKey) == 0
+                        && check == id;
+        if (!ok) {
+            setError(errorMessage, tr("Backup %1 has a damaged chunk %2.").arg(snapshotId, QString::fromLatin1(id.toHex())));
+            return false;
+        }
+        offset += length;
+    }
+    if (offset != plaintext->size()) {
+        setError(errorMessage, tr("Backup %1 is damaged.").arg(snapshotId));
+        return false;
+    }
+    return true;
+}
+
+bool BackupStore::prune(int keep, int *removedSnapshots, int *removedChunks, QString *errorMessage)
+{
+    *removedSnapshots = 0;
+    *removedChunks = 0;
+    QDir snapshotDir(m_directory + QLatin1String("/snapshots"));
+    const QStringList ids = snapshotDir.entryList(QDir::Files, QDir::Name);
+
+    // Newest first, counting per vault, and marking what the kept backups use
+    // before deleting anything
+    QSet<QByteArray> used;
+    QHash<QString, int> keptPerVault;
+    QStringList expired;
+    for (qsizetype i = ids.size() - 1; i >= 0; --i) {
+        Snapshot snapshot;
+        QByteArray chunkIds;
+        if (!readManifest(ids.at(i), &snapshot, &chunkIds, errorMessage)) {
+            return false;
+        }
+        int &kept = keptPerVault[snapshot.vaultName];
+        if (kept >= keep) {
+            expired.append(ids.at(i));
+            continue;
+        }
+        ++kept;
+        for (qsizetype at = 0; at < chunkIds.size(); at += kIdBytes) {
+            used.insert(chunkIds.mid(at, kIdBytes).toHex());
+        }
+    }
+    for (const QString &id : std::as_const(expired)) {
+        if (snapshotDir.remove(id)) {
+            ++*removedSnapshots;
+        }
+    }
+
+    // Sweep
+    QDir chunkDir(m_directory + QLatin1String("/chunks"));
+    for (const QString &subdirectory : chunkDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        QDir dir(chunkDir.filePath(subdirectory));
+        for (const QString &name : dir.entryList(QDir::Files)) {
+            if (!used.contains(name.toLatin1()) && dir.remove(name)) {
+                ++*removedChunks;
+            }
+        }
+    }
+    return true;
+}
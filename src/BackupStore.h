@@ -0,0 +1,76 @@
+#ifndef BACKUPSTORE_H
+#define BACKUPSTORE_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QList>
+#include <QString>
+
+// Deduplicating store of vault backups in a directory.
+//
+// A backup splits the plaintext serialization into content-defined chunks
+// (a gear rolling hash picks the cut points, so an edit only changes the
+// chunks around it) and stores each chunk once, named by a keyed hash of its
+// plaintext. Chunks are encrypted with a nonce derived from the same hash, so
+// an unchanged chunk encrypts to the same file and is not written again. Each
+// backup adds one small encrypted manifest listing its chunks: N backups of a
+// slowly changing vault cost about one vault plus the chunks that changed.
+//
+// Layout:
+//   config                 "ALOCK_BACKUP_V1" | KDF salt | key check
+//   chunks/ab/abcd...      secretbox of a chunk; the name is its id in hex
+//   snapshots/<time>       nonce | secretbox of the manifest
+//
+// The keys come from one Argon2id run over the master password with the
+// store's salt, split with crypto_kdf. Functions taking an errorMessage fill
+// it with a translated, user-facing message when they fail.
+class BackupStore
+{
+public:
+    struct Snapshot {
+        QString id; // File name under snapshots/; sorts by time
+        QDateTime created;
+        QString vaultName;
+        qint64 size = 0; // Plaintext bytes
+        int chunkCount = 0;
+    };
+
+    struct Stats {
+        int newChunks = 0; // Not in the store before this backup
+        qint64 newBytes = 0; // Written for them
+    };
+
+    BackupStore() = default;
+    BackupStore(const BackupStore &) = delete;
+    BackupStore &operator=(const BackupStore &) = delete;
+    ~BackupStore(); // Wipes the keys
+
+    // Opens the store in directory, creating it if it has no config yet
+    bool open(const QString &directory, const QByteArray &passwordUtf8, QString *errorMessage);
+    QString directory() const { return m_directory; }
+
+    bool backup(const QByteArray &plaintext, const QString &vaultName, Snapshot *snapshot, Stats *stats,
+                QString *errorMessage);
+    bool snapshots(QList<Snapshot> *snapshots, QString *errorMessage) const; // Oldest first
+    // Reassembles a backup; the caller wipes plaintext
+    bool restore(const QString &snapshotId, QByteArray *plaintext, QString *errorMessage) const;
+    // Keeps the newest keep backups of each vault (by vaultName) and deletes the
+    // chunks only the others used.
+    // Not safe to run while another process backs up into the store.
+    bool prune(int keep, int *removedSnapshots, int *removedChunks, QString *errorMessage);
+
+private:
+    static constexpr int kKeyBytes = 32;
+    static constexpr int kIdBytes = 32;
+
+    QString chunkPath(const QByteArray &id) const;
+    QString snapshotPath(const QString &snapshotId) const;
+    bool readManifest(const QString &snapshotId, Snapshot *snapshot, QByteArray *ids, QString *errorMessage) const;
+
+    QString m_directory;
+    unsigned char m_idKey[kKeyBytes] = {};       // Chunk ids and nonces
+    unsigned char m_chunkKey[kKeyBytes] = {};    // Chunk encryption
+    unsigned char m_manifestKey[kKeyBytes] = {}; // Manifests and the key check
+};
+
+#endif // BACKUPSTORE_H
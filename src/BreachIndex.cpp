@@ -0,0 +1,375 @@
+#include "BreachIndex.h"
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QtEndian>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include <sodium.h> // Required for sodium_memzero
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h> // Required for madvise
+#endif
+
+namespace {
+
+const char kMagic[] = "ALHIBPv1";
+constexpr int kMagicSize = sizeof kMagic - 1;
+constexpr qint64 kHeaderSize = 64;
+constexpr int kPrefixBytes = 3;
+constexpr quint32 kPrefixCount = 1u << (8 * kPrefixBytes);
+constexpr qint64 kTableSize = qint64(kPrefixCount + 1) * 4;
+constexpr qint64 kRecordsOffset = kHeaderSize + kTableSize;
+constexpr int kRecordSize = 8;
+constexpr int kKeptHashBytes = kPrefixBytes + kRecordSize;
+constexpr qint64 kBloomBlockSize = 64; // A cache line: one block per lookup
+constexpr int kBloomProbes = 6;        // Nine bits each, taken from one 64-bit hash
+constexpr qint64 kChunkSize = 1 << 20;
+
+// Header fields
+constexpr int kAlgorithmOffset = 8;
+constexpr int kBloomBitsOffset = 12;
+constexpr int kCountOffset = 16;
+constexpr int kBloomBlocksOffset = 24;
+
+QString tr(const char *text)
+{
+    return QCoreApplication::translate("BreachIndex", text);
+}
+
+void setError(QString *errorMessage, const QString &message)
+{
+    if (errorMessage) {
+        *errorMessage = message;
+    }
+}
+
+quint64 mix(quint64 x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccd;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53;
+    x ^= x >> 33;
+    return x;
+}
+
+// The Bloom filter only sees what the index keeps of a hash
+struct BloomProbe {
+    quint64 block;
+    quint64 bits;
+};
+
+BloomProbe bloomProbe(quint32 prefix, quint64 suffix, quint64 blocks)
+{
+    const quint64 key = mix(suffix + quint64(prefix) * 0x9e3779b97f4a7c15);
+    return BloomProbe{key % blocks, mix(key ^ 0xc2b2ae3d27d4eb4f)};
+}
+
+int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+quint32 prefixOf(const unsigned char *hash)
+{
+    return quint32(hash[0]) << 16 | quint32(hash[1]) << 8 | quint32(hash[2]);
+}
+
+} // namespace
+
+bool BreachIndex::build(const QString &hashFile, const QString &indexFile, int bloomBitsPerEntry, qint64 *count,
+                        QString *errorMessage)
+{
+    QFile input(hashFile);
+    if (!input.open(QIODevice::ReadOnly)) {
+        setError(errorMessage, tr("Cannot open file %1:\n%2.").arg(hashFile, input.errorString()));
+        return false;
+    }
+    const QString partPath = indexFile + QLatin1String(".part");
+    QFile output(partPath);
+    // Room for the header and the table, written once the counts are known
+    if (!output.open(QIODevice::ReadWrite | QIODevice::Truncate) || !output.resize(kRecordsOffset)
+        || !output.seek(kRecordsOffset)) {
+        setError(errorMessage, tr("Cannot write file %1:\n%2.").arg(partPath, output.errorString()));
+        return false;
+    }
+
+    std::vector<quint32> offsets(kPrefixCount + 1, 0); // Counts per prefix first
+    QByteArray records;
+    records.reserve(kChunkSize + kRecordSize);
+    unsigned char previous[kKeptHashBytes] = {};
+    int hashBytes = 0; // From the first line: 20 for SHA-1, 16 for NTLM
+    qint64 total = 0;
+    qint64 lineNumber = 0;
+    bool failed = false;
+
+    const auto takeLine = [&](const char *begin, const char *end) {
+        ++lineNumber;
+        while (end > begin && (end[-1] == '\r' || end[-1] == ' ')) {
+            --end;
+        }
+        if (begin == end) {
+            return;
+        }
+        const char *colon = static_cast<const char *>(std::memchr(begin, ':', size_t(end - begin)));
+        const qsizetype hexLength = (colon ? colon : end) - begin;
+        if (hashBytes == 0) {
+            hashBytes = hexLength == 40 ? 20 : hexLength == 32 ? 16 : 0;
+        }
+        unsigned char hash[kKeptHashBytes];
+        bool valid = hashBytes != 0 && hexLength == 2 * hashBytes;
+        for (int i = 0; valid && i < kKeptHashBytes; ++i) {
+            const int high = hexValue(begin[2 * i]);
+            const int low = hexValue(begin[2 * i + 1]);
+            valid = high >= 0 && low >= 0;
+            hash[i] = static_cast<unsigned char>(high << 4 | low);
+        }
+        if (!valid) {
+            setError(errorMessage, tr("Line %1 of %2 is not a SHA-1 or NTLM hash.").arg(lineNumber).arg(hashFile));
+            failed = true;
+            return;
+        }
+        const int order = total == 0 ? 1 : std::memcmp(hash, previous, kKeptHashBytes);
+        if (order < 0) {
+            setError(errorMessage, tr("%1 is not sorted by hash (line %2). Download the list ordered by hash.")
+                                       .arg(hashFile).arg(lineNumber));
+            failed = true;
+            return;
+        }
+        if (order == 0) {
+            return; // Differs from the line before only past the bytes the index keeps
+        }
+        if (total == qint64(std::numeric_limits<quint32>::max())) {
+            setError(errorMessage, tr("%1 has more hashes than an index can hold.").arg(hashFile));
+            failed = true;
+            return;
+        }
+        std::memcpy(previous, hash, kKeptHashBytes);
+        ++offsets[prefixOf(hash)];
+        records.append(reinterpret_cast<const char *>(hash + kPrefixBytes), kRecordSize); // Already big-endian
+        ++total;
+        if (records.size() >= kChunkSize) {
+            failed = output.write(records) != records.size();
+            records.resize(0);
+        }
+    };
+
+    // Whole lines from each chunk; a partial last line waits for the next one
+    QByteArray chunk;
+    qsizetype carried = 0;
+    while (!failed) {
+        chunk.resize(carried + kChunkSize);
+        const qint64 read = input.read(chunk.data() + carried, kChunkSize);
+        if (read < 0) {
+            setError(errorMessage, tr("Cannot read file %1:\n%2.").arg(hashFile, input.errorString()));
+            failed = true;
+            break;
+        }
+        const char *begin = chunk.constData();
+        const char *end = begin + carried + read;
+        for (const char *newline; !failed && (newline = static_cast<const char *>(std::memchr(begin, '\n', size_t(end - begin))));
+             begin = newline + 1) {
+            takeLine(begin, newline);
+        }
+        carried = end - begin;
+        if (read == 0) {
+            if (carried > 0 && !failed) {
+                takeLine(begin, end);
+            }
+            break;
+        }
+        std::memmove(chunk.data(), begin, size_t(carried));
+    }
+    if (!failed && !records.isEmpty()) {
+        failed = output.write(records) != records.size();
+    }
+    if (failed) {
+        if (errorMessage && errorMessage->isEmpty()) {
+            *errorMessage = tr("Cannot write file %1:\n%2.").arg(partPath, output.errorString());
+        }
+        output.remove();
+        return false;
+    }
+
+    // Counts to start offsets, stored little-endian
+    QByteArray table(kTableSize, Qt::Uninitialized);
+    quint32 start = 0;
+    for (quint32 prefix = 0; prefix <= kPrefixCount; ++prefix) {
+        const quint32 prefixCount = prefix < kPrefixCount ? offsets[prefix] : 0;
+        offsets[prefix] = start;
+        qToLittleEndian(start, table.data() + qint64(prefix) * 4);
+        start += prefixCount;
+    }
+
+    quint64 bloomBlocks = 0;
+    if (bloomBitsPerEntry > 0 && total > 0) {
+        bloomBlocks = (quint64(total) * quint64(bloomBitsPerEntry) + 8 * kBloomBlockSize - 1) / (8 * kBloomBlockSize);
+        const qint64 bloomOffset = (kRecordsOffset + total * kRecordSize + kBloomBlockSize - 1) / kBloomBlockSize * kBloomBlockSize;
+        output.flush();
+        uchar *bloom = output.resize(bloomOffset + qint64(bloomBlocks) * kBloomBlockSize)
+                           ? output.map(bloomOffset, qint64(bloomBlocks) * kBloomBlockSize)
+                           : nullptr;
+        const uchar *stored = output.map(kRecordsOffset, total * kRecordSize);
+        if (!bloom || !stored) {
+            setError(errorMessage, tr("Cannot map file %1:\n%2.").arg(partPath, output.errorString()));
+            output.remove();
+            return false;
+        }
+        // Second pass over the records just written, so the input is read once
+        for (quint32 prefix = 0; prefix < kPrefixCount; ++prefix) {
+            for (quint32 i = offsets[prefix]; i < offsets[prefix + 1]; ++i) {
+                const BloomProbe probe = bloomProbe(prefix, qFromBigEndian<quint64>(stored + qint64(i) * kRecordSize), bloomBlocks);
+                uchar *block = bloom + probe.block * kBloomBlockSize;
+                for (int j = 0; j < kBloomProbes; ++j) {
+                    const unsigned bit = unsigned(probe.bits >> (9 * j)) & 511;
+                    block[bit >> 3] |= uchar(1u << (bit & 7));
+                }
+            }
+        }
+        output.unmap(bloom);
+        output.unmap(const_cast<uchar *>(stored));
+    }
+
+    QByteArray header(kHeaderSize, '\0');
+    std::memcpy(header.data(), kMagic, kMagicSize);
+    header[kAlgorithmOffset] = char(hashBytes == 20 ? Algorithm::Sha1 : Algorithm::Ntlm);
+    qToLittleEndian(quint32(bloomBlocks ? bloomBitsPerEntry : 0), header.data() + kBloomBitsOffset);
+    qToLittleEndian(quint64(total), header.data() + kCountOffset);
+    qToLittleEndian(bloomBlocks, header.data() + kBloomBlocksOffset);
+    if (!output.seek(0) || output.write(header) != header.size() || output.write(table) != table.size()) {
+        setError(errorMessage, tr("Cannot write file %1:\n%2.").arg(partPath, output.errorString()));
+        output.remove();
+        return false;
+    }
+    output.close();
+    QFile::remove(indexFile);
+    if (!QFile::rename(partPath, indexFile)) {
+        setError(errorMessage, tr("Cannot write file %1.").arg(indexFile));
+        return false;
+    }
+    if (count) {
+        *count = total;
+    }
+    return true;
+}
+
+bool BreachIndex::open(const QString &indexFile, QString *errorMessage)
+{
+    m_file.setFileName(indexFile);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        setError(errorMessage, tr("Cannot open file %1:\n%2.").arg(indexFile, m_file.errorString()));
+        return false;
+    }
+    const qint64 fileSize = m_file.size();
+    const uchar *data = fileSize >= kRecordsOffset ? m_file.map(0, fileSize) : nullptr;
+    if (!data || std::memcmp(data, kMagic, kMagicSize) != 0) {
+        setError(errorMessage, tr("%1 is not a breach index.").arg(indexFile));
+        m_file.close();
+        return false;
+    }
+    // Both counts are bounded by the file size before anything is multiplied,
+    // so a damaged header can't overflow the offsets
+    const quint64 storedCount = qFromLittleEndian<quint64>(data + kCountOffset);
+    const quint64 bloomBlocks = qFromLittleEndian<quint64>(data + kBloomBlocksOffset);
+    const bool countFits = storedCount <= quint64(fileSize - kRecordsOffset) / kRecordSize;
+    const qint64 count = countFits ? qint64(storedCount) : 0;
+    const qint64 bloomOffset = (kRecordsOffset + count * kRecordSize + kBloomBlockSize - 1) / kBloomBlockSize * kBloomBlockSize;
+    if (!countFits
+        || (bloomBlocks && (bloomOffset > fileSize || bloomBlocks > quint64(fileSize - bloomOffset) / kBloomBlockSize))) {
+        setError(errorMessage, tr("%1 is truncated.").arg(indexFile));
+        m_file.unmap(const_cast<uchar *>(data));
+        m_file.close();
+        return false;
+    }
+    // Lookups trust the prefix table to bound their binary search: it has to
+    // run from 0 up to count without going back
+    const uchar *table = data + kHeaderSize;
+    quint32 previous = 0;
+    bool tableValid = qFromLittleEndian<quint32>(table) == 0;
+    for (quint32 prefix = 1; tableValid && prefix <= kPrefixCount; ++prefix) {
+        const quint32 offset = qFromLittleEndian<quint32>(table + qint64(prefix) * 4);
+        tableValid = offset >= previous;
+        previous = offset;
+    }
+    if (!tableValid || previous != quint64(count)) {
+        setError(errorMessage, tr("%1 is damaged.").arg(indexFile));
+        m_file.unmap(const_cast<uchar *>(data));
+        m_file.close();
+        return false;
+    }
+#ifdef Q_OS_UNIX
+    // Lookups jump around; reading ahead would only evict useful pages
+    madvise(const_cast<uchar *>(data), size_t(fileSize), MADV_RANDOM);
+#endif
+
+    m_data = data;
+    m_algorithm = data[kAlgorithmOffset] == quint8(Algorithm::Ntlm) ? Algorithm::Ntlm : Algorithm::Sha1;
+    m_count = count;
+    m_table = table;
+    m_records = data + kRecordsOffset;
+    m_bloomBlocks = bloomBlocks;
+    m_bloom = bloomBlocks ? data + bloomOffset : nullptr;
+    return true;
+}
+
+bool BreachIndex::mayContain(quint32 prefix, quint64 suffix) const
+{
+    const BloomProbe probe = bloomProbe(prefix, suffix, m_bloomBlocks);
+    const uchar *block = m_bloom + probe.block * kBloomBlockSize;
+    for (int j = 0; j < kBloomProbes; ++j) {
+        const unsigned bit = unsigned(probe.bits >> (9 * j)) & 511;
+        if (!(block[bit >> 3] & (1u << (bit & 7)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BreachIndex::containsHash(const unsigned char *hash) const
+{
+    const quint32 prefix = prefixOf(hash);
+    const quint64 suffix = qFromBigEndian<quint64>(hash + kPrefixBytes);
+    if (m_bloom && !mayContain(prefix, suffix)) {
+        return false;
+    }
+    quint32 low = qFromLittleEndian<quint32>(m_table + qint64(prefix) * 4);
+    quint32 high = qFromLittleEndian<quint32>(m_table + qint64(prefix + 1) * 4);
+    while (low < high) {
+        const quint32 middle = low + (high - low) / 2;
+        const quint64 record = qFromBigEndian<quint64>(m_records + qint64(middle) * kRecordSize);
+        if (record < suffix) {
+            low = middle + 1;
+        } else if (record > suffix) {
+            high = middle;
+        } else {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BreachIndex::contains(QStringView password) const
+{
+    QByteArray digest;
+    if (m_algorithm == Algorithm::Sha1) {
+        QByteArray utf8 = password.toUtf8();
+        digest = QCryptographicHash::hash(utf8, QCryptographicHash::Sha1);
+        sodium_memzero(utf8.data(), size_t(utf8.size()));
+    } else {
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        digest = QCryptographicHash::hash(QByteArray::fromRawData(reinterpret_cast<const char *>(password.utf16()),
+                                                                  password.size() * qsizetype(sizeof(char16_t))),
+                                          QCryptographicHash::Md4);
+#else
+        QByteArray utf16le(password.size() * qsizetype(sizeof(char16_t)), Qt::Uninitialized);
+        qToLittleEndian<char16_t>(password.utf16(), password.size(), utf16le.data());
+        digest = QCryptographicHash::hash(utf16le, QCryptographicHash::Md4);
+        sodium_memzero(utf16le.data(), size_t(utf16le.size()));
+#endif
+    }
+    return containsHash(reinterpret_cast<const unsigned char *>(digest.constData()));
+}
@@ -0,0 +1,65 @@
+#ifndef BREACHINDEX_H
+#define BREACHINDEX_H
+
+#include <QFile>
+#include <QString>
+#include <QStringView>
+
+// Offline check of passwords against the Have I Been Pwned corpus.
+//
+// build() converts the downloaded hash list ("HASH:COUNT" lines sorted by
+// hash, SHA-1 or NTLM) once into an index file:
+//
+//   header (64 bytes)
+//   prefix table   2^24 + 1 little-endian quint32: where each 3-byte prefix starts
+//   records        count big-endian quint64: hash bytes 3..10, sorted
+//   Bloom filter   optional; 512-bit blocks, one block per lookup
+//
+// The prefix table front-codes the records: their first three bytes are the
+// table slot, so a record keeps only the next eight. 88 bits of hash leave a
+// false match rate around 1e-17 at a billion hashes, for 8 bytes per hash.
+//
+// open() maps the file instead of reading it. A lookup touches the Bloom block
+// (and stops there for most passwords that aren't in the corpus), two table
+// entries and a binary search over ~50 records of one prefix: a few pages of a
+// multi-gigabyte file. Lookups are const and safe from any number of threads.
+class BreachIndex
+{
+public:
+    enum class Algorithm : quint8 {
+        Sha1 = 1, // SHA-1 of the UTF-8 password
+        Ntlm = 2, // MD4 of the UTF-16LE password
+    };
+
+    BreachIndex() = default;
+    BreachIndex(const BreachIndex &) = delete;
+    BreachIndex &operator=(const BreachIndex &) = delete;
+
+    // Streams hashFile into indexFile; bloomBitsPerEntry 0 leaves the filter out
+    // (10 gives about 1% false positives, which then fall through to the records)
+    static bool build(const QString &hashFile, const QString &indexFile, int bloomBitsPerEntry, qint64 *count,
+                      QString *errorMessage);
+
+    bool open(const QString &indexFile, QString *errorMessage);
+    bool isOpen() const { return m_data != nullptr; }
+    Algorithm algorithm() const { return m_algorithm; }
+    qint64 size() const { return m_count; }
+
+    // Hashes password with the index's algorithm
+    bool contains(QStringView password) const;
+    bool containsHash(const unsigned char *hash) const; // At least 11 bytes of the hash
+
+private:
+    bool mayContain(quint32 prefix, quint64 suffix) const;
+
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    Algorithm m_algorithm = Algorithm::Sha1;
+    qint64 m_count = 0;
+    const uchar *m_table = nullptr;
+    const uchar *m_records = nullptr;
+    const uchar *m_bloom = nullptr; // nullptr without a filter
+    quint64 m_bloomBlocks = 0;
+};
+
+#endif // BREACHINDEX_H
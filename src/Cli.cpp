@@ -0,0 +1,893 @@
+#include "Cli.h"
+#include "AttachmentStore.h"
+#include "BackupStore.h"
+#include "BreachIndex.h"
+#include "Exporter.h"
+#include "PasswordAudit.h"
+#include "UnlockAgent.h"
+#include "VaultBatch.h"
+#include "VaultFile.h"
+#include "VaultSnapshot.h"
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QFile>
+#include <QSaveFile> // Required for writing attachments out whole or not at all
+#include <QSettings> // Required for remembering the breach index
+#include <algorithm> // Required for std::find_if
+#include <cstdio>
+#include <cstring> // Required for strcmp
+#include <sodium.h> // Required for sodium_memzero
+
+#ifdef Q_OS_WIN
+#include <windows.h> // Required for disabling console echo
+#include <fcntl.h> // Required for writing exports and attachments to stdout in binary mode
+#include <io.h>
+#else
+#include <termios.h> // Required for disabling terminal echo
+#include <unistd.h>
+#include <cerrno>
+#include <fcntl.h> // Required for pointing a detached agent's standard streams at /dev/null
+#endif
+
+namespace {
+
+enum ExitCode {
+    ExitOk = 0,
+    ExitNotFound = 1,
+    ExitError = 2,
+};
+
+constexpr int kDefaultAgentTtlSeconds = 15 * 60;
+
+const char kUsage[] =
+    "Usage:\n"
+    "  arcanelock                                     Start the GUI\n"
+    "  arcanelock agent <vault> [--ttl <seconds>] [--detach]\n"
+    "                                                 Unlock the vault and serve lookups (0 = no expiry)\n"
+    "  arcanelock get <vault> <entry> [--field <f>]   Print a field of an entry (default: password)\n"
+    "  arcanelock find <vault> <query>                List the entries matching a search query\n"
+    "  arcanelock url <vault> <url>                   List the entries for the host of a URL\n"
+    "  arcanelock export <vault> [--format csv|json] [--folder <path>] [--fields <f,...>] [--redact] [--output <file>]\n"
+    "                                                 Write the entries as CSV or JSON (default: stdout)\n"
+    "  arcanelock attachment <vault> <entry> [<name>] [--output <file>]\n"
+    "                                                 List an entry's attachments, or write one out (default: stdout)\n"
+    "  arcanelock audit <vault> [--stale-days <n>] [--breaches <index>]\n"
+    "                                                 List reused, weak, stale and breached passwords\n"
+    "  arcanelock hibp-index <hashes> <index> [--bloom <bits>]\n"
+    "                                                 Convert a downloaded HIBP hash list into a breach index\n"
+    "  arcanelock backup <vault> <store>              Add a backup of the vault to a backup store\n"
+    "  arcanelock backups <store>                     List the backups in a store\n"
+    "  arcanelock restore <store> <backup> <file> [--attachments <vault>]\n"
+    "                                                 Write a backup out as a new vault file\n"
+    "  arcanelock prune <store> --keep <n>            Delete all but the newest n backups of each vault\n"
+    "  arcanelock batch verify|upgrade|rekey [--input-fd <n>] [--jobs <n>] [--memory <MiB>] [--force]\n"
+    "                                                 Check or rewrite many vaults at once\n"
+    "  arcanelock status                              Show which vault the agent holds\n"
+    "  arcanelock lock                                Wipe the agent's vault and stop it\n"
+    "\n"
+    "Entries are addressed by path (\"Folder/Entry\") or by name when it is unique.\n"
+    "Export columns are folder, the field names (name, username, password, url, notes),\n"
+    "fields (all custom fields) or a custom field key. --redact leaves passwords and\n"
+    "secret fields empty.\n"
+    "\n"
+    "A backup store is a directory, created by the first backup into it and locked\n"
+    "with that vault's master password. Unchanged parts of a vault are stored once.\n"
+    "Backups hold no attachment blobs: restore --attachments copies them from the vault\n"
+    "that was backed up, so the restored file's entries can open theirs.\n"
+    "\n"
+    "hibp-index reads the SHA-1 or NTLM list ordered by hash (HASH:COUNT lines) and\n"
+    "remembers the index for later audits; --bloom sets the filter's bits per hash\n"
+    "(default 10, 0 for none).\n"
+    "\n"
+    "batch reads one vault per line from standard input or file descriptor n:\n"
+    "<path>[<TAB><master password>[<TAB><new master password>]]. Without a password\n"
+    "the unlock agent's copy is used. upgrade re-seals files made with older KDF\n"
+    "settings (all of them with --force); rekey sets the new master password. Files\n"
+    "are replaced atomically. At most --memory MiB (default: half the RAM) go to\n"
+    "key derivation at once. The report has one line per file: outcome, path, detail.\n";
+
+void printLine(FILE *stream, const QString &text)
+{
+    const QByteArray utf8 = text.toUtf8();
+    std::fwrite(utf8.constData(), 1, size_t(utf8.size()), stream);
+    std::fputc('\n', stream);
+}
+
+int usageError()
+{
+    std::fputs(kUsage, stderr);
+    return ExitError;
+}
+
+// Reads a line from the terminal with echo turned off
+QByteArray readPassword(const QString &prompt)
+{
+    std::fputs(prompt.toUtf8().constData(), stderr);
+    std::fflush(stderr);
+
+#ifdef Q_OS_WIN
+    HANDLE input = GetStdHandle(STD_INPUT_HANDLE);
+    DWORD mode = 0;
+    const bool console = GetConsoleMode(input, &mode);
+    if (console) SetConsoleMode(input, mode & ~DWORD(ENABLE_ECHO_INPUT));
+#else
+    termios saved;
+    const bool terminal = tcgetattr(STDIN_FILENO, &saved) == 0;
+    if (terminal) {
+        termios silent = saved;
+        silent.c_lflag &= ~tcflag_t(ECHO);
+        tcsetattr(STDIN_FILENO, TCSAFLUSH, &silent);
+    }
+#endif
+
+    QByteArray password;
+    int c;
+    while ((c = std::fgetc(stdin)) != EOF && c != '\n') {
+        if (c != '\r') password.append(char(c));
+    }
+
+#ifdef Q_OS_WIN
+    if (console) SetConsoleMode(input, mode);
+#else
+    if (terminal) tcsetattr(STDIN_FILENO, TCSAFLUSH, &saved);
+#endif
+    std::fputc('\n', stderr);
+    return password;
+}
+
+void wipe(QByteArray *data)
+{
+    sodium_memzero(data->data(), size_t(data->size()));
+    data->clear();
+}
+
+// Prompts for the master password and decrypts the vault in-process
+bool unlockLocally(const QString &vaultPath, QByteArray *document)
+{
+    QByteArray password = readPassword(QCoreApplication::translate("Cli", "Master password for %1: ").arg(vaultPath));
+    QString errorMessage;
+    const bool opened = VaultFile::open(vaultPath, password, document, &errorMessage);
+    wipe(&password);
+    if (!opened) {
+        printLine(stderr, errorMessage);
+    }
+    return opened;
+}
+
+// Installed memory in bytes; 0 if unknown
+qint64 physicalMemory()
+{
+#ifdef Q_OS_WIN
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof status;
+    return GlobalMemoryStatusEx(&status) ? qint64(status.ullTotalPhys) : 0;
+#else
+    const long pages = sysconf(_SC_PHYS_PAGES);
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    return pages > 0 && pageSize > 0 ? qint64(pages) * pageSize : 0;
+#endif
+}
+
+// Takes the value of "--name <value>" out of arguments
+bool takeOption(QStringList *arguments, const QString &name, QString *value)
+{
+    const int index = arguments->indexOf(name);
+    if (index < 0 || index + 1 >= arguments->size()) {
+        return false;
+    }
+    *value = arguments->at(index + 1);
+    arguments->remove(index, 2);
+    return true;
+}
+
+#ifndef Q_OS_WIN
+// Forks once the password has been read, so the prompt still has the terminal.
+// The parent waits for the child to report whether its agent started and exits
+// with that status; the child goes on in a session of its own, where a shell's
+// job control can't stop it for touching the terminal. Returns -1 in the child,
+// with *reportFd open for the status byte, and the exit status in the parent.
+int detachAgent(int *reportFd)
+{
+    int fds[2];
+    if (pipe(fds) != 0) {
+        printLine(stderr, QCoreApplication::translate("Cli", "Cannot detach: %1.").arg(QString::fromLocal8Bit(strerror(errno))));
+        return ExitError;
+    }
+    const pid_t pid = fork();
+    if (pid < 0) {
+        printLine(stderr, QCoreApplication::translate("Cli", "Cannot detach: %1.").arg(QString::fromLocal8Bit(strerror(errno))));
+        close(fds[0]);
+        close(fds[1]);
+        return ExitError;
+    }
+    if (pid > 0) {
+        close(fds[1]);
+        unsigned char status = ExitError; // Stays so if the child dies first
+        ssize_t got;
+        do {
+            got = read(fds[0], &status, 1);
+        } while (got < 0 && errno == EINTR);
+        close(fds[0]);
+        return got == 1 ? int(status) : int(ExitError);
+    }
+    close(fds[0]);
+    setsid();
+    *reportFd = fds[1];
+    return -1;
+}
+
+// Tells the waiting parent how the start went; on success the agent lets go of the terminal
+void reportDetached(int reportFd, int status)
+{
+    const unsigned char byte = static_cast<unsigned char>(status);
+    while (write(reportFd, &byte, 1) < 0 && errno == EINTR) {
+    }
+    close(reportFd);
+    if (status != ExitOk) {
+        return;
+    }
+    const int null = open("/dev/null", O_RDWR);
+    if (null >= 0) {
+        dup2(null, STDIN_FILENO);
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        if (null > STDERR_FILENO) {
+            close(null);
+        }
+    }
+}
+#endif
+
+int runAgent(QStringList arguments)
+{
+    QString ttlText;
+    int ttlSeconds = kDefaultAgentTtlSeconds;
+    if (takeOption(&arguments, QStringLiteral("--ttl"), &ttlText)) {
+        bool ok = false;
+        ttlSeconds = ttlText.toInt(&ok);
+        if (!ok || ttlSeconds < 0) return usageError();
+    }
+    const bool detach = arguments.removeAll(QStringLiteral("--detach")) > 0;
+    if (arguments.size() != 1) return usageError();
+#ifdef Q_OS_WIN
+    if (detach) {
+        printLine(stderr, QCoreApplication::translate("Cli", "--detach is not supported on Windows; start the agent in a window of its own."));
+        return ExitError;
+    }
+#endif
+
+    QByteArray document;
+    if (!unlockLocally(arguments.at(0), &document)) {
+        return ExitError;
+    }
+    int reportFd = -1;
+#ifndef Q_OS_WIN
+    // Before the agent starts: no threads or sockets yet for the fork to split
+    if (detach) {
+        const int parentStatus = detachAgent(&reportFd);
+        if (parentStatus >= 0) {
+            wipe(&document); // The child holds the vault now
+            return parentStatus;
+        }
+    }
+#endif
+    UnlockAgent agent;
+    QString errorMessage;
+    const bool started = agent.start(arguments.at(0), &document, ttlSeconds, &errorMessage);
+    if (started) {
+        QObject::connect(&agent, &UnlockAgent::locked, qApp, &QCoreApplication::quit);
+        printLine(stderr, ttlSeconds > 0
+            ? QCoreApplication::translate("Cli", "Agent holds %1 for %2 seconds.").arg(arguments.at(0)).arg(ttlSeconds)
+            : QCoreApplication::translate("Cli", "Agent holds %1 until locked.").arg(arguments.at(0)));
+    } else {
+        printLine(stderr, errorMessage);
+    }
+#ifndef Q_OS_WIN
+    if (reportFd >= 0) {
+        reportDetached(reportFd, started ? ExitOk : ExitError);
+    }
+#endif
+    return started ? QCoreApplication::exec() : int(ExitError);
+}
+
+int runGet(QStringList arguments)
+{
+    QString field = QStringLiteral("password");
+    takeOption(&arguments, QStringLiteral("--field"), &field);
+    if (arguments.size() != 2) return usageError();
+    const QString &vaultPath = arguments.at(0);
+    const QString &entryPath = arguments.at(1);
+
+    QString value;
+    const AgentProtocol::Reply reply = AgentClient::get(vaultPath, entryPath, field, &value);
+    bool found = reply == AgentProtocol::Reply::Ok;
+    if (reply != AgentProtocol::Reply::Ok && reply != AgentProtocol::Reply::NotFound) {
+        QByteArray document;
+        if (!unlockLocally(vaultPath, &document)) {
+            return ExitError;
+        }
+        VaultSnapshot snapshot;
+        snapshot.load(document);
+        wipe(&document);
+        const VaultSnapshot::Entry *entry = snapshot.entry(entryPath);
+        found = entry && VaultSnapshot::fieldValue(entry->record, field, &value);
+    }
+    if (!found) {
+        printLine(stderr, QCoreApplication::translate("Cli", "No field '%1' in entry '%2'.").arg(field, entryPath));
+        return ExitNotFound;
+    }
+    printLine(stdout, value);
+    sodium_memzero(value.data(), size_t(value.size()) * sizeof(QChar));
+    return ExitOk;
+}
+
+int runFind(const QStringList &arguments)
+{
+    if (arguments.size() != 2) return usageError();
+    const QString &vaultPath = arguments.at(0);
+
+    QStringList paths;
+    if (AgentClient::find(vaultPath, arguments.at(1), &paths) != AgentProtocol::Reply::Ok) {
+        QByteArray document;
+        if (!unlockLocally(vaultPath, &document)) {
+            return ExitError;
+        }
+        VaultSnapshot snapshot;
+        snapshot.load(document);
+        wipe(&document);
+        QString queryError;
+        paths = snapshot.search(arguments.at(1), &queryError);
+        if (!queryError.isEmpty()) {
+            printLine(stderr, queryError);
+            return ExitError;
+        }
+    }
+    for (const QString &path : paths) {
+        printLine(stdout, path);
+    }
+    return paths.isEmpty() ? ExitNotFound : ExitOk;
+}
+
+int runUrl(const QStringList &arguments)
+{
+    if (arguments.size() != 2) return usageError();
+    const QString &vaultPath = arguments.at(0);
+    if (HostIndex::normalizedHost(arguments.at(1)).isEmpty()) {
+        printLine(stderr, QCoreApplication::translate("Cli", "No host in '%1'.").arg(arguments.at(1)));
+        return ExitError;
+    }
+
+    QStringList paths;
+    if (AgentClient::matchUrl(vaultPath, arguments.at(1), &paths) != AgentProtocol::Reply::Ok) {
+        QByteArray document;
+        if (!unlockLocally(vaultPath, &document)) {
+            return ExitError;
+        }
+        VaultSnapshot snapshot;
+        snapshot.load(document);
+        wipe(&document);
+        paths = snapshot.matchUrl(arguments.at(1));
+    }
+    for (const QString &path : paths) {
+        printLine(stdout, path);
+    }
+    return paths.isEmpty() ? ExitNotFound : ExitOk;
+}
+
+int runExport(QStringList arguments)
+{
+    Exporter::Options options;
+    options.redactSecrets = arguments.removeAll(QStringLiteral("--redact")) > 0;
+    QString formatName;
+    QString folder;
+    QString columns;
+    QString outputPath;
+    const bool hasFormat = takeOption(&arguments, QStringLiteral("--format"), &formatName);
+    takeOption(&arguments, QStringLiteral("--folder"), &folder);
+    const bool hasColumns = takeOption(&arguments, QStringLiteral("--fields"), &columns);
+    takeOption(&arguments, QStringLiteral("--output"), &outputPath);
+    if (arguments.size() != 1) return usageError();
+    const QString &vaultPath = arguments.at(0);
+
+    if (hasFormat) {
+        if (!Exporter::formatFromName(formatName, &options.format)) return usageError();
+    } else if (!outputPath.isEmpty()) {
+        options.format = Exporter::formatForPath(outputPath);
+    }
+    if (hasColumns) {
+        options.columns.clear();
+        for (const QString &column : columns.split(u',', Qt::SkipEmptyParts)) {
+            if (!Exporter::validColumn(column.trimmed())) {
+                printLine(stderr, QCoreApplication::translate("Cli", "Unknown column '%1'.").arg(column.trimmed()));
+                return ExitError;
+            }
+            options.columns.append(column.trimmed());
+        }
+        if (options.columns.isEmpty()) return usageError();
+    }
+    while (folder.endsWith(u'/')) {
+        folder.chop(1);
+    }
+
+    // The agent's copy if it holds the vault; the snapshot then keeps the
+    // secrets in secure memory and the writer streams them out a chunk at a time
+    QByteArray document;
+    if (AgentClient::document(vaultPath, &document) != AgentProtocol::Reply::Ok
+        && !unlockLocally(vaultPath, &document)) {
+        return ExitError;
+    }
+    VaultSnapshot snapshot;
+    snapshot.load(document);
+    wipe(&document);
+
+    QFile output;
+    bool opened;
+    if (outputPath.isEmpty()) {
+#ifdef Q_OS_WIN
+        _setmode(_fileno(stdout), _O_BINARY); // The writer ends CSV rows with CRLF itself
+#endif
+        std::fflush(stdout);
+        opened = output.open(stdout, QIODevice::WriteOnly | QIODevice::Unbuffered);
+    } else {
+        output.setFileName(outputPath);
+        opened = Exporter::openOwnerOnly(&output, QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered);
+    }
+    if (!opened) {
+        printLine(stderr, QCoreApplication::translate("Cli", "Could not write %1: %2")
+                              .arg(outputPath.isEmpty() ? QStringLiteral("stdout") : outputPath, output.errorString()));
+        return ExitError;
+    }
+
+    Exporter::Writer writer(&output, options);
+    for (const VaultSnapshot::Entry &entry : snapshot.entries()) {
+        const QStringView path(entry.path);
+        if (!folder.isEmpty() && path != folder
+            && !(path.startsWith(folder) && path.size() > folder.size() && path.at(folder.size()) == u'/')) {
+            continue;
+        }
+        const qsizetype slash = path.lastIndexOf(u'/');
+        writer.writeEntry(slash < 0 ? QStringView() : path.left(slash), entry.record);
+    }
+    QString errorMessage;
+    if (!writer.finish(&errorMessage)) {
+        printLine(stderr, errorMessage);
+        return ExitError;
+    }
+    if (writer.entryCount() == 0 && !folder.isEmpty()) {
+        printLine(stderr, QCoreApplication::translate("Cli", "No entries under '%1'.").arg(folder));
+        return ExitNotFound;
+    }
+    return ExitOk;
+}
+
+int runAttachment(QStringList arguments)
+{
+    QString outputPath;
+    takeOption(&arguments, QStringLiteral("--output"), &outputPath);
+    if (arguments.size() != 2 && arguments.size() != 3) return usageError();
+    const QString &vaultPath = arguments.at(0);
+    const QString &entryPath = arguments.at(1);
+
+    QByteArray document;
+    if (AgentClient::document(vaultPath, &document) != AgentProtocol::Reply::Ok
+        && !unlockLocally(vaultPath, &document)) {
+        return ExitError;
+    }
+    VaultSnapshot snapshot;
+    snapshot.load(document);
+    wipe(&document);
+    const VaultSnapshot::Entry *entry = snapshot.entry(entryPath);
+    if (!entry) {
+        printLine(stderr, QCoreApplication::translate("Cli", "No entry '%1'.").arg(entryPath));
+        return ExitNotFound;
+    }
+
+    if (arguments.size() == 2) {
+        for (const Attachment &attachment : entry->record.attachments) {
+            printLine(stdout, QStringLiteral("%1\t%2").arg(attachment.size).arg(attachment.name));
+        }
+        return entry->record.attachments.empty() ? ExitNotFound : ExitOk;
+    }
+    const auto found = std::find_if(entry->record.attachments.begin(), entry->record.attachments.end(),
+                                    [&](const Attachment &attachment) { return attachment.name == arguments.at(2); });
+    if (found == entry->record.attachments.end()) {
+        printLine(stderr, QCoreApplication::translate("Cli", "No attachment '%1' in entry '%2'.").arg(arguments.at(2), entryPath));
+        return ExitNotFound;
+    }
+
+    // Decrypted a chunk at a time straight into the output
+    QSaveFile file(outputPath);
+    QFile console;
+    QIODevice *output = &file;
+    bool opened;
+    if (outputPath.isEmpty()) {
+#ifdef Q_OS_WIN
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        std::fflush(stdout);
+        opened = console.open(stdout, QIODevice::WriteOnly | QIODevice::Unbuffered);
+        output = &console;
+    } else {
+        opened = Exporter::openOwnerOnly(&file, QIODevice::WriteOnly);
+    }
+    if (!opened) {
+        printLine(stderr, QCoreApplication::translate("Cli", "Could not write %1: %2")
+                              .arg(outputPath.isEmpty() ? QStringLiteral("stdout") : outputPath, output->errorString()));
+        return ExitError;
+    }
+    QString errorMessage;
+    if (!AttachmentStore(vaultPath).extract(*found, output, &errorMessage)) {
+        printLine(stderr, errorMessage);
+        return ExitError;
+    }
+    if (!outputPath.isEmpty() && !file.commit()) {
+        printLine(stderr, QCoreApplication::translate("Cli", "Could not write %1: %2").arg(outputPath, file.errorString()));
+        return ExitError;
+    }
+    return ExitOk;
+}
+
+int runAudit(QStringList arguments)
+{
+    PasswordAudit::Options options;
+    QString staleText;
+    if (takeOption(&arguments, QStringLiteral("--stale-days"), &staleText)) {
+        bool ok = false;
+        options.staleAfterDays = staleText.toInt(&ok);
+        if (!ok || options.staleAfterDays < 1) return usageError();
+    }
+    QString indexPath;
+    if (!takeOption(&arguments, QStringLiteral("--breaches"), &indexPath)) {
+        QSettings settings(QSettings::IniFormat, QSettings::UserScope, "ArcaneLock", "ArcaneLock");
+        indexPath = settings.value("breachIndex").toString();
+    }
+    if (arguments.size() != 1) return usageError();
+    const QString &vaultPath = arguments.at(0);
+
+    BreachIndex breaches;
+    if (!indexPath.isEmpty()) {
+        QString errorMessage;
+        if (!breaches.open(indexPath, &errorMessage)) {
+            printLine(stderr, errorMessage);
+            return ExitError;
+        }
+        options.breaches = &breaches;
+    }
+
+    QByteArray document;
+    if (AgentClient::document(vaultPath, &document) != AgentProtocol::Reply::Ok
+        && !unlockLocally(vaultPath, &document)) {
+        return ExitError;
+    }
+    VaultSnapshot snapshot;
+    snapshot.load(document);
+    wipe(&document);
+
+    std::vector<const PasswordRecord *> records;
+    records.reserve(snapshot.entries().size());
+    for (const VaultSnapshot::Entry &entry : snapshot.entries()) {
+        records.push_back(&entry.record);
+    }
+    const std::vector<PasswordAudit::Finding> findings = PasswordAudit::audit(records, options);
+    int flagged = 0;
+    for (std::size_t i = 0; i < findings.size(); ++i) {
+        const PasswordAudit::Finding &finding = findings[i];
+        if (finding.issues == 0) {
+            continue;
+        }
+        ++flagged;
+        QString line = QStringLiteral("%1\t%2\t%3").arg(PasswordAudit::describeIssues(finding.issues),
+                                                        PasswordAudit::strengthName(finding.strength),
+                                                        snapshot.entries()[i].path);
+        if (finding.reuseGroup >= 0) {
+            line += QCoreApplication::translate("Cli", "\tsame password as %1 other(s), group %2")
+                        .arg(finding.reuseCount - 1).arg(finding.reuseGroup + 1);
+        }
+        printLine(stdout, line);
+    }
+    printLine(stderr, QCoreApplication::translate("Cli", "%1 of %2 entries flagged.").arg(flagged).arg(int(findings.size())));
+    return ExitOk;
+}
+
+int runHibpIndex(QStringList arguments)
+{
+    int bloomBits = 10;
+    QString bloomText;
+    if (takeOption(&arguments, QStringLiteral("--bloom"), &bloomText)) {
+        bool ok = false;
+        bloomBits = bloomText.toInt(&ok);
+        if (!ok || bloomBits < 0 || bloomBits > 64) return usageError();
+    }
+    if (arguments.size() != 2) return usageError();
+
+    qint64 count = 0;
+    QString errorMessage;
+    if (!BreachIndex::build(arguments.at(0), arguments.at(1), bloomBits, &count, &errorMessage)) {
+        printLine(stderr, errorMessage);
+        return ExitError;
+    }
+    QSettings settings(QSettings::IniFormat, QSettings::UserScope, "ArcaneLock", "ArcaneLock");
+    settings.setValue("breachIndex", QFileInfo(arguments.at(1)).absoluteFilePath());
+    printLine(stderr, QCoreApplication::translate("Cli", "Indexed %1 hashes into %2.").arg(count).arg(arguments.at(1)));
+    return ExitOk;
+}
+
+int runBatch(QStringList arguments)
+{
+    VaultBatch::Options options;
+    QString text;
+    int inputFd = 0;
+    if (takeOption(&arguments, QStringLiteral("--input-fd"), &text)) {
+        bool ok = false;
+        inputFd = text.toInt(&ok);
+        if (!ok || inputFd < 0) return usageError();
+    }
+    if (takeOption(&arguments, QStringLiteral("--jobs"), &text)) {
+        bool ok = false;
+        options.maxJobs = text.toInt(&ok);
+        if (!ok || options.maxJobs < 1) return usageError();
+    }
+    options.memoryBudget = physicalMemory() / 2;
+    if (takeOption(&arguments, QStringLiteral("--memory"), &text)) {
+        bool ok = false;
+        options.memoryBudget = text.toLongLong(&ok) * 1024 * 1024;
+        if (!ok || options.memoryBudget <= 0) return usageError();
+    }
+    options.force = arguments.removeAll(QStringLiteral("--force")) > 0;
+    if (arguments.size() != 1) return usageError();
+    if (arguments.at(0) == QLatin1String("verify")) {
+        options.operation = VaultBatch::Operation::Verify;
+    } else if (arguments.at(0) == QLatin1String("upgrade")) {
+        options.operation = VaultBatch::Operation::Upgrade;
+    } else if (arguments.at(0) == QLatin1String("rekey")) {
+        options.operation = VaultBatch::Operation::Rekey;
+    } else {
+        return usageError();
+    }
+
+    QFile input;
+    if (!input.open(inputFd, QIODevice::ReadOnly)) {
+        printLine(stderr, QCoreApplication::translate("Cli", "Cannot read file descriptor %1.").arg(inputFd));
+        return ExitError;
+    }
+    // Split in place, so the passwords exist once in the list and once in their job
+    QByteArray list = input.readAll();
+    std::vector<VaultBatch::Job> jobs;
+    for (qsizetype start = 0; start < list.size();) {
+        qsizetype end = list.indexOf('\n', start);
+        if (end < 0) end = list.size();
+        const qsizetype lineEnd = end > start && list.at(end - 1) == '\r' ? end - 1 : end;
+        const qsizetype tab = list.indexOf('\t', start);
+        const qsizetype pathEnd = tab >= 0 && tab < lineEnd ? tab : lineEnd;
+        if (pathEnd > start) {
+            VaultBatch::Job job;
+            job.filePath = QString::fromUtf8(list.constData() + start, pathEnd - start);
+            if (pathEnd < lineEnd) {
+                const qsizetype secondTab = list.indexOf('\t', pathEnd + 1);
+                const qsizetype passwordEnd = secondTab >= 0 && secondTab < lineEnd ? secondTab : lineEnd;
+                job.passwordUtf8 = QByteArray(list.constData() + pathEnd + 1, passwordEnd - pathEnd - 1);
+                if (passwordEnd < lineEnd) {
+                    job.newPasswordUtf8 = QByteArray(list.constData() + passwordEnd + 1, lineEnd - passwordEnd - 1);
+                }
+            }
+            if (job.passwordUtf8.isEmpty()) {
+                AgentClient::document(job.filePath, &job.document);
+            }
+            jobs.push_back(std::move(job));
+        }
+        start = end + 1;
+    }
+    wipe(&list);
+    if (jobs.empty()) {
+        printLine(stderr, QCoreApplication::translate("Cli", "No vaults listed."));
+        return ExitNotFound;
+    }
+
+    const int total = int(jobs.size());
+    options.finished = [total](const VaultBatch::Job &job, int done) {
+        printLine(stderr, QStringLiteral("[%1/%2] %3 %4").arg(done).arg(total).arg(VaultBatch::outcomeName(job.outcome), job.filePath));
+    };
+    const int failed = VaultBatch::run(&jobs, options);
+    for (const VaultBatch::Job &job : jobs) {
+        printLine(stdout, QStringLiteral("%1\t%2\t%3").arg(VaultBatch::outcomeName(job.outcome), job.filePath, job.detail));
+    }
+    printLine(stderr, QCoreApplication::translate("Cli", "%1 of %2 files failed.").arg(failed).arg(total));
+    return failed > 0 ? ExitError : ExitOk;
+}
+
+// Opens a backup store, prompting for the password unless one is given
+bool openStore(BackupStore *store, const QString &directory, QByteArray *password = nullptr)
+{
+    QByteArray prompted;
+    if (!password) {
+        prompted = readPassword(QCoreApplication::translate("Cli", "Master password for %1: ").arg(directory));
+        password = &prompted;
+    }
+    QString errorMessage;
+    const bool opened = store->open(directory, *password, &errorMessage);
+    wipe(&prompted);
+    if (!opened) {
+        printLine(stderr, errorMessage);
+    }
+    return opened;
+}
+
+int runBackup(const QStringList &arguments)
+{
+    if (arguments.size() != 2) return usageError();
+    const QString &vaultPath = arguments.at(0);
+
+    // The store's keys come from the same password, so one prompt serves both
+    QByteArray password = readPassword(QCoreApplication::translate("Cli", "Master password for %1: ").arg(vaultPath));
+    QByteArray document;
+    QString errorMessage;
+    BackupStore store;
+    const bool opened = VaultFile::open(vaultPath, password, &document, &errorMessage);
+    if (!opened) {
+        printLine(stderr, errorMessage);
+    }
+    const bool storeOpened = opened && openStore(&store, arguments.at(1), &password);
+    wipe(&password);
+    if (!storeOpened) {
+        wipe(&document);
+        return ExitError;
+    }
+
+    BackupStore::Snapshot snapshot;
+    BackupStore::Stats stats;
+    const bool saved = store.backup(document, QFileInfo(vaultPath).fileName(), &snapshot, &stats, &errorMessage);
+    wipe(&document);
+    if (!saved) {
+        printLine(stderr, errorMessage);
+        return ExitError;
+    }
+    printLine(stdout, QCoreApplication::translate("Cli", "%1: %2 chunks, %3 new (%4 bytes written)")
+                          .arg(snapshot.id).arg(snapshot.chunkCount).arg(stats.newChunks).arg(stats.newBytes));
+    return ExitOk;
+}
+
+int runBackups(const QStringList &arguments)
+{
+    if (arguments.size() != 1) return usageError();
+    BackupStore store;
+    if (!openStore(&store, arguments.at(0))) {
+        return ExitError;
+    }
+    QList<BackupStore::Snapshot> snapshots;
+    QString errorMessage;
+    if (!store.snapshots(&snapshots, &errorMessage)) {
+        printLine(stderr, errorMessage);
+        return ExitError;
+    }
+    for (const BackupStore::Snapshot &snapshot : std::as_const(snapshots)) {
+        printLine(stdout, QStringLiteral("%1  %2  %3  %4 bytes")
+                              .arg(snapshot.id, snapshot.created.toLocalTime().toString(Qt::ISODate), snapshot.vaultName)
+                              .arg(snapshot.size));
+    }
+    return snapshots.isEmpty() ? ExitNotFound : ExitOk;
+}
+
+int runRestore(QStringList arguments)
+{
+    QString attachmentsFrom;
+    takeOption(&arguments, QStringLiteral("--attachments"), &attachmentsFrom);
+    if (arguments.size() != 3) return usageError();
+    const QString &outputPath = arguments.at(2);
+    if (QFileInfo::exists(outputPath)) {
+        printLine(stderr, QCoreApplication::translate("Cli", "%1 already exists.").arg(outputPath));
+        return ExitError;
+    }
+    QByteArray password = readPassword(QCoreApplication::translate("Cli", "Master password for %1: ").arg(arguments.at(0)));
+    BackupStore store;
+    QByteArray document;
+    QString errorMessage;
+    bool restored = false;
+    if (openStore(&store, arguments.at(0), &password)) {
+        restored = store.restore(arguments.at(1), &document, &errorMessage)
+                   && VaultFile::save(outputPath, document, password, &errorMessage);
+        if (!restored) {
+            printLine(stderr, errorMessage);
+        }
+    }
+    wipe(&document);
+    wipe(&password);
+    if (!restored) {
+        return ExitError;
+    }
+
+    // The blobs live beside the vault that was backed up, not in the store
+    int blobsCopied = 0;
+    if (attachmentsFrom.isEmpty()) {
+        printLine(stderr, QCoreApplication::translate("Cli", "Attachments were not restored; pass --attachments <vault> to copy them."));
+    } else if (!AttachmentStore::mirror(attachmentsFrom, outputPath, &blobsCopied, &errorMessage)) {
+        printLine(stderr, errorMessage);
+        return ExitError;
+    }
+    return ExitOk;
+}
+
+int runPrune(QStringList arguments)
+{
+    QString keepText;
+    if (!takeOption(&arguments, QStringLiteral("--keep"), &keepText) || arguments.size() != 1) return usageError();
+    bool ok = false;
+    const int keep = keepText.toInt(&ok);
+    if (!ok || keep < 1) return usageError();
+    BackupStore store;
+    if (!openStore(&store, arguments.at(0))) {
+        return ExitError;
+    }
+    int removedSnapshots = 0;
+    int removedChunks = 0;
+    QString errorMessage;
+    if (!store.prune(keep, &removedSnapshots, &removedChunks, &errorMessage)) {
+        printLine(stderr, errorMessage);
+        return ExitError;
+    }
+    printLine(stdout, QCoreApplication::translate("Cli", "Removed %1 backups and %2 chunks.")
+                          .arg(removedSnapshots).arg(removedChunks));
+    return ExitOk;
+}
+
+int runStatus()
+{
+    QString vaultPath;
+    qint64 secondsLeft = 0;
+    quint32 entryCount = 0;
+    if (AgentClient::status(&vaultPath, &secondsLeft, &entryCount) != AgentProtocol::Reply::Ok) {
+        printLine(stderr, QCoreApplication::translate("Cli", "No agent is running."));
+        return ExitNotFound;
+    }
+    printLine(stdout, QCoreApplication::translate("Cli", "%1: %2 entries, %3")
+                          .arg(vaultPath).arg(entryCount)
+                          .arg(secondsLeft < 0 ? QCoreApplication::translate("Cli", "no expiry")
+                                               : QCoreApplication::translate("Cli", "locks in %1 s").arg(secondsLeft)));
+    return ExitOk;
+}
+
+int runLock()
+{
+    if (AgentClient::lock() != AgentProtocol::Reply::Ok) {
+        printLine(stderr, QCoreApplication::translate("Cli", "No agent is running."));
+        return ExitNotFound;
+    }
+    return ExitOk;
+}
+
+} // namespace
+
+namespace Cli {
+
+bool isCommand(const char *argument)
+{
+    static const char *const kCommands[] = { "agent", "get", "find", "url", "export", "attachment", "audit", "hibp-index", "backup", "backups", "restore", "prune", "batch", "status", "lock", "help", "--help", "-h" };
+    for (const char *command : kCommands) {
+        if (std::strcmp(argument, command) == 0) return true;
+    }
+    return false;
+}
+
+int run(const QStringList &arguments)
+{
+    const QString command = arguments.value(0);
+    const QStringList rest = arguments.mid(1);
+    if (command == QLatin1String("agent")) return runAgent(rest);
+    if (command == QLatin1String("get")) return runGet(rest);
+    if (command == QLatin1String("find")) return runFind(rest);
+    if (command == QLatin1String("url")) return runUrl(rest);
+    if (command == QLatin1String("export")) return runExport(rest);
+    if (command == QLatin1String("attachment")) return runAttachment(rest);
+    if (command == QLatin1String("audit")) return runAudit(rest);
+    if (command == QLatin1String("hibp-index")) return runHibpIndex(rest);
+    if (command == QLatin1String("backup")) return runBackup(rest);
+    if (command == QLatin1String("backups")) return runBackups(rest);
+    if (command == QLatin1String("restore")) return runRestore(rest);
+    if (command == QLatin1String("prune")) return runPrune(rest);
+    if (command == QLatin1String("batch")) return runBatch(rest);
+    if (command == QLatin1String("status")) return runStatus();
+    if (command == QLatin1String("lock")) return runLock();
+    std::fputs(kUsage, command == QLatin1String("help") || command.startsWith(u'-') ? stdout : stderr);
+    return command == QLatin1String("help") || command.startsWith(u'-') ? ExitOk : ExitError;
+}
+
+} // namespace Cli
@@ -0,0 +1,19 @@
+#ifndef CLI_H
+#define CLI_H
+
+#include <QStringList>
+
+// Command-line front end: "arcanelock <command> ...". get/find ask the unlock
+// agent first and only fall back to prompting for the master password when no
+// agent holds the vault.
+namespace Cli {
+
+bool isCommand(const char *argument);
+
+// arguments excludes the program name. Needs a QCoreApplication (the agent
+// command runs its event loop).
+int run(const QStringList &arguments);
+
+} // namespace Cli
+
+#endif // CLI_H
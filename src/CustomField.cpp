@@ -0,0 +1,186 @@
+#include "CustomField.h"
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QReadWriteLock>
+#include <cstring> // Required for memcmp
+#include <iterator> // Required for std::size
+
+namespace {
+
+// Keys that show up in most vaults, interned up front so their ids are stable
+// and lookups for them never take the write lock.
+const char *const kWellKnownKeys[] = {
+    "api_key", "totp", "recovery_codes", "account_number", "email", "pin", "secret_question", "license_key",
+};
+
+struct KeyTable {
+    QReadWriteLock lock;
+    QHash<QByteArray, FieldKeyId> ids;
+    QList<QString> names; // Indexed by FieldKeyId
+
+    KeyTable()
+    {
+        for (const char *key : kWellKnownKeys) {
+            ids.insert(QByteArray(key), FieldKeyId(names.size()));
+            names.append(QString::fromLatin1(key));
+        }
+    }
+};
+
+KeyTable &keyTable()
+{
+    static KeyTable table;
+    return table;
+}
+
+bool isKeyChar(char16_t c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-';
+}
+
+const char *const kTypeNames[] = { "text", "secret", "totp", "url", "multiline" };
+
+} // namespace
+
+QStringView CustomField::text() const
+{
+    return CustomFieldTypes::isSecret(type) ? secret.view() : QStringView(value);
+}
+
+void CustomField::setText(const QString &text)
+{
+    if (CustomFieldTypes::isSecret(type)) {
+        secret = SecureString::fromString(text);
+        value.clear();
+    } else {
+        value = text;
+        secret = SecureString();
+    }
+}
+
+namespace FieldKeyTable {
+
+bool isValidKey(QByteArrayView key)
+{
+    if (key.isEmpty() || key.size() > 64) return false;
+    for (char c : key) {
+        if (!isKeyChar(char16_t(uchar(c)))) return false;
+    }
+    return true;
+}
+
+bool isValidKey(QStringView key)
+{
+    if (key.isEmpty() || key.size() > 64) return false;
+    for (QChar c : key) {
+        if (!isKeyChar(c.unicode())) return false;
+    }
+    return true;
+}
+
+FieldKeyId intern(QByteArrayView key)
+{
+    if (!isValidKey(key)) return kInvalidKey;
+
+    KeyTable &table = keyTable();
+    // fromRawData avoids allocating just to probe the hash
+    const QByteArray probe = QByteArray::fromRawData(key.data(), key.size());
+    {
+        QReadLocker locker(&table.lock);
+        auto it = table.ids.constFind(probe);
+        if (it != table.ids.constEnd()) return it.value();
+    }
+
+    QWriteLocker locker(&table.lock);
+    auto it = table.ids.constFind(probe);
+    if (it != table.ids.constEnd()) return it.value();
+    if (table.names.size() >= kInvalidKey) return kInvalidKey;
+
+    const FieldKeyId id = FieldKeyId(table.names.size());
+    table.ids.insert(key.toByteArray(), id);
+    table.names.append(QString::fromLatin1(key.data(), key.size()));
+    return id;
+}
+
+FieldKeyId intern(QStringView key)
+{
+    if (!isValidKey(key)) return kInvalidKey;
+    return intern(QByteArrayView(key.toLatin1()));
+}
+
+FieldKeyId find(QStringView key)
+{
+    if (!isValidKey(key)) return kInvalidKey;
+    KeyTable &table = keyTable();
+    QReadLocker locker(&table.lock);
+    return table.ids.value(key.toLatin1(), kInvalidKey);
+}
+
+QString name(FieldKeyId id)
+{
+    KeyTable &table = keyTable();
+    QReadLocker locker(&table.lock);
+    return id < table.names.size() ? table.names.at(id) : QString();
+}
+
+} // namespace FieldKeyTable
+
+namespace CustomFieldTypes {
+
+const char *name(CustomFieldType type)
+{
+    return kTypeNames[int(type)];
+}
+
+bool fromName(QByteArrayView typeName, CustomFieldType *type)
+{
+    for (int i = 0; i < count(); ++i) {
+        const qsizetype length = qsizetype(qstrlen(kTypeNames[i]));
+        if (typeName.size() == length && memcmp(typeName.data(), kTypeNames[i], size_t(length)) == 0) {
+            *type = CustomFieldType(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+int count()
+{
+    return int(std::size(kTypeNames));
+}
+
+} // namespace CustomFieldTypes
+
+namespace CustomFieldCodec {
+
+QString escape(QStringView value)
+{
+    QString escaped;
+    escaped.reserve(value.size());
+    for (QChar c : value) {
+        if (c == u'\\') escaped += QStringLiteral("\\\\");
+        else if (c == u'\n') escaped += QStringLiteral("\\n");
+        else if (c == u'\r') escaped += QStringLiteral("\\r");
+        else escaped += c;
+    }
+    return escaped;
+}
+
+QByteArray unescape(QByteArrayView escaped)
+{
+    QByteArray value;
+    value.reserve(escaped.size());
+    for (qsizetype i = 0; i < escaped.size(); ++i) {
+        const char c = escaped[i];
+        if (c != '\\' || i + 1 == escaped.size()) {
+            value.append(c);
+            continue;
+        }
+        const char next = escaped[++i];
+        value.append(next == 'n' ? '\n' : next == 'r' ? '\r' : next);
+    }
+    return value;
+}
+
+} // namespace CustomFieldCodec
@@ -0,0 +1,88 @@
+#ifndef CUSTOMFIELD_H
+#define CUSTOMFIELD_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+#include <QStringView>
+#include "SecureString.h"
+#include "model/SmallVector.hpp"
+
+// Interned name of a custom field ("api_key", "totp", ...). Entries only store
+// the 16-bit id, so a key shared by thousands of entries exists once.
+using FieldKeyId = quint16;
+
+enum class CustomFieldType : quint8 {
+    Text,
+    Secret,    // Masked in the detail view, not searched
+    Totp,      // TOTP seed, treated like Secret
+    Url,
+    Multiline, // Edited and displayed with line breaks
+};
+
+// Secret and TOTP values are kept in secure memory (secret), every other type in
+// value. Use text()/setText() rather than picking the member by hand.
+struct CustomField {
+    FieldKeyId key;
+    CustomFieldType type;
+    QString value;
+    SecureString secret;
+
+    QStringView text() const;
+    void setText(const QString &text);
+};
+
+// Most entries carry none or a couple of custom fields; those stay inside the record.
+using CustomFieldList = ArcaneLock::SmallVector<CustomField, 2>;
+
+// Process-wide table of custom field names. Safe to use from the parser threads.
+namespace FieldKeyTable {
+
+inline constexpr FieldKeyId kInvalidKey = 0xFFFF;
+
+// Keys are restricted to ASCII letters, digits, '_' and '-' so they can be used
+// verbatim as tags in the V1 text format and as prefixes in search queries.
+bool isValidKey(QByteArrayView key);
+bool isValidKey(QStringView key);
+
+// Returns the id for key, adding it to the table on first use.
+// Returns kInvalidKey for invalid keys.
+FieldKeyId intern(QByteArrayView key);
+FieldKeyId intern(QStringView key);
+
+// Returns the id for key without adding it, or kInvalidKey if it was never interned.
+FieldKeyId find(QStringView key);
+
+QString name(FieldKeyId id);
+
+} // namespace FieldKeyTable
+
+namespace CustomFieldTypes {
+
+// Tag used for the type in the V1 text format and the editor ("text", "secret", ...)
+const char *name(CustomFieldType type);
+bool fromName(QByteArrayView name, CustomFieldType *type);
+int count();
+
+inline bool isSecret(CustomFieldType type)
+{
+    return type == CustomFieldType::Secret || type == CustomFieldType::Totp;
+}
+
+inline bool isSearchable(CustomFieldType type)
+{
+    return !isSecret(type);
+}
+
+} // namespace CustomFieldTypes
+
+// Custom field values are written on a single line so older readers, which skip
+// unknown tags, never mistake the lines of a multiline value for items or fields.
+namespace CustomFieldCodec {
+
+QString escape(QStringView value); // Backslash-escapes '\\', newlines and carriage returns
+QByteArray unescape(QByteArrayView escaped);
+
+} // namespace CustomFieldCodec
+
+#endif // CUSTOMFIELD_H
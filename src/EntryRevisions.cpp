@@ -0,0 +1,344 @@
+#include "EntryRevisions.h"
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QIODevice>
+#include <algorithm>
+#include <utility>
+#include <sodium.h> // Required for sodium_memzero
+
+namespace {
+
+constexpr quint8 kFormatVersion = 1;
+constexpr quint8 kSet = 0;    // The older version had the field: prefix, suffix and middle follow
+constexpr quint8 kAbsent = 1; // The older version didn't have the field
+constexpr qint64 kSecondsPerDay = 24 * 60 * 60;
+const char kChangedKey[] = "changed";
+const char kAttachmentsKey[] = "attachments";
+
+// The record as field keys of the V1 format ("password", "field.secret.api_key",
+// ...) with their values, in record order
+using Fields = std::vector<std::pair<QByteArray, QString>>;
+
+struct Entry {
+    qint64 replaced = 0;
+    QByteArray delta;
+};
+
+void wipe(QByteArray *data)
+{
+    sodium_memzero(data->data(), size_t(data->size()));
+    data->clear();
+}
+
+void wipe(QString *text)
+{
+    sodium_memzero(text->data(), size_t(text->size()) * sizeof(QChar));
+    text->clear();
+}
+
+void wipe(Fields *fields)
+{
+    for (auto &field : *fields) {
+        wipe(&field.second);
+    }
+    fields->clear();
+}
+
+void wipe(std::vector<Entry> *entries)
+{
+    for (Entry &entry : *entries) {
+        wipe(&entry.delta);
+    }
+    entries->clear();
+}
+
+Fields fieldsOf(const PasswordRecord &record)
+{
+    Fields fields;
+    for (const RecordFieldSpec &spec : kRecordFields) {
+        const QStringView value = record.view(spec.id);
+        if (!value.isEmpty()) {
+            fields.emplace_back(QByteArray(spec.key), value.toString());
+        }
+    }
+    for (const CustomField &field : record.customFields) {
+        fields.emplace_back(QByteArray("field.") + CustomFieldTypes::name(field.type) + '.'
+                                + FieldKeyTable::name(field.key).toLatin1(),
+                            field.text().toString());
+    }
+    if (!record.attachments.empty()) {
+        QString lines;
+        for (const Attachment &attachment : record.attachments) {
+            if (!lines.isEmpty()) {
+                lines += u'\n';
+            }
+            lines += AttachmentCodec::encode(attachment);
+        }
+        fields.emplace_back(QByteArray(kAttachmentsKey), std::move(lines));
+    }
+    if (record.passwordChanged != 0) {
+        fields.emplace_back(QByteArray(kChangedKey), QString::number(record.passwordChanged));
+    }
+    return fields;
+}
+
+PasswordRecord recordOf(const Fields &fields)
+{
+    PasswordRecord record;
+    for (const auto &[key, value] : fields) {
+        const int field = RecordSchema::fieldForKey(key.constData(), std::size_t(key.size()));
+        if (field >= 0) {
+            record.setValue(kRecordFields[field].id, value);
+        } else if (key == kChangedKey) {
+            record.passwordChanged = value.toLongLong();
+        } else if (key == kAttachmentsKey) {
+            for (QStringView line : QStringView(value).split(u'\n')) {
+                QByteArray utf8 = line.toUtf8();
+                Attachment attachment;
+                if (AttachmentCodec::decode(utf8, &attachment)) {
+                    record.attachments.push_back(std::move(attachment));
+                }
+                wipe(&utf8);
+            }
+        } else {
+            // "field.<type>.<key>"
+            const QList<QByteArray> parts = key.split('.');
+            CustomFieldType type;
+            if (parts.size() != 3 || parts[0] != "field" || !CustomFieldTypes::fromName(parts[1], &type)) {
+                continue;
+            }
+            const FieldKeyId id = FieldKeyTable::intern(QByteArrayView(parts[2]));
+            if (id != FieldKeyTable::kInvalidKey) {
+                CustomField custom{id, type, QString(), SecureString()};
+                custom.setText(value);
+                record.customFields.push_back(std::move(custom));
+            }
+        }
+    }
+    return record;
+}
+
+// Label of a field key for the list of changes; empty for keys not worth listing
+QString label(const QByteArray &key)
+{
+    const int field = RecordSchema::fieldForKey(key.constData(), std::size_t(key.size()));
+    if (field >= 0) {
+        return QString::fromLatin1(kRecordFields[field].label);
+    }
+    if (key == kAttachmentsKey) {
+        return QCoreApplication::translate("EntryRevisions", "Attachments");
+    }
+    if (key == kChangedKey) {
+        return QString(); // Goes with the password
+    }
+    return QString::fromLatin1(key.mid(key.lastIndexOf('.') + 1));
+}
+
+Fields::iterator findField(Fields *fields, const QByteArray &key)
+{
+    return std::find_if(fields->begin(), fields->end(), [&](const auto &field) { return field.first == key; });
+}
+
+// What turns newer back into older, or an empty array if they hold the same fields
+QByteArray makeDelta(const Fields &newer, const Fields &older)
+{
+    QByteArray delta;
+    QDataStream out(&delta, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    bool changed = false;
+    for (const auto &[key, value] : older) {
+        const auto now = std::find_if(newer.begin(), newer.end(), [&](const auto &field) { return field.first == key; });
+        const QStringView current = now != newer.end() ? QStringView(now->second) : QStringView();
+        if (now != newer.end() && current == value) {
+            continue;
+        }
+        // Only the part between the common start and the common end is stored
+        const qsizetype limit = qMin(current.size(), value.size());
+        qsizetype prefix = 0;
+        while (prefix < limit && current[prefix] == value[prefix]) {
+            ++prefix;
+        }
+        qsizetype suffix = 0;
+        while (suffix < limit - prefix && current[current.size() - 1 - suffix] == value[value.size() - 1 - suffix]) {
+            ++suffix;
+        }
+        QString middle = value.mid(prefix, value.size() - prefix - suffix);
+        out << key << kSet << quint32(prefix) << quint32(suffix) << middle;
+        wipe(&middle);
+        changed = true;
+    }
+    for (const auto &field : newer) {
+        if (std::none_of(older.begin(), older.end(), [&](const auto &old) { return old.first == field.first; })) {
+            out << field.first << kAbsent;
+            changed = true;
+        }
+    }
+    if (!changed) {
+        return QByteArray();
+    }
+    out << QByteArray(); // End of the changes
+    return delta;
+}
+
+// Turns fields into the older version delta describes
+bool applyDelta(const QByteArray &delta, Fields *fields, QStringList *changed)
+{
+    QDataStream in(delta);
+    in.setVersion(QDataStream::Qt_6_0);
+    for (;;) {
+        QByteArray key;
+        quint8 kind = kAbsent;
+        in >> key;
+        if (key.isEmpty()) {
+            break;
+        }
+        in >> kind;
+        const auto it = findField(fields, key);
+        if (kind == kAbsent) {
+            if (it != fields->end()) {
+                wipe(&it->second);
+                fields->erase(it);
+            }
+        } else {
+            quint32 prefix = 0, suffix = 0;
+            QString middle;
+            in >> prefix >> suffix >> middle;
+            const QStringView current = it != fields->end() ? QStringView(it->second) : QStringView();
+            if (in.status() != QDataStream::Ok || qsizetype(prefix) + qsizetype(suffix) > current.size()) {
+                wipe(&middle);
+                return false;
+            }
+            QString value;
+            value.reserve(qsizetype(prefix) + middle.size() + qsizetype(suffix));
+            value += current.first(prefix);
+            value += middle;
+            value += current.last(suffix);
+            wipe(&middle);
+            if (it != fields->end()) {
+                wipe(&it->second);
+                it->second = std::move(value);
+            } else {
+                fields->emplace_back(key, std::move(value));
+            }
+        }
+        const QString name = label(key);
+        if (!name.isEmpty()) {
+            changed->append(name);
+        }
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+bool decode(const SecureString &text, std::vector<Entry> *entries)
+{
+    const QStringView view = text.view();
+    const qsizetype space = view.indexOf(u' ');
+    if (space < 0) {
+        return false;
+    }
+    QByteArray base64 = view.sliced(space + 1).toLatin1();
+    QByteArray blob = QByteArray::fromBase64(base64);
+    wipe(&base64);
+    QDataStream in(blob);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint8 version = 0;
+    quint32 count = 0;
+    in >> version >> count;
+    bool ok = in.status() == QDataStream::Ok && version == kFormatVersion;
+    for (quint32 i = 0; ok && i < count; ++i) {
+        Entry entry;
+        in >> entry.replaced >> entry.delta;
+        ok = in.status() == QDataStream::Ok;
+        entries->push_back(std::move(entry));
+    }
+    wipe(&blob);
+    if (!ok) {
+        wipe(entries);
+    }
+    return ok;
+}
+
+SecureString encode(const std::vector<Entry> &entries)
+{
+    QByteArray blob;
+    QDataStream out(&blob, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << kFormatVersion << quint32(entries.size());
+    for (const Entry &entry : entries) {
+        out << entry.replaced << entry.delta;
+    }
+    QByteArray text = QByteArray::number(qulonglong(entries.size())) + ' ' + blob.toBase64();
+    const SecureString encoded = SecureString::fromUtf8(text);
+    wipe(&blob);
+    wipe(&text);
+    return encoded;
+}
+
+} // namespace
+
+namespace EntryRevisions {
+
+int count(const PasswordRecord &record)
+{
+    const QStringView view = record.revisions.view();
+    return view.left(view.indexOf(u' ')).toInt();
+}
+
+void add(const PasswordRecord &previous, PasswordRecord *current, qint64 now, const Retention &retention)
+{
+    Fields older = fieldsOf(previous);
+    Fields newer = fieldsOf(*current);
+    QByteArray delta = makeDelta(newer, older);
+    wipe(&older);
+    wipe(&newer);
+    if (delta.isEmpty()) {
+        current->revisions = previous.revisions;
+        return;
+    }
+
+    std::vector<Entry> entries;
+    if (!previous.revisions.isEmpty()) {
+        decode(previous.revisions, &entries); // Unreadable revisions are dropped rather than kept forever
+    }
+    entries.insert(entries.begin(), Entry{now, std::move(delta)});
+    std::size_t keep = qMin(entries.size(), std::size_t(qMax(0, retention.maxRevisions)));
+    if (retention.maxAgeDays > 0) {
+        const qint64 cutoff = now - qint64(retention.maxAgeDays) * kSecondsPerDay;
+        std::size_t recent = 0;
+        while (recent < keep && entries[recent].replaced >= cutoff) {
+            ++recent;
+        }
+        keep = recent;
+    }
+    for (std::size_t i = keep; i < entries.size(); ++i) {
+        wipe(&entries[i].delta);
+    }
+    entries.resize(keep);
+    current->revisions = entries.empty() ? SecureString() : encode(entries);
+    wipe(&entries);
+}
+
+std::vector<Revision> revisions(const PasswordRecord &current)
+{
+    std::vector<Revision> result;
+    std::vector<Entry> entries;
+    if (current.revisions.isEmpty() || !decode(current.revisions, &entries)) {
+        return result;
+    }
+    Fields fields = fieldsOf(current);
+    for (const Entry &entry : entries) {
+        Revision revision;
+        revision.replaced = entry.replaced;
+        if (!applyDelta(entry.delta, &fields, &revision.changedFields)) {
+            break; // The older ones build on this one
+        }
+        revision.record = recordOf(fields);
+        result.push_back(std::move(revision));
+    }
+    wipe(&fields);
+    wipe(&entries);
+    return result;
+}
+
+} // namespace EntryRevisions
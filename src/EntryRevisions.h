@@ -0,0 +1,48 @@
+#ifndef ENTRYREVISIONS_H
+#define ENTRYREVISIONS_H
+
+#include <QString>
+#include <QStringList>
+#include <vector>
+#include "PasswordRecord.h"
+
+// Earlier versions of an entry, kept in the entry itself.
+//
+// Each revision is stored as a reverse delta: what has to change in the next
+// newer version to get it back. Only the fields that differ are stored, and a
+// text field only as the middle part that differs between the two versions,
+// so rotating a password costs about the old password and editing a line of
+// the notes about that line. Revisions chain from the current record, newest
+// first, which makes adding one a matter of putting a delta in front and
+// dropping old ones a matter of cutting the tail.
+//
+// The record holds the encoded history as it appears in the vault text
+// ("history: <count> <base64>"). Loading, searching and saving the vault copy
+// it along without decoding; it is only decoded when an entry's history is
+// shown or the entry is edited.
+namespace EntryRevisions {
+
+struct Retention {
+    int maxRevisions = 20; // Newest revisions kept per entry; 0 keeps none
+    int maxAgeDays = 0;    // Revisions replaced longer ago are dropped; 0 for no limit
+};
+
+struct Revision {
+    qint64 replaced = 0;       // When the next version took its place, in seconds since the epoch
+    PasswordRecord record;     // The entry as it was; no revisions of its own
+    QStringList changedFields; // Labels of the fields the next version changed
+};
+
+// Number of revisions, read from the count in front of the encoded history
+int count(const PasswordRecord &record);
+
+// Gives current the revisions of previous plus previous itself as the newest,
+// pruned to retention; just the revisions of previous if the fields are the same
+void add(const PasswordRecord &previous, PasswordRecord *current, qint64 now, const Retention &retention);
+
+// Every revision, newest first; empty if there are none or they can't be decoded
+std::vector<Revision> revisions(const PasswordRecord &current);
+
+} // namespace EntryRevisions
+
+#endif // ENTRYREVISIONS_H
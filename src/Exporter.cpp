@@ -0,0 +1,347 @@
+#include "Exporter.h"
+#include "TreeFilterModel.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QIODevice>
+#include <QStandardItem>
+#include <cstdio> // Required for snprintf
+#include <cstring> // Required for strlen
+#include <sodium.h> // Required for sodium_memzero
+
+#ifndef Q_OS_WIN
+#include <sys/stat.h> // Required for umask
+#endif
+
+namespace {
+
+// Bytes buffered before a write; the only plaintext the export holds at a time
+constexpr qsizetype kBufferSize = 64 * 1024;
+
+const char kFolderColumn[] = "folder";
+const char kCustomFieldsColumn[] = "fields";
+
+} // namespace
+
+namespace Exporter {
+
+bool formatFromName(QStringView name, Format *format)
+{
+    if (name.compare(QLatin1String("csv"), Qt::CaseInsensitive) == 0) {
+        *format = Format::Csv;
+        return true;
+    }
+    if (name.compare(QLatin1String("json"), Qt::CaseInsensitive) == 0) {
+        *format = Format::Json;
+        return true;
+    }
+    return false;
+}
+
+Format formatForPath(const QString &filePath)
+{
+    return QFileInfo(filePath).suffix().compare(QLatin1String("json"), Qt::CaseInsensitive) == 0 ? Format::Json
+                                                                                                : Format::Csv;
+}
+
+bool openOwnerOnly(QFileDevice *file, QIODevice::OpenMode mode)
+{
+    constexpr QFileDevice::Permissions ownerOnly = QFileDevice::ReadOwner | QFileDevice::WriteOwner;
+    bool opened;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 3, 0)
+    if (auto *plain = qobject_cast<QFile *>(file)) {
+        opened = plain->open(mode, ownerOnly);
+    } else
+#endif
+    {
+#ifdef Q_OS_WIN
+        opened = file->open(mode); // Files under the user's profile aren't shared to begin with
+#else
+        // QSaveFile creates its temporary file under the process umask
+        const mode_t previous = umask(077);
+        opened = file->open(mode);
+        umask(previous);
+#endif
+    }
+    return opened && file->setPermissions(ownerOnly);
+}
+
+QStringList defaultColumns()
+{
+    QStringList columns{QLatin1String(kFolderColumn)};
+    for (const RecordFieldSpec &spec : kRecordFields) {
+        columns.append(QLatin1String(spec.key));
+    }
+    columns.append(QLatin1String(kCustomFieldsColumn));
+    return columns;
+}
+
+bool validColumn(QStringView column)
+{
+    return column == QLatin1String(kFolderColumn) || column == QLatin1String(kCustomFieldsColumn)
+           || FieldKeyTable::isValidKey(column); // Schema keys are valid custom keys too
+}
+
+Writer::Writer(QIODevice *device, const Options &options)
+    : m_device(device), m_options(options), m_encoder(QStringEncoder::Utf8)
+{
+    m_buffer.reserve(kBufferSize);
+    for (const QString &name : m_options.columns) {
+        Column column{name, ColumnKind::CustomField, RecordField::Name, FieldKeyTable::kInvalidKey};
+        const QByteArray latin1 = name.toLatin1();
+        const int field = RecordSchema::fieldForKey(latin1.constData(), size_t(latin1.size()));
+        if (name == QLatin1String(kFolderColumn)) {
+            column.kind = ColumnKind::Folder;
+        } else if (name == QLatin1String(kCustomFieldsColumn)) {
+            column.kind = ColumnKind::CustomFields;
+        } else if (field >= 0) {
+            column.kind = ColumnKind::Field;
+            column.field = kRecordFields[field].id;
+        } else {
+            column.key = FieldKeyTable::intern(name);
+            if (column.key == FieldKeyTable::kInvalidKey) {
+                continue;
+            }
+        }
+        m_columns.push_back(column);
+    }
+
+    if (m_options.format == Format::Json) {
+        appendLatin1("[");
+        return;
+    }
+    for (std::size_t i = 0; i < m_columns.size(); ++i) {
+        if (i > 0) appendLatin1(",");
+        writeCsvValue(m_columns[i].name);
+    }
+    appendLatin1("\r\n");
+}
+
+Writer::~Writer()
+{
+    sodium_memzero(m_buffer.data(), size_t(m_buffer.size()));
+}
+
+void Writer::writeEntry(QStringView folderPath, const PasswordRecord &record)
+{
+    const bool json = m_options.format == Format::Json;
+    if (json) {
+        appendLatin1(m_entryCount == 0 ? "\n{" : ",\n{");
+    }
+    for (std::size_t i = 0; i < m_columns.size(); ++i) {
+        const Column &column = m_columns[i];
+        if (json) {
+            if (i > 0) appendLatin1(", ");
+            writeJsonString(column.name);
+            appendLatin1(": ");
+        } else if (i > 0) {
+            appendLatin1(",");
+        }
+
+        // null in JSON for values that are missing or redacted, an empty cell in CSV
+        QStringView value;
+        bool present = true;
+        switch (column.kind) {
+        case ColumnKind::Folder:
+            value = folderPath;
+            break;
+        case ColumnKind::Field:
+            present = !(m_options.redactSecrets
+                        && RecordSchema::hasFlag(std::size_t(column.field), FieldSecret));
+            if (present) value = record.view(column.field);
+            break;
+        case ColumnKind::CustomField:
+            if (const CustomField *field = record.customField(column.key)) {
+                present = !(m_options.redactSecrets && CustomFieldTypes::isSecret(field->type));
+                if (present) value = field->text();
+            } else {
+                present = false;
+            }
+            break;
+        case ColumnKind::CustomFields:
+            writeCustomFields(record);
+            continue;
+        }
+        if (json) {
+            if (present) {
+                writeJsonString(value);
+            } else {
+                appendLatin1("null");
+            }
+        } else {
+            writeCsvValue(value);
+        }
+    }
+    appendLatin1(json ? "}" : "\r\n");
+    ++m_entryCount;
+}
+
+void Writer::writeItems(const QStandardItem *item)
+{
+    writeItems(item, item->parent() ? TreeFilterModel::folderPath(item) : QString());
+}
+
+void Writer::writeItems(const QStandardItem *item, const QString &folderPath)
+{
+    const QVariant data = item->data(Qt::UserRole);
+    if (data.metaType() == QMetaType::fromType<PasswordRecord>()) {
+        writeEntry(folderPath, *static_cast<const PasswordRecord *>(data.constData()));
+    }
+    if (!item->hasChildren()) {
+        return;
+    }
+    // The children of a vault root are at the top of the vault
+    const QString childPath = !item->parent() ? QString()
+                              : folderPath.isEmpty() ? item->text()
+                                                     : folderPath + u'/' + item->text();
+    for (int row = 0; row < item->rowCount(); ++row) {
+        writeItems(item->child(row), childPath);
+    }
+}
+
+bool Writer::finish(QString *errorMessage)
+{
+    if (m_options.format == Format::Json) {
+        appendLatin1(m_entryCount == 0 ? "]\n" : "\n]\n");
+    }
+    flush();
+    if (m_failed && errorMessage) {
+        *errorMessage = m_error;
+    }
+    return !m_failed;
+}
+
+void Writer::writeCsvValue(QStringView text)
+{
+    bool quote = false;
+    for (QChar c : text) {
+        if (c == u',' || c == u'"' || c == u'\n' || c == u'\r') {
+            quote = true;
+            break;
+        }
+    }
+    if (!quote) {
+        append(text);
+        return;
+    }
+    appendLatin1("\"");
+    qsizetype start = 0;
+    for (qsizetype quoteAt; (quoteAt = text.indexOf(u'"', start)) >= 0; start = quoteAt + 1) {
+        append(text.sliced(start, quoteAt - start));
+        appendLatin1("\"\"");
+    }
+    append(text.sliced(start));
+    appendLatin1("\"");
+}
+
+void Writer::writeJsonString(QStringView text)
+{
+    appendLatin1("\"");
+    qsizetype start = 0;
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        const char16_t c = text[i].unicode();
+        if (c >= 0x20 && c != u'"' && c != u'\\') {
+            continue;
+        }
+        append(text.sliced(start, i - start));
+        start = i + 1;
+        switch (c) {
+        case u'"': appendLatin1("\\\""); break;
+        case u'\\': appendLatin1("\\\\"); break;
+        case u'\n': appendLatin1("\\n"); break;
+        case u'\r': appendLatin1("\\r"); break;
+        case u'\t': appendLatin1("\\t"); break;
+        default: {
+            char escape[8];
+            std::snprintf(escape, sizeof escape, "\\u%04x", unsigned(c));
+            appendLatin1(escape);
+            break;
+        }
+        }
+    }
+    append(text.sliced(start));
+    appendLatin1("\"");
+}
+
+// CSV: one cell of "key: value" lines, the layout Bitwarden uses and Shift+I reads.
+// JSON: an array of {"key", "type", "value"} objects.
+void Writer::writeCustomFields(const PasswordRecord &record)
+{
+    const bool json = m_options.format == Format::Json;
+    appendLatin1(json ? "[" : "\"");
+    bool first = true;
+    for (const CustomField &field : record.customFields) {
+        const bool redacted = m_options.redactSecrets && CustomFieldTypes::isSecret(field.type);
+        if (json) {
+            appendLatin1(first ? "{\"key\": " : ", {\"key\": ");
+            writeJsonString(FieldKeyTable::name(field.key));
+            appendLatin1(", \"type\": \"");
+            appendLatin1(CustomFieldTypes::name(field.type));
+            appendLatin1("\", \"value\": ");
+            if (redacted) {
+                appendLatin1("null");
+            } else {
+                writeJsonString(field.text());
+            }
+            appendLatin1("}");
+        } else if (!redacted) {
+            if (!first) appendLatin1("\n");
+            append(FieldKeyTable::name(field.key));
+            appendLatin1(": ");
+            const QStringView text = field.text();
+            qsizetype start = 0;
+            for (qsizetype quoteAt; (quoteAt = text.indexOf(u'"', start)) >= 0; start = quoteAt + 1) {
+                append(text.sliced(start, quoteAt - start));
+                appendLatin1("\"\"");
+            }
+            append(text.sliced(start));
+        } else {
+            continue;
+        }
+        first = false;
+    }
+    appendLatin1(json ? "]" : "\"");
+}
+
+void Writer::append(QStringView text)
+{
+    while (!text.isEmpty()) {
+        // UTF-8 needs at most three bytes per UTF-16 code unit
+        qsizetype count = qMin(text.size(), (m_buffer.capacity() - m_buffer.size() - 1) / 3);
+        if (count > 0 && count < text.size() && text[count - 1].isHighSurrogate()) {
+            --count; // Keep the pair together for the encoder
+        }
+        if (count == 0) {
+            flush();
+            continue;
+        }
+        const qsizetype used = m_buffer.size();
+        m_buffer.resize(used + count * 3); // Within the reserved capacity, so no reallocation
+        const char *end = m_encoder.appendToBuffer(m_buffer.data() + used, text.first(count));
+        m_buffer.resize(end - m_buffer.constData());
+        text = text.sliced(count);
+    }
+}
+
+void Writer::appendLatin1(const char *text)
+{
+    const qsizetype length = qsizetype(std::strlen(text));
+    if (m_buffer.capacity() - m_buffer.size() <= length) {
+        flush();
+    }
+    m_buffer.append(text, length);
+}
+
+void Writer::flush()
+{
+    if (m_buffer.isEmpty()) {
+        return;
+    }
+    if (!m_failed && m_device->write(m_buffer) != m_buffer.size()) {
+        m_failed = true;
+        m_error = m_device->errorString();
+    }
+    sodium_memzero(m_buffer.data(), size_t(m_buffer.size()));
+    m_buffer.resize(0); // Keeps the capacity
+}
+
+} // namespace Exporter
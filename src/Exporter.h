@@ -0,0 +1,98 @@
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QString>
+#include <QStringEncoder>
+#include <QStringList>
+#include <QStringView>
+#include <vector>
+
+#include "PasswordRecord.h"
+
+class QFileDevice;
+class QStandardItem;
+
+// Writes entries as CSV or JSON for other tools, one at a time.
+//
+// Values are encoded from the records' own storage (SecurePool for secrets)
+// straight into a fixed buffer that is written out and wiped whenever it
+// fills, so memory use does not depend on the size of the vault and no second
+// plaintext copy of it is ever built. The GUI and the "export" command share
+// this writer; they only differ in where the entries come from.
+namespace Exporter {
+
+enum class Format {
+    Csv,  // Header row, then one row per entry; the default columns read back with Shift+I
+    Json, // Array of objects, one entry per line
+};
+
+bool formatFromName(QStringView name, Format *format); // "csv" or "json"
+Format formatForPath(const QString &filePath);         // By extension, CSV unless ".json"
+
+// Opens file (a QFile or a QSaveFile) with mode, creating it readable and
+// writable by the owner only: what goes in is plaintext, and it must not be
+// readable by others even until a later chmod. A file that already existed is
+// narrowed to the same before anything is written.
+bool openOwnerOnly(QFileDevice *file, QIODevice::OpenMode mode);
+
+// Column names: the schema keys ("name", "password", ...), "folder", "fields"
+// (all custom fields of the entry) or the key of one custom field
+QStringList defaultColumns();
+bool validColumn(QStringView column);
+
+struct Options {
+    Format format = Format::Csv;
+    QStringList columns = defaultColumns();
+    bool redactSecrets = false; // Passwords and secret/TOTP fields are written empty (null in JSON)
+};
+
+class Writer
+{
+public:
+    // Open device with QIODevice::Unbuffered, or Qt keeps a copy of the text in its write buffer
+    Writer(QIODevice *device, const Options &options);
+    ~Writer();
+    Writer(const Writer &) = delete;
+    Writer &operator=(const Writer &) = delete;
+
+    // folderPath is '/'-separated, empty for entries at the top of the vault
+    void writeEntry(QStringView folderPath, const PasswordRecord &record);
+    // Walks item and everything below it; item may be a vault root, a folder or an entry
+    void writeItems(const QStandardItem *item);
+    // Ends the document and writes what is buffered; false if any write failed
+    bool finish(QString *errorMessage);
+
+    int entryCount() const { return m_entryCount; }
+
+private:
+    enum class ColumnKind { Folder, Field, CustomField, CustomFields };
+    struct Column {
+        QString name;
+        ColumnKind kind;
+        RecordField field;
+        FieldKeyId key;
+    };
+
+    void writeItems(const QStandardItem *item, const QString &folderPath);
+    void writeCsvValue(QStringView text);
+    void writeJsonString(QStringView text);
+    void writeCustomFields(const PasswordRecord &record);
+    void append(QStringView text); // UTF-8 encoded, flushing as needed
+    void appendLatin1(const char *text);
+    void flush();
+
+    QIODevice *m_device;
+    Options m_options;
+    std::vector<Column> m_columns;
+    QByteArray m_buffer; // Fixed capacity; never reallocated while it holds plaintext
+    QStringEncoder m_encoder;
+    int m_entryCount = 0;
+    bool m_failed = false;
+    QString m_error;
+};
+
+} // namespace Exporter
+
+#endif // EXPORTER_H
@@ -0,0 +1,318 @@
+#include "FuzzyMatcher.h"
+#include <QChar>
+#include <QDateTime>
+#include <QVarLengthArray> // Required for the character classes of the match window
+#include <QtAlgorithms> // Required for qCountTrailingZeroBits
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ARCANELOCK_FUZZY_SSE2 1
+#endif
+
+namespace {
+
+// Score constants from fzf's v1 algorithm
+constexpr int kScoreMatch = 16;
+constexpr int kGapStart = -3;
+constexpr int kGapExtension = -1;
+constexpr int kBonusBoundary = kScoreMatch / 2;
+constexpr int kBonusNonWord = kScoreMatch / 2;
+constexpr int kBonusCamel = kBonusBoundary + kGapExtension;
+constexpr int kBonusConsecutive = -(kGapStart + kGapExtension);
+constexpr int kBonusFirstCharMultiplier = 2;
+
+// The values are what classifyAscii() computes; keep them in step
+enum class CharClass : quint8 { Delimiter, NonWord, Lower, Upper, Letter, Digit };
+
+CharClass classOf(char16_t c)
+{
+    if (c < 0x80) {
+        if (c >= 'a' && c <= 'z') return CharClass::Lower;
+        if (c >= 'A' && c <= 'Z') return CharClass::Upper;
+        if (c >= '0' && c <= '9') return CharClass::Digit;
+        switch (c) {
+        case ' ': case '\t': case '\n': case '/': case '\\': case ',': case ':': case ';':
+        case '|': case '.': case '-': case '_': case '@':
+            return CharClass::Delimiter;
+        default:
+            return CharClass::NonWord;
+        }
+    }
+    const QChar qc(c);
+    if (qc.isLower()) return CharClass::Lower;
+    if (qc.isUpper()) return CharClass::Upper;
+    if (qc.isDigit()) return CharClass::Digit;
+    if (qc.isLetterOrNumber()) return CharClass::Letter;
+    return qc.isSpace() ? CharClass::Delimiter : CharClass::NonWord;
+}
+
+bool isWord(CharClass cls)
+{
+    return cls != CharClass::Delimiter && cls != CharClass::NonWord;
+}
+
+int bonusFor(CharClass previous, CharClass current)
+{
+    if (isWord(current)) {
+        if (!isWord(previous)) return kBonusBoundary;
+        if (previous == CharClass::Lower && current == CharClass::Upper) return kBonusCamel;
+        if (previous != CharClass::Digit && current == CharClass::Digit) return kBonusCamel;
+        return 0;
+    }
+    return kBonusNonWord;
+}
+
+// Index of the first of text[from, size) equal to lower or upper, or -1. This
+// is where nearly all the time goes on a miss, so it compares eight UTF-16
+// units per step where SSE2 is available (always on x86-64).
+qsizetype findEither(const char16_t *text, qsizetype from, qsizetype size, char16_t lower, char16_t upper)
+{
+    qsizetype i = from;
+#ifdef ARCANELOCK_FUZZY_SSE2
+    const __m128i lowerVector = _mm_set1_epi16(short(lower));
+    const __m128i upperVector = _mm_set1_epi16(short(upper));
+    for (; i + 8 <= size; i += 8) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i));
+        const __m128i hits = _mm_or_si128(_mm_cmpeq_epi16(chunk, lowerVector), _mm_cmpeq_epi16(chunk, upperVector));
+        const int mask = _mm_movemask_epi8(hits);
+        if (mask != 0) {
+            return i + qCountTrailingZeroBits(uint(mask)) / 2;
+        }
+    }
+#endif
+    for (; i < size; ++i) {
+        if (text[i] == lower || text[i] == upper) return i;
+    }
+    return -1;
+}
+
+// Index of the last of text[0, from] equal to lower or upper, or -1: the
+// backward pass's counterpart of findEither
+qsizetype findEitherBackward(const char16_t *text, qsizetype from, char16_t lower, char16_t upper)
+{
+    qsizetype i = from;
+#ifdef ARCANELOCK_FUZZY_SSE2
+    const __m128i lowerVector = _mm_set1_epi16(short(lower));
+    const __m128i upperVector = _mm_set1_epi16(short(upper));
+    for (; i >= 7; i -= 8) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i - 7));
+        const __m128i hits = _mm_or_si128(_mm_cmpeq_epi16(chunk, lowerVector), _mm_cmpeq_epi16(chunk, upperVector));
+        const int mask = _mm_movemask_epi8(hits);
+        if (mask != 0) {
+            return i - 7 + (31 - qCountLeadingZeroBits(quint32(mask))) / 2;
+        }
+    }
+#endif
+    for (; i >= 0; --i) {
+        if (text[i] == lower || text[i] == upper) return i;
+    }
+    return -1;
+}
+
+// classOf() for text[0, size) into classes. Blocks of eight ASCII units are
+// classified together with SSE2 (the usual case: names, user names and URLs);
+// a block holding anything else goes through classOf() one unit at a time.
+void classifyAscii(const char16_t *text, qsizetype size, CharClass *classes)
+{
+    qsizetype i = 0;
+#ifdef ARCANELOCK_FUZZY_SSE2
+    const auto inRange = [](__m128i chunk, char16_t low, char16_t high) {
+        return _mm_and_si128(_mm_cmpgt_epi16(chunk, _mm_set1_epi16(short(low - 1))),
+                             _mm_cmplt_epi16(chunk, _mm_set1_epi16(short(high + 1))));
+    };
+    static constexpr char16_t kDelimiters[] = { ' ', '\t', '\n', '/', '\\', ',', ':', ';', '|', '.', '-', '_', '@' };
+    const __m128i nonAscii = _mm_set1_epi16(short(0xff80));
+    for (; i + 8 <= size; i += 8) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(chunk, nonAscii), _mm_setzero_si128())) != 0xffff) {
+            for (qsizetype j = i; j < i + 8; ++j) classes[j] = classOf(text[j]);
+            continue;
+        }
+        __m128i delimiter = _mm_setzero_si128();
+        for (char16_t c : kDelimiters) {
+            delimiter = _mm_or_si128(delimiter, _mm_cmpeq_epi16(chunk, _mm_set1_epi16(short(c))));
+        }
+        // The masks exclude each other: NonWord (1) plus Lower 1, Upper 2 or Digit 4, or minus 1 for Delimiter
+        __m128i cls = _mm_set1_epi16(short(CharClass::NonWord));
+        cls = _mm_add_epi16(cls, _mm_and_si128(inRange(chunk, 'a', 'z'), _mm_set1_epi16(1)));
+        cls = _mm_add_epi16(cls, _mm_and_si128(inRange(chunk, 'A', 'Z'), _mm_set1_epi16(2)));
+        cls = _mm_add_epi16(cls, _mm_and_si128(inRange(chunk, '0', '9'), _mm_set1_epi16(4)));
+        cls = _mm_sub_epi16(cls, _mm_and_si128(delimiter, _mm_set1_epi16(1)));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(classes + i), _mm_packus_epi16(cls, cls));
+    }
+#endif
+    for (; i < size; ++i) {
+        classes[i] = classOf(text[i]);
+    }
+}
+
+} // namespace
+
+FuzzyMatcher::FuzzyMatcher(QStringView pattern)
+    : m_pattern(pattern.toString().toCaseFolded())
+{
+    m_pattern.remove(u' '); // Spaces only separate the words typed
+    m_upper.resize(m_pattern.size());
+    for (qsizetype i = 0; i < m_pattern.size(); ++i) {
+        const char16_t c = m_pattern.at(i).unicode();
+        // Non-ASCII characters have no single upper twin; 0 sends them down the folding path
+        m_upper[i] = c < 0x80 ? QChar(c >= 'a' && c <= 'z' ? char16_t(c - 'a' + 'A') : c) : QChar(0);
+    }
+}
+
+int FuzzyMatcher::score(QStringView text) const
+{
+    const qsizetype patternLength = m_pattern.size();
+    const qsizetype length = text.size();
+    if (patternLength == 0) return 0;
+    if (patternLength > length) return kNoMatch;
+
+    const char16_t *data = text.utf16();
+    const char16_t *pattern = QStringView(m_pattern).utf16();
+    const char16_t *upper = QStringView(m_upper).utf16();
+    const auto matchesAt = [&](qsizetype i, qsizetype p) {
+        return upper[p] != 0 ? (data[i] == pattern[p] || data[i] == upper[p])
+                             : QChar::toCaseFolded(data[i]) == pattern[p];
+    };
+
+    // Forward pass: where the leftmost occurrence of the pattern ends
+    qsizetype position = 0;
+    for (qsizetype p = 0; p < patternLength; ++p) {
+        qsizetype hit = -1;
+        if (upper[p] != 0) {
+            hit = findEither(data, position, length, pattern[p], upper[p]);
+        } else {
+            for (qsizetype i = position; i < length && hit < 0; ++i) {
+                if (matchesAt(i, p)) hit = i;
+            }
+        }
+        if (hit < 0) return kNoMatch;
+        position = hit + 1;
+    }
+    const qsizetype end = position - 1;
+
+    // Backward pass: the shortest window ending there. The forward pass found
+    // every character, so each search here succeeds.
+    qsizetype start = end + 1;
+    for (qsizetype p = patternLength - 1; p >= 0; --p) {
+        if (upper[p] != 0) {
+            start = findEitherBackward(data, start - 1, pattern[p], upper[p]);
+        } else {
+            do {
+                --start;
+            } while (!matchesAt(start, p));
+        }
+    }
+
+    // Classes of the window and the character before it, classified in one go
+    const qsizetype first = start > 0 ? start - 1 : start;
+    QVarLengthArray<CharClass, 256> classes(end + 1 - first);
+    classifyAscii(data + first, end + 1 - first, classes.data());
+
+    int total = 0;
+    int consecutive = 0;
+    int firstBonus = 0;
+    bool inGap = false;
+    qsizetype p = 0;
+    CharClass previous = start > 0 ? classes[0] : CharClass::Delimiter; // Text start counts as a boundary
+    for (qsizetype i = start; i <= end; ++i) {
+        const CharClass current = classes[i - first];
+        if (p < patternLength && matchesAt(i, p)) {
+            int bonus = bonusFor(previous, current);
+            if (consecutive == 0) {
+                firstBonus = bonus;
+            } else {
+                // A run keeps the bonus of the boundary it started on
+                if (bonus >= kBonusBoundary && bonus > firstBonus) firstBonus = bonus;
+                bonus = std::max({bonus, firstBonus, kBonusConsecutive});
+            }
+            total += kScoreMatch + (p == 0 ? bonus * kBonusFirstCharMultiplier : bonus);
+            inGap = false;
+            ++consecutive;
+            ++p;
+        } else {
+            total += inGap ? kGapExtension : kGapStart;
+            inGap = true;
+            consecutive = 0;
+            firstBonus = 0;
+        }
+        previous = current;
+    }
+    return std::max(total, 1); // A match never scores below a miss
+}
+
+int FuzzyMatcher::score(const PasswordRecord &record) const
+{
+    int best = kNoMatch;
+    RecordSchema::forEachField([&](auto field) {
+        if constexpr (RecordSchema::hasFlag(field, FieldSearchable)) {
+            const int fieldScore = score(record.view(kRecordFields[field].id));
+            if (fieldScore != kNoMatch) {
+                best = std::max(best, fieldScore * kRecordFields[field].searchWeight);
+            }
+        }
+    });
+    for (const CustomField &field : record.customFields) {
+        if (CustomFieldTypes::isSearchable(field.type)) {
+            best = std::max(best, score(field.text())); // Weighted like notes
+        }
+    }
+    return best;
+}
+
+double Frecency::decayedWeight(const Usage &usage, qint64 nowMs)
+{
+    constexpr double halfLifeMs = kHalfLifeDays * 24.0 * 60 * 60 * 1000;
+    return usage.weight * std::exp2(-double(nowMs - usage.lastUseMs) / halfLifeMs);
+}
+
+void Frecency::recordUse(quint64 itemId)
+{
+    if (itemId == 0) return;
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    Usage &usage = m_usage[itemId];
+    usage.weight = decayedWeight(usage, now) + 1;
+    usage.lastUseMs = now;
+}
+
+int Frecency::boost(quint64 itemId) const
+{
+    const auto it = m_usage.constFind(itemId);
+    if (it == m_usage.constEnd()) return 0;
+    // Logarithmic, so a handful of recent uses counts and a hundred doesn't swamp the match score
+    const double weight = decayedWeight(it.value(), QDateTime::currentMSecsSinceEpoch());
+    return std::min(kMaxBoost, int(16 * std::log2(1 + weight)));
+}
+
+QStringList Frecency::toStringList() const
+{
+    constexpr double kMinWeight = 0.05; // 16 * log2(1.05) rounds down to no boost
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QStringList list;
+    for (auto it = m_usage.constBegin(); it != m_usage.constEnd(); ++it) {
+        if (decayedWeight(it.value(), now) >= kMinWeight) {
+            list.append(QString("%1:%2:%3").arg(it.key(), 16, 16, QChar(u'0'))
+                            .arg(it.value().weight, 0, 'g', 8).arg(it.value().lastUseMs));
+        }
+    }
+    return list;
+}
+
+void Frecency::fromStringList(const QStringList &list)
+{
+    m_usage.clear();
+    for (const QString &line : list) {
+        const QStringList parts = line.split(u':');
+        if (parts.size() != 3) continue;
+        bool idOk = false, weightOk = false, timeOk = false;
+        const quint64 id = parts[0].toULongLong(&idOk, 16);
+        Usage usage;
+        usage.weight = parts[1].toDouble(&weightOk);
+        usage.lastUseMs = parts[2].toLongLong(&timeOk);
+        if (idOk && weightOk && timeOk && id != 0 && usage.weight > 0) {
+            m_usage.insert(id, usage);
+        }
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef FUZZYMATCHER_H
+#define FUZZYMATCHER_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+
+#include "PasswordRecord.h"
+
+// fzf-style fuzzy matching: the pattern's characters have to appear in order,
+// case-insensitively, but not next to each other. Matches are scored so that
+// characters at word boundaries, at the start of the text and in consecutive
+// runs rank above scattered ones, and gaps cost a little.
+class FuzzyMatcher
+{
+public:
+    static constexpr int kNoMatch = -1;
+
+    explicit FuzzyMatcher(QStringView pattern);
+
+    bool isEmpty() const { return m_pattern.isEmpty(); }
+
+    // Score of the best-placed match of the pattern in text, or kNoMatch
+    int score(QStringView text) const;
+    // Best field score of a record, weighted by the schema's searchWeight
+    // (the name counts most, notes least), or kNoMatch
+    int score(const PasswordRecord &record) const;
+
+private:
+    QString m_pattern; // Case-folded
+    QString m_upper;   // Upper-case twin of each ASCII pattern character, for the scan kernel
+};
+
+// Frequency and recency of use, as a bonus added to the fuzzy score of entries
+// that already match. Each use adds one to a weight that halves every
+// kHalfLifeDays. Entries are keyed by their ItemId, so the history follows an
+// entry through renames and moves and survives restarts; the ids are random
+// and only the decrypted vault says which entry holds one, so the stored table
+// says nothing about the vault.
+class Frecency
+{
+public:
+    static constexpr int kMaxBoost = 64;
+    static constexpr int kHalfLifeDays = 3;
+
+    void recordUse(quint64 itemId);
+    int boost(quint64 itemId) const;
+
+    // "<hex id>:<weight>:<last use ms>" per entry, for the settings file;
+    // entries that have decayed below any boost are left out
+    QStringList toStringList() const;
+    void fromStringList(const QStringList &list);
+
+private:
+    struct Usage {
+        double weight = 0;
+        qint64 lastUseMs = 0;
+    };
+
+    static double decayedWeight(const Usage &usage, qint64 nowMs);
+
+    QHash<quint64, Usage> m_usage;
+};
+
+#endif // FUZZYMATCHER_H
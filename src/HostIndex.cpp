@@ -0,0 +1,137 @@
+#include "HostIndex.h"
+#include <QHostAddress>
+#include <QUrl>
+#include <algorithm>
+#include <cstring> // Required for strcmp
+#include <iterator>
+
+namespace {
+
+// Second-level public suffixes under which names are registered one label
+// further down. Not the full Public Suffix List, only the ones common enough
+// that taking the last two labels would lump unrelated sites together.
+// Sorted, for std::binary_search.
+const char *const kTwoLabelSuffixes[] = {
+    "ac.jp", "ac.nz", "ac.uk", "co.id", "co.il", "co.in", "co.jp", "co.kr", "co.nz", "co.th", "co.uk", "co.za",
+    "com.ar", "com.au", "com.br", "com.cn", "com.hk", "com.mx", "com.my", "com.pl", "com.sg", "com.tr", "com.tw",
+    "com.ua", "gov.au", "gov.uk", "ne.jp", "net.au", "net.br", "net.cn", "or.jp", "org.au", "org.br", "org.nz",
+    "org.uk",
+};
+
+bool isTwoLabelSuffix(QStringView suffix)
+{
+    const QByteArray latin1 = suffix.toLatin1();
+    return std::binary_search(std::begin(kTwoLabelSuffixes), std::end(kTwoLabelSuffixes), latin1.constData(),
+                              [](const char *a, const char *b) { return std::strcmp(a, b) < 0; });
+}
+
+} // namespace
+
+QString HostIndex::normalizedHost(QStringView url)
+{
+    const QString trimmed = url.trimmed().toString();
+    if (trimmed.isEmpty()) {
+        return QString();
+    }
+    // Takes "https://host/path", "host:port" and "user@host" alike; IDNs come out in ACE form
+    QString host = QUrl::fromUserInput(trimmed).host(QUrl::FullyEncoded).toLower();
+    while (host.endsWith(u'.')) {
+        host.chop(1); // "example.com." is the same host
+    }
+    return host;
+}
+
+QString HostIndex::registrableDomain(const QString &host)
+{
+    if (QHostAddress(host).protocol() != QAbstractSocket::UnknownNetworkLayerProtocol) {
+        return host;
+    }
+    const qsizetype last = host.lastIndexOf(u'.');
+    if (last <= 0) {
+        return host; // "localhost", "db01"
+    }
+    const qsizetype second = host.lastIndexOf(u'.', last - 1);
+    if (second < 0) {
+        return host;
+    }
+    if (!isTwoLabelSuffix(QStringView(host).mid(second + 1))) {
+        return host.mid(second + 1);
+    }
+    const qsizetype third = host.lastIndexOf(u'.', second - 1);
+    return third < 0 ? host : host.mid(third + 1);
+}
+
+void HostIndex::insert(std::uint32_t entry, QStringView url)
+{
+    const QString host = normalizedHost(url);
+    if (host.isEmpty()) {
+        return;
+    }
+    m_hosts[host].push_back(entry);
+    m_domains[registrableDomain(host)].push_back(entry);
+    m_entryHosts.insert(entry, host);
+}
+
+void HostIndex::remove(std::uint32_t entry)
+{
+    const QString host = m_entryHosts.take(entry);
+    if (host.isEmpty()) {
+        return;
+    }
+    const auto unfile = [entry](QHash<QString, std::vector<std::uint32_t>> &lists, const QString &key) {
+        const auto list = lists.find(key);
+        if (list == lists.end()) {
+            return;
+        }
+        list->erase(std::remove(list->begin(), list->end(), entry), list->end());
+        if (list->empty()) {
+            lists.erase(list);
+        }
+    };
+    unfile(m_hosts, host);
+    unfile(m_domains, registrableDomain(host));
+}
+
+void HostIndex::clear()
+{
+    m_hosts.clear();
+    m_domains.clear();
+    m_entryHosts.clear();
+}
+
+std::vector<std::uint32_t> HostIndex::lookup(QStringView url, Match *match) const
+{
+    if (match) {
+        *match = Match::None;
+    }
+    const QString host = normalizedHost(url);
+    if (host.isEmpty()) {
+        return {};
+    }
+    const QString domain = registrableDomain(host);
+
+    // Walk up one label at a time; the domain is a suffix of host, so this ends there
+    qsizetype start = 0;
+    for (;;) {
+        const auto found = m_hosts.constFind(host.mid(start));
+        if (found != m_hosts.constEnd()) {
+            if (match) {
+                *match = start == 0 ? Match::Host : Match::ParentHost;
+            }
+            return found.value();
+        }
+        if (host.size() - start <= domain.size()) {
+            break;
+        }
+        start = host.indexOf(u'.', start) + 1;
+    }
+
+    const auto sameDomain = m_domains.constFind(domain);
+    if (sameDomain == m_domains.constEnd()) {
+        return {};
+    }
+    if (match) {
+        *match = Match::Domain;
+    }
+    return sameDomain.value();
+}
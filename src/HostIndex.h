@@ -0,0 +1,53 @@
+#ifndef HOSTINDEX_H
+#define HOSTINDEX_H
+
+#include <QHash>
+#include <QString>
+#include <QStringView>
+#include <cstdint>
+#include <vector>
+
+// Entries by the host of their url field, for "which credential is for this
+// site". Each entry is filed under its normalized host and under the
+// registrable domain of that host, so a lookup costs one hash probe per
+// label of the looked-up host and never scans the vault.
+//
+// Entries are numbered by the owner (the main window uses its search buffer
+// numbering, VaultSnapshot its entry order). The owner calls insert() once
+// per entry, and remove() before an entry changes or goes, so an edit touches
+// only that entry's two lists.
+class HostIndex
+{
+public:
+    enum class Match {
+        None,
+        Host,       // An entry for exactly this host
+        ParentHost, // An entry for a host above it ("example.com" for "db01.example.com")
+        Domain,     // Only entries elsewhere under the same registrable domain
+    };
+
+    // Lower-case ASCII host of a URL or bare host name ("user@Host:22/x" -> "host"),
+    // or empty if there is none
+    static QString normalizedHost(QStringView url);
+    // The part of host a registrant owns: "example.com" for "db01.prod.example.com",
+    // "example.co.uk" for "www.example.co.uk". IP addresses are their own domain.
+    static QString registrableDomain(const QString &host);
+
+    void insert(std::uint32_t entry, QStringView url);
+    // Takes entry out of the lists insert() filed it under; no-op if it has no host
+    void remove(std::uint32_t entry);
+    void clear();
+    bool isEmpty() const { return m_hosts.isEmpty(); }
+
+    // Entries for the host of url, most specific level first: the host itself,
+    // then each parent up to the registrable domain, then any entry of that
+    // domain. Stops at the first level that has entries.
+    std::vector<std::uint32_t> lookup(QStringView url, Match *match = nullptr) const;
+
+private:
+    QHash<QString, std::vector<std::uint32_t>> m_hosts;
+    QHash<QString, std::vector<std::uint32_t>> m_domains;
+    QHash<std::uint32_t, QString> m_entryHosts; // Host each entry is filed under
+};
+
+#endif // HOSTINDEX_H
@@ -0,0 +1,872 @@
+#include "Importer.h"
+#include "HostIndex.h"
+#include "ItemId.h"
+#include "PasswordRecord.h"
+#include "StringArena.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSet>
+#include <QStandardItem>
+#include <QXmlStreamReader>
+#include <sodium.h> // Required for sodium_memzero
+
+namespace {
+
+using Importer::Progress;
+using Importer::Result;
+
+// Bytes read from the export per step. Only the record being parsed is kept
+// beyond that, so the memory used does not grow with the size of the file.
+constexpr qint64 kChunkSize = 64 * 1024;
+
+void wipe(QByteArray &bytes)
+{
+    if (!bytes.isEmpty()) {
+        sodium_memzero(bytes.data(), size_t(bytes.size()));
+    }
+}
+
+void wipe(QString &text)
+{
+    if (!text.isEmpty()) {
+        sodium_memzero(text.data(), size_t(text.size()) * sizeof(QChar));
+    }
+}
+
+// Custom field keys are restricted to [A-Za-z0-9_-]; other managers allow any
+// label, so "Security question 1" is imported as "security_question_1"
+QByteArray fieldKeyFor(QStringView label)
+{
+    QByteArray key;
+    key.reserve(label.size());
+    for (QChar c : label) {
+        const char16_t u = c.toLower().unicode();
+        if ((u >= 'a' && u <= 'z') || (u >= '0' && u <= '9') || u == '-') {
+            key.append(char(u));
+        } else if (!key.isEmpty() && !key.endsWith('_')) {
+            key.append('_');
+        }
+    }
+    while (key.endsWith('_')) {
+        key.chop(1);
+    }
+    if (key.isEmpty()) {
+        key = "field";
+    }
+    return key.left(56); // Leaves room for a "_<n>" suffix within the 64 allowed
+}
+
+bool looksSecret(QStringView label)
+{
+    static const char *const kSecretWords[] = { "password", "passwd", "secret", "pin", "key", "token", "cvv", "code" };
+    for (const char *word : kSecretWords) {
+        if (label.contains(QLatin1String(word), Qt::CaseInsensitive)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Builds the detached items of one import. Folders are looked up by their full
+// path, so entries of the same folder land in one item however they are ordered.
+class TreeBuilder
+{
+public:
+    TreeBuilder(StringArena *arena, Result *result)
+        : m_arena(arena), m_result(result)
+    {
+    }
+
+    // '/'-separated path below the import; an empty path is the top level
+    QStandardItem *folderForPath(QStringView path)
+    {
+        QStandardItem *parent = nullptr;
+        qsizetype start = 0;
+        while (start <= path.size()) {
+            qsizetype end = path.indexOf(u'/', start);
+            if (end < 0) {
+                end = path.size();
+            }
+            const QStringView name = path.mid(start, end - start).trimmed();
+            if (!name.isEmpty()) {
+                const QString key = path.left(end).toString();
+                QStandardItem *&folder = m_folders[key];
+                if (!folder) {
+                    folder = addFolder(parent, name.toString());
+                }
+                parent = folder;
+            }
+            start = end + 1;
+        }
+        return parent;
+    }
+
+    QStandardItem *addFolder(QStandardItem *parent, const QString &name)
+    {
+        auto *folder = new QStandardItem(m_arena->intern(name.isEmpty() ? QStringLiteral("Untitled") : name));
+        folder->setData(ItemId::generate(), ItemId::kRole);
+        attach(parent, folder);
+        ++m_result->folderCount;
+        return folder;
+    }
+
+    void addEntry(QStandardItem *parent, PasswordRecord &record)
+    {
+        if (record.view(RecordField::Name).trimmed().isEmpty()) {
+            // Browser exports have no title; the host is what the user would have typed
+            QString name = HostIndex::normalizedHost(record.view(RecordField::Url));
+            if (name.isEmpty()) {
+                name = record.value(RecordField::Username);
+            }
+            setField(record, RecordField::Name, name.isEmpty() ? QStringLiteral("Untitled") : name);
+        }
+        auto *item = new QStandardItem(record.value(RecordField::Name));
+        item->setData(QVariant::fromValue(record), Qt::UserRole);
+        item->setData(ItemId::generate(), ItemId::kRole);
+        attach(parent, item);
+        ++m_result->entryCount;
+        record = PasswordRecord();
+    }
+
+    void setField(PasswordRecord &record, RecordField field, const QString &value)
+    {
+        if (RecordSchema::hasFlag(std::size_t(field), FieldShared)) {
+            record.setValue(field, m_arena->intern(value));
+        } else {
+            record.setValue(field, value);
+        }
+    }
+
+    void setFieldUtf8(PasswordRecord &record, RecordField field, QByteArrayView utf8)
+    {
+        if (RecordSchema::hasFlag(std::size_t(field), FieldShared)) {
+            record.setValue(field, m_arena->internUtf8(utf8));
+        } else if (PasswordRecord::isSensitive(field)) {
+            record.setSensitiveValue(field, SecureString::fromUtf8(utf8)); // No heap copy of the secret
+        } else {
+            record.setValue(field, QString::fromUtf8(utf8));
+        }
+    }
+
+    void addCustom(PasswordRecord &record, QStringView label, const QString &value, CustomFieldType type)
+    {
+        if (value.isEmpty()) {
+            return;
+        }
+        const QByteArray base = fieldKeyFor(label);
+        FieldKeyId key = FieldKeyTable::intern(base);
+        for (int n = 2; key != FieldKeyTable::kInvalidKey && record.customField(key); ++n) {
+            key = FieldKeyTable::intern(base + '_' + QByteArray::number(n)); // Two columns with one key
+        }
+        if (key == FieldKeyTable::kInvalidKey) {
+            return;
+        }
+        CustomField field{key, type, QString(), SecureString()};
+        if (type == CustomFieldType::Text || type == CustomFieldType::Url) {
+            field.value = m_arena->intern(value);
+        } else {
+            field.setText(value);
+        }
+        record.customFields.push_back(std::move(field));
+    }
+
+private:
+    void attach(QStandardItem *parent, QStandardItem *item)
+    {
+        if (parent) {
+            parent->appendRow(item); // Detached, so no model signals yet
+        } else {
+            m_result->items.append(item);
+        }
+    }
+
+    StringArena *m_arena;
+    Result *m_result;
+    QHash<QString, QStandardItem*> m_folders;
+};
+
+// ---- CSV ----------------------------------------------------------------
+
+enum class CsvColumn { Custom, Skip, Field, Folder, Totp, BitwardenFields };
+
+struct CsvHeader {
+    CsvColumn kind = CsvColumn::Custom;
+    RecordField field = RecordField::Name;
+    QString label;
+    bool secret = false;
+};
+
+// Column names used by KeePass(XC), Bitwarden, LastPass, 1Password, Chrome and Firefox
+CsvHeader csvHeaderFor(const QString &label)
+{
+    CsvHeader header;
+    header.label = label;
+    const QString key = label.trimmed().toLower();
+    static const QHash<QString, RecordField> kFields = {
+        { "name", RecordField::Name }, { "title", RecordField::Name }, { "account", RecordField::Name },
+        { "username", RecordField::Username }, { "user name", RecordField::Username },
+        { "login_username", RecordField::Username }, { "user", RecordField::Username },
+        { "login", RecordField::Username },
+        { "password", RecordField::Password }, { "login_password", RecordField::Password },
+        { "url", RecordField::Url }, { "login_uri", RecordField::Url }, { "uri", RecordField::Url },
+        { "website", RecordField::Url }, { "web site", RecordField::Url },
+        { "notes", RecordField::Notes }, { "note", RecordField::Notes }, { "extra", RecordField::Notes },
+        { "comments", RecordField::Notes },
+    };
+    static const QSet<QString> kFolders = { "folder", "group", "grouping", "path" };
+    static const QSet<QString> kTotp = { "totp", "login_totp", "otpauth", "otp" };
+    // Bookkeeping of the exporting manager, meaningless here
+    static const QSet<QString> kSkipped = {
+        "favorite", "fav", "type", "reprompt", "icon", "created", "modified", "last modified", "archived",
+        "guid", "httprealm", "formactionorigin", "timecreated", "timelastused", "timepasswordchanged",
+    };
+    const auto field = kFields.constFind(key);
+    if (field != kFields.constEnd()) {
+        header.kind = CsvColumn::Field;
+        header.field = field.value();
+    } else if (kFolders.contains(key)) {
+        header.kind = CsvColumn::Folder;
+    } else if (kTotp.contains(key)) {
+        header.kind = CsvColumn::Totp;
+    } else if (key == QLatin1String("fields")) {
+        header.kind = CsvColumn::BitwardenFields;
+    } else if (kSkipped.contains(key) || key.isEmpty()) {
+        header.kind = CsvColumn::Skip;
+    } else {
+        header.secret = looksSecret(key);
+    }
+    return header;
+}
+
+// Splits one row (without its line break) into unquoted fields (RFC 4180)
+void splitCsvRow(const char *begin, const char *end, char delimiter, QList<QByteArray> *fields)
+{
+    fields->clear();
+    QByteArray field;
+    bool quoted = false;
+    for (const char *p = begin; p < end; ++p) {
+        const char c = *p;
+        if (quoted) {
+            if (c != '"') {
+                field.append(c);
+            } else if (p + 1 < end && p[1] == '"') {
+                field.append('"');
+                ++p;
+            } else {
+                quoted = false;
+            }
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == delimiter) {
+            fields->append(field);
+            wipe(field);
+            field.clear();
+        } else if (c != '\r') {
+            field.append(c);
+        }
+    }
+    fields->append(field);
+    wipe(field);
+}
+
+char detectDelimiter(const char *begin, const char *end)
+{
+    int commas = 0, semicolons = 0, tabs = 0;
+    bool quoted = false;
+    for (const char *p = begin; p < end; ++p) {
+        if (*p == '"') quoted = !quoted;
+        if (quoted) continue;
+        commas += *p == ',';
+        semicolons += *p == ';';
+        tabs += *p == '\t';
+    }
+    if (tabs > commas && tabs >= semicolons) return '\t';
+    return semicolons > commas ? ';' : ',';
+}
+
+class CsvImporter
+{
+public:
+    CsvImporter(TreeBuilder *builder)
+        : m_builder(builder)
+    {
+    }
+
+    QString run(QFile *file, Progress *progress)
+    {
+        QByteArray buffer;
+        qsizetype scan = 0;  // Where the search for the end of the current row resumes
+        bool quoted = false; // Whether scan is inside a quoted field
+        bool atStart = true;
+        for (;;) {
+            if (progress->cancelled) {
+                wipe(buffer);
+                return QString();
+            }
+            QByteArray chunk = file->read(kChunkSize);
+            const bool atEnd = chunk.isEmpty();
+            buffer.append(chunk);
+            wipe(chunk);
+            progress->bytesRead = file->pos();
+            if (atStart && buffer.size() >= 3) {
+                if (buffer.startsWith("\xEF\xBB\xBF")) {
+                    buffer.remove(0, 3);
+                }
+                atStart = false;
+            }
+
+            qsizetype rowStart = 0;
+            for (; scan < buffer.size(); ++scan) {
+                const char c = buffer.at(scan);
+                if (c == '"') {
+                    quoted = !quoted; // An escaped "" toggles twice
+                } else if (c == '\n' && !quoted) {
+                    row(buffer.constData() + rowStart, buffer.constData() + scan);
+                    rowStart = scan + 1;
+                }
+            }
+            if (atEnd) {
+                if (rowStart < buffer.size()) {
+                    row(buffer.constData() + rowStart, buffer.constData() + buffer.size());
+                }
+                wipe(buffer);
+                break;
+            }
+            sodium_memzero(buffer.data(), size_t(rowStart));
+            buffer.remove(0, rowStart);
+            scan -= rowStart;
+        }
+        if (m_headers.isEmpty()) {
+            return QObject::tr("The file has no header row.");
+        }
+        if (!m_hasKnownColumn) {
+            return QObject::tr("None of the columns is a name, username, password or URL.");
+        }
+        return QString();
+    }
+
+private:
+    void row(const char *begin, const char *end)
+    {
+        if (begin == end || (end - begin == 1 && *begin == '\r')) {
+            return;
+        }
+        if (m_headers.isEmpty()) {
+            m_delimiter = detectDelimiter(begin, end);
+            splitCsvRow(begin, end, m_delimiter, &m_fields);
+            for (const QByteArray &label : std::as_const(m_fields)) {
+                m_headers.append(csvHeaderFor(QString::fromUtf8(label)));
+                m_hasKnownColumn |= m_headers.last().kind == CsvColumn::Field;
+            }
+            return;
+        }
+        splitCsvRow(begin, end, m_delimiter, &m_fields);
+        PasswordRecord record;
+        QString folder;
+        for (qsizetype i = 0; i < m_fields.size() && i < m_headers.size(); ++i) {
+            QByteArray &value = m_fields[i];
+            const CsvHeader &header = m_headers.at(i);
+            if (!value.isEmpty()) {
+                switch (header.kind) {
+                case CsvColumn::Field:
+                    m_builder->setFieldUtf8(record, header.field, value);
+                    break;
+                case CsvColumn::Folder:
+                    folder = QString::fromUtf8(value);
+                    break;
+                case CsvColumn::Totp:
+                    addCustom(record, u"totp", value, CustomFieldType::Totp);
+                    break;
+                case CsvColumn::BitwardenFields:
+                    addBitwardenFields(record, value);
+                    break;
+                case CsvColumn::Custom:
+                    addCustom(record, header.label, value, header.secret ? CustomFieldType::Secret
+                                                                         : CustomFieldType::Text);
+                    break;
+                case CsvColumn::Skip:
+                    break;
+                }
+            }
+            wipe(value);
+        }
+        m_builder->addEntry(m_builder->folderForPath(folder), record);
+    }
+
+    void addCustom(PasswordRecord &record, QStringView label, QByteArrayView utf8, CustomFieldType type)
+    {
+        QString value = QString::fromUtf8(utf8);
+        m_builder->addCustom(record, label, value, type);
+        wipe(value);
+    }
+
+    // Bitwarden packs its custom fields into one column, one "name: value" per line
+    void addBitwardenFields(PasswordRecord &record, QByteArrayView lines)
+    {
+        while (!lines.isEmpty()) {
+            qsizetype end = lines.indexOf('\n');
+            if (end < 0) end = lines.size();
+            const QByteArrayView line = lines.first(end);
+            const qsizetype colon = line.indexOf(": ");
+            if (colon > 0) {
+                const QString label = QString::fromUtf8(line.first(colon));
+                addCustom(record, label, line.sliced(colon + 2).trimmed(),
+                          looksSecret(label) ? CustomFieldType::Secret : CustomFieldType::Text);
+            }
+            lines = lines.sliced(qMin(end + 1, lines.size()));
+        }
+    }
+
+    TreeBuilder *m_builder;
+    QList<CsvHeader> m_headers;
+    QList<QByteArray> m_fields; // Reused between rows
+    char m_delimiter = ',';
+    bool m_hasKnownColumn = false;
+};
+
+// ---- KeePass XML --------------------------------------------------------
+
+class KeePassXmlImporter
+{
+public:
+    KeePassXmlImporter(TreeBuilder *builder)
+        : m_builder(builder)
+    {
+    }
+
+    // QXmlStreamReader pulls from the file as it goes; only the current entry is held
+    QString run(QFile *file, Progress *progress)
+    {
+        m_file = file;
+        m_progress = progress;
+        m_xml.setDevice(file);
+        if (!m_xml.readNextStartElement() || m_xml.name() != QLatin1String("KeePassFile")) {
+            return QObject::tr("Not a KeePass XML export.");
+        }
+        while (m_xml.readNextStartElement() && !m_progress->cancelled) {
+            if (m_xml.name() == QLatin1String("Meta")) {
+                readMeta();
+            } else if (m_xml.name() == QLatin1String("Root")) {
+                bool first = true;
+                while (m_xml.readNextStartElement() && !m_progress->cancelled) {
+                    if (m_xml.name() == QLatin1String("Group")) {
+                        readGroup(nullptr, first); // The database's root group is the vault itself
+                        first = false;
+                    } else {
+                        m_xml.skipCurrentElement(); // DeletedObjects
+                    }
+                }
+            } else {
+                m_xml.skipCurrentElement();
+            }
+        }
+        if (m_xml.hasError()) {
+            return QObject::tr("Invalid XML at line %1: %2").arg(m_xml.lineNumber()).arg(m_xml.errorString());
+        }
+        return QString();
+    }
+
+private:
+    void readMeta()
+    {
+        while (m_xml.readNextStartElement()) {
+            if (m_xml.name() == QLatin1String("RecycleBinUUID")) {
+                m_recycleBin = m_xml.readElementText();
+            } else {
+                m_xml.skipCurrentElement();
+            }
+        }
+    }
+
+    void readGroup(QStandardItem *parent, bool isRoot)
+    {
+        QString uuid;
+        QStandardItem *folder = parent;
+        bool created = isRoot;
+        while (m_xml.readNextStartElement() && !m_progress->cancelled) {
+            const QStringView name = m_xml.name();
+            if (name == QLatin1String("UUID")) {
+                uuid = m_xml.readElementText();
+            } else if (name == QLatin1String("Name")) {
+                const QString groupName = m_xml.readElementText();
+                if (!uuid.isEmpty() && uuid == m_recycleBin) {
+                    skipRest(); // Deleted entries stay deleted
+                    return;
+                }
+                if (!created) {
+                    folder = m_builder->addFolder(parent, groupName);
+                    created = true;
+                }
+            } else if (name == QLatin1String("Entry")) {
+                ensureFolder(parent, &folder, &created);
+                readEntry(folder);
+            } else if (name == QLatin1String("Group")) {
+                ensureFolder(parent, &folder, &created);
+                readGroup(folder, false);
+            } else {
+                m_xml.skipCurrentElement();
+            }
+        }
+    }
+
+    void ensureFolder(QStandardItem *parent, QStandardItem **folder, bool *created)
+    {
+        if (!*created) {
+            *folder = m_builder->addFolder(parent, QString()); // Group without a Name before its children
+            *created = true;
+        }
+    }
+
+    void readEntry(QStandardItem *folder)
+    {
+        PasswordRecord record;
+        while (m_xml.readNextStartElement()) {
+            if (m_xml.name() == QLatin1String("String")) {
+                readString(record);
+            } else {
+                m_xml.skipCurrentElement(); // Times, AutoType, Binary, History (old revisions)
+            }
+        }
+        m_builder->addEntry(folder, record);
+        m_progress->bytesRead = m_file->pos();
+    }
+
+    void readString(PasswordRecord &record)
+    {
+        QString key;
+        QString value;
+        bool isProtected = false;
+        while (m_xml.readNextStartElement()) {
+            if (m_xml.name() == QLatin1String("Key")) {
+                key = m_xml.readElementText();
+            } else if (m_xml.name() == QLatin1String("Value")) {
+                isProtected = m_xml.attributes().value(QLatin1String("Protected")) == QLatin1String("True");
+                value = m_xml.readElementText();
+            } else {
+                m_xml.skipCurrentElement();
+            }
+        }
+        static const QHash<QString, RecordField> kFields = {
+            { "Title", RecordField::Name }, { "UserName", RecordField::Username },
+            { "Password", RecordField::Password }, { "URL", RecordField::Url }, { "Notes", RecordField::Notes },
+        };
+        const auto field = kFields.constFind(key);
+        if (field != kFields.constEnd()) {
+            if (!value.isEmpty()) {
+                m_builder->setField(record, field.value(), value);
+            }
+        } else if (key.compare(QLatin1String("otp"), Qt::CaseInsensitive) == 0
+                   || key.startsWith(QLatin1String("TOTP"), Qt::CaseInsensitive)) {
+            m_builder->addCustom(record, key, value, CustomFieldType::Totp);
+        } else {
+            m_builder->addCustom(record, key, value,
+                                 isProtected ? CustomFieldType::Secret
+                                             : value.contains(u'\n') ? CustomFieldType::Multiline
+                                                                      : CustomFieldType::Text);
+        }
+        wipe(value);
+    }
+
+    void skipRest()
+    {
+        while (m_xml.readNextStartElement()) {
+            m_xml.skipCurrentElement();
+        }
+    }
+
+    TreeBuilder *m_builder;
+    QXmlStreamReader m_xml;
+    QFile *m_file = nullptr;
+    Progress *m_progress = nullptr;
+    QString m_recycleBin;
+};
+
+// ---- Bitwarden JSON -----------------------------------------------------
+
+// The export is one object holding a "folders" and an "items" array. Instead of
+// parsing the whole document, a byte scanner follows strings and nesting and
+// cuts out each element of those arrays; only that slice goes to QJsonDocument.
+class BitwardenJsonImporter
+{
+public:
+    BitwardenJsonImporter(TreeBuilder *builder)
+        : m_builder(builder)
+    {
+    }
+
+    QString run(QFile *file, Progress *progress)
+    {
+        QByteArray buffer;
+        qsizetype scan = 0;
+        qsizetype objectStart = -1; // Of the array element being cut out
+        qsizetype stringStart = -1; // Of the string being read at depth 1 (a key)
+        int depth = 0;
+        bool inString = false;
+        bool escaped = false;
+        QByteArray key;   // Last key of the top-level object
+        QByteArray array; // Key of the top-level array being read
+        QString error;
+        for (;;) {
+            if (progress->cancelled) {
+                break;
+            }
+            QByteArray chunk = file->read(kChunkSize);
+            if (chunk.isEmpty()) {
+                break;
+            }
+            buffer.append(chunk);
+            wipe(chunk);
+            progress->bytesRead = file->pos();
+
+            for (; scan < buffer.size() && error.isEmpty(); ++scan) {
+                const char c = buffer.at(scan);
+                if (inString) {
+                    if (escaped) {
+                        escaped = false;
+                    } else if (c == '\\') {
+                        escaped = true;
+                    } else if (c == '"') {
+                        inString = false;
+                        if (depth == 1) {
+                            key = buffer.mid(stringStart, scan - stringStart);
+                            stringStart = -1;
+                        }
+                    }
+                    continue;
+                }
+                switch (c) {
+                case '"':
+                    inString = true;
+                    if (depth == 1) stringStart = scan + 1;
+                    break;
+                case '{':
+                case '[':
+                    if (depth == 1) {
+                        array = c == '[' ? key : QByteArray();
+                    } else if (depth == 2 && c == '{' && (array == "folders" || array == "items")) {
+                        objectStart = scan;
+                    }
+                    ++depth;
+                    break;
+                case '}':
+                case ']':
+                    --depth;
+                    if (depth == 2 && objectStart >= 0) {
+                        QByteArray object = buffer.mid(objectStart, scan + 1 - objectStart);
+                        error = element(object);
+                        wipe(object);
+                        objectStart = -1;
+                    } else if (depth == 1) {
+                        array.clear();
+                    }
+                    break;
+                case 't':
+                    if (depth == 1 && key == "encrypted") { // "encrypted": true
+                        error = QObject::tr("Encrypted Bitwarden exports can't be imported; export as unencrypted JSON.");
+                    }
+                    break;
+                default:
+                    break;
+                }
+            }
+            if (!error.isEmpty()) {
+                break;
+            }
+            // Keep only what a pending element or key still needs
+            qsizetype keep = objectStart >= 0 ? objectStart : stringStart >= 0 ? stringStart : buffer.size();
+            sodium_memzero(buffer.data(), size_t(keep));
+            buffer.remove(0, keep);
+            scan -= keep;
+            if (objectStart >= 0) objectStart -= keep;
+            if (stringStart >= 0) stringStart -= keep;
+        }
+        wipe(buffer);
+        if (!error.isEmpty() || progress->cancelled) {
+            return error;
+        }
+        if (m_folderNames.isEmpty() && m_itemCount == 0 && m_stashed.isEmpty()) {
+            return QObject::tr("Not a Bitwarden JSON export.");
+        }
+        // Items that came before their folder
+        for (QJsonObject &item : m_stashed) {
+            addItem(item);
+        }
+        return QString();
+    }
+
+private:
+    QString element(const QByteArray &bytes)
+    {
+        QJsonParseError parseError;
+        const QJsonDocument document = QJsonDocument::fromJson(bytes, &parseError);
+        if (!document.isObject()) {
+            return QObject::tr("Invalid JSON: %1").arg(parseError.errorString());
+        }
+        QJsonObject object = document.object();
+        if (object.contains(QLatin1String("folderId")) || object.contains(QLatin1String("type"))) {
+            ++m_itemCount;
+            const QString folderId = object.value(QLatin1String("folderId")).toString();
+            if (!folderId.isEmpty() && !m_folderNames.contains(folderId)) {
+                m_stashed.append(object);
+            } else {
+                addItem(object);
+            }
+        } else {
+            m_folderNames.insert(object.value(QLatin1String("id")).toString(),
+                                 object.value(QLatin1String("name")).toString());
+        }
+        return QString();
+    }
+
+    void addItem(const QJsonObject &item)
+    {
+        PasswordRecord record;
+        setField(record, RecordField::Name, item.value(QLatin1String("name")));
+        setField(record, RecordField::Notes, item.value(QLatin1String("notes")));
+
+        const QJsonObject login = item.value(QLatin1String("login")).toObject();
+        setField(record, RecordField::Username, login.value(QLatin1String("username")));
+        setField(record, RecordField::Password, login.value(QLatin1String("password")));
+        const QJsonArray uris = login.value(QLatin1String("uris")).toArray();
+        for (qsizetype i = 0; i < uris.size(); ++i) {
+            const QJsonValue uri = uris.at(i).toObject().value(QLatin1String("uri"));
+            if (i == 0) {
+                setField(record, RecordField::Url, uri);
+            } else {
+                m_builder->addCustom(record, QStringLiteral("url%1").arg(i + 1), uri.toString(), CustomFieldType::Url);
+            }
+        }
+        m_builder->addCustom(record, u"totp", login.value(QLatin1String("totp")).toString(), CustomFieldType::Totp);
+
+        for (const QJsonValue &value : item.value(QLatin1String("fields")).toArray()) {
+            const QJsonObject field = value.toObject();
+            const int type = field.value(QLatin1String("type")).toInt();
+            if (type == 3) {
+                continue; // Linked: points at another field of the item
+            }
+            const QJsonValue fieldValue = field.value(QLatin1String("value"));
+            m_builder->addCustom(record, field.value(QLatin1String("name")).toString(),
+                                 fieldValue.isBool() ? QString::fromLatin1(fieldValue.toBool() ? "true" : "false")
+                                                     : fieldValue.toString(),
+                                 type == 1 ? CustomFieldType::Secret : CustomFieldType::Text);
+        }
+
+        // Cards, identities and SSH keys have no fields of their own here
+        static const char *const kSections[] = { "card", "identity", "sshKey" };
+        for (const char *section : kSections) {
+            const QJsonObject object = item.value(QLatin1String(section)).toObject();
+            for (auto it = object.constBegin(); it != object.constEnd(); ++it) {
+                if (!it.value().isString()) {
+                    continue;
+                }
+                const QString label = QString::fromLatin1(section) + u'_' + it.key();
+                static const QSet<QString> kSecretKeys = {
+                    "number", "code", "ssn", "passportNumber", "licenseNumber", "privateKey",
+                };
+                m_builder->addCustom(record, label, it.value().toString(),
+                                     kSecretKeys.contains(it.key()) ? CustomFieldType::Secret : CustomFieldType::Text);
+            }
+        }
+
+        const QString folderId = item.value(QLatin1String("folderId")).toString();
+        m_builder->addEntry(m_builder->folderForPath(m_folderNames.value(folderId)), record);
+    }
+
+    void setField(PasswordRecord &record, RecordField field, const QJsonValue &value)
+    {
+        QString text = value.toString();
+        if (!text.isEmpty()) {
+            m_builder->setField(record, field, text);
+        }
+        wipe(text);
+    }
+
+    TreeBuilder *m_builder;
+    QHash<QString, QString> m_folderNames; // Folder id -> '/'-separated name
+    QList<QJsonObject> m_stashed;
+    int m_itemCount = 0;
+};
+
+} // namespace
+
+namespace Importer {
+
+bool detectFormat(const QString &filePath, Format *format)
+{
+    const QString suffix = QFileInfo(filePath).suffix().toLower();
+    if (suffix == QLatin1String("csv") || suffix == QLatin1String("tsv")) {
+        *format = Format::Csv;
+        return true;
+    }
+    if (suffix == QLatin1String("xml")) {
+        *format = Format::KeePassXml;
+        return true;
+    }
+    if (suffix == QLatin1String("json")) {
+        *format = Format::BitwardenJson;
+        return true;
+    }
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const QByteArray head = file.read(512).trimmed();
+    if (head.startsWith('<') || head.startsWith("\xEF\xBB\xBF<")) {
+        *format = Format::KeePassXml;
+    } else if (head.startsWith('{')) {
+        *format = Format::BitwardenJson;
+    } else if (!head.isEmpty()) {
+        *format = Format::Csv;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+QString formatName(Format format)
+{
+    switch (format) {
+    case Format::Csv:
+        return QObject::tr("CSV");
+    case Format::KeePassXml:
+        return QObject::tr("KeePass XML");
+    case Format::BitwardenJson:
+        return QObject::tr("Bitwarden JSON");
+    }
+    return QString();
+}
+
+Result importFile(const QString &filePath, Format format, StringPool *strings, Progress *progress)
+{
+    Result result;
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        result.error = QObject::tr("Could not open %1: %2").arg(filePath, file.errorString());
+        return result;
+    }
+    TreeBuilder builder(strings->createArena(), &result);
+    switch (format) {
+    case Format::Csv:
+        result.error = CsvImporter(&builder).run(&file, progress);
+        break;
+    case Format::KeePassXml:
+        result.error = KeePassXmlImporter(&builder).run(&file, progress);
+        break;
+    case Format::BitwardenJson:
+        result.error = BitwardenJsonImporter(&builder).run(&file, progress);
+        break;
+    }
+    if (!result.error.isEmpty() || progress->cancelled) {
+        qDeleteAll(result.items);
+        result.items.clear();
+        result.entryCount = 0;
+        result.folderCount = 0;
+    }
+    return result;
+}
+
+} // namespace Importer
@@ -0,0 +1,48 @@
+#ifndef IMPORTER_H
+#define IMPORTER_H
+
+#include <QList>
+#include <QString>
+#include <atomic>
+
+class QStandardItem;
+class StringPool;
+
+// Reads the exports of other password managers into detached QStandardItem
+// subtrees, ready to be handed to the model with one appendRows().
+//
+// The file is read in fixed-size chunks and each record is turned into an
+// item as soon as it is complete, so memory grows with the vault being built,
+// not with the size of the export. Folders and groups become folder items;
+// columns and fields without a schema field become custom fields. Can run on
+// any thread; shared fields are interned into an arena taken from strings.
+namespace Importer {
+
+enum class Format {
+    Csv,           // Header row naming the columns (KeePass, Bitwarden, browsers, ...)
+    KeePassXml,    // KeePass 2 / KeePassXC "KeePass XML (2.x)" export
+    BitwardenJson, // Unencrypted Bitwarden JSON export
+};
+
+// By extension, or by the first non-blank byte for unknown extensions
+bool detectFormat(const QString &filePath, Format *format);
+QString formatName(Format format);
+
+// Shared between the importing thread and the one showing progress
+struct Progress {
+    std::atomic<qint64> bytesRead{0};
+    std::atomic_bool cancelled{false};
+};
+
+struct Result {
+    QList<QStandardItem*> items; // Top-level folders and entries, in file order; owned by the caller
+    int entryCount = 0;
+    int folderCount = 0;
+    QString error; // Empty on success
+};
+
+Result importFile(const QString &filePath, Format format, StringPool *strings, Progress *progress);
+
+} // namespace Importer
+
+#endif // IMPORTER_H
@@ -0,0 +1,33 @@
+#ifndef ITEMID_H
+#define ITEMID_H
+
+#include <QStandardItem>
+#include <sodium.h> // Required for randombytes_buf
+
+// Stable identity of a vault item. Names and positions change; the id stays
+// with the item through renames, edits and moves and is written to the file
+// ("id: <hex>"), so two copies of a vault can be matched item by item.
+// Random 64-bit ids need no coordination between the people sharing a vault.
+namespace ItemId {
+
+// quint64 on every folder and entry, set where the item is created (or read,
+// see parseV1Document), so undo steps capture it with the rest of the item
+inline constexpr int kRole = Qt::UserRole + 1;
+
+inline quint64 generate()
+{
+    quint64 id = 0;
+    while (id == 0) {
+        randombytes_buf(&id, sizeof id);
+    }
+    return id;
+}
+
+inline quint64 of(const QStandardItem *item)
+{
+    return item->data(kRole).toULongLong();
+}
+
+} // namespace ItemId
+
+#endif // ITEMID_H
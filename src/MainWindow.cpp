@@ -19,32 +19,95 @@
 #include <QItemDelegate> // Required for connecting to editor signals
 #include <QCompleter> // Required for search completer
 #include <functional> // Required for std::function for recursive lambda
+#include <algorithm> // Required for std::partial_sort
 #include <QTimer> // Required for QTimer::singleShot
 #include <QClipboard> // Required for clipboard access
 #include <QMessageBox> // Required for QMessageBox
-
-
-// Define a simple struct to hold password record data
-struct PasswordRecord {
-    QString name;
-    QString username;
-    QString password;
-    QString url;
-    QString notes;
-
-    bool isEmpty() const {
-        return name.isEmpty() && username.isEmpty() && password.isEmpty() && url.isEmpty() && notes.isEmpty();
-    }
-};
+#include <QComboBox> // Required for the custom field type selector
+#include "PasswordRecord.h" // Record data stored on tree items
+#include "V1Reader.h" // Parser for the decrypted database text
+#include "model/SecurePool.hpp" // Usage figures for the memory stats dialog
+#include "VaultFile.h" // ALOCK_V1 encryption and decryption
+#include "VaultSnapshot.h" // Shared record matching for the search bar
+#include "UnlockAgent.h" // Open vaults held by a running agent
+#include "SearchQuery.h" // Search bar query language
+#include <QtConcurrent/QtConcurrentMap> // Parallel unlock and search across mounted vaults
+#include <QtConcurrent/QtConcurrentRun> // Background imports
+#include <QFutureWatcher> // Required for waiting on the import without blocking the window
+#include <QProgressDialog> // Required for the import progress
+#include <QEventLoop> // Required for running the import dialog while the pool works
+#include "Importer.h" // CSV, KeePass XML and Bitwarden JSON imports
+#include "Exporter.h" // Streaming CSV and JSON export
+#include "ItemId.h" // Stable item ids written with the vault
+#include <QFile> // Required for writing exports
+#include "PasswordAudit.h" // Reuse, strength and age checks
+#include "AuditDialog.h"
+#include "BreachIndex.h" // Offline check against known breached passwords
+#include "AttachmentStore.h" // Encrypted attachment blobs next to the vault
+#include "AttachmentDialog.h"
+#include "EntryRevisions.h" // Earlier versions of entries
+#include "RevisionDialog.h"
+#include <QDesktopServices> // Required for opening attachments in their application
+#include <QSaveFile> // Required for exporting attachments
+#include <QUrl>
+#include <QDateTime> // Required for password change dates
+#include <QLocale> // Required for dates and sizes in the record view
 
 #include <QSettings>
 #include <QDir>
+#include <QDataStream> // Required for the locked session blob
 
-// Declare the struct as a metatype so it can be stored in QVariant
-Q_DECLARE_METATYPE(PasswordRecord)
-// Also declare QStandardItem* as a metatype
+// Declare QStandardItem* as a metatype so it can be stored in QVariant
 Q_DECLARE_METATYPE(QStandardItem*)
 
+namespace {
+constexpr qsizetype kMaxSearchResults = 200; // Completer rows; the rest of the ranking is never looked at
+constexpr int kExternalChangeRetryMs = 1000; // Until the edit or dialog holding back a merge is closed
+// Removed search entries tolerated before the next search rebuilds the buffer
+// without them: a fixed floor, then a share of all entries
+constexpr std::size_t kMinRemovedSearchEntries = 256;
+
+// Case folding goes through temporary QStrings; the ones holding notes are wiped afterwards
+QByteArray foldToUtf8(QStringView value, bool sensitive)
+{
+    QString folded = value.toString();
+    folded = std::move(folded).toCaseFolded();
+    QByteArray utf8 = folded.toUtf8();
+    if (sensitive) {
+        sodium_memzero(folded.data(), size_t(folded.size()) * sizeof(QChar));
+    }
+    return utf8;
+}
+
+EntryRevisions::Retention revisionRetention()
+{
+    QSettings settings(QSettings::IniFormat, QSettings::UserScope, "ArcaneLock", "ArcaneLock");
+    EntryRevisions::Retention retention;
+    if (!settings.contains("historyRevisions")) {
+        settings.setValue("historyRevisions", retention.maxRevisions); // Written out so they can be found and changed
+        settings.setValue("historyDays", retention.maxAgeDays);
+    }
+    retention.maxRevisions = settings.value("historyRevisions", retention.maxRevisions).toInt();
+    retention.maxAgeDays = settings.value("historyDays", retention.maxAgeDays).toInt();
+    return retention;
+}
+} // namespace
+
+// The vault file as it is on disk now and as this window last read or wrote
+// it, both decrypted, so merge() can take over just what changed
+struct MainWindow::ExternalChange {
+    QByteArray fileContent; // The new bytes
+    QByteArray baseContent; // vault->fileContent when the read began
+    StringPool baseStrings; // Outlive the roots, whose items point into them
+    StringPool remoteStrings;
+    QStandardItem baseRoot;
+    QStandardItem remoteRoot;
+    std::unique_ptr<VaultSync::Tree> base;
+    std::unique_ptr<VaultSync::Tree> remote; // Null when the bytes turned out to be the same
+    QString errorMessage;
+    bool ready = false; // Read; only touched by the GUI thread from then on
+};
+
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -64,7 +127,43 @@ MainWindow::MainWindow(QWidget *parent)
 
     // Set up a basic model for the tree view
     m_treeModel = new QStandardItemModel(this);
-    m_treeView->setModel(m_treeModel);
+    // The view sees the vaults through the filter proxy, which passes every row until f is used
+    m_treeFilter = new TreeFilterModel(this);
+    m_treeFilter->setSourceModel(m_treeModel);
+    m_treeView->setModel(m_treeFilter);
+    // Any change to a vault leaves it to be saved, and updates the search entries of the rows it touched
+    connect(m_treeModel, &QStandardItemModel::rowsInserted, this,
+            [this](const QModelIndex &parent) { markVaultChanged(parent); });
+    connect(m_treeModel, &QStandardItemModel::rowsRemoved, this,
+            [this](const QModelIndex &parent) { markVaultChanged(parent); });
+    connect(m_treeModel, &QStandardItemModel::dataChanged, this,
+            [this](const QModelIndex &topLeft) { markVaultChanged(topLeft); });
+    connect(m_treeModel, &QStandardItemModel::rowsInserted, this, &MainWindow::indexSearchRows);
+    connect(m_treeModel, &QStandardItemModel::rowsAboutToBeRemoved, this, &MainWindow::unindexSearchRows);
+    connect(m_treeModel, &QStandardItemModel::dataChanged, this,
+            [this](const QModelIndex &topLeft, const QModelIndex &bottomRight, const QList<int> &roles) {
+                if (roles.isEmpty() || roles.contains(Qt::UserRole)) {
+                    reindexSearchRows(topLeft, bottomRight); // Only the record feeds the search buffer
+                }
+            });
+    connect(m_treeModel, &QStandardItemModel::rowsInserted, this, &MainWindow::forgetSyncHashes);
+    connect(m_treeModel, &QStandardItemModel::rowsAboutToBeRemoved, this, &MainWindow::forgetSyncHashes);
+    // Files replaced underneath us are merged in rather than overwritten by the next save
+    m_vaultWatcher = new VaultWatcher(this);
+    connect(m_vaultWatcher, &VaultWatcher::changed, this, &MainWindow::onVaultFileChanged);
+    m_externalChangeTimer = new QTimer(this);
+    m_externalChangeTimer->setSingleShot(true);
+    m_externalChangeTimer->setInterval(kExternalChangeRetryMs);
+    connect(m_externalChangeTimer, &QTimer::timeout, this, &MainWindow::applyExternalChanges);
+    // A rename in the tree's editor is the one change not made by MainWindow code
+    connect(m_treeModel, &QStandardItemModel::itemChanged, this, [this](QStandardItem *item) {
+        Vault *vault = m_isEditingTreeItem ? vaultForItem(item) : nullptr;
+        if (vault && item != vault->root) {
+            const VaultHistory::Path path = VaultHistory::pathOf(item);
+            vault->history.updated(item);
+            vault->history.commit(tr("Rename"), path, path);
+        }
+    });
 
     // --- NO DUMMY DATA ---
     // The tree view starts empty as per new requirement.
@@ -121,6 +220,8 @@ MainWindow::MainWindow(QWidget *parent)
     m_searchCompleterModel = new QStandardItemModel(this);
     m_searchCompleter = new QCompleter(m_searchCompleterModel, this);
     m_searchCompleter->setCaseSensitivity(Qt::CaseInsensitive);
+    // Results are fuzzy matches ranked by performSearch(); the completer must not re-filter them by prefix
+    m_searchCompleter->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
     m_searchBar->setCompleter(m_searchCompleter);
 
     connect(m_searchBar, &QLineEdit::textChanged, this, &MainWindow::performSearch);
@@ -139,6 +240,13 @@ MainWindow::MainWindow(QWidget *parent)
     qApp->installEventFilter(this);
 
     loadRecentFiles();
+    loadFrecency();
+
+    // Idle lock
+    m_idleTimer = new QTimer(this);
+    m_idleTimer->setSingleShot(true);
+    connect(m_idleTimer, &QTimer::timeout, this, &MainWindow::lockVault);
+    loadIdleLockSettings();
 
     // As per new requirement: Do not load the most recent file on startup.
     // The application should always launch with an empty database.
@@ -169,6 +277,34 @@ void MainWindow::saveRecentFiles()
     settings.setValue("recentFiles", m_recentFiles);
 }
 
+void MainWindow::loadFrecency()
+{
+    QSettings settings(QSettings::IniFormat, QSettings::UserScope, "ArcaneLock", "ArcaneLock");
+    m_frecency.fromStringList(settings.value("frecency").toStringList());
+}
+
+void MainWindow::saveFrecency()
+{
+    QSettings settings(QSettings::IniFormat, QSettings::UserScope, "ArcaneLock", "ArcaneLock");
+    settings.setValue("frecency", m_frecency.toStringList());
+}
+
+void MainWindow::loadIdleLockSettings()
+{
+    QSettings settings(QSettings::IniFormat, QSettings::UserScope, "ArcaneLock", "ArcaneLock");
+    if (!settings.contains("idleLockMinutes")) {
+        settings.setValue("idleLockMinutes", 5); // Written out so it can be found and changed
+    }
+    const int minutes = settings.value("idleLockMinutes").toInt();
+    if (minutes > 0) {
+        m_idleTimer->setInterval(minutes * 60 * 1000);
+        m_idleTimer->start();
+    } else {
+        m_idleTimer->stop(); // 0 disables the idle lock
+        m_idleTimer->setInterval(0);
+    }
+}
+
 void MainWindow::addRecentFile(const QString &filePath)
 {
     m_recentFiles.removeAll(filePath);
@@ -197,12 +333,14 @@ void MainWindow::setMode(Mode newMode)
             m_rightPanelStackedWidget->setCurrentIndex(0); // Show read-only view
             break;
         case Mode::INSERT:
-            if (m_nameEdit) { // Check if m_nameEdit is valid before setting focus
-                m_nameEdit->setFocus();
+            if (QWidget *firstEditor = m_fieldEditors[std::size_t(RecordSchema::kDisplayOrder.front())]) {
+                firstEditor->setFocus();
             }
             m_rightPanelStackedWidget->setCurrentIndex(1); // Show editable view
             break;
         case Mode::VISUAL:
+            m_treeView->setFocus();
+            m_rightPanelStackedWidget->setCurrentIndex(0); // Show read-only view
             break;
     }
 }
@@ -216,7 +354,10 @@ void MainWindow::updateStatusLabel()
         case Mode::INSERT: modeText = "INSERT"; break;
         case Mode::VISUAL: modeText = "VISUAL"; break;
     }
-    m_statusLabel->setText(QString("MODE: %1").arg(modeText));
+    if (m_currentMode == Mode::VISUAL) {
+        modeText += tr(" (%n selected)", nullptr, int(m_visualSelection.size()));
+    }
+    m_statusLabel->setText(m_vaultLocked ? QString("LOCKED") : QString("MODE: %1").arg(modeText));
 }
 
 void MainWindow::expandAllNodes() {
@@ -225,15 +366,19 @@ void MainWindow::expandAllNodes() {
 
 void MainWindow::collapseAllNodes() {
     m_treeView->collapseAll();
+    // Vault roots stay open so each vault's top level remains visible
+    for (const auto &vault : m_vaults) {
+        m_treeView->expand(viewIndex(vault->root->index()));
+    }
     QModelIndex firstItem = m_treeModel->index(0, 0);
     if (firstItem.isValid()) {
-        m_treeView->setCurrentIndex(firstItem);
+        setCurrentSourceIndex(firstItem);
     }
 }
 
 // --- Tree Item Manipulation Implementations ---
 void MainWindow::moveItemToParentOrRoot() {
-    QModelIndex currentIndex = m_treeView->currentIndex();
+    QModelIndex currentIndex = currentSourceIndex();
     if (!currentIndex.isValid()) return;
 
     QStandardItem *currentItem = m_treeModel->itemFromIndex(currentIndex);
@@ -243,26 +388,34 @@ void MainWindow::moveItemToParentOrRoot() {
     if (!parentItem) { // Already a top-level item
         return;
     }
+    if (!parentItem->parent()) { // Parent is a vault root; items don't leave their vault
+        statusBar()->showMessage(tr("Already at the top of the vault."), 3000);
+        return;
+    }
 
     int currentRow = currentItem->row();
+    Vault *vault = vaultForItem(currentItem);
+    vault->history.prepare(vault->root);
+    const VaultHistory::Path before = VaultHistory::pathOf(currentItem);
 
     QList<QStandardItem*> itemsToMove = parentItem->takeRow(currentRow);
     if (itemsToMove.isEmpty()) {
         return;
     }
 
-    QStandardItem *grandparentItem = parentItem->parent();
-    QStandardItem *newContainer = grandparentItem ? grandparentItem : m_treeModel->invisibleRootItem();
+    QStandardItem *newContainer = parentItem->parent();
 
     newContainer->appendRow(itemsToMove);
+    vault->history.moved(before, itemsToMove.first());
+    vault->history.commit(tr("Move"), before, VaultHistory::pathOf(itemsToMove.first()));
 
     QModelIndex newIndex = m_treeModel->index(newContainer->rowCount() - 1, 0, newContainer->index());
-    m_treeView->setCurrentIndex(newIndex);
-    m_treeView->scrollTo(newIndex);
+    setCurrentSourceIndex(newIndex);
+    m_treeView->scrollTo(viewIndex(newIndex));
 }
 
 void MainWindow::moveItemDown() {
-    QModelIndex currentIndex = m_treeView->currentIndex();
+    QModelIndex currentIndex = currentSourceIndex();
     if (!currentIndex.isValid()) return;
 
     QStandardItem *currentItem = m_treeModel->itemFromIndex(currentIndex);
@@ -277,20 +430,30 @@ void MainWindow::moveItemDown() {
         return;
     }
 
+    Vault *vault = parentItem ? vaultForItem(currentItem) : nullptr; // Reordering vaults is not a vault change
+    if (vault) {
+        vault->history.prepare(vault->root);
+    }
+    const VaultHistory::Path before = VaultHistory::pathOf(currentItem);
+
     QList<QStandardItem*> itemsToMove = containerItem->takeRow(currentRow);
     if (itemsToMove.isEmpty()) {
         return;
     }
 
     containerItem->insertRow(currentRow + 1, itemsToMove);
+    if (vault) {
+        vault->history.moved(before, itemsToMove.first());
+        vault->history.commit(tr("Move"), before, VaultHistory::pathOf(itemsToMove.first()));
+    }
 
     QModelIndex newIndex = m_treeModel->index(currentRow + 1, 0, parentItem ? parentItem->index() : QModelIndex());
-    m_treeView->setCurrentIndex(newIndex);
-    m_treeView->scrollTo(newIndex);
+    setCurrentSourceIndex(newIndex);
+    m_treeView->scrollTo(viewIndex(newIndex));
 }
 
 void MainWindow::moveItemUp() {
-    QModelIndex currentIndex = m_treeView->currentIndex();
+    QModelIndex currentIndex = currentSourceIndex();
     if (!currentIndex.isValid()) return;
 
     QStandardItem *currentItem = m_treeModel->itemFromIndex(currentIndex);
@@ -304,27 +467,40 @@ void MainWindow::moveItemUp() {
         return;
     }
 
+    Vault *vault = parentItem ? vaultForItem(currentItem) : nullptr; // Reordering vaults is not a vault change
+    if (vault) {
+        vault->history.prepare(vault->root);
+    }
+    const VaultHistory::Path before = VaultHistory::pathOf(currentItem);
+
     QList<QStandardItem*> itemsToMove = containerItem->takeRow(currentRow);
     if (itemsToMove.isEmpty()) {
         return;
     }
 
     containerItem->insertRow(currentRow - 1, itemsToMove);
+    if (vault) {
+        vault->history.moved(before, itemsToMove.first());
+        vault->history.commit(tr("Move"), before, VaultHistory::pathOf(itemsToMove.first()));
+    }
 
     QModelIndex newIndex = m_treeModel->index(currentRow - 1, 0, parentItem ? parentItem->index() : QModelIndex());
-    m_treeView->setCurrentIndex(newIndex);
-    m_treeView->scrollTo(newIndex);
+    setCurrentSourceIndex(newIndex);
+    m_treeView->scrollTo(viewIndex(newIndex));
 }
 
 void MainWindow::moveItemIntoSiblingFolder() {
-    QModelIndex currentIndex = m_treeView->currentIndex();
+    QModelIndex currentIndex = currentSourceIndex();
     if (!currentIndex.isValid()) return;
 
     QStandardItem *currentItem = m_treeModel->itemFromIndex(currentIndex);
     if (!currentItem) return;
 
     QStandardItem *parentItem = currentItem->parent();
-    QStandardItem *containerItem = parentItem ? parentItem : m_treeModel->invisibleRootItem();
+    if (!parentItem) { // Vault roots can't be nested
+        return;
+    }
+    QStandardItem *containerItem = parentItem;
 
     int currentRow = currentItem->row();
     if (currentRow == 0) { // Cannot move into a sibling folder if it's the first child
@@ -336,32 +512,400 @@ void MainWindow::moveItemIntoSiblingFolder() {
         return;
     }
 
+    Vault *vault = vaultForItem(currentItem);
+    vault->history.prepare(vault->root);
+    const VaultHistory::Path before = VaultHistory::pathOf(currentItem);
+
     QList<QStandardItem*> itemsToMove = containerItem->takeRow(currentRow);
     if (itemsToMove.isEmpty()) {
         return;
     }
 
     siblingItem->appendRow(itemsToMove);
+    vault->history.moved(before, itemsToMove.first());
+    vault->history.commit(tr("Move"), before, VaultHistory::pathOf(itemsToMove.first()));
 
-    m_treeView->expand(siblingItem->index());
+    m_treeView->expand(viewIndex(siblingItem->index()));
 
     QModelIndex newIndex = m_treeModel->index(siblingItem->rowCount() - 1, 0, siblingItem->index());
-    m_treeView->setCurrentIndex(newIndex);
-    m_treeView->scrollTo(newIndex);
+    setCurrentSourceIndex(newIndex);
+    m_treeView->scrollTo(viewIndex(newIndex));
 }
 
 void MainWindow::deleteSelectedItem() {
-    QModelIndex currentIndex = m_treeView->currentIndex();
+    QModelIndex currentIndex = currentSourceIndex();
     if (!currentIndex.isValid()) return;
 
     QStandardItem *currentItem = m_treeModel->itemFromIndex(currentIndex);
     if (!currentItem) return;
 
     QStandardItem *parentItem = currentItem->parent();
-    QModelIndex parentIndex = parentItem ? parentItem->index() : QModelIndex();
+    if (!parentItem) {
+        statusBar()->showMessage(tr("Use Shift+W to close a vault."), 3000);
+        return;
+    }
+    QModelIndex parentIndex = parentItem->index();
+    Vault *vault = vaultForItem(currentItem);
+    vault->history.prepare(vault->root);
+    const VaultHistory::Path path = VaultHistory::pathOf(currentItem);
 
     int currentRow = currentItem->row();
     m_treeModel->removeRow(currentRow, parentIndex);
+    vault->history.removed(path);
+    vault->history.commit(tr("Delete"), path, path);
+    statusBar()->showMessage(tr("Deleted. Press u to undo."), 3000);
+}
+
+void MainWindow::enterVisualMode()
+{
+    if (!currentSourceIndex().isValid()) {
+        return;
+    }
+    m_visualBase.clear();
+    m_visualAnchor = currentSourceIndex();
+    setMode(Mode::VISUAL);
+    updateVisualSelection();
+}
+
+void MainWindow::exitVisualMode()
+{
+    m_visualSelection.clear();
+    m_visualBase.clear();
+    m_visualAnchor = QPersistentModelIndex();
+    m_treeView->selectionModel()->select(m_treeView->currentIndex(), QItemSelectionModel::ClearAndSelect);
+    setMode(Mode::TREE);
+}
+
+void MainWindow::startVisualRange()
+{
+    m_visualBase = m_visualSelection;
+    m_visualAnchor = currentSourceIndex();
+    updateVisualSelection();
+}
+
+void MainWindow::toggleVisualItem()
+{
+    const QPersistentModelIndex current(currentSourceIndex());
+    if (!current.isValid()) {
+        return;
+    }
+    if (!m_visualSelection.remove(current)) {
+        m_visualSelection.insert(current);
+    }
+    m_visualBase = m_visualSelection;
+    m_visualAnchor = QPersistentModelIndex();
+    updateVisualSelection();
+}
+
+void MainWindow::updateVisualSelection()
+{
+    if (m_visualAnchor.isValid()) {
+        m_visualSelection = m_visualBase;
+        // The rows on screen between anchor and cursor, whichever comes first
+        const QModelIndex from = viewIndex(m_visualAnchor);
+        const QModelIndex to = m_treeView->currentIndex();
+        QModelIndexList range;
+        for (QModelIndex index = from; index.isValid(); index = m_treeView->indexBelow(index)) {
+            range.append(index);
+            if (index == to) break;
+        }
+        if (range.isEmpty() || range.last() != to) {
+            range.clear();
+            for (QModelIndex index = from; index.isValid(); index = m_treeView->indexAbove(index)) {
+                range.append(index);
+                if (index == to) break;
+            }
+        }
+        for (const QModelIndex &index : std::as_const(range)) {
+            m_visualSelection.insert(QPersistentModelIndex(m_treeFilter->mapToSource(index)));
+        }
+    }
+
+    QItemSelection selection;
+    for (const QPersistentModelIndex &index : std::as_const(m_visualSelection)) {
+        const QModelIndex shown = viewIndex(index);
+        if (shown.isValid()) {
+            selection.select(shown, shown);
+        }
+    }
+    m_treeView->selectionModel()->select(selection, QItemSelectionModel::ClearAndSelect);
+    updateStatusLabel();
+}
+
+QList<QStandardItem*> MainWindow::visualSelectedItems(Vault **vault)
+{
+    *vault = nullptr;
+    QSet<QStandardItem*> chosen;
+    for (const QPersistentModelIndex &index : std::as_const(m_visualSelection)) {
+        QStandardItem *item = index.isValid() ? m_treeModel->itemFromIndex(index) : nullptr;
+        if (!item || !item->parent()) {
+            continue; // Vault roots are closed with Shift+W, not deleted or moved
+        }
+        Vault *itemVault = vaultForItem(item);
+        if (*vault && itemVault != *vault) {
+            statusBar()->showMessage(tr("Select items from one vault at a time."), 3000);
+            *vault = nullptr;
+            return {};
+        }
+        *vault = itemVault;
+        chosen.insert(item);
+    }
+
+    // A selected folder brings its contents along; they don't count twice
+    std::vector<std::pair<VaultHistory::Path, QStandardItem*>> ordered;
+    for (QStandardItem *item : std::as_const(chosen)) {
+        bool nested = false;
+        for (QStandardItem *above = item->parent(); above && !nested; above = above->parent()) {
+            nested = chosen.contains(above);
+        }
+        if (!nested) {
+            ordered.emplace_back(VaultHistory::pathOf(item), item);
+        }
+    }
+    std::sort(ordered.begin(), ordered.end(),
+              [](const auto &a, const auto &b) { return a.first < b.first; });
+    QList<QStandardItem*> items;
+    items.reserve(qsizetype(ordered.size()));
+    for (const auto &entry : ordered) {
+        items.append(entry.second);
+    }
+    return items;
+}
+
+void MainWindow::takeItemRows(const QList<QStandardItem*> &items)
+{
+    // Back to front, so rows still to take keep their numbers. Each run of
+    // adjacent rows leaves the model with one removeRows.
+    for (qsizetype i = items.size() - 1; i >= 0;) {
+        QStandardItem *parent = items.at(i)->parent();
+        const int last = items.at(i)->row();
+        int first = last;
+        qsizetype j = i - 1;
+        while (j >= 0 && items.at(j)->parent() == parent && items.at(j)->row() == first - 1) {
+            --first;
+            --j;
+        }
+        for (int row = first; row <= last; ++row) {
+            parent->takeChild(row);
+        }
+        parent->removeRows(first, last - first + 1);
+        i = j;
+    }
+}
+
+void MainWindow::deleteVisualSelection()
+{
+    Vault *vault = nullptr;
+    const QList<QStandardItem*> items = visualSelectedItems(&vault);
+    if (items.isEmpty()) {
+        return;
+    }
+    vault->history.prepare(vault->root);
+    std::vector<VaultHistory::Path> paths;
+    for (const QStandardItem *item : items) {
+        paths.push_back(VaultHistory::pathOf(item));
+    }
+
+    m_treeView->setUpdatesEnabled(false);
+    for (qsizetype i = items.size() - 1; i >= 0;) {
+        QStandardItem *parent = items.at(i)->parent();
+        const int last = items.at(i)->row();
+        int first = last;
+        qsizetype j = i - 1;
+        while (j >= 0 && items.at(j)->parent() == parent && items.at(j)->row() == first - 1) {
+            --first;
+            --j;
+        }
+        parent->removeRows(first, last - first + 1);
+        i = j;
+    }
+    for (auto path = paths.rbegin(); path != paths.rend(); ++path) {
+        vault->history.removed(*path);
+    }
+    vault->history.commit(tr("Delete %n items", nullptr, int(paths.size())), paths.front(), paths.front());
+    m_treeView->setUpdatesEnabled(true);
+
+    exitVisualMode();
+    setCurrentSourceIndex(VaultHistory::itemAt(vault->root, paths.front())->index());
+    statusBar()->showMessage(tr("Deleted %n items. Press u to undo.", nullptr, int(paths.size())), 3000);
+}
+
+void MainWindow::moveVisualSelection(int delta)
+{
+    Vault *vault = nullptr;
+    const QList<QStandardItem*> items = visualSelectedItems(&vault);
+    if (items.isEmpty()) {
+        return;
+    }
+
+    // A run of selected rows moves by swapping places with the row next to
+    // it, so only that one row per run actually changes folders' order
+    struct Displaced {
+        QStandardItem *item;
+        QStandardItem *parent;
+        int finalRow;
+    };
+    std::vector<Displaced> displaced;
+    for (qsizetype i = 0; i < items.size();) {
+        QStandardItem *parent = items.at(i)->parent();
+        const int first = items.at(i)->row();
+        int last = first;
+        qsizetype j = i + 1;
+        while (j < items.size() && items.at(j)->parent() == parent && items.at(j)->row() == last + 1) {
+            ++last;
+            ++j;
+        }
+        if (delta < 0 && first > 0) {
+            displaced.push_back(Displaced{parent->child(first - 1), parent, last});
+        } else if (delta > 0 && last + 1 < parent->rowCount()) {
+            displaced.push_back(Displaced{parent->child(last + 1), parent, first});
+        }
+        i = j;
+    }
+    if (displaced.empty()) {
+        return; // Every run is already at the edge of its folder
+    }
+
+    // The runs come in selection order, which isn't tree order once a run ends
+    // in a folder and the next one starts below it: moving up, that folder is
+    // displaced after a row inside it. Sorted by path, rows inside a displaced
+    // folder come right after it, so they are taken before it and put back
+    // after it, and the folder carries them along.
+    vault->history.prepare(vault->root);
+    std::vector<std::pair<VaultHistory::Path, Displaced>> sorted;
+    for (const Displaced &move : displaced) {
+        sorted.emplace_back(VaultHistory::pathOf(move.item), move);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+    QList<QStandardItem*> taken;
+    for (std::size_t i = 0; i < sorted.size(); ++i) {
+        displaced[i] = sorted[i].second;
+        taken.append(displaced[i].item);
+    }
+    std::vector<VaultHistory::Subtree> subtrees(sorted.size());
+    for (std::size_t i = sorted.size(); i-- > 0;) {
+        subtrees[i] = vault->history.take(sorted[i].first); // Deepest and last first, so the other paths hold
+    }
+
+    m_treeView->setUpdatesEnabled(false);
+    takeItemRows(taken);
+    for (const Displaced &move : displaced) {
+        move.parent->insertRow(move.finalRow, move.item); // Front to back, so earlier rows are in place
+    }
+    for (std::size_t i = 0; i < displaced.size(); ++i) {
+        vault->history.put(subtrees[i], displaced[i].item);
+    }
+    const VaultHistory::Path focus = VaultHistory::pathOf(m_treeModel->itemFromIndex(currentSourceIndex()));
+    vault->history.commit(tr("Move %n items", nullptr, int(items.size())), focus, focus);
+    m_treeView->setUpdatesEnabled(true);
+
+    updateVisualSelection();
+    m_treeView->scrollTo(m_treeView->currentIndex());
+}
+
+void MainWindow::moveVisualSelectionToFolder()
+{
+    Vault *vault = nullptr;
+    QList<QStandardItem*> items = visualSelectedItems(&vault);
+    if (items.isEmpty()) {
+        return;
+    }
+
+    // Every folder of the vault that isn't being moved itself
+    const QSet<QStandardItem*> moving(items.begin(), items.end());
+    QStringList labels{QStringLiteral("/")};
+    QList<QStandardItem*> folders{vault->root};
+    std::function<void(QStandardItem *, const QString &)> collectFolders = [&](QStandardItem *item, const QString &path) {
+        for (int i = 0; i < item->rowCount(); ++i) {
+            QStandardItem *child = item->child(i);
+            if (moving.contains(child) || child->data(Qt::UserRole).canConvert<PasswordRecord>()) {
+                continue;
+            }
+            const QString childPath = path + u'/' + child->text();
+            labels.append(childPath);
+            folders.append(child);
+            collectFolders(child, childPath);
+        }
+    };
+    collectFolders(vault->root, QString());
+    // Sibling folders may share a name; the dialog hands back a label, so each must name one folder
+    QSet<QString> taken;
+    for (QString &label : labels) {
+        const QString path = label;
+        for (int occurrence = 2; taken.contains(label); ++occurrence) {
+            label = QStringLiteral("%1 (%2)").arg(path).arg(occurrence);
+        }
+        taken.insert(label);
+    }
+
+    m_isModalDialogActive = true;
+    bool ok = false;
+    const QString chosen = QInputDialog::getItem(this, tr("Move to Folder"),
+                                                 tr("Move %n items to:", nullptr, int(items.size())),
+                                                 labels, 0, false, &ok);
+    m_isModalDialogActive = false;
+    if (!ok) {
+        return;
+    }
+    QStandardItem *target = folders.at(labels.indexOf(chosen));
+
+    vault->history.prepare(vault->root);
+    std::vector<VaultHistory::Path> paths;
+    for (const QStandardItem *item : std::as_const(items)) {
+        paths.push_back(VaultHistory::pathOf(item));
+    }
+    std::vector<VaultHistory::Subtree> subtrees(paths.size());
+    for (std::size_t i = paths.size(); i-- > 0;) {
+        subtrees[i] = vault->history.take(paths[i]);
+    }
+
+    m_treeView->setUpdatesEnabled(false);
+    takeItemRows(items);
+    target->appendRows(items); // One rowsInserted for the whole batch
+    for (qsizetype i = 0; i < items.size(); ++i) {
+        vault->history.put(subtrees[std::size_t(i)], items.at(i));
+    }
+    vault->history.commit(tr("Move %n items", nullptr, int(items.size())), paths.front(),
+                          VaultHistory::pathOf(items.first()));
+    m_treeView->setUpdatesEnabled(true);
+
+    exitVisualMode();
+    m_treeView->expand(viewIndex(target->index()));
+    setCurrentSourceIndex(items.first()->index());
+    m_treeView->scrollTo(m_treeView->currentIndex());
+    statusBar()->showMessage(tr("Moved %n items to %1.", nullptr, int(items.size())).arg(chosen), 3000);
+}
+
+void MainWindow::undoLastChange()
+{
+    Vault *vault = currentVault();
+    QString label;
+    VaultHistory::Path focus;
+    if (!vault || !vault->history.undo(vault->root, &label, &focus)) {
+        statusBar()->showMessage(tr("Nothing to undo."), 3000);
+        return;
+    }
+    m_searchCompleterModel->clear(); // Results may point at items the undo replaced
+    QStandardItem *item = VaultHistory::itemAt(vault->root, focus);
+    setCurrentSourceIndex(item->index());
+    m_treeView->scrollTo(viewIndex(item->index()));
+    statusBar()->showMessage(tr("Undid %1.").arg(label), 3000);
+}
+
+void MainWindow::redoLastChange()
+{
+    Vault *vault = currentVault();
+    QString label;
+    VaultHistory::Path focus;
+    if (!vault || !vault->history.redo(vault->root, &label, &focus)) {
+        statusBar()->showMessage(tr("Nothing to redo."), 3000);
+        return;
+    }
+    m_searchCompleterModel->clear();
+    QStandardItem *item = VaultHistory::itemAt(vault->root, focus);
+    setCurrentSourceIndex(item->index());
+    m_treeView->scrollTo(viewIndex(item->index()));
+    statusBar()->showMessage(tr("Redid %1.").arg(label), 3000);
 }
 
 void MainWindow::setupEditableRecordView()
@@ -369,25 +913,110 @@ void MainWindow::setupEditableRecordView()
     m_editableRecordView = new QWidget(this);
     QFormLayout *formLayout = new QFormLayout(m_editableRecordView);
     
-    // Correct initialization: new QLineEdit/QTextEdit objects
-    m_nameEdit = new QLineEdit(this);
-    m_usernameEdit = new QLineEdit(this);
-    m_passwordEdit = new QLineEdit(this);
-    m_urlEdit = new QLineEdit(this);
-    m_notesEdit = new QTextEdit(this);
-
-    // Set object names for easier identification if needed, and for debugging
-    m_nameEdit->setObjectName("nameEdit");
-    m_usernameEdit->setObjectName("usernameEdit");
-    m_passwordEdit->setObjectName("passwordEdit");
-    m_urlEdit->setObjectName("urlEdit");
-    m_notesEdit->setObjectName("notesEdit");
-
-    formLayout->addRow("Name:", m_nameEdit);
-    formLayout->addRow("Username:", m_usernameEdit);
-    formLayout->addRow("Password:", m_passwordEdit);
-    formLayout->addRow("URL:", m_urlEdit);
-    formLayout->addRow("Notes:", m_notesEdit);
+    // One editor per field in display order: multiline fields get a QTextEdit
+    for (RecordField field : RecordSchema::kDisplayOrder) {
+        const RecordFieldSpec &spec = RecordSchema::spec(field);
+        QWidget *editor = (spec.flags & FieldMultiline) ? static_cast<QWidget*>(new QTextEdit(this))
+                                                        : static_cast<QWidget*>(new QLineEdit(this));
+        // Set object names for easier identification if needed, and for debugging
+        editor->setObjectName(QString::fromLatin1(spec.key) + "Edit");
+        formLayout->addRow(QString::fromLatin1(spec.label) + ":", editor);
+        m_fieldEditors[std::size_t(field)] = editor;
+    }
+
+    // Custom fields: one row per field, the type is picked from a combo box
+    m_customFieldsTable = new QTableWidget(0, 3, this);
+    m_customFieldsTable->setObjectName("customFieldsTable");
+    m_customFieldsTable->setHorizontalHeaderLabels({"Field", "Type", "Value"});
+    m_customFieldsTable->horizontalHeader()->setStretchLastSection(true);
+    m_customFieldsTable->verticalHeader()->hide();
+    formLayout->addRow("Custom:", m_customFieldsTable);
+}
+
+void MainWindow::loadCustomFieldEditor(const CustomFieldList &fields)
+{
+    m_customFieldsTable->setRowCount(0);
+    for (const CustomField &field : fields) {
+        addCustomFieldRow(&field);
+    }
+}
+
+bool MainWindow::readCustomFieldEditor(CustomFieldList *fields)
+{
+    fields->clear();
+    for (int row = 0; row < m_customFieldsTable->rowCount(); ++row) {
+        QTableWidgetItem *keyItem = m_customFieldsTable->item(row, 0);
+        QTableWidgetItem *valueItem = m_customFieldsTable->item(row, 2);
+        const QString key = keyItem ? keyItem->text().trimmed() : QString();
+        const QString value = valueItem ? valueItem->text() : QString();
+        if (key.isEmpty() && value.isEmpty()) {
+            continue; // Blank rows are dropped
+        }
+
+        const FieldKeyId keyId = FieldKeyTable::intern(QStringView(key));
+        if (keyId == FieldKeyTable::kInvalidKey) {
+            statusBar()->showMessage(tr("Invalid custom field name '%1' (use letters, digits, '_' or '-').").arg(key), 5000);
+            m_customFieldsTable->setCurrentCell(row, 0);
+            return false;
+        }
+        QComboBox *typeBox = qobject_cast<QComboBox*>(m_customFieldsTable->cellWidget(row, 1));
+        const CustomFieldType type = typeBox ? CustomFieldType(typeBox->currentIndex()) : CustomFieldType::Text;
+        CustomField field{keyId, type, QString(), SecureString()};
+        field.setText(value);
+        fields->push_back(std::move(field));
+    }
+    return true;
+}
+
+void MainWindow::addCustomFieldRow(const CustomField *field)
+{
+    const int row = m_customFieldsTable->rowCount();
+    m_customFieldsTable->insertRow(row);
+
+    QComboBox *typeBox = new QComboBox(m_customFieldsTable);
+    for (int i = 0; i < CustomFieldTypes::count(); ++i) {
+        typeBox->addItem(QString::fromLatin1(CustomFieldTypes::name(CustomFieldType(i))));
+    }
+    m_customFieldsTable->setCellWidget(row, 1, typeBox);
+
+    if (field) {
+        m_customFieldsTable->setItem(row, 0, new QTableWidgetItem(FieldKeyTable::name(field->key)));
+        typeBox->setCurrentIndex(int(field->type));
+        m_customFieldsTable->setItem(row, 2, new QTableWidgetItem(field->text().toString()));
+    } else {
+        m_customFieldsTable->setItem(row, 0, new QTableWidgetItem());
+        m_customFieldsTable->setItem(row, 2, new QTableWidgetItem());
+        m_customFieldsTable->setFocus();
+        m_customFieldsTable->setCurrentCell(row, 0);
+        m_customFieldsTable->editItem(m_customFieldsTable->item(row, 0));
+    }
+}
+
+void MainWindow::removeCustomFieldRow()
+{
+    const int row = m_customFieldsTable->currentRow();
+    if (row >= 0) {
+        m_customFieldsTable->removeRow(row);
+    }
+}
+
+QString MainWindow::fieldEditorText(RecordField field) const
+{
+    QWidget *editor = m_fieldEditors[std::size_t(field)];
+    if (QTextEdit *textEdit = qobject_cast<QTextEdit*>(editor)) {
+        return textEdit->toPlainText();
+    }
+    return static_cast<QLineEdit*>(editor)->text();
+}
+
+void MainWindow::setFieldEditorText(RecordField field, const QString &text)
+{
+    QWidget *editor = m_fieldEditors[std::size_t(field)];
+    if (QTextEdit *textEdit = qobject_cast<QTextEdit*>(editor)) {
+        textEdit->setPlainText(text);
+    } else {
+        static_cast<QLineEdit*>(editor)->setText(text);
+    }
 }
 
 void MainWindow::enterInsertMode(const QModelIndex &index)
@@ -405,11 +1034,10 @@ void MainWindow::enterInsertMode(const QModelIndex &index)
     m_currentEditedItem = selectedItem;
     PasswordRecord record = m_currentEditedItem->data(Qt::UserRole).value<PasswordRecord>();
 
-    m_nameEdit->setText(record.name);
-    m_usernameEdit->setText(record.username);
-    m_passwordEdit->setText(record.password);
-    m_urlEdit->setText(record.url);
-    m_notesEdit->setText(record.notes);
+    for (const RecordFieldSpec &spec : kRecordFields) {
+        setFieldEditorText(spec.id, record.value(spec.id));
+    }
+    loadCustomFieldEditor(record.customFields);
 
     setMode(Mode::INSERT);
     // Restore sizes immediately after setMode, once widgets are visible
@@ -422,11 +1050,10 @@ void MainWindow::enterInsertMode(const QModelIndex &index)
 void MainWindow::exitInsertMode()
 {
     m_currentEditedItem = nullptr;
-    m_nameEdit->clear();
-    m_usernameEdit->clear();
-    m_passwordEdit->clear();
-    m_urlEdit->clear();
-    m_notesEdit->clear();
+    for (const RecordFieldSpec &spec : kRecordFields) {
+        setFieldEditorText(spec.id, QString());
+    }
+    m_customFieldsTable->setRowCount(0);
 
     setMode(Mode::TREE);
     // Restore sizes immediately after setMode, once widgets are visible
@@ -444,50 +1071,126 @@ void MainWindow::saveRecord()
     }
 
     PasswordRecord updatedRecord;
-    updatedRecord.name = m_nameEdit->text();
-    updatedRecord.username = m_usernameEdit->text();
-    updatedRecord.password = m_passwordEdit->text();
-    updatedRecord.url = m_urlEdit->text();
-    updatedRecord.notes = m_notesEdit->toPlainText();
+    for (const RecordFieldSpec &spec : kRecordFields) {
+        const QString text = fieldEditorText(spec.id);
+        updatedRecord.setValue(spec.id, (spec.flags & FieldShared) ? vaultForItem(m_currentEditedItem)->strings.intern(text) : text);
+    }
+    if (!readCustomFieldEditor(&updatedRecord.customFields)) {
+        return; // Stay in INSERT mode so the field name can be fixed
+    }
+    // The audit's stale check goes by when the password itself last changed
+    const QVariant previous = m_currentEditedItem->data(Qt::UserRole);
+    const PasswordRecord *previousRecord = previous.metaType() == QMetaType::fromType<PasswordRecord>()
+                                               ? static_cast<const PasswordRecord *>(previous.constData())
+                                               : nullptr;
+    if (previousRecord && previousRecord->view(RecordField::Password) == updatedRecord.view(RecordField::Password)) {
+        updatedRecord.passwordChanged = previousRecord->passwordChanged;
+    } else if (!updatedRecord.view(RecordField::Password).isEmpty()) {
+        updatedRecord.passwordChanged = QDateTime::currentSecsSinceEpoch();
+    }
+    if (previousRecord) {
+        updatedRecord.attachments = previousRecord->attachments; // Managed in the attachments dialog, not the editor
+        if (!previousRecord->isEmpty()) {
+            // The version being replaced becomes the newest revision (Shift+Y)
+            EntryRevisions::add(*previousRecord, &updatedRecord, QDateTime::currentSecsSinceEpoch(), revisionRetention());
+        }
+    }
 
     QModelIndex itemIndex = m_currentEditedItem->index(); // Store index before pointer is nulled
+    Vault *vault = vaultForItem(m_currentEditedItem);
+    vault->history.prepare(vault->root);
 
     m_currentEditedItem->setData(QVariant::fromValue(updatedRecord), Qt::UserRole);
-    m_currentEditedItem->setText(updatedRecord.name);
+    m_currentEditedItem->setText(updatedRecord.value(RecordField::Name));
+    const VaultHistory::Path path = VaultHistory::pathOf(m_currentEditedItem);
+    vault->history.updated(m_currentEditedItem);
+    vault->history.commit(tr("Edit"), path, path);
 
-    qDebug() << "Record saved for:" << updatedRecord.name;
+    qDebug() << "Record saved for:" << updatedRecord.value(RecordField::Name);
     exitInsertMode(); // This will null m_currentEditedItem
-    onTreeSelectionChanged(itemIndex, QModelIndex()); // Use the stored index
+    onTreeSelectionChanged(viewIndex(itemIndex), QModelIndex()); // Use the stored index
 }
 
 void MainWindow::newDatabase() {
-    // Clear the current model
-    m_treeModel->clear();
-    m_treeModel->setHorizontalHeaderLabels({"Items"}); // Re-set header if cleared
-    m_searchCompleterModel->clear(); // Clear completer model as well
-
-    // Clear the current file path
-    m_currentFilePath.clear();
+    // The new database is mounted next to the open vaults; Shift+W closes one
+    Vault *vault = mountVault(QString(), QString());
+    showMountedVaults(vault);
+    setCurrentSourceIndex(vault->root->index());
+    saveSessionVaults();
 
     // Update status bar
     statusBar()->showMessage(tr("New database created."), 3000);
-    qDebug() << "New database created. Current file path cleared.";
+    qDebug() << "New database created.";
 
     // Clear record display
     m_recordDisplay->setText("Select an item from the tree view to see details.");
 }
 
 void MainWindow::saveDatabase() {
-    if (m_currentFilePath.isEmpty() || m_masterPassword.isEmpty()) {
+    Vault *vault = currentVault();
+    if (!vault) {
+        return;
+    }
+    // A vault with a shared folder saves there too, merging what others saved first
+    const auto save = [this, vault]() {
+        if (!mergeExternalChangeBeforeSave(vault)) {
+            return;
+        }
+        const QString directory = syncDirectory(vault);
+        if (directory.isEmpty()) {
+            saveModelToFile(vault);
+        } else {
+            syncWithSharedCopy(vault, directory);
+        }
+    };
+    if (!vault->filePath.isEmpty() && vault->masterPassword.isEmpty() && QFileInfo::exists(vault->filePath)) {
+        // Opened through the unlock agent: confirm the file's master password instead of picking a new one
+        if (confirmMasterPassword(vault)) {
+            save();
+        }
+    } else if (vault->filePath.isEmpty() || vault->masterPassword.isEmpty()) {
         // If no file path is set or no master password is set, act as "Save As"
         saveDatabaseAs();
     } else {
         // For existing files, use the stored master password
-        saveModelToFile(m_currentFilePath, m_masterPassword);
+        save();
+    }
+}
+
+bool MainWindow::confirmMasterPassword(Vault *vault)
+{
+    bool ok;
+    m_isModalDialogActive = true;
+    QString password = QInputDialog::getText(this, tr("Master Password for %1:").arg(QFileInfo(vault->filePath).fileName()),
+                                             tr("Enter master password to save:"), QLineEdit::Password,
+                                             QString(), &ok);
+    m_isModalDialogActive = false;
+    if (!ok || password.isEmpty()) {
+        statusBar()->showMessage(tr("Save operation cancelled. Master password not provided."), 3000);
+        return false;
     }
+
+    VaultFile::Envelope envelope;
+    QString errorMessage;
+    QByteArray passwordUtf8 = password.toUtf8();
+    const bool verified = VaultFile::initCrypto(&errorMessage)
+                          && VaultFile::read(vault->filePath, &envelope, &errorMessage)
+                          && VaultFile::verifyPassword(envelope, passwordUtf8);
+    sodium_memzero(passwordUtf8.data(), size_t(passwordUtf8.size()));
+    if (!verified) {
+        statusBar()->showMessage(errorMessage.isEmpty() ? tr("Incorrect master password.") : errorMessage, 5000);
+        return false;
+    }
+    vault->masterPassword = password;
+    return true;
 }
 
 void MainWindow::saveDatabaseAs() {
+    Vault *vault = currentVault();
+    if (!vault) {
+        return;
+    }
+
     // For new files, prompt to set master password
     SetMasterPasswordDialog passwordDialog(this);
     m_isModalDialogActive = true;
@@ -505,9 +1208,24 @@ void MainWindow::saveDatabaseAs() {
         m_isModalDialogActive = false; // Reset flag after dialog is closed
 
         if (!filePath.isEmpty()) {
-            m_currentFilePath = filePath;
-            m_masterPassword = masterPassword;
-            saveModelToFile(m_currentFilePath, masterPassword);
+            // The blobs stay beside the old file; the copy's entries need them beside the new one
+            QString errorMessage;
+            int blobsCopied = 0;
+            if (!vault->filePath.isEmpty()
+                && !AttachmentStore::mirror(vault->filePath, filePath, &blobsCopied, &errorMessage)) {
+                statusBar()->showMessage(tr("Save failed: %1").arg(errorMessage), 5000);
+                return;
+            }
+            m_vaultWatcher->unwatch(vault->filePath);
+            vault->fileContent.clear();
+            vault->externalChange.reset();
+            vault->filePath = filePath;
+            vault->masterPassword = masterPassword;
+            vault->root->setText(vaultLabel(vault));
+            vault->root->setToolTip(filePath);
+            saveModelToFile(vault);
+            addRecentFile(filePath);
+            saveSessionVaults();
         } else {
             statusBar()->showMessage(tr("Save operation cancelled."), 3000);
         }
@@ -540,254 +1258,1138 @@ void MainWindow::openDatabase()
     }
 }
 
-void MainWindow::createFolder()
+void MainWindow::importFile()
 {
-    QModelIndex currentIndex = m_treeView->currentIndex();
-    QStandardItem *parentItem = m_treeModel->invisibleRootItem();
-
-    if (currentIndex.isValid()) {
-        QStandardItem *selectedItem = m_treeModel->itemFromIndex(currentIndex);
-        if (selectedItem->data(Qt::UserRole).canConvert<PasswordRecord>()) {
-            // If it's a record, add as sibling
-            parentItem = selectedItem->parent() ? selectedItem->parent() : parentItem;
-        } else {
-            // If it's a folder, add as child
-            parentItem = selectedItem;
-        }
+    m_isModalDialogActive = true;
+    const QString filePath = QFileDialog::getOpenFileName(this,
+                                                          tr("Import Passwords"),
+                                                          "",
+                                                          tr("Exports (*.csv *.xml *.json);;All Files (*)"));
+    m_isModalDialogActive = false;
+    if (filePath.isEmpty()) {
+        return;
+    }
+    Importer::Format format;
+    if (!Importer::detectFormat(filePath, &format)) {
+        statusBar()->showMessage(tr("Unrecognized export format."), 5000);
+        return;
+    }
+    if (m_treeFilter->isFiltering()) {
+        clearTreeFilter(); // The imported folder must be visible to be selected
+    }
+    Vault *vault = currentVault();
+    if (!vault) {
+        vault = mountVault(QString(), QString()); // Nothing mounted yet: import into a new database
     }
 
-    QStandardItem *newItem = new QStandardItem("New Folder");
-    parentItem->appendRow(newItem);
-    m_treeView->setCurrentIndex(newItem->index());
-    m_isEditingTreeItem = true;
-    m_treeView->edit(newItem->index()); // Allow immediate renaming
-}
+    // Parse on the thread pool; the window only polls the byte count, so a large
+    // export neither blocks painting nor floods the event loop with updates
+    Importer::Progress progress;
+    StringPool *strings = &vault->strings;
+    QFutureWatcher<Importer::Result> watcher;
+    QProgressDialog progressDialog(tr("Importing %1...").arg(QFileInfo(filePath).fileName()), tr("Cancel"),
+                                   0, 1000, this);
+    progressDialog.setWindowModality(Qt::WindowModal);
+    progressDialog.setMinimumDuration(300);
+    const qint64 totalBytes = qMax<qint64>(1, QFileInfo(filePath).size());
+    QTimer poll;
+    connect(&poll, &QTimer::timeout, &progressDialog, [&]() {
+        progressDialog.setValue(int(qMin<qint64>(999, progress.bytesRead * 1000 / totalBytes)));
+    });
+    connect(&progressDialog, &QProgressDialog::canceled, &progressDialog, [&]() { progress.cancelled = true; });
+    QEventLoop loop;
+    connect(&watcher, &QFutureWatcher<Importer::Result>::finished, &loop, &QEventLoop::quit);
 
-void MainWindow::createRecord()
+    m_isModalDialogActive = true;
+    watcher.setFuture(QtConcurrent::run([filePath, format, strings, &progress]() {
+        return Importer::importFile(filePath, format, strings, &progress);
+    }));
+    poll.start(100);
+    loop.exec();
+    poll.stop();
+    progressDialog.reset();
+    m_isModalDialogActive = false;
+
+    Importer::Result result = watcher.result();
+    if (progress.cancelled) {
+        statusBar()->showMessage(tr("Import cancelled."), 3000);
+        return;
+    }
+    if (!result.error.isEmpty()) {
+        statusBar()->showMessage(tr("Import failed: %1").arg(result.error), 5000);
+        return;
+    }
+    if (result.items.isEmpty()) {
+        statusBar()->showMessage(tr("Nothing to import in %1.").arg(QFileInfo(filePath).fileName()), 3000);
+        return;
+    }
+
+    // Assemble everything under one detached folder, so the model sees a single
+    // rowsInserted however many entries came in, and the import is one undo step
+    auto *folder = new QStandardItem(tr("Imported %1").arg(QFileInfo(filePath).completeBaseName()));
+    folder->setData(ItemId::generate(), ItemId::kRole);
+    folder->appendRows(result.items);
+    vault->history.prepare(vault->root);
+    const VaultHistory::Path before = VaultHistory::pathOf(m_treeModel->itemFromIndex(currentSourceIndex()));
+    m_treeView->setUpdatesEnabled(false);
+    vault->root->appendRow(folder);
+    m_treeView->setUpdatesEnabled(true);
+    vault->history.inserted(folder);
+    vault->history.commit(tr("Import"), before, VaultHistory::pathOf(folder));
+
+    m_treeView->expand(viewIndex(vault->root->index()));
+    m_treeView->expand(viewIndex(folder->index()));
+    setCurrentSourceIndex(folder->index());
+    statusBar()->showMessage(tr("Imported %n entries from %1.", nullptr, result.entryCount)
+                                 .arg(Importer::formatName(format)), 5000);
+}
+
+void MainWindow::exportItems()
 {
-    QModelIndex currentIndex = m_treeView->currentIndex();
-    QStandardItem *parentItem = m_treeModel->invisibleRootItem();
+    const QStandardItem *item = m_treeModel->itemFromIndex(currentSourceIndex());
+    if (!item) {
+        statusBar()->showMessage(tr("Select a vault, folder or entry to export."), 3000);
+        return;
+    }
 
-    if (currentIndex.isValid()) {
-        QStandardItem *selectedItem = m_treeModel->itemFromIndex(currentIndex);
-        if (selectedItem->data(Qt::UserRole).canConvert<PasswordRecord>()) {
-            // If it's a record, add as sibling
-            parentItem = selectedItem->parent() ? selectedItem->parent() : parentItem;
-        } else {
-            // If it's a folder, add as child
-            parentItem = selectedItem;
+    m_isModalDialogActive = true;
+    QString selectedFilter;
+    const QString filePath = QFileDialog::getSaveFileName(this,
+                                                          tr("Export %1").arg(item->text()),
+                                                          "",
+                                                          tr("CSV (*.csv);;JSON (*.json)"),
+                                                          &selectedFilter);
+    if (filePath.isEmpty()) {
+        m_isModalDialogActive = false;
+        return;
+    }
+    const QMessageBox::StandardButton secrets = QMessageBox::question(
+        this, tr("Export"),
+        tr("The exported file is not encrypted. Include passwords and secret fields?"),
+        QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel, QMessageBox::No);
+    m_isModalDialogActive = false;
+    if (secrets == QMessageBox::Cancel) {
+        return;
+    }
+
+    Exporter::Options options;
+    options.format = selectedFilter.startsWith(QLatin1String("JSON")) ? Exporter::Format::Json
+                                                                     : Exporter::formatForPath(filePath);
+    options.redactSecrets = secrets != QMessageBox::Yes;
+
+    QFile file(filePath);
+    if (!Exporter::openOwnerOnly(&file, QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered)) {
+        statusBar()->showMessage(tr("Could not write %1: %2").arg(filePath, file.errorString()), 5000);
+        return;
+    }
+    Exporter::Writer writer(&file, options);
+    writer.writeItems(item);
+    QString errorMessage;
+    if (!writer.finish(&errorMessage)) {
+        statusBar()->showMessage(tr("Export failed: %1").arg(errorMessage), 5000);
+        return;
+    }
+    statusBar()->showMessage(tr("Exported %n entries to %1.", nullptr, writer.entryCount()).arg(filePath), 5000);
+}
+
+QString MainWindow::syncDirectory(const Vault *vault) const
+{
+    QSettings settings(QSettings::IniFormat, QSettings::UserScope, "ArcaneLock", "ArcaneLock");
+    return settings.value("syncDirectories").toMap().value(vault->filePath).toString();
+}
+
+void MainWindow::syncVault()
+{
+    Vault *vault = currentVault();
+    if (!vault) {
+        return;
+    }
+    if (vault->filePath.isEmpty()) {
+        statusBar()->showMessage(tr("Save the vault before syncing it."), 3000);
+        return;
+    }
+    if (vault->masterPassword.isEmpty() && !confirmMasterPassword(vault)) {
+        return;
+    }
+    QString directory = syncDirectory(vault);
+    if (directory.isEmpty()) {
+        m_isModalDialogActive = true;
+        directory = QFileDialog::getExistingDirectory(this, tr("Shared Folder for %1").arg(QFileInfo(vault->filePath).fileName()));
+        m_isModalDialogActive = false;
+        if (directory.isEmpty()) {
+            statusBar()->showMessage(tr("Sync cancelled."), 3000);
+            return;
         }
+        QSettings settings(QSettings::IniFormat, QSettings::UserScope, "ArcaneLock", "ArcaneLock");
+        QVariantMap directories = settings.value("syncDirectories").toMap();
+        directories.insert(vault->filePath, directory);
+        settings.setValue("syncDirectories", directories);
     }
+    syncWithSharedCopy(vault, directory);
+}
 
-    QStandardItem *newItem = new QStandardItem("New Record");
-    PasswordRecord newRecord = {"New Record", "", "", "", ""};
-    newItem->setData(QVariant::fromValue(newRecord), Qt::UserRole);
+// The shared copy is the vault's file name in the shared folder. Next to the
+// vault, <vault>.base keeps the bytes of the shared copy as of the last sync:
+// the common ancestor of both sides for the next merge.
+void MainWindow::syncWithSharedCopy(Vault *vault, const QString &directory)
+{
+    const QString sharedPath = QDir(directory).filePath(QFileInfo(vault->filePath).fileName());
+    const QString basePath = vault->filePath + QLatin1String(".base");
+    const auto readAll = [](const QString &filePath) {
+        QFile file(filePath);
+        return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    };
 
-    parentItem->appendRow(newItem);
-    m_treeView->setCurrentIndex(newItem->index());
-    enterInsertMode(newItem->index());
+    // Attachment blobs never change, so each side only needs the ones it lacks.
+    // Ours go first: the shared copy must not reference blobs others can't find.
+    QString errorMessage;
+    int blobsCopied = 0;
+    if (!AttachmentStore::mirror(vault->filePath, sharedPath, &blobsCopied, &errorMessage)) {
+        statusBar()->showMessage(tr("Sync failed: %1").arg(errorMessage), 5000);
+        return;
+    }
+
+    QByteArray passwordUtf8 = vault->masterPassword.toUtf8();
+    QList<VaultSync::Conflict> conflicts;
+    int applied = 0;
+    bool synced = false;
+    // Another copy published between our read and our write: merge again on top of it
+    constexpr int kAttempts = 3;
+    for (int attempt = 0; attempt < kAttempts && errorMessage.isEmpty() && !synced; ++attempt) {
+        const QByteArray shared = readAll(sharedPath);
+        const QByteArray sharedDigest = VaultSync::digest(shared);
+        if (!vault->syncBase && !shared.isEmpty()) {
+            const QByteArray base = readAll(basePath);
+            vault->syncDigest = VaultSync::digest(base);
+            if (vault->syncDigest != sharedDigest) { // Only needed when the shared copy changed since
+                StringPool strings;
+                QStandardItem root;
+                if (!base.isEmpty() && !VaultSync::readCopy(base, passwordUtf8, &strings, &root, &errorMessage)) {
+                    break;
+                }
+                vault->syncBase = std::make_unique<VaultSync::Tree>(VaultSync::Tree::build(&root));
+            }
+        }
+
+        StringPool remoteStrings; // Outlives remoteRoot, whose items point into it
+        QStandardItem remoteRoot;
+        std::unique_ptr<VaultSync::Tree> remote;
+        if (!shared.isEmpty() && sharedDigest != vault->syncDigest) {
+            if (!VaultSync::readCopy(shared, passwordUtf8, &remoteStrings, &remoteRoot, &errorMessage)) {
+                break;
+            }
+            remote = std::make_unique<VaultSync::Tree>(VaultSync::Tree::build(&remoteRoot));
+            const VaultSync::Tree local = VaultSync::Tree::build(vault->root, &vault->syncHashes);
+            if (local.hash() == remote->hash()) {
+                // Same items on both sides: adopt the shared bytes, no encryption needed
+                synced = VaultFile::write(vault->filePath, shared, &errorMessage)
+                         && VaultFile::write(basePath, shared, &errorMessage);
+                if (synced) {
+                    rememberFileContent(vault, shared);
+                    vault->syncBase = std::move(remote);
+                    vault->syncDigest = sharedDigest;
+                }
+                continue;
+            }
+            if (remote->hash() != vault->syncBase->hash()) {
+                vault->history.prepare(vault->root);
+                const VaultHistory::Path before = VaultHistory::pathOf(m_treeModel->itemFromIndex(currentSourceIndex()));
+                m_treeView->setUpdatesEnabled(false);
+                const VaultSync::Result result = VaultSync::merge(vault->root, local, *vault->syncBase, *remote, &vault->history);
+                m_treeView->setUpdatesEnabled(true);
+                vault->history.commit(tr("Sync"), before, VaultHistory::pathOf(m_treeModel->itemFromIndex(currentSourceIndex())));
+                conflicts += result.conflicts;
+                applied += result.applied;
+            }
+        }
+
+        // Publish: one encryption for the three files
+        QByteArray plaintext = serializeModelToByteArray(vault->root);
+        QByteArray sealed;
+        if (!VaultFile::seal(plaintext, passwordUtf8, &sealed, &errorMessage)) {
+            sodium_memzero(plaintext.data(), size_t(plaintext.size()));
+            break;
+        }
+        if (VaultSync::digest(readAll(sharedPath)) != sharedDigest) {
+            sodium_memzero(plaintext.data(), size_t(plaintext.size()));
+            if (remote) { // What we merged is now part of ours
+                vault->syncBase = std::move(remote);
+                vault->syncDigest = sharedDigest;
+            }
+            continue;
+        }
+        synced = VaultFile::write(sharedPath, sealed, &errorMessage)
+                 && VaultFile::write(vault->filePath, sealed, &errorMessage)
+                 && VaultFile::write(basePath, sealed, &errorMessage);
+        if (synced) {
+            rememberFileContent(vault, sealed);
+            vault->syncBase = std::make_unique<VaultSync::Tree>(VaultSync::Tree::build(vault->root, &vault->syncHashes));
+            vault->syncDigest = VaultSync::digest(sealed);
+            backUpPlaintext(vault, plaintext);
+        }
+        sodium_memzero(plaintext.data(), size_t(plaintext.size()));
+    }
+    sodium_memzero(passwordUtf8.data(), size_t(passwordUtf8.size()));
+
+    if (!errorMessage.isEmpty()) {
+        statusBar()->showMessage(tr("Sync failed: %1").arg(errorMessage), 5000);
+        return;
+    }
+    if (!synced) {
+        statusBar()->showMessage(tr("Sync gave up: %1 keeps changing.").arg(sharedPath), 5000);
+        return;
+    }
+    if (!AttachmentStore::mirror(sharedPath, vault->filePath, &blobsCopied, &errorMessage)) {
+        statusBar()->showMessage(tr("Synced, but not every attachment was copied: %1").arg(errorMessage), 5000);
+        return;
+    }
+    if (!conflicts.isEmpty()) {
+        QStringList lines;
+        for (const VaultSync::Conflict &conflict : std::as_const(conflicts)) {
+            lines.append(VaultSync::describe(conflict));
+        }
+        QMessageBox box(QMessageBox::Warning, tr("Sync"),
+                        tr("Synced with %n conflict(s); both versions were kept where they differ.", nullptr, int(conflicts.size())),
+                        QMessageBox::Ok, this);
+        box.setDetailedText(lines.join(u'\n'));
+        m_isModalDialogActive = true;
+        box.exec();
+        m_isModalDialogActive = false;
+    }
+    statusBar()->showMessage(tr("Synced with %1: %n change(s) taken over.", nullptr, applied).arg(sharedPath), 3000);
 }
 
-void MainWindow::loadFile(const QString &filePath, bool isStartup)
+void MainWindow::rememberFileContent(Vault *vault, const QByteArray &fileContent)
 {
-    // Prompt for password to load file
-    bool ok;
-    m_isModalDialogActive = true;
-    QString password = QInputDialog::getText(this, tr("Master Password for %1:").arg(QFileInfo(filePath).fileName()), // Display file name
-                                             tr("Enter master password to open:"), QLineEdit::Password,
-                                             QString(), &ok);
-    m_isModalDialogActive = false;
+    vault->fileContent = fileContent;
+    vault->unsavedChanges = false; // The items are what the file holds
+    m_vaultWatcher->watch(vault->filePath, fileContent);
+}
 
-    if (ok && !password.isEmpty()) {
-        if (loadModelFromFile(filePath, password)) { // Assuming loadModelFromFile returns bool for success
-            addRecentFile(filePath);
-            m_currentFilePath = filePath;
-            m_masterPassword = password;
-            statusBar()->showMessage(tr("Loaded %1").arg(filePath), 3000);
-        } else {
-            // If loading failed (e.g., incorrect password)
-            if (isStartup) {
-                newDatabase(); // Reset to blank state
-                m_recentFiles.removeAll(filePath); // Remove the problematic file from recent list
-                saveRecentFiles();
-                m_currentFilePath.clear(); // Ensure no invalid path is kept
-                statusBar()->showMessage(tr("Failed to load recent file. Starting with an empty database."), 5000);
-            } else {
-                statusBar()->showMessage(tr("Failed to load file %1. Password might be incorrect or file corrupted.").arg(filePath), 5000);
+void MainWindow::onVaultFileChanged(const QString &filePath)
+{
+    Vault *vault = nullptr;
+    for (const auto &mounted : m_vaults) {
+        if (!mounted->filePath.isEmpty() && QFileInfo(mounted->filePath) == QFileInfo(filePath)) {
+            vault = mounted.get();
+        }
+    }
+    if (!vault) {
+        return;
+    }
+    if (vault->masterPassword.isEmpty() || vault->fileContent.isEmpty()) {
+        // Opened through the agent: there is no password to read the new file with
+        statusBar()->showMessage(tr("%1 changed on disk; close and reopen it to see the changes.").arg(vault->filePath), 5000);
+        return;
+    }
+    if (vault->externalChange && !vault->externalChange->ready) {
+        vault->externalChangeAgain = true; // Read once more when this read is done
+        return;
+    }
+
+    // Two Argon2id runs and decryptions: off the GUI thread. A change read but
+    // not merged yet is superseded; it still has the same base.
+    auto change = std::make_shared<ExternalChange>();
+    change->baseContent = vault->fileContent;
+    vault->externalChange = change;
+    vault->externalChangeAgain = false;
+    QByteArray passwordUtf8 = vault->masterPassword.toUtf8();
+    auto *watcher = new QFutureWatcher<void>(this);
+    connect(watcher, &QFutureWatcher<void>::finished, this, [this, watcher, change]() {
+        watcher->deleteLater();
+        change->ready = true;
+        // The vault may have been closed, locked or saved over since
+        for (const auto &vault : m_vaults) {
+            if (vault->externalChange != change) {
+                continue;
+            }
+            if (vault->externalChangeAgain) {
+                onVaultFileChanged(vault->filePath);
+                return;
             }
+            applyExternalChanges();
+            return;
         }
-    } else {
-        statusBar()->showMessage(tr("Open cancelled. Master password not provided."), 3000);
-        if (isStartup) {
-            newDatabase(); // Reset to blank state
-            m_recentFiles.removeAll(filePath); // Remove the problematic file from recent list
-            saveRecentFiles();
-            m_currentFilePath.clear(); // Ensure no invalid path is kept
+    });
+    watcher->setFuture(QtConcurrent::run([change, filePath = vault->filePath, passwordUtf8 = std::move(passwordUtf8)]() mutable {
+        readExternalChange(change.get(), filePath, passwordUtf8);
+        sodium_memzero(passwordUtf8.data(), size_t(passwordUtf8.size()));
+    }));
+}
+
+void MainWindow::readExternalChange(ExternalChange *change, const QString &filePath, const QByteArray &passwordUtf8)
+{
+    if (!VaultFile::readFile(filePath, &change->fileContent, &change->errorMessage)
+        || change->fileContent == change->baseContent) {
+        return;
+    }
+    if (!VaultSync::readCopy(change->baseContent, passwordUtf8, &change->baseStrings, &change->baseRoot, &change->errorMessage)
+        || !VaultSync::readCopy(change->fileContent, passwordUtf8, &change->remoteStrings, &change->remoteRoot,
+                                &change->errorMessage)) {
+        return;
+    }
+    change->base = std::make_unique<VaultSync::Tree>(VaultSync::Tree::build(&change->baseRoot));
+    change->remote = std::make_unique<VaultSync::Tree>(VaultSync::Tree::build(&change->remoteRoot));
+}
+
+void MainWindow::applyExternalChanges()
+{
+    // The INSERT-mode fields, a rename in the tree or a dialog may hold on to
+    // items the merge would change or remove; wait until they are closed
+    const bool busy = m_currentMode == Mode::INSERT || m_isEditingTreeItem || m_isModalDialogActive || m_vaultLocked;
+    std::vector<Vault *> ready;
+    for (const auto &vault : m_vaults) {
+        if (vault->externalChange && vault->externalChange->ready) {
+            ready.push_back(vault.get());
         }
     }
+    if (busy && !ready.empty()) {
+        m_externalChangeTimer->start();
+        return;
+    }
+    for (Vault *vault : ready) {
+        if (vault->externalChange->baseContent != vault->fileContent) {
+            // Saved since the read began, merging the file as it was then
+            vault->externalChange.reset();
+            if (!m_vaultWatcher->isCurrent(vault->filePath)) {
+                onVaultFileChanged(vault->filePath);
+            }
+            continue;
+        }
+        applyExternalChange(vault);
+    }
 }
 
-// Modify loadModelFromFile to return bool indicating success or failure
-bool MainWindow::loadModelFromFile(const QString &filePath, const QString &masterPassword)
+bool MainWindow::applyExternalChange(Vault *vault)
 {
-    if (sodium_init() < 0) {
-        statusBar()->showMessage(tr("libsodium initialization failed."), 5000);
+    const std::shared_ptr<ExternalChange> change = std::move(vault->externalChange);
+    if (!change->errorMessage.isEmpty()) {
+        statusBar()->showMessage(tr("%1 changed on disk but could not be read: %2").arg(vault->filePath, change->errorMessage), 5000);
         return false;
     }
 
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly)) {
-        statusBar()->showMessage(tr("Cannot open file %1:\n%2.").arg(filePath).arg(file.errorString()), 5000);
+    // Merged like a sync with the file as the shared copy: only the items that
+    // differ are touched, so expansion, selection and local changes stay
+    VaultSync::Result result;
+    if (change->remote) {
+        const VaultSync::Tree local = VaultSync::Tree::build(vault->root, &vault->syncHashes);
+        if (local.hash() != change->remote->hash()) {
+            vault->history.prepare(vault->root);
+            const VaultHistory::Path before = VaultHistory::pathOf(m_treeModel->itemFromIndex(currentSourceIndex()));
+            m_treeView->setUpdatesEnabled(false);
+            result = VaultSync::merge(vault->root, local, *change->base, *change->remote, &vault->history);
+            m_treeView->setUpdatesEnabled(true);
+            vault->history.commit(tr("Reload"), before, VaultHistory::pathOf(m_treeModel->itemFromIndex(currentSourceIndex())));
+            onTreeSelectionChanged(m_treeView->currentIndex(), QModelIndex()); // The shown entry may have changed
+        }
+    }
+    // Local changes merged on top of the file are still unsaved
+    const bool unsavedChanges = vault->unsavedChanges;
+    rememberFileContent(vault, change->fileContent);
+    vault->unsavedChanges = unsavedChanges;
+
+    if (!result.conflicts.isEmpty()) {
+        QStringList lines;
+        for (const VaultSync::Conflict &conflict : std::as_const(result.conflicts)) {
+            lines.append(VaultSync::describe(conflict));
+        }
+        QMessageBox box(QMessageBox::Warning, tr("Reload"),
+                        tr("%1 changed on disk. Merged with %n conflict(s); both versions were kept where they differ.",
+                           nullptr, int(result.conflicts.size())).arg(vaultLabel(vault)),
+                        QMessageBox::Ok, this);
+        box.setDetailedText(lines.join(u'\n'));
+        m_isModalDialogActive = true;
+        box.exec();
+        m_isModalDialogActive = false;
+    }
+    if (result.applied > 0) {
+        statusBar()->showMessage(tr("%1 changed on disk: %n change(s) taken over.", nullptr, result.applied).arg(vaultLabel(vault)), 5000);
+    }
+    return true;
+}
+
+bool MainWindow::mergeExternalChangeBeforeSave(Vault *vault)
+{
+    if (vault->fileContent.isEmpty() || m_vaultWatcher->isCurrent(vault->filePath)) {
+        return true;
+    }
+    // Replaces a read still running or waiting; saving can't wait for either
+    auto change = std::make_shared<ExternalChange>();
+    change->baseContent = vault->fileContent;
+    QByteArray passwordUtf8 = vault->masterPassword.toUtf8();
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    readExternalChange(change.get(), vault->filePath, passwordUtf8);
+    QApplication::restoreOverrideCursor();
+    sodium_memzero(passwordUtf8.data(), size_t(passwordUtf8.size()));
+    change->ready = true;
+    vault->externalChange = change;
+    vault->externalChangeAgain = false;
+    if (!applyExternalChange(vault)) {
+        statusBar()->showMessage(tr("Not saved: %1 changed on disk and could not be read. Use Save As to keep both.")
+                                     .arg(vault->filePath), 5000);
         return false;
     }
+    return true;
+}
 
-    QByteArray fileContent = file.readAll();
-    file.close();
+void MainWindow::auditPasswords()
+{
+    Vault *vault = currentVault();
+    if (!vault) {
+        return;
+    }
 
-    // 1. Read Header
-    QByteArray header = fileContent.mid(0, 8); // "ALOCK_V1" is 8 bytes
-    if (header != "ALOCK_V1") {
-        statusBar()->showMessage(tr("Error: Not a valid ArcaneLock encrypted file (or unknown version)."), 5000);
-        return false;
+    // The QVariant copies share the items' records, which stay untouched while the pool reads them
+    std::vector<QStandardItem *> items;
+    std::vector<QVariant> data;
+    std::function<void(QStandardItem *)> collect = [&](QStandardItem *item) {
+        for (int row = 0; row < item->rowCount(); ++row) {
+            QStandardItem *child = item->child(row);
+            QVariant value = child->data(Qt::UserRole);
+            if (value.metaType() == QMetaType::fromType<PasswordRecord>()) {
+                items.push_back(child);
+                data.push_back(std::move(value));
+            }
+            collect(child);
+        }
+    };
+    collect(vault->root);
+    std::vector<const PasswordRecord *> records;
+    records.reserve(data.size());
+    for (const QVariant &value : data) {
+        records.push_back(static_cast<const PasswordRecord *>(value.constData()));
     }
-    int offset = header.size();
 
-    // 2. Read Argon2 Hash String
-    QByteArray hashedPasswordData = fileContent.mid(offset, crypto_pwhash_STRBYTES);
-    offset += crypto_pwhash_STRBYTES;
+    // The index built with "arcanelock hibp-index"; mapping it costs nothing until the lookups
+    PasswordAudit::Options options;
+    BreachIndex breaches;
+    QSettings settings(QSettings::IniFormat, QSettings::UserScope, "ArcaneLock", "ArcaneLock");
+    const QString indexPath = settings.value("breachIndex").toString();
+    if (!indexPath.isEmpty()) {
+        QString errorMessage;
+        if (breaches.open(indexPath, &errorMessage)) {
+            options.breaches = &breaches;
+        } else {
+            statusBar()->showMessage(tr("Skipping the breach check: %1").arg(errorMessage), 5000);
+        }
+    }
 
-    // 3. Read Encryption Salt
-    QByteArray encryptionSaltData = fileContent.mid(offset, crypto_pwhash_SALTBYTES);
-    offset += crypto_pwhash_SALTBYTES;
+    const std::vector<PasswordAudit::Finding> findings = PasswordAudit::audit(records, options);
+    std::vector<AuditDialog::Row> rows;
+    for (std::size_t i = 0; i < findings.size(); ++i) {
+        if (findings[i].issues != 0) {
+            const QString folder = TreeFilterModel::folderPath(items[i]);
+            rows.push_back(AuditDialog::Row{items[i], folder.isEmpty() ? items[i]->text() : folder + u'/' + items[i]->text(),
+                                            findings[i]});
+        }
+    }
+    if (rows.empty()) {
+        statusBar()->showMessage(options.breaches
+                                     ? tr("Checked %n entries: no reused, weak, stale or breached passwords.", nullptr, int(records.size()))
+                                     : tr("Checked %n entries: no reused, weak or stale passwords.", nullptr, int(records.size())),
+                                 5000);
+        return;
+    }
 
-    // 4. Read Nonce
-    QByteArray nonceData = fileContent.mid(offset, crypto_secretbox_NONCEBYTES);
-    offset += crypto_secretbox_NONCEBYTES;
+    AuditDialog dialog(std::move(rows), int(records.size()), options.breaches != nullptr, this);
+    m_isModalDialogActive = true;
+    const int result = dialog.exec();
+    m_isModalDialogActive = false;
+    if (result == QDialog::Accepted && dialog.selectedItem()) {
+        clearTreeFilter();
+        setCurrentSourceIndex(dialog.selectedItem()->index());
+    }
+}
 
-    // 5. Read Ciphertext
-    QByteArray ciphertext = fileContent.mid(offset);
+void MainWindow::manageAttachments()
+{
+    QStandardItem *item = m_treeModel->itemFromIndex(currentSourceIndex());
+    if (!item || !item->parent() || item->data(Qt::UserRole).value<PasswordRecord>().isEmpty()) {
+        statusBar()->showMessage(tr("Select an entry to see its attachments."), 3000);
+        return;
+    }
+    Vault *vault = vaultForItem(item);
+    if (vault->filePath.isEmpty()) {
+        statusBar()->showMessage(tr("Save the vault before attaching files: they are stored next to it."), 3000);
+        return;
+    }
+    const AttachmentStore store(vault->filePath);
+    // The item stays put while the dialog is open: locking and external merges wait for modal dialogs
+    const auto attachments = [item] { return item->data(Qt::UserRole).value<PasswordRecord>().attachments; };
+    AttachmentDialog dialog(item->text(), this);
+    const auto setAttachments = [&](AttachmentList list, const QString &label) {
+        PasswordRecord record = item->data(Qt::UserRole).value<PasswordRecord>();
+        record.attachments = std::move(list);
+        vault->history.prepare(vault->root);
+        item->setData(QVariant::fromValue(record), Qt::UserRole);
+        const VaultHistory::Path path = VaultHistory::pathOf(item);
+        vault->history.updated(item);
+        vault->history.commit(label, path, path);
+        dialog.setAttachments(record.attachments);
+    };
+    const auto validRow = [&](int row) { return row >= 0 && row < int(attachments().size()); };
 
-    // Verify master password
-    if (crypto_pwhash_str_verify(hashedPasswordData.constData(),
-                                 masterPassword.toUtf8().constData(), masterPassword.toUtf8().length()) != 0) {
-        statusBar()->showMessage(tr("Incorrect master password."), 5000);
-        return false;
+    connect(&dialog, &AttachmentDialog::addRequested, &dialog, [&] {
+        const QString filePath = QFileDialog::getOpenFileName(&dialog, tr("Attach File"));
+        if (filePath.isEmpty()) {
+            return;
+        }
+        Attachment attachment;
+        attachment.name = QFileInfo(filePath).fileName();
+        QString errorMessage;
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        bool added = AttachmentStore::hashFile(filePath, &attachment.contentHash, &attachment.size, &errorMessage);
+        if (added) {
+            // The same content attached elsewhere in the vault: take its key, and with it its blob
+            std::function<bool(QStandardItem *)> findShared = [&](QStandardItem *parent) {
+                for (int row = 0; row < parent->rowCount(); ++row) {
+                    QStandardItem *child = parent->child(row);
+                    const QVariant data = child->data(Qt::UserRole);
+                    if (data.metaType() == QMetaType::fromType<PasswordRecord>()) {
+                        for (const Attachment &other : static_cast<const PasswordRecord *>(data.constData())->attachments) {
+                            if (other.contentHash == attachment.contentHash && other.size == attachment.size
+                                && store.contains(other)) {
+                                attachment.key = other.key;
+                                return true;
+                            }
+                        }
+                    }
+                    if (findShared(child)) {
+                        return true;
+                    }
+                }
+                return false;
+            };
+            if (!findShared(vault->root)) {
+                attachment.key = AttachmentStore::newKey();
+            }
+            added = store.add(filePath, attachment, &errorMessage);
+        }
+        QApplication::restoreOverrideCursor();
+        if (!added) {
+            statusBar()->showMessage(tr("Not attached: %1").arg(errorMessage), 5000);
+            return;
+        }
+        AttachmentList list = attachments();
+        list.push_back(std::move(attachment));
+        setAttachments(std::move(list), tr("Attach"));
+        statusBar()->showMessage(tr("Attached %1.").arg(QFileInfo(filePath).fileName()), 3000);
+    });
+
+    connect(&dialog, &AttachmentDialog::openRequested, &dialog, [&](int row) {
+        if (!validRow(row)) {
+            return;
+        }
+        const Attachment attachment = attachments()[std::size_t(row)];
+        // Decrypted copies live in a private temporary directory, removed on lock and exit
+        if (!m_attachmentTempDir) {
+            m_attachmentTempDir = std::make_unique<QTemporaryDir>();
+        }
+        const QString directory = m_attachmentTempDir->filePath(QString::number(++m_attachmentsOpened));
+        const QString filePath = directory + u'/' + attachment.name;
+        QFile output(filePath);
+        QString errorMessage;
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        const bool extracted = m_attachmentTempDir->isValid() && QDir().mkpath(directory)
+                               && Exporter::openOwnerOnly(&output, QIODevice::WriteOnly)
+                               && store.extract(attachment, &output, &errorMessage);
+        QApplication::restoreOverrideCursor();
+        output.close();
+        if (!extracted) {
+            output.remove();
+            statusBar()->showMessage(tr("Cannot open %1: %2")
+                                         .arg(attachment.name, errorMessage.isEmpty() ? output.errorString() : errorMessage),
+                                     5000);
+            return;
+        }
+        if (!QDesktopServices::openUrl(QUrl::fromLocalFile(filePath))) {
+            statusBar()->showMessage(tr("No application opens %1.").arg(attachment.name), 5000);
+        }
+    });
+
+    connect(&dialog, &AttachmentDialog::exportRequested, &dialog, [&](int row) {
+        if (!validRow(row)) {
+            return;
+        }
+        const Attachment attachment = attachments()[std::size_t(row)];
+        const QString filePath = QFileDialog::getSaveFileName(&dialog, tr("Export Attachment"),
+                                                              QDir::home().filePath(attachment.name));
+        if (filePath.isEmpty()) {
+            return;
+        }
+        QSaveFile output(filePath);
+        QString errorMessage;
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        const bool exported = Exporter::openOwnerOnly(&output, QIODevice::WriteOnly)
+                              && store.extract(attachment, &output, &errorMessage)
+                              && output.commit();
+        QApplication::restoreOverrideCursor();
+        statusBar()->showMessage(exported ? tr("Exported %1 to %2.").arg(attachment.name, filePath)
+                                          : tr("Export failed: %1").arg(errorMessage.isEmpty() ? output.errorString() : errorMessage),
+                                 exported ? 3000 : 5000);
+    });
+
+    connect(&dialog, &AttachmentDialog::removeRequested, &dialog, [&](int row) {
+        if (!validRow(row)) {
+            return;
+        }
+        AttachmentList list = attachments();
+        const QString name = list[std::size_t(row)].name;
+        list.erase(list.begin() + row);
+        // The blob stays, for undo and for other entries sharing it
+        setAttachments(std::move(list), tr("Remove attachment"));
+        statusBar()->showMessage(tr("Removed %1; u brings it back.").arg(name), 3000);
+    });
+
+    dialog.setAttachments(attachments());
+    m_isModalDialogActive = true;
+    dialog.exec();
+    m_isModalDialogActive = false;
+    onTreeSelectionChanged(m_treeView->currentIndex(), QModelIndex());
+}
+
+void MainWindow::showRevisions()
+{
+    QStandardItem *item = m_treeModel->itemFromIndex(currentSourceIndex());
+    const PasswordRecord current = item ? item->data(Qt::UserRole).value<PasswordRecord>() : PasswordRecord();
+    if (!item || !item->parent() || current.isEmpty()) {
+        statusBar()->showMessage(tr("Select an entry to see its history."), 3000);
+        return;
+    }
+    if (current.revisions.isEmpty()) {
+        statusBar()->showMessage(tr("'%1' has no earlier versions yet.").arg(item->text()), 3000);
+        return;
+    }
+    // The only place the revisions are decoded
+    const std::vector<EntryRevisions::Revision> revisions = EntryRevisions::revisions(current);
+    if (revisions.empty()) {
+        statusBar()->showMessage(tr("The history of '%1' cannot be read.").arg(item->text()), 5000);
+        return;
     }
 
-    // Derive encryption key
-    unsigned char encryptionKey[crypto_secretbox_KEYBYTES];
-    if (crypto_pwhash(encryptionKey, sizeof encryptionKey,
-                      masterPassword.toUtf8().constData(), masterPassword.toUtf8().length(),
-                      reinterpret_cast<const unsigned char*>(encryptionSaltData.constData()),
-                      crypto_pwhash_OPSLIMIT_MODERATE,
-                      crypto_pwhash_MEMLIMIT_MODERATE,
-                      crypto_pwhash_ALG_ARGON2ID13) != 0) {
-        statusBar()->showMessage(tr("Key derivation failed during decryption."), 5000);
-        return false;
+    RevisionDialog dialog(item->text(), revisions, this); // Copies share the records' secure strings
+    m_isModalDialogActive = true;
+    const int result = dialog.exec();
+    m_isModalDialogActive = false;
+    if (result != QDialog::Accepted || dialog.selectedRevision() < 0) {
+        return;
     }
 
-    // Decrypt the ciphertext
-    QByteArray decryptedPlaintext(ciphertext.size() - crypto_secretbox_MACBYTES, Qt::Uninitialized);
-    if (crypto_secretbox_open_easy(reinterpret_cast<unsigned char*>(decryptedPlaintext.data()),
-                                   reinterpret_cast<const unsigned char*>(ciphertext.constData()), ciphertext.size(),
-                                   reinterpret_cast<const unsigned char*>(nonceData.constData()),
-                                   encryptionKey) != 0) {
-        statusBar()->showMessage(tr("Decryption failed. Data may be corrupted or password incorrect."), 5000);
-        return false;
+    // Restoring is an edit like any other: the current version goes into the history
+    Vault *vault = vaultForItem(item);
+    const EntryRevisions::Revision &revision = revisions[std::size_t(dialog.selectedRevision())];
+    PasswordRecord restored = revision.record;
+    for (const RecordFieldSpec &spec : kRecordFields) {
+        if (spec.flags & FieldShared) {
+            restored.setValue(spec.id, vault->strings.intern(restored.value(spec.id)));
+        }
     }
+    EntryRevisions::add(current, &restored, QDateTime::currentSecsSinceEpoch(), revisionRetention());
+    vault->history.prepare(vault->root);
+    item->setData(QVariant::fromValue(restored), Qt::UserRole);
+    item->setText(restored.value(RecordField::Name));
+    const VaultHistory::Path path = VaultHistory::pathOf(item);
+    vault->history.updated(item);
+    vault->history.commit(tr("Restore version"), path, path);
+    onTreeSelectionChanged(m_treeView->currentIndex(), QModelIndex());
+    statusBar()->showMessage(tr("Restored '%1' as it was until %2; u undoes it.")
+                                 .arg(item->text(), QLocale().toString(QDateTime::fromSecsSinceEpoch(revision.replaced),
+                                                                       QLocale::ShortFormat)),
+                             3000);
+}
 
-    // Deserialize the decrypted plaintext into the model
-    m_treeModel->clear();
-    m_treeModel->setHorizontalHeaderLabels({"Items"});
-    m_searchCompleterModel->clear(); // Clear completer model as well
+void MainWindow::backupVault()
+{
+    Vault *vault = currentVault();
+    if (!vault) {
+        return;
+    }
+    if (vault->filePath.isEmpty()) {
+        statusBar()->showMessage(tr("Save the vault before backing it up."), 3000);
+        return;
+    }
+    if (vault->masterPassword.isEmpty() && !confirmMasterPassword(vault)) {
+        return;
+    }
+    QSettings settings(QSettings::IniFormat, QSettings::UserScope, "ArcaneLock", "ArcaneLock");
+    QVariantMap directories = settings.value("backupDirectories").toMap();
+    if (directories.value(vault->filePath).toString().isEmpty()) {
+        m_isModalDialogActive = true;
+        const QString directory = QFileDialog::getExistingDirectory(this, tr("Backup Store for %1").arg(QFileInfo(vault->filePath).fileName()));
+        m_isModalDialogActive = false;
+        if (directory.isEmpty()) {
+            statusBar()->showMessage(tr("Backup cancelled."), 3000);
+            return;
+        }
+        directories.insert(vault->filePath, directory);
+        settings.setValue("backupDirectories", directories);
+    }
+    QByteArray plaintext = serializeModelToByteArray(vault->root);
+    backUpPlaintext(vault, plaintext);
+    sodium_memzero(plaintext.data(), size_t(plaintext.size()));
+}
+
+void MainWindow::backUpPlaintext(Vault *vault, const QByteArray &plaintext)
+{
+    QSettings settings(QSettings::IniFormat, QSettings::UserScope, "ArcaneLock", "ArcaneLock");
+    const QString directory = settings.value("backupDirectories").toMap().value(vault->filePath).toString();
+    if (directory.isEmpty()) {
+        return;
+    }
+    QString errorMessage;
+    if (!vault->backupStore || vault->backupStore->directory() != directory) {
+        // One key derivation per vault and store, not per backup
+        auto store = std::make_unique<BackupStore>();
+        QByteArray passwordUtf8 = vault->masterPassword.toUtf8();
+        const bool opened = store->open(directory, passwordUtf8, &errorMessage);
+        sodium_memzero(passwordUtf8.data(), size_t(passwordUtf8.size()));
+        if (!opened) {
+            statusBar()->showMessage(tr("Backup failed: %1").arg(errorMessage), 5000);
+            return;
+        }
+        vault->backupStore = std::move(store);
+    }
+    BackupStore::Snapshot snapshot;
+    BackupStore::Stats stats;
+    if (!vault->backupStore->backup(plaintext, QFileInfo(vault->filePath).fileName(), &snapshot, &stats, &errorMessage)) {
+        statusBar()->showMessage(tr("Backup failed: %1").arg(errorMessage), 5000);
+        return;
+    }
+    statusBar()->showMessage(tr("Backup %1: %2 of %3 chunks new.")
+                                 .arg(snapshot.id).arg(stats.newChunks).arg(snapshot.chunkCount), 3000);
+}
 
-    QString decryptedDataString = QString::fromUtf8(decryptedPlaintext);
-    QTextStream in(&decryptedDataString);
-    QList<QStandardItem*> parentStack;
-    parentStack.append(m_treeModel->invisibleRootItem());
+void MainWindow::createFolder()
+{
+    if (m_treeFilter->isFiltering()) {
+        clearTreeFilter(); // The new item must be visible to be named
+    }
+    QModelIndex currentIndex = currentSourceIndex();
+    Vault *vault = currentVault();
+    if (!vault) {
+        vault = mountVault(QString(), QString()); // Nothing mounted yet: start a new database
+    }
+    QStandardItem *parentItem = vault->root;
 
-    QStandardItem *currentItem = nullptr;
-    PasswordRecord currentRecord;
+    if (currentIndex.isValid()) {
+        QStandardItem *selectedItem = m_treeModel->itemFromIndex(currentIndex);
+        if (selectedItem->data(Qt::UserRole).canConvert<PasswordRecord>()) {
+            // If it's a record, add as sibling
+            parentItem = selectedItem->parent() ? selectedItem->parent() : parentItem;
+        } else {
+            // If it's a folder (or a vault root), add as child
+            parentItem = selectedItem;
+        }
+    }
 
-    while (!in.atEnd()) {
-        QString line = in.readLine();
-        if (line.trimmed().isEmpty() || line.trimmed().startsWith('#')) {
-            continue;
+    vault->history.prepare(vault->root);
+    const VaultHistory::Path before = VaultHistory::pathOf(m_treeModel->itemFromIndex(currentIndex));
+    QStandardItem *newItem = new QStandardItem("New Folder");
+    newItem->setData(ItemId::generate(), ItemId::kRole);
+    parentItem->appendRow(newItem);
+    vault->history.inserted(newItem);
+    vault->history.commit(tr("New folder"), before, VaultHistory::pathOf(newItem));
+    setCurrentSourceIndex(newItem->index());
+    m_isEditingTreeItem = true;
+    m_treeView->edit(viewIndex(newItem->index())); // Allow immediate renaming
+}
+
+void MainWindow::createRecord()
+{
+    if (m_treeFilter->isFiltering()) {
+        clearTreeFilter(); // The new item must be visible to be named
+    }
+    QModelIndex currentIndex = currentSourceIndex();
+    Vault *vault = currentVault();
+    if (!vault) {
+        vault = mountVault(QString(), QString()); // Nothing mounted yet: start a new database
+    }
+    QStandardItem *parentItem = vault->root;
+
+    if (currentIndex.isValid()) {
+        QStandardItem *selectedItem = m_treeModel->itemFromIndex(currentIndex);
+        if (selectedItem->data(Qt::UserRole).canConvert<PasswordRecord>()) {
+            // If it's a record, add as sibling
+            parentItem = selectedItem->parent() ? selectedItem->parent() : parentItem;
+        } else {
+            // If it's a folder (or a vault root), add as child
+            parentItem = selectedItem;
         }
+    }
+
+    QStandardItem *newItem = new QStandardItem("New Record");
+    PasswordRecord newRecord;
+    newRecord.setValue(RecordField::Name, "New Record");
+    newItem->setData(QVariant::fromValue(newRecord), Qt::UserRole);
+    newItem->setData(ItemId::generate(), ItemId::kRole);
+
+    vault->history.prepare(vault->root);
+    const VaultHistory::Path before = VaultHistory::pathOf(m_treeModel->itemFromIndex(currentIndex));
+    parentItem->appendRow(newItem);
+    vault->history.inserted(newItem);
+    vault->history.commit(tr("New entry"), before, VaultHistory::pathOf(newItem));
+    setCurrentSourceIndex(newItem->index());
+    enterInsertMode(newItem->index());
+}
+
+bool MainWindow::loadFile(const QString &filePath, bool isStartup)
+{
+    return openVaults({filePath}, isStartup) == 1;
+}
+
+void MainWindow::reopenLastSession()
+{
+    QSettings settings(QSettings::IniFormat, QSettings::UserScope, "ArcaneLock", "ArcaneLock");
+    const QStringList filePaths = settings.value("sessionVaults").toStringList();
+    if (filePaths.isEmpty()) {
+        statusBar()->showMessage(tr("No previous session to reopen."), 3000);
+        return;
+    }
+    const int mounted = openVaults(filePaths);
+    statusBar()->showMessage(tr("Reopened %1 of %2 vaults.").arg(mounted).arg(filePaths.size()), 3000);
+}
+
+int MainWindow::openVaults(const QStringList &filePaths, bool isStartup)
+{
+    struct UnlockJob {
+        QString filePath;
+        QString password;
+        Vault *vault = nullptr;      // Not in the tree until the job succeeded
+        QByteArray fileContent;      // Kept as the base for merging later changes to the file
+        QByteArray document;
+        QList<QStandardItem*> items;
+        QString errorMessage;
+        bool ok = false;
+    };
 
-        int indentation = 0;
-        while (indentation < line.length() && line[indentation] == ' ') {
-            indentation++;
+    std::vector<std::unique_ptr<Vault>> pending;
+    QList<UnlockJob> jobs;
+    Vault *lastMounted = nullptr;
+    int mountedCount = 0;
+    int attemptedCount = 0;
+
+    const auto forgetFile = [&](const QString &filePath) {
+        if (isStartup) {
+            m_recentFiles.removeAll(filePath); // Remove the problematic file from recent list
+            saveRecentFiles();
         }
-        int level = indentation / 2;
+    };
 
-        if (line.trimmed().startsWith("- ")) {
-            // New item
-            if (currentItem) {
-                if (!currentRecord.isEmpty()) {
-                    currentItem->setData(QVariant::fromValue(currentRecord), Qt::UserRole);
-                }
-                currentRecord = PasswordRecord();
+    for (const QString &filePath : filePaths) {
+        // Already mounted: just go there
+        bool alreadyMounted = false;
+        for (const auto &vault : m_vaults) {
+            if (!vault->filePath.isEmpty() && QFileInfo(vault->filePath) == QFileInfo(filePath)) {
+                setCurrentSourceIndex(vault->root->index());
+                alreadyMounted = true;
+                ++mountedCount;
             }
+        }
+        if (alreadyMounted) {
+            continue;
+        }
+        ++attemptedCount;
 
-            QString itemName = line.trimmed().mid(2);
-            currentItem = new QStandardItem(itemName);
+        // An unlock agent holding this vault spares us the password prompt and the KDF
+        QByteArray agentDocument;
+        if (AgentClient::document(filePath, &agentDocument) == AgentProtocol::Reply::Ok) {
+            lastMounted = mountVault(filePath, QString()); // Master password asked for on the first save
+            loadModelFromDocument(lastMounted, &agentDocument);
+            addRecentFile(filePath);
+            ++mountedCount;
+            continue;
+        }
 
-            while (level < parentStack.size() - 1) {
-                parentStack.removeLast();
-            }
-            parentStack.last()->appendRow(currentItem);
-            parentStack.append(currentItem);
-
-        } else if (currentItem) {
-            // Part of the current item's record
-            QString trimmedLine = line.trimmed();
-            int colonIndex = trimmedLine.indexOf(':');
-            if (colonIndex > 0) {
-                QString key = trimmedLine.left(colonIndex).trimmed();
-                QString value = trimmedLine.mid(colonIndex + 1).trimmed();
-
-                if (key == "name") currentRecord.name = value;
-                else if (key == "username") currentRecord.username = value;
-                else if (key == "password") currentRecord.password = value;
-                else if (key == "url") currentRecord.url = value;
-                else if (key == "notes" && value == "|") {
-                    QStringList notesLines;
-                    while (!in.atEnd()) {
-                        qint64 lastPos = in.pos(); // Save current position
-                        QString noteLine = in.readLine();
-                        int noteIndentation = 0;
-                        while (noteIndentation < noteLine.length() && noteLine[noteIndentation] == ' ') {
-                            noteIndentation++;
-                        }
-                        // Check if the note line is more indented than the expected level for record fields
-                        // This assumes note lines are indented by at least `indentation + 2`
-                        if (noteIndentation >= indentation + 2) {
-                            notesLines.append(noteLine.trimmed());
-                        } else {
-                            // If not, it means the note block has ended. Seek back to read this line again
-                            // as it might be a new record item or another field.
-                            in.seek(lastPos);
-                            break;
-                        }
-                    }
-                    currentRecord.notes = notesLines.join('\n');
-                }
+        // Prompt for password to load file
+        bool ok;
+        m_isModalDialogActive = true;
+        QString password = QInputDialog::getText(this, tr("Master Password for %1:").arg(QFileInfo(filePath).fileName()), // Display file name
+                                                 tr("Enter master password to open:"), QLineEdit::Password,
+                                                 QString(), &ok);
+        m_isModalDialogActive = false;
+        if (!ok || password.isEmpty()) {
+            statusBar()->showMessage(tr("Open cancelled. Master password not provided."), 3000);
+            forgetFile(filePath);
+            continue;
+        }
+
+        pending.push_back(std::make_unique<Vault>());
+        UnlockJob job;
+        job.filePath = filePath;
+        job.password = password;
+        job.vault = pending.back().get();
+        jobs.append(job);
+    }
+
+    // The Argon2id runs and decryption dominate; with several vaults they run on the pool side by side
+    const auto unlock = [](UnlockJob &job) {
+        QByteArray passwordUtf8 = job.password.toUtf8();
+        VaultFile::Envelope envelope;
+        job.ok = VaultFile::readFile(job.filePath, &job.fileContent, &job.errorMessage)
+                 && VaultFile::parse(job.fileContent, &envelope, &job.errorMessage)
+                 && VaultFile::open(envelope, passwordUtf8, &job.document, &job.errorMessage);
+        sodium_memzero(passwordUtf8.data(), size_t(passwordUtf8.size()));
+        if (job.ok) {
+            job.items = parseV1Document(job.document, &job.vault->strings);
+        }
+        sodium_memzero(job.document.data(), size_t(job.document.size()));
+    };
+    if (jobs.size() > 1) {
+        QtConcurrent::blockingMap(jobs, unlock);
+    } else if (!jobs.isEmpty()) {
+        unlock(jobs.first());
+    }
+
+    for (UnlockJob &job : jobs) {
+        if (!job.ok) {
+            statusBar()->showMessage(job.errorMessage, 5000);
+            forgetFile(job.filePath);
+            continue;
+        }
+        for (auto it = pending.begin(); it != pending.end(); ++it) {
+            if (it->get() == job.vault) {
+                // Adopt the vault the items were parsed into; they share its string pool
+                lastMounted = mountVault(job.filePath, job.password, std::move(*it));
+                pending.erase(it);
+                break;
             }
         }
+        if (!job.items.isEmpty()) {
+            // One bulk insertion instead of a rowsInserted signal per item
+            lastMounted->root->appendRows(job.items);
+        }
+        rememberFileContent(lastMounted, job.fileContent);
+        addRecentFile(job.filePath);
+        ++mountedCount;
+    }
+
+    if (lastMounted) {
+        showMountedVaults(lastMounted);
+        saveSessionVaults();
+        if (attemptedCount == 1 && mountedCount == 1) {
+            statusBar()->showMessage(tr("Loaded %1").arg(lastMounted->filePath), 3000);
+        }
+    } else if (attemptedCount == 1 && !jobs.isEmpty() && isStartup) {
+        statusBar()->showMessage(tr("Failed to load recent file."), 5000);
+    }
+    return mountedCount;
+}
+
+MainWindow::Vault *MainWindow::mountVault(const QString &filePath, const QString &masterPassword, std::unique_ptr<Vault> vault)
+{
+    // An untouched, unsaved database gets replaced, like opening a file used to replace it
+    if (m_vaults.size() == 1 && m_vaults.front()->filePath.isEmpty() && !m_vaults.front()->root->hasChildren()) {
+        unmountVault(m_vaults.front().get());
+    }
+
+    if (!vault) {
+        vault = std::make_unique<Vault>();
+    }
+    vault->filePath = filePath;
+    vault->masterPassword = masterPassword;
+    vault->root = new QStandardItem;
+    vault->root->setText(vaultLabel(vault.get()));
+    vault->root->setToolTip(filePath);
+    m_treeModel->invisibleRootItem()->appendRow(vault->root);
+    m_vaults.push_back(std::move(vault));
+    return m_vaults.back().get();
+}
+
+void MainWindow::loadModelFromDocument(Vault *vault, QByteArray *decryptedPlaintext)
+{
+    const QList<QStandardItem*> topLevelItems = parseV1Document(*decryptedPlaintext, &vault->strings);
+    // Secrets now live in the SecurePool; wipe the decrypted document
+    sodium_memzero(decryptedPlaintext->data(), size_t(decryptedPlaintext->size()));
+    if (!topLevelItems.isEmpty()) {
+        // One bulk insertion instead of a rowsInserted signal per item
+        vault->root->appendRows(topLevelItems);
     }
+}
 
-    if (currentItem && !currentRecord.isEmpty()) {
-        currentItem->setData(QVariant::fromValue(currentRecord), Qt::UserRole);
+void MainWindow::unmountVault(Vault *vault)
+{
+    if (m_currentEditedItem && vaultForItem(m_currentEditedItem) == vault) {
+        exitInsertMode();
     }
+    m_searchCompleterModel->clear(); // Results may point into the vault and share its strings
+    m_vaultWatcher->unwatch(vault->filePath);
+    m_treeModel->removeRow(vault->root->row());
+    for (auto it = m_vaults.begin(); it != m_vaults.end(); ++it) {
+        if (it->get() == vault) {
+            m_vaults.erase(it); // Releases the vault's string pool after its items are gone
+            break;
+        }
+    }
+}
+
+void MainWindow::unmountAllVaults()
+{
+    m_searchCompleterModel->clear();
+    m_vaultWatcher->unwatchAll();
+    m_treeModel->clear();
+    m_treeModel->setHorizontalHeaderLabels({"Items"});
+    m_vaults.clear();
+}
 
-    // No need to close file here, already done after reading all content.
+void MainWindow::closeCurrentVault()
+{
+    Vault *vault = currentVault();
+    if (!vault) {
+        return;
+    }
+    const QString label = vaultLabel(vault);
+    unmountVault(vault);
+    saveSessionVaults();
+    m_recordDisplay->setText("Select an item from the tree view to see details.");
+    statusBar()->showMessage(tr("Closed %1").arg(label), 3000);
+}
+
+MainWindow::Vault *MainWindow::vaultForItem(const QStandardItem *item) const
+{
+    if (!item) {
+        return nullptr;
+    }
+    while (item->parent()) {
+        item = item->parent();
+    }
+    for (const auto &vault : m_vaults) {
+        if (vault->root == item) {
+            return vault.get();
+        }
+    }
+    return nullptr;
+}
+
+MainWindow::Vault *MainWindow::currentVault()
+{
+    if (Vault *vault = vaultForItem(m_treeModel->itemFromIndex(currentSourceIndex()))) {
+        return vault;
+    }
+    return m_vaults.empty() ? nullptr : m_vaults.front().get();
+}
+
+QString MainWindow::vaultLabel(const Vault *vault) const
+{
+    return vault->filePath.isEmpty() ? tr("Untitled") : QFileInfo(vault->filePath).completeBaseName();
+}
+
+void MainWindow::showMountedVaults(const Vault *focus)
+{
     collapseAllNodes(); // Collapse all nodes by default after loading
-    QModelIndex firstItem = m_treeModel->index(0, 0);
-    if (firstItem.isValid()) {
-        m_treeView->setCurrentIndex(firstItem);
+    QModelIndex firstItem = m_treeModel->index(0, 0, focus->root->index());
+    setCurrentSourceIndex(firstItem.isValid() ? firstItem : focus->root->index());
+}
+
+void MainWindow::saveSessionVaults()
+{
+    QStringList filePaths;
+    for (const auto &vault : m_vaults) {
+        if (!vault->filePath.isEmpty()) {
+            filePaths.append(vault->filePath);
+        }
     }
-    return true; // Indicate success
+    QSettings settings(QSettings::IniFormat, QSettings::UserScope, "ArcaneLock", "ArcaneLock");
+    settings.setValue("sessionVaults", filePaths);
 }
 
 void MainWindow::onTreeSelectionChanged(const QModelIndex &current, const QModelIndex &previous)
@@ -803,12 +2405,20 @@ void MainWindow::onTreeSelectionChanged(const QModelIndex &current, const QModel
         return;
     }
 
-    QStandardItem *selectedItem = m_treeModel->itemFromIndex(current);
+    QStandardItem *selectedItem = m_treeModel->itemFromIndex(m_treeFilter->mapToSource(current));
     if (!selectedItem) {
         m_recordDisplay->setText("Error: Could not retrieve item data.");
         return;
     }
 
+    if (!selectedItem->parent()) {
+        const Vault *vault = vaultForItem(selectedItem);
+        m_recordDisplay->setText(vault && !vault->filePath.isEmpty()
+                                     ? QString("Vault %1").arg(QDir::toNativeSeparators(vault->filePath))
+                                     : QString("Unsaved vault. Press s to save it."));
+        return;
+    }
+
     if (selectedItem->data(Qt::UserRole).canConvert<PasswordRecord>()) {
         PasswordRecord record = selectedItem->data(Qt::UserRole).value<PasswordRecord>();
         if (record.isEmpty()) {
@@ -822,16 +2432,41 @@ void MainWindow::onTreeSelectionChanged(const QModelIndex &current, const QModel
                               "p { margin: 0; padding: 2px 0; }"
                               "b { color: #aaaaaa; }"
                               "</style>"
-                              "<body>"
-                              "<h3>Password Record: %1</h3>"
-                              "<p><b>Name:</b> %2</p>"
-                              "<p><b>Username:</b> %3</p>"
-                              "<p><b>Password:</b> %4</p>"
-                              "<p><b>URL:</b> <a href=\"%5\">%5</a></p>"
-                              "<p><b>Notes:</b> %6</p>"
-                              "</body>";
-        
-        m_recordDisplay->setHtml(displayHtml.arg(record.name, record.name, record.username, QString(record.password.length(), '*'), record.url, record.notes));
+                              "<body>";
+        displayHtml += QString("<h3>Password Record: %1</h3>").arg(record.value(RecordField::Name));
+        for (RecordField field : RecordSchema::kDisplayOrder) {
+            const RecordFieldSpec &spec = RecordSchema::spec(field);
+            QString value;
+            if (spec.flags & FieldSecret) {
+                value = QString(record.view(field).size(), '*'); // Don't copy the secret out of secure memory
+            } else if (spec.flags & FieldLink) {
+                value = QString("<a href=\"%1\">%1</a>").arg(record.view(field));
+            } else {
+                value = record.value(field);
+            }
+            displayHtml += QString("<p><b>%1:</b> %2</p>").arg(QString::fromLatin1(spec.label), value);
+        }
+        for (const CustomField &field : record.customFields) {
+            QString value = field.value;
+            if (CustomFieldTypes::isSecret(field.type)) {
+                value = QString(field.text().size(), '*');
+            } else if (field.type == CustomFieldType::Url) {
+                value = QString("<a href=\"%1\">%1</a>").arg(value);
+            } else if (field.type == CustomFieldType::Multiline) {
+                value.replace('\n', "<br>");
+            }
+            displayHtml += QString("<p><b>%1:</b> %2</p>").arg(FieldKeyTable::name(field.key), value);
+        }
+        for (const Attachment &attachment : record.attachments) {
+            displayHtml += QString("<p><b>Attachment:</b> %1 (%2)</p>")
+                               .arg(attachment.name.toHtmlEscaped(), QLocale().formattedDataSize(attachment.size));
+        }
+        if (const int revisions = EntryRevisions::count(record)) {
+            displayHtml += QString("<p><b>History:</b> %1</p>").arg(tr("%n earlier version(s), Shift+Y to see them", nullptr, revisions));
+        }
+        displayHtml += "</body>";
+
+        m_recordDisplay->setHtml(displayHtml);
 
     } else {
         m_recordDisplay->setText("This is a folder or category. Select a password entry to see details.");
@@ -840,49 +2475,250 @@ void MainWindow::onTreeSelectionChanged(const QModelIndex &current, const QModel
 
 void MainWindow::showSearchBar()
 {
+    if (m_filterMode) {
+        clearTreeFilter();
+    }
     m_searchBar->show();
     m_searchBar->setFocus();
 }
 
+void MainWindow::showFilterBar()
+{
+    if (!m_filterMode) {
+        m_filterMode = true;
+        m_searchBar->clear();
+        m_searchBar->setCompleter(nullptr); // Matches show up in the tree itself
+        m_searchBar->setPlaceholderText("Filter...");
+    }
+    m_searchBar->show(); // Keeps the text of a filter that is still applied
+    m_searchBar->setFocus();
+}
+
+void MainWindow::applyTreeFilter(const QString &text)
+{
+    QString queryError;
+    const SearchQuery query = SearchQuery::parse(text, &queryError);
+    if (!queryError.isEmpty()) {
+        statusBar()->showMessage(queryError, 3000);
+        return; // Keep showing the last filter that parsed
+    }
+
+    if (!m_treeFilter->isFiltering() && !query.isEmpty()) {
+        // Remember what was open so clearing the filter puts the tree back as it was
+        m_expandedBeforeFilter.clear();
+        std::function<void(const QStandardItem *)> saveExpanded = [&](const QStandardItem *item) {
+            for (int i = 0; i < item->rowCount(); ++i) {
+                const QStandardItem *child = item->child(i);
+                if (child->hasChildren() && m_treeView->isExpanded(viewIndex(child->index()))) {
+                    m_expandedBeforeFilter.append(QPersistentModelIndex(child->index()));
+                    saveExpanded(child);
+                }
+            }
+        };
+        saveExpanded(m_treeModel->invisibleRootItem());
+    }
+
+    const bool wasFiltering = m_treeFilter->isFiltering();
+    m_treeFilter->setQuery(query);
+    if (query.isEmpty()) {
+        if (wasFiltering) {
+            m_treeView->setUpdatesEnabled(false);
+            m_treeView->collapseAll();
+            for (const QPersistentModelIndex &index : std::as_const(m_expandedBeforeFilter)) {
+                if (index.isValid()) {
+                    m_treeView->expand(viewIndex(index));
+                }
+            }
+            m_treeView->setUpdatesEnabled(true);
+            m_expandedBeforeFilter.clear();
+            if (currentSourceIndex().isValid()) {
+                m_treeView->scrollTo(m_treeView->currentIndex());
+            }
+        }
+        return;
+    }
+    m_treeView->expandAll(); // Only the paths to matches are left to expand
+    statusBar()->showMessage(tr("%n matching entries", nullptr, m_treeFilter->matchCount()), 2000);
+}
+
+void MainWindow::clearTreeFilter()
+{
+    if (!m_filterMode) {
+        return;
+    }
+    applyTreeFilter(QString());
+    m_filterMode = false;
+    m_searchBar->hide();
+    m_searchBar->blockSignals(true); // Not a search; there is nothing to look up
+    m_searchBar->clear();
+    m_searchBar->blockSignals(false);
+    m_searchBar->setCompleter(m_searchCompleter);
+    m_searchBar->setPlaceholderText("Search...");
+}
+
+QModelIndex MainWindow::currentSourceIndex() const
+{
+    return m_treeFilter->mapToSource(m_treeView->currentIndex());
+}
+
+void MainWindow::setCurrentSourceIndex(const QModelIndex &sourceIndex)
+{
+    m_treeView->setCurrentIndex(viewIndex(sourceIndex));
+}
+
+QModelIndex MainWindow::viewIndex(const QModelIndex &sourceIndex) const
+{
+    return m_treeFilter->mapFromSource(sourceIndex);
+}
+
 void MainWindow::performSearch(const QString &text)
 {
+    if (m_filterMode) {
+        applyTreeFilter(text);
+        return;
+    }
     m_searchCompleterModel->clear();
     if (text.isEmpty()) {
         m_searchCompleter->popup()->hide(); // Hide completer if search text is empty
         return;
     }
 
-    // Recursive search lambda
-    std::function<void(QStandardItem *, const QString &, QStandardItemModel *)> searchTreeRecursiveLambda = 
-        [&](QStandardItem *item, const QString &searchText, QStandardItemModel *resultModel) {
-        if (!item) return;
+    QString queryError;
+    const SearchQuery query = SearchQuery::parse(text, &queryError);
+    if (query.isEmpty()) {
+        if (!queryError.isEmpty()) {
+            statusBar()->showMessage(queryError, 3000);
+        }
+        m_searchCompleter->popup()->hide();
+        return;
+    }
+    struct SearchHit {
+        QStandardItem *item;
+        int score;
+    };
 
-        // Check if the current item is a password record
-        if (item->data(Qt::UserRole).canConvert<PasswordRecord>()) {
-            PasswordRecord record = item->data(Qt::UserRole).value<PasswordRecord>();
-            // Check if any field contains the search text (case-insensitive)
-            if (record.name.contains(searchText, Qt::CaseInsensitive) ||
-                record.username.contains(searchText, Qt::CaseInsensitive) ||
-                record.url.contains(searchText, Qt::CaseInsensitive) ||
-                record.notes.contains(searchText, Qt::CaseInsensitive)) 
-            {
-                // Create a new item for the completer model
-                QStandardItem *resultItem = new QStandardItem(item->text());
-                // Store a pointer to the original item in the main tree model
-                resultItem->setData(QVariant::fromValue(item), Qt::UserRole);
-                resultModel->appendRow(resultItem);
-                qDebug() << "Search: Added result:" << item->text() << "Original item ptr:" << (void*)item; // DEBUG
-            }
+    QList<Vault*> vaults;
+    for (const auto &vault : m_vaults) {
+        if (vault->searchTextStale) {
+            rebuildSearchText(vault.get());
         }
-        // Recursively search children
-        for (int i = 0; i < item->rowCount(); ++i) {
-            searchTreeRecursiveLambda(item->child(i), searchText, resultModel);
+        vaults.append(vault.get());
+    }
+    // Only reads the vault, so each one can be searched on its own thread
+    const auto searchVault = [&](Vault *vault) {
+        QList<SearchHit> hits;
+        std::vector<std::uint32_t> entries;
+        const bool narrowed = query.selectCandidates(vault->searchText, &entries);
+        const std::size_t candidateCount = narrowed ? entries.size() : vault->searchItems.size();
+        for (std::size_t i = 0; i < candidateCount; ++i) {
+            QStandardItem *item = vault->searchItems[narrowed ? entries[i] : i];
+            if (!item) {
+                continue; // Removed since the buffer was built
+            }
+            const PasswordRecord record = item->data(Qt::UserRole).value<PasswordRecord>();
+            const int score = query.score(record, query.needsFolderPath() ? TreeFilterModel::folderPath(item) : QString());
+            if (score != FuzzyMatcher::kNoMatch) {
+                hits.append(SearchHit{item, score});
+            }
         }
+        return hits;
     };
+    QList<QList<SearchHit>> perVault;
+    if (vaults.size() > 1) {
+        perVault = QtConcurrent::blockingMapped<QList<QList<SearchHit>>>(vaults, searchVault);
+    } else if (!vaults.isEmpty()) {
+        perVault.append(searchVault(vaults.first()));
+    }
+
+    // Entries yanked often or lately move up, but only among the matches
+    QList<SearchHit> ranked;
+    for (const QList<SearchHit> &hits : perVault) {
+        for (const SearchHit &hit : hits) {
+            ranked.append(SearchHit{hit.item, hit.score + m_frecency.boost(ItemId::of(hit.item))});
+        }
+    }
+    const qsizetype shown = std::min<qsizetype>(ranked.size(), kMaxSearchResults);
+    std::partial_sort(ranked.begin(), ranked.begin() + shown, ranked.end(),
+                      [](const SearchHit &a, const SearchHit &b) { return a.score > b.score; });
+
+    for (qsizetype i = 0; i < shown; ++i) {
+        appendSearchResult(ranked.at(i).item, vaults.size() > 1);
+    }
+    m_searchCompleter->complete();
+}
+
+void MainWindow::appendSearchResult(QStandardItem *item, bool nameVault)
+{
+    // With several vaults mounted each result names its vault
+    const QString label = nameVault ? QString("%1: %2").arg(vaultForItem(item)->root->text(), item->text()) : item->text();
+    // Create a new item for the completer model
+    QStandardItem *resultItem = new QStandardItem(label);
+    // Store a pointer to the original item in the main tree model
+    resultItem->setData(QVariant::fromValue(item), Qt::UserRole);
+    m_searchCompleterModel->appendRow(resultItem);
+}
+
+void MainWindow::matchClipboardUrl()
+{
+    const QString url = QApplication::clipboard()->text();
+    if (HostIndex::normalizedHost(url).isEmpty()) {
+        statusBar()->showMessage(tr("The clipboard holds no URL or host name."), 3000);
+        return;
+    }
+    if (m_filterMode) {
+        clearTreeFilter();
+    }
+
+    // The most specific level found in any vault wins (see HostIndex::lookup)
+    HostIndex::Match best = HostIndex::Match::None;
+    QList<QStandardItem*> matches;
+    for (const auto &vault : m_vaults) {
+        if (vault->searchTextStale) {
+            rebuildSearchText(vault.get());
+        }
+        HostIndex::Match match;
+        const std::vector<std::uint32_t> entries = vault->hosts.lookup(url, &match);
+        if (entries.empty() || (best != HostIndex::Match::None && match > best)) {
+            continue;
+        }
+        if (match != best) {
+            matches.clear();
+            best = match;
+        }
+        for (std::uint32_t entry : entries) {
+            matches.append(vault->searchItems[entry]);
+        }
+    }
+    if (matches.isEmpty()) {
+        // The clipboard may hold a password, so it is never echoed
+        statusBar()->showMessage(tr("No entry for the host on the clipboard."), 3000);
+        return;
+    }
+    std::stable_sort(matches.begin(), matches.end(), [this](QStandardItem *a, QStandardItem *b) {
+        return m_frecency.boost(ItemId::of(a)) > m_frecency.boost(ItemId::of(b));
+    });
 
-    // Start recursive search from the invisible root item of the main tree model
-    searchTreeRecursiveLambda(m_treeModel->invisibleRootItem(), text, m_searchCompleterModel);
+    const QString level = best == HostIndex::Match::Host ? tr("this host")
+                        : best == HostIndex::Match::ParentHost ? tr("a parent host") : tr("the same domain");
+    if (matches.size() == 1) {
+        setCurrentSourceIndex(matches.first()->index());
+        m_treeView->scrollTo(m_treeView->currentIndex());
+        m_treeView->setFocus();
+        statusBar()->showMessage(tr("Entry for %1 selected.").arg(level), 3000);
+        return;
+    }
+    // Several: offer them like search results, best used first
+    m_searchCompleterModel->clear();
+    for (QStandardItem *item : std::as_const(matches)) {
+        appendSearchResult(item, m_vaults.size() > 1);
+    }
+    m_searchBar->blockSignals(true); // An empty bar would otherwise clear the list again
+    m_searchBar->clear();
+    m_searchBar->blockSignals(false);
+    m_searchBar->show();
+    m_searchBar->setFocus();
     m_searchCompleter->complete();
+    statusBar()->showMessage(tr("%1 entries for %2.").arg(matches.size()).arg(level), 3000);
 }
 
 void MainWindow::jumpToSearchResult(const QModelIndex &index)
@@ -938,14 +2774,14 @@ void MainWindow::jumpToSearchResult(const QModelIndex &index)
     QModelIndex parent = treeIndex.parent();
     while (parent.isValid()) {
         qDebug() << "jumpToSearchResult: Expanding parent:" << m_treeModel->itemFromIndex(parent)->text(); // DEBUG
-        m_treeView->expand(parent);
+        m_treeView->expand(viewIndex(parent));
         parent = parent.parent();
     }
 
     qDebug() << "jumpToSearchResult: Setting current index to:" << m_treeModel->itemFromIndex(treeIndex)->text(); // DEBUG
-    m_treeView->setCurrentIndex(treeIndex);
+    setCurrentSourceIndex(treeIndex);
     qDebug() << "jumpToSearchResult: Scrolling to:" << m_treeModel->itemFromIndex(treeIndex)->text(); // DEBUG
-    m_treeView->scrollTo(treeIndex);
+    m_treeView->scrollTo(viewIndex(treeIndex));
     qDebug() << "jumpToSearchResult: Setting focus to treeView."; // DEBUG
     m_treeView->setFocus();
     
@@ -959,6 +2795,15 @@ void MainWindow::jumpToSearchResult(const QModelIndex &index)
 
 void MainWindow::onSearchBarReturnPressed()
 {
+    if (m_filterMode) {
+        // Keep the filter and browse what it left
+        m_searchBar->hide();
+        m_treeView->setFocus();
+        if (!m_treeView->currentIndex().isValid()) {
+            m_treeView->setCurrentIndex(m_treeFilter->index(0, 0));
+        }
+        return;
+    }
     qDebug() << "onSearchBarReturnPressed called."; // DEBUG
     QModelIndex currentIndex = m_searchCompleter->popup()->currentIndex();
     qDebug() << "onSearchBarReturnPressed: Completer popup current index valid:" << currentIndex.isValid(); // DEBUG
@@ -983,7 +2828,7 @@ void MainWindow::onSearchBarReturnPressed()
 void MainWindow::copyPasswordToClipboard()
 {
     qDebug() << "copyPasswordToClipboard called."; // DEBUG
-    QModelIndex currentIndex = m_treeView->currentIndex();
+    QModelIndex currentIndex = currentSourceIndex();
     if (!currentIndex.isValid()) {
         statusBar()->showMessage(tr("No item selected to copy password from."), 3000);
         qDebug() << "copyPasswordToClipboard: No item selected."; // DEBUG
@@ -1000,9 +2845,11 @@ void MainWindow::copyPasswordToClipboard()
     if (selectedItem->data(Qt::UserRole).canConvert<PasswordRecord>()) {
         PasswordRecord record = selectedItem->data(Qt::UserRole).value<PasswordRecord>();
         if (!record.isEmpty()) {
-            QApplication::clipboard()->setText(record.password);
-            statusBar()->showMessage(tr("Password for '%1' copied to clipboard.").arg(record.name), 3000);
-            qDebug() << "copyPasswordToClipboard: Password copied for:" << record.name; // DEBUG
+            QApplication::clipboard()->setText(record.value(RecordField::Password));
+            m_frecency.recordUse(ItemId::of(selectedItem));
+            saveFrecency();
+            statusBar()->showMessage(tr("Password for '%1' copied to clipboard.").arg(record.value(RecordField::Name)), 3000);
+            qDebug() << "copyPasswordToClipboard: Password copied for:" << record.value(RecordField::Name); // DEBUG
         } else {
             statusBar()->showMessage(tr("Selected item is not a password record."), 3000);
             qDebug() << "copyPasswordToClipboard: Selected item is not a password record (empty record)."; // DEBUG
@@ -1014,7 +2861,156 @@ void MainWindow::copyPasswordToClipboard()
 }
 
 
-QByteArray MainWindow::serializeModelToByteArray() {
+void MainWindow::markVaultChanged(const QModelIndex &index)
+{
+    QStandardItem *item = m_treeModel->itemFromIndex(index);
+    if (Vault *vault = vaultForItem(item)) {
+        vault->unsavedChanges = true;
+        vault->syncHashes.invalidate(item);
+    }
+}
+
+void MainWindow::forgetSyncHashes(const QModelIndex &parent, int first, int last)
+{
+    QStandardItem *item = m_treeModel->itemFromIndex(parent);
+    Vault *vault = vaultForItem(item);
+    if (!vault) {
+        return; // Vaults being mounted or unmounted bring their own cache
+    }
+    for (int row = first; row <= last; ++row) {
+        if (const QStandardItem *child = item->child(row)) {
+            vault->syncHashes.forget(child);
+        }
+    }
+}
+
+void MainWindow::rebuildSearchText(Vault *vault)
+{
+    vault->searchText.clear();
+    vault->searchItems.clear();
+    vault->searchEntries.clear();
+    vault->hosts.clear();
+    std::size_t column = 0;
+    RecordSchema::forEachField([&](auto field) {
+        if constexpr (RecordSchema::hasFlag(field, FieldSearchable)) {
+            vault->searchText.setColumnSensitive(column++, RecordSchema::hasFlag(field, FieldSensitive));
+        }
+    });
+
+    std::function<void(QStandardItem *)> collect = [&](QStandardItem *item) {
+        for (int i = 0; i < item->rowCount(); ++i) {
+            QStandardItem *child = item->child(i);
+            appendSearchEntry(vault, child);
+            collect(child);
+        }
+    };
+    collect(vault->root);
+    vault->searchTextStale = false;
+}
+
+void MainWindow::indexSearchRows(const QModelIndex &parent, int first, int last)
+{
+    QStandardItem *item = m_treeModel->itemFromIndex(parent);
+    Vault *vault = vaultForItem(item);
+    if (!vault || vault->searchTextStale) {
+        return; // Vaults being mounted, and stale buffers, are built in full on the next search
+    }
+    // Rows arrive with whatever subtree they carry; only the top row is announced
+    std::function<void(QStandardItem *)> index = [&](QStandardItem *row) {
+        appendSearchEntry(vault, row);
+        for (int i = 0; i < row->rowCount(); ++i) {
+            index(row->child(i));
+        }
+    };
+    for (int row = first; row <= last; ++row) {
+        if (QStandardItem *child = item->child(row)) {
+            index(child);
+        }
+    }
+}
+
+void MainWindow::unindexSearchRows(const QModelIndex &parent, int first, int last)
+{
+    QStandardItem *item = m_treeModel->itemFromIndex(parent);
+    Vault *vault = vaultForItem(item);
+    if (!vault || vault->searchTextStale) {
+        return;
+    }
+    std::function<void(const QStandardItem *)> unindex = [&](const QStandardItem *row) {
+        removeSearchEntry(vault, row);
+        for (int i = 0; i < row->rowCount(); ++i) {
+            unindex(row->child(i));
+        }
+    };
+    for (int row = first; row <= last; ++row) {
+        if (const QStandardItem *child = item->child(row)) {
+            unindex(child);
+        }
+    }
+}
+
+void MainWindow::reindexSearchRows(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+    Vault *vault = vaultForItem(m_treeModel->itemFromIndex(topLeft));
+    if (!vault || vault->searchTextStale) {
+        return;
+    }
+    // The old text can't be found from the new record, so the entry is replaced as a whole
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+        QStandardItem *item = m_treeModel->itemFromIndex(topLeft.siblingAtRow(row));
+        removeSearchEntry(vault, item);
+        appendSearchEntry(vault, item);
+    }
+}
+
+void MainWindow::appendSearchEntry(Vault *vault, QStandardItem *item)
+{
+    if (!item->data(Qt::UserRole).canConvert<PasswordRecord>() || vault->searchEntries.contains(item)) {
+        return;
+    }
+    const PasswordRecord record = item->data(Qt::UserRole).value<PasswordRecord>();
+    std::array<QByteArray, SearchColumns::kCount> folded;
+    std::size_t c = 0;
+    RecordSchema::forEachField([&](auto field) {
+        if constexpr (RecordSchema::hasFlag(field, FieldSearchable)) {
+            folded[c++] = foldToUtf8(record.view(kRecordFields[field].id), RecordSchema::hasFlag(field, FieldSensitive));
+        }
+    });
+    for (const CustomField &customField : record.customFields) {
+        if (CustomFieldTypes::isSearchable(customField.type)) {
+            folded[c] += foldToUtf8(customField.text(), false) + '\n';
+        }
+    }
+    std::array<std::string_view, SearchColumns::kCount> fields;
+    for (std::size_t f = 0; f < SearchColumns::kCount; ++f) {
+        fields[f] = std::string_view(folded[f].constData(), size_t(folded[f].size()));
+    }
+    const std::uint32_t entry = vault->searchText.appendEntry(fields.data());
+    vault->searchItems.push_back(item);
+    vault->searchEntries.insert(item, entry);
+    vault->hosts.insert(entry, record.view(RecordField::Url));
+    for (QByteArray &value : folded) {
+        sodium_memzero(value.data(), size_t(value.size()));
+    }
+}
+
+void MainWindow::removeSearchEntry(Vault *vault, const QStandardItem *item)
+{
+    const auto found = vault->searchEntries.constFind(item);
+    if (found == vault->searchEntries.constEnd()) {
+        return;
+    }
+    vault->searchText.removeEntry(found.value());
+    vault->searchItems[found.value()] = nullptr;
+    vault->hosts.remove(found.value());
+    vault->searchEntries.erase(found);
+    const std::size_t removed = vault->searchText.removedCount();
+    if (removed >= kMinRemovedSearchEntries && removed * 2 >= vault->searchText.entryCount()) {
+        vault->searchTextStale = true; // Mostly holes: the next search rebuilds it densely
+    }
+}
+
+QByteArray MainWindow::serializeModelToByteArray(QStandardItem *vaultRoot) {
     QString strData;
     QTextStream out(&strData);
 
@@ -1030,19 +3026,43 @@ QByteArray MainWindow::serializeModelToByteArray() {
 
         // Write item text
         outStreamLambda << "- " << item->text() << "\n";
+        for (int i = 0; i < depth + 1; ++i) { outStreamLambda << "  "; }
+        outStreamLambda << "  id: " << QString::number(ItemId::of(item), 16) << "\n";
 
         // If it has PasswordRecord data, write it
         if (item->data(Qt::UserRole).canConvert<PasswordRecord>()) {
             PasswordRecord record = item->data(Qt::UserRole).value<PasswordRecord>();
             if (!record.isEmpty()) {
-                for (int i = 0; i < depth + 1; ++i) { outStreamLambda << "  "; } outStreamLambda << "  name: " << record.name << "\n";
-                for (int i = 0; i < depth + 1; ++i) { outStreamLambda << "  "; } outStreamLambda << "  username: " << record.username << "\n";
-                for (int i = 0; i < depth + 1; ++i) { outStreamLambda << "  "; } outStreamLambda << "  password: " << record.password << "\n"; // Placeholder: NO ENCRYPTION
-                for (int i = 0; i < depth + 1; ++i) { outStreamLambda << "  "; } outStreamLambda << "  url: " << record.url << "\n";
-                for (int i = 0; i < depth + 1; ++i) { outStreamLambda << "  "; } outStreamLambda << "  notes: |\n";
-                QStringList notesLines = record.notes.split('\n');
-                for (const QString &line : notesLines) {
-                    for (int i = 0; i < depth + 3; ++i) { outStreamLambda << "  "; } outStreamLambda << line << "\n";
+                RecordSchema::forEachField([&](auto field) {
+                    constexpr const RecordFieldSpec &spec = kRecordFields[field];
+                    for (int i = 0; i < depth + 1; ++i) { outStreamLambda << "  "; }
+                    if constexpr ((spec.flags & FieldMultiline) != 0) {
+                        outStreamLambda << "  " << spec.key << ": |\n";
+                        const QList<QStringView> blockLines = record.view(spec.id).split(u'\n');
+                        for (QStringView line : blockLines) {
+                            for (int i = 0; i < depth + 3; ++i) { outStreamLambda << "  "; } outStreamLambda << line << "\n";
+                        }
+                    } else {
+                        outStreamLambda << "  " << spec.key << ": " << record.view(spec.id) << "\n";
+                    }
+                });
+                // Custom fields: "field.<type>.<key>: <escaped value>"
+                for (const CustomField &field : record.customFields) {
+                    for (int i = 0; i < depth + 1; ++i) { outStreamLambda << "  "; }
+                    outStreamLambda << "  field." << CustomFieldTypes::name(field.type) << "." << FieldKeyTable::name(field.key)
+                                    << ": " << CustomFieldCodec::escape(field.text()) << "\n";
+                }
+                for (const Attachment &attachment : record.attachments) {
+                    for (int i = 0; i < depth + 1; ++i) { outStreamLambda << "  "; }
+                    outStreamLambda << "  attachment: " << AttachmentCodec::encode(attachment) << "\n";
+                }
+                if (record.passwordChanged != 0) {
+                    for (int i = 0; i < depth + 1; ++i) { outStreamLambda << "  "; }
+                    outStreamLambda << "  changed: " << record.passwordChanged << "\n";
+                }
+                if (!record.revisions.isEmpty()) {
+                    for (int i = 0; i < depth + 1; ++i) { outStreamLambda << "  "; }
+                    outStreamLambda << "  history: " << record.revisions.view() << "\n";
                 }
             }
         }
@@ -1055,91 +3075,59 @@ QByteArray MainWindow::serializeModelToByteArray() {
 
     out << "# ArcaneLock Password Database\n";
     out << "# Format: Item Name\n";
+    out << "#   id: stable item id (hex)\n";
+    out << "#   changed: when the password was set (seconds since 1970)\n";
     out << "#   field: value\n";
+    out << "#   attachment: blob key, content hash, size and name of an attached file\n";
+    out << "#   history: earlier versions of the entry (count, then encoded reverse deltas)\n";
     out << "#   notes: |\n";
     out << "#     line 1\n";
     out << "#     line 2\n";
     out << "\n";
 
-    QStandardItem *rootItem = m_treeModel->invisibleRootItem();
-    for (int i = 0; i < rootItem->rowCount(); ++i) {
-        serializeItemRecursiveToStringLambda(out, rootItem->child(i), 0);
+    for (int i = 0; i < vaultRoot->rowCount(); ++i) {
+        serializeItemRecursiveToStringLambda(out, vaultRoot->child(i), 0);
     }
-    return strData.toUtf8();
+    out.flush();
+    QByteArray utf8 = strData.toUtf8();
+    // The UTF-16 copy holds every secret of the vault; don't leave it on the heap
+    sodium_memzero(strData.data(), size_t(strData.size()) * sizeof(QChar));
+    return utf8;
 }
 
 #include <QDialog>
 #include <functional> // Required for std::function
 
-void MainWindow::saveModelToFile(const QString &filePath, const QString &masterPassword) {
-    if (sodium_init() < 0) {
-        statusBar()->showMessage(tr("libsodium initialization failed."), 5000);
-        return;
-    }
-
-    QByteArray plaintext = serializeModelToByteArray();
-    
-    // 1. Argon2 password hashing for verification (contains its own salt and params)
-    char hashedPasswordStr[crypto_pwhash_STRBYTES];
-    if (crypto_pwhash_str(hashedPasswordStr,
-                          masterPassword.toUtf8().constData(), masterPassword.toUtf8().length(),
-                          crypto_pwhash_OPSLIMIT_MODERATE,
-                          crypto_pwhash_MEMLIMIT_MODERATE) != 0) {
-        statusBar()->showMessage(tr("Password hashing for verification failed."), 5000);
-        return;
-    }
-    QByteArray hashedPasswordData(hashedPasswordStr, crypto_pwhash_STRBYTES);
-
-    // 2. Generate a separate salt for key derivation
-    unsigned char encryptionSalt[crypto_pwhash_SALTBYTES];
-    randombytes_buf(encryptionSalt, sizeof encryptionSalt);
-
-    // 3. Derive a raw encryption key from master password and encryption salt
-    unsigned char encryptionKey[crypto_secretbox_KEYBYTES];
-    if (crypto_pwhash(encryptionKey, sizeof encryptionKey,
-                      masterPassword.toUtf8().constData(), masterPassword.toUtf8().length(),
-                      encryptionSalt,
-                      crypto_pwhash_OPSLIMIT_MODERATE,
-                      crypto_pwhash_MEMLIMIT_MODERATE,
-                      crypto_pwhash_ALG_ARGON2ID13) != 0) {
-        statusBar()->showMessage(tr("Key derivation for encryption failed."), 5000);
-        return;
-    }
-
-    // 4. Generate a random nonce
-    unsigned char nonce[crypto_secretbox_NONCEBYTES];
-    randombytes_buf(nonce, sizeof nonce);
-
-    // 5. Encrypt the plaintext
-    QByteArray ciphertext(plaintext.size() + crypto_secretbox_MACBYTES, Qt::Uninitialized);
-    if (crypto_secretbox_easy(reinterpret_cast<unsigned char*>(ciphertext.data()),
-                              reinterpret_cast<const unsigned char*>(plaintext.constData()), plaintext.size(),
-                              nonce, encryptionKey) != 0) {
-        statusBar()->showMessage(tr("Encryption failed."), 5000);
-        return;
-    }
-
-    // Write to file
-    QFile file(filePath);
-    if (!file.open(QIODevice::WriteOnly)) {
-        statusBar()->showMessage(tr("Cannot write file %1:\n%2.").arg(filePath).arg(file.errorString()), 5000);
+void MainWindow::saveModelToFile(Vault *vault) {
+    QByteArray plaintext = serializeModelToByteArray(vault->root);
+    QByteArray passwordUtf8 = vault->masterPassword.toUtf8();
+    QString errorMessage;
+    QByteArray sealed;
+    const bool saved = VaultFile::seal(plaintext, passwordUtf8, &sealed, &errorMessage)
+                       && VaultFile::write(vault->filePath, sealed, &errorMessage);
+    sodium_memzero(passwordUtf8.data(), size_t(passwordUtf8.size()));
+    if (!saved) {
+        sodium_memzero(plaintext.data(), size_t(plaintext.size()));
+        statusBar()->showMessage(errorMessage, 5000);
         return;
     }
-
-    QByteArray header = "ALOCK_V1"; // 8 bytes for header
-    file.write(header);
-    file.write(hashedPasswordData);       // Argon2 hash string for verification
-    file.write(QByteArray(reinterpret_cast<const char*>(encryptionSalt), sizeof encryptionSalt)); // Salt for key derivation
-    file.write(QByteArray(reinterpret_cast<const char*>(nonce), sizeof nonce)); // Nonce for encryption
-    file.write(ciphertext);
-
-    file.close();
-    statusBar()->showMessage(tr("File saved and encrypted to %1").arg(filePath), 3000);
-    qDebug() << "Model saved and encrypted to:" << filePath;
+    rememberFileContent(vault, sealed);
+    statusBar()->showMessage(tr("File saved and encrypted to %1").arg(vault->filePath), 3000);
+    backUpPlaintext(vault, plaintext);
+    sodium_memzero(plaintext.data(), size_t(plaintext.size()));
+    qDebug() << "Model saved and encrypted to:" << vault->filePath;
 }
 
 bool MainWindow::eventFilter(QObject *obj, QEvent *event)
 {
+    // Any input, dialogs included, postpones the idle lock
+    if (m_idleTimer && m_idleTimer->interval() > 0 && !m_vaultLocked) {
+        const QEvent::Type type = event->type();
+        if (type == QEvent::KeyPress || type == QEvent::MouseButtonPress || type == QEvent::Wheel) {
+            m_idleTimer->start();
+        }
+    }
+
     // If a modal dialog is active, don't process any of our custom keybindings.
     if (m_isModalDialogActive) {
         return QMainWindow::eventFilter(obj, event);
@@ -1159,8 +3147,12 @@ bool MainWindow::eventFilter(QObject *obj, QEvent *event)
         // Handle search bar interaction
         if (m_searchBar->isVisible()) {
             if (key == Qt::Key_Escape) {
-                m_searchBar->hide();
-                m_searchBar->clear();
+                if (m_filterMode) {
+                    clearTreeFilter();
+                } else {
+                    m_searchBar->hide();
+                    m_searchBar->clear();
+                }
                 m_treeView->setFocus();
                 return true;
             }
@@ -1170,6 +3162,18 @@ bool MainWindow::eventFilter(QObject *obj, QEvent *event)
             }
         }
 
+        // While locked only unlocking, help and quitting are available
+        if (m_vaultLocked) {
+            if (key == Qt::Key_Return || key == Qt::Key_Enter) {
+                unlockVault();
+            } else if (key == Qt::Key_Q) {
+                QApplication::quit();
+            } else if (key == Qt::Key_Question) {
+                showHelpDialog();
+            }
+            return true;
+        }
+
         if (m_currentMode == Mode::TREE) {
             // If an item is being edited in the tree view, don't process any other keybindings
             if (m_isEditingTreeItem) {
@@ -1181,14 +3185,17 @@ bool MainWindow::eventFilter(QObject *obj, QEvent *event)
                 showHelpDialog();
                 return true;
             } else if (key == Qt::Key_I && !(modifiers & Qt::ShiftModifier)) { // 'i' for insert/rename
-                QModelIndex currentIndex = m_treeView->currentIndex();
+                QModelIndex currentIndex = currentSourceIndex();
                 if (currentIndex.isValid()) {
                     QStandardItem *item = m_treeModel->itemFromIndex(currentIndex);
                     if (item->data(Qt::UserRole).canConvert<PasswordRecord>()) {
                         enterInsertMode(currentIndex); // Edit record
                     } else {
+                        if (Vault *vault = vaultForItem(item)) {
+                            vault->history.prepare(vault->root); // Before the editor changes the name
+                        }
                         m_isEditingTreeItem = true;
-                        m_treeView->edit(currentIndex); // Edit folder name
+                        m_treeView->edit(viewIndex(currentIndex)); // Edit folder name
                     }
                     return true;
                 }
@@ -1205,7 +3212,11 @@ bool MainWindow::eventFilter(QObject *obj, QEvent *event)
                 newDatabase();
                 return true;
             } else if (key == Qt::Key_O) {
-                openDatabase();
+                if (modifiers & Qt::ShiftModifier) {
+                    reopenLastSession();
+                } else {
+                    openDatabase();
+                }
                 return true;
             } else if (key == Qt::Key_A) {
                 if (modifiers & Qt::ShiftModifier) {
@@ -1224,6 +3235,45 @@ bool MainWindow::eventFilter(QObject *obj, QEvent *event)
             } else if (key == Qt::Key_Slash) {
                 showSearchBar();
                 return true;
+            } else if (key == Qt::Key_V && !(modifiers & Qt::ShiftModifier)) {
+                enterVisualMode();
+                return true;
+            } else if (key == Qt::Key_I && (modifiers & Qt::ShiftModifier)) {
+                importFile();
+                return true;
+            } else if (key == Qt::Key_E && !(modifiers & Qt::ShiftModifier)) {
+                exportItems();
+                return true;
+            } else if (key == Qt::Key_R && (modifiers & Qt::ShiftModifier) && !(modifiers & Qt::ControlModifier)) {
+                syncVault();
+                return true;
+            } else if (key == Qt::Key_B && (modifiers & Qt::ShiftModifier)) {
+                backupVault();
+                return true;
+            } else if (key == Qt::Key_T && (modifiers & Qt::ShiftModifier)) {
+                auditPasswords();
+                return true;
+            } else if (key == Qt::Key_F && (modifiers & Qt::ShiftModifier)) {
+                manageAttachments();
+                return true;
+            } else if (key == Qt::Key_Y && (modifiers & Qt::ShiftModifier)) {
+                showRevisions();
+                return true;
+            } else if (key == Qt::Key_U && (modifiers & Qt::ShiftModifier)) {
+                matchClipboardUrl();
+                return true;
+            } else if (key == Qt::Key_U) {
+                undoLastChange();
+                return true;
+            } else if (key == Qt::Key_R && (modifiers & Qt::ControlModifier)) {
+                redoLastChange();
+                return true;
+            } else if (key == Qt::Key_F && !(modifiers & Qt::ShiftModifier)) {
+                showFilterBar();
+                return true;
+            } else if (key == Qt::Key_Escape && m_filterMode) {
+                clearTreeFilter();
+                return true;
             }
 
             // Item manipulation (Shift pressed)
@@ -1249,6 +3299,18 @@ bool MainWindow::eventFilter(QObject *obj, QEvent *event)
                 } else if (key == Qt::Key_C) {
                     collapseAllNodes();
                     return true;
+                } else if (key == Qt::Key_M) {
+                    showMemoryStats();
+                    return true;
+                } else if (key == Qt::Key_X) {
+                    lockVault();
+                    return true;
+                } else if (key == Qt::Key_P) {
+                    setQuickUnlockPin();
+                    return true;
+                } else if (key == Qt::Key_W) {
+                    closeCurrentVault();
+                    return true;
                 }
             } else { // No Shift modifier
                 // Navigation
@@ -1284,6 +3346,33 @@ bool MainWindow::eventFilter(QObject *obj, QEvent *event)
                     return true;
                 }
             }
+        } else if (m_currentMode == Mode::VISUAL) {
+            // VISUAL mode keybindings: extend the selection, then act on all of it
+            if (key == Qt::Key_Escape) {
+                exitVisualMode();
+            } else if ((key == Qt::Key_J || key == Qt::Key_K) && (modifiers & Qt::ShiftModifier)) {
+                moveVisualSelection(key == Qt::Key_J ? 1 : -1);
+            } else if (key == Qt::Key_J || key == Qt::Key_K || key == Qt::Key_Down || key == Qt::Key_Up) {
+                const Qt::Key arrow = (key == Qt::Key_J || key == Qt::Key_Down) ? Qt::Key_Down : Qt::Key_Up;
+                QKeyEvent simulatedArrowEvent(QEvent::KeyPress, arrow, Qt::NoModifier);
+                QApplication::sendEvent(m_treeView, &simulatedArrowEvent);
+                updateVisualSelection(); // The view selected only the new current row
+            } else if (key == Qt::Key_L) {
+                m_treeView->expand(m_treeView->currentIndex());
+            } else if (key == Qt::Key_H) {
+                m_treeView->collapse(m_treeView->currentIndex());
+            } else if (key == Qt::Key_V) {
+                startVisualRange();
+            } else if (key == Qt::Key_Space) {
+                toggleVisualItem();
+            } else if (key == Qt::Key_D || key == Qt::Key_X) {
+                deleteVisualSelection();
+            } else if (key == Qt::Key_M) {
+                moveVisualSelectionToFolder();
+            } else if (key == Qt::Key_Question) {
+                showHelpDialog();
+            }
+            return true; // Nothing else acts on a multi-selection
         } else if (m_currentMode == Mode::INSERT) {
             // INSERT mode keybindings
             if (key == Qt::Key_Escape) {
@@ -1292,41 +3381,31 @@ bool MainWindow::eventFilter(QObject *obj, QEvent *event)
             } else if (key == Qt::Key_Return && (modifiers & Qt::ControlModifier)) {
                 saveRecord();
                 return true;
+            } else if (key == Qt::Key_N && (modifiers & Qt::ControlModifier)) {
+                addCustomFieldRow();
+                return true;
+            } else if (key == Qt::Key_D && (modifiers & Qt::ControlModifier)) {
+                removeCustomFieldRow();
+                return true;
             } else if (key == Qt::Key_Tab) {
-                if (modifiers & Qt::ShiftModifier) {
-                    QWidget *focusedWidget = QApplication::focusWidget();
-                    if (focusedWidget == m_nameEdit) {
-                        m_notesEdit->setFocus();
-                    } else if (focusedWidget == m_usernameEdit) {
-                        m_nameEdit->setFocus();
-                    }
-                    else if (focusedWidget == m_passwordEdit) {
-                        m_usernameEdit->setFocus();
-                    }
-                    else if (focusedWidget == m_urlEdit) {
-                        m_passwordEdit->setFocus();
-                    }
-                    else if (focusedWidget == m_notesEdit) {
-                        m_urlEdit->setFocus();
-                    } else {
-                        m_notesEdit->setFocus();
+                // Cycle through the field editors in display order
+                const auto &order = RecordSchema::kDisplayOrder;
+                const int count = int(order.size());
+                QWidget *focusedWidget = QApplication::focusWidget();
+                int focusedPos = -1;
+                for (int i = 0; i < count; ++i) {
+                    if (m_fieldEditors[std::size_t(order[i])] == focusedWidget) {
+                        focusedPos = i;
+                        break;
                     }
+                }
+                int nextPos;
+                if (modifiers & Qt::ShiftModifier) {
+                    nextPos = focusedPos <= 0 ? count - 1 : focusedPos - 1;
                 } else {
-                    QWidget *focusedWidget = QApplication::focusWidget();
-                    if (focusedWidget == m_nameEdit) {
-                        m_usernameEdit->setFocus();
-                    } else if (focusedWidget == m_usernameEdit) {
-                        m_passwordEdit->setFocus();
-                    } else if (focusedWidget == m_passwordEdit) {
-                        m_urlEdit->setFocus();
-                    } else if (focusedWidget == m_urlEdit) {
-                        m_notesEdit->setFocus();
-                    } else if (focusedWidget == m_notesEdit) {
-                        m_nameEdit->setFocus();
-                    } else {
-                        m_nameEdit->setFocus();
-                    }
+                    nextPos = focusedPos < 0 ? 0 : (focusedPos + 1) % count;
                 }
+                m_fieldEditors[std::size_t(order[nextPos])]->setFocus();
                 return true;
             }
         }
@@ -1352,7 +3431,13 @@ void MainWindow::showHelpDialog()
                        "<b>Actions:</b><br>"
                        "  <b>i</b>: Edit selected record / Rename folder<br>"
                        "  <b>y</b>: Yank (copy) password to clipboard<br>"
-                       "  <b>/</b>: Show search bar<br>"
+                       "  <b>/</b>: Show search bar (fuzzy; entries yanked often or lately rank first;<br>"
+                       "       user:, url:, notes:, folder:, re:, \"phrase\" and -term narrow it)<br>"
+                       "  <b>u</b>: Undo the last change to the vault<br>"
+                       "  <b>Ctrl+R</b>: Redo<br>"
+                       "  <b>Shift+U</b>: Select the entries for the URL on the clipboard (or its parent domains)<br>"
+                       "  <b>f</b>: Filter the tree in place with the same queries<br>"
+                       "       (Enter browses the matches, Esc shows everything again)<br>"
                        "  <b>Shift+A</b>: Create new folder<br>"
                        "  <b>a</b>: Create new record<br>"
                        "  <b>Shift+D</b>: Delete selected item<br>"
@@ -1361,18 +3446,42 @@ void MainWindow::showHelpDialog()
                        "  <b>Shift+H</b>: Move selected item to parent or root<br>"
                        "  <b>Shift+L</b>: Move selected item into sibling folder<br>"
                        "  <b>Shift+E</b>: Expand all nodes<br>"
-                       "  <b>Shift+C</b>: Collapse all nodes<br><br>"
+                       "  <b>Shift+C</b>: Collapse all nodes<br>"
+                       "  <b>Shift+M</b>: Show memory statistics<br>"
+                       "  <b>Shift+T</b>: Audit the selected vault for reused, weak, stale and breached passwords<br>"
+                       "  <b>Shift+F</b>: Files attached to the selected entry<br>"
+                       "  <b>Shift+Y</b>: Earlier versions of the selected entry (restore one, or y to copy its password)<br>"
+                       "  <b>Shift+X</b>: Lock all vaults now (also after the idle timeout)<br>"
+                       "  <b>Shift+P</b>: Set the quick-unlock PIN<br>"
+                       "  <b>Enter</b>: Unlock (while locked)<br><br>"
                        "<b>File Operations:</b><br>"
-                       "  <b>n</b>: New database<br>"
-                       "  <b>o</b>: Open database<br>"
-                       "  <b>s</b>: Save database<br>"
-                       "  <b>Shift+S</b>: Save database as...<br>"
+                       "  <b>n</b>: New database (mounted next to the open ones)<br>"
+                       "  <b>o</b>: Open database (mounted next to the open ones)<br>"
+                       "  <b>Shift+O</b>: Reopen the vaults of the last session<br>"
+                       "  <b>Shift+W</b>: Close the vault of the selected item<br>"
+                       "  <b>Shift+I</b>: Import a CSV, KeePass XML or Bitwarden JSON export into the selected vault<br>"
+                       "  <b>e</b>: Export the selected vault, folder or entry as CSV or JSON<br>"
+                       "  <b>Shift+R</b>: Sync the selected vault through a shared folder (asked for the first time)<br>"
+                       "  <b>Shift+B</b>: Back up the selected vault into a backup store (asked for the first time; saves back up too)<br>"
+                       "  <b>s</b>: Save the selected item's database<br>"
+                       "  <b>Shift+S</b>: Save the selected item's database as...<br>"
                        "  <b>q</b>: Quit application<br>"
                        "  <b>?</b>: Show this help dialog<br><br>"
+                       "<b>VISUAL mode</b> (<b>v</b> in TREE mode):<br>"
+                       "  <b>j/k</b>: Extend the selection down/up<br>"
+                       "  <b>Space</b>: Add or remove the current item<br>"
+                       "  <b>v</b>: Start another range at the current item<br>"
+                       "  <b>d</b>: Delete the selected items<br>"
+                       "  <b>Shift+J/Shift+K</b>: Move the selected items down/up<br>"
+                       "  <b>m</b>: Move the selected items to a folder<br>"
+                       "  <b>Esc</b>: Back to TREE mode<br>"
+                       "  Each of these is one step for <b>u</b><br><br>"
                        "<b>INSERT mode:</b><br>"
                        "  <b>Esc</b>: Exit INSERT mode<br>"
                        "  <b>Ctrl+Return</b>: Save record and exit INSERT mode<br>"
-                       "  <b>Tab/Shift+Tab</b>: Navigate between fields<br>";
+                       "  <b>Tab/Shift+Tab</b>: Navigate between fields<br>"
+                       "  <b>Ctrl+N</b>: Add custom field<br>"
+                       "  <b>Ctrl+D</b>: Remove current custom field<br>";
 
     QMessageBox msgBox(this);
     msgBox.setWindowTitle("Arcane Lock Help");
@@ -1380,3 +3489,385 @@ void MainWindow::showHelpDialog()
     msgBox.setIcon(QMessageBox::NoIcon);
     msgBox.exec();
 }
+
+void MainWindow::showMemoryStats()
+{
+    // Count entries and folders so the arena figures can be read per entry
+    int entryCount = 0;
+    int folderCount = 0;
+    std::function<void(QStandardItem *)> countItems = [&](QStandardItem *item) {
+        for (int i = 0; i < item->rowCount(); ++i) {
+            QStandardItem *child = item->child(i);
+            if (child->data(Qt::UserRole).canConvert<PasswordRecord>()) {
+                ++entryCount;
+            } else {
+                ++folderCount;
+            }
+            countItems(child);
+        }
+    };
+    countItems(m_treeModel->invisibleRootItem());
+
+    StringArena::Stats strings;
+    for (const auto &vault : m_vaults) {
+        strings += vault->strings.stats();
+    }
+    const auto kib = [](qsizetype bytes) { return QString::number(bytes / 1024.0, 'f', 1) + " KiB"; };
+    const QString perEntry = entryCount > 0
+        ? QString::number(double(strings.reservedBytes) / entryCount, 'f', 1) + " bytes"
+        : QString("-");
+
+    QString statsText = QString("<b>Vaults:</b> %10 mounted, %1 entries, %2 folders<br><br>"
+                                "<b>Shared string arena:</b><br>"
+                                "  Unique strings: %3<br>"
+                                "  Lookups: %4 (%5 deduplicated)<br>"
+                                "  Reserved: %6, used: %7<br>"
+                                "  Saved by interning: %8<br>"
+                                "  Reserved per entry: %9<br>")
+                            .arg(entryCount).arg(folderCount)
+                            .arg(strings.uniqueStrings)
+                            .arg(strings.lookups).arg(strings.hits)
+                            .arg(kib(strings.reservedBytes), kib(strings.usedBytes), kib(strings.savedBytes), perEntry)
+                            .arg(m_vaults.size());
+
+    qsizetype searchBytes = 0;
+    for (const auto &vault : m_vaults) {
+        searchBytes += qsizetype(vault->searchText.bytes());
+    }
+    statsText += QString("<br><b>Search buffer:</b> %1, scanned with the %2 kernel<br>")
+                     .arg(kib(searchBytes), QString::fromLatin1(ArcaneLock::SearchBuffer::kernelName()));
+
+    const ArcaneLock::SecurePool::Stats secure = ArcaneLock::SecurePool::instance().stats();
+    statsText += QString("<br><b>Secure memory (passwords, notes, secret fields):</b><br>"
+                         "  Live allocations: %1 (%2 requested, %3 in slots)<br>"
+                         "  Peak in use: %4<br>"
+                         "  Mapped: %5 in %6 regions<br>"
+                         "  Locked: %7, not locked: %8<br>"
+                         "  Lock limit (RLIMIT_MEMLOCK): %9<br>")
+                     .arg(qulonglong(secure.liveAllocations))
+                     .arg(kib(qsizetype(secure.requestedBytes)), kib(qsizetype(secure.bytesInUse)),
+                          kib(qsizetype(secure.peakBytesInUse)), kib(qsizetype(secure.mappedBytes)))
+                     .arg(qulonglong(secure.regions))
+                     .arg(kib(qsizetype(secure.lockedBytes)), kib(qsizetype(secure.unlockedBytes)),
+                          secure.memlockLimit ? kib(qsizetype(secure.memlockLimit)) : QString("unlimited"));
+
+    QMessageBox msgBox(this);
+    msgBox.setWindowTitle("Arcane Lock Memory");
+    msgBox.setText(statsText);
+    msgBox.setIcon(QMessageBox::NoIcon);
+    m_isModalDialogActive = true;
+    msgBox.exec();
+    m_isModalDialogActive = false;
+}
+
+namespace {
+
+// Names from the top level down to item; the model is rebuilt on unlock, so
+// items are remembered by name rather than by pointer or row
+QStringList itemNamePath(const QStandardItem *item)
+{
+    QStringList path;
+    for (; item; item = item->parent()) {
+        path.prepend(item->text());
+    }
+    return path;
+}
+
+QStandardItem *itemForNamePath(QStandardItem *root, const QStringList &path)
+{
+    QStandardItem *item = root;
+    for (const QString &name : path) {
+        QStandardItem *next = nullptr;
+        for (int i = 0; i < item->rowCount() && !next; ++i) {
+            if (item->child(i)->text() == name) {
+                next = item->child(i);
+            }
+        }
+        if (!next) {
+            return nullptr;
+        }
+        item = next;
+    }
+    return item == root ? nullptr : item;
+}
+
+} // namespace
+
+QByteArray MainWindow::saveSessionState()
+{
+    // Paths start with the vault root's label; a vault's label is its file name
+    QList<QStringList> expandedPaths;
+    std::function<void(QStandardItem *)> collectExpanded = [&](QStandardItem *item) {
+        for (int i = 0; i < item->rowCount(); ++i) {
+            QStandardItem *child = item->child(i);
+            if (child->hasChildren() && m_treeView->isExpanded(viewIndex(child->index()))) {
+                expandedPaths.append(itemNamePath(child));
+                collectExpanded(child);
+            }
+        }
+    };
+    collectExpanded(m_treeModel->invisibleRootItem());
+    const QStringList selectedPath = itemNamePath(m_treeModel->itemFromIndex(currentSourceIndex()));
+
+    QByteArray session;
+    session.reserve(64 * 1024);
+    QDataStream out(&session, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << quint32(m_vaults.size());
+    for (const auto &vault : m_vaults) {
+        QByteArray document = serializeModelToByteArray(vault->root);
+        QByteArray passwordUtf8 = vault->masterPassword.toUtf8();
+        // Grow ahead of the write so no reallocated copy of a document is left behind
+        session.reserve(session.size() + document.size() + passwordUtf8.size() + 1024);
+        out << vault->filePath << passwordUtf8 << document << vault->fileContent << vault->unsavedChanges;
+        sodium_memzero(document.data(), size_t(document.size()));
+        sodium_memzero(passwordUtf8.data(), size_t(passwordUtf8.size()));
+    }
+    out << expandedPaths << selectedPath;
+    return session;
+}
+
+void MainWindow::restoreSessionState(QByteArray *session)
+{
+    QDataStream in(*session);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 vaultCount = 0;
+    in >> vaultCount;
+    for (quint32 i = 0; i < vaultCount && in.status() == QDataStream::Ok; ++i) {
+        QString filePath;
+        QByteArray passwordUtf8;
+        QByteArray document;
+        QByteArray fileContent;
+        bool unsavedChanges = false;
+        in >> filePath >> passwordUtf8 >> document >> fileContent >> unsavedChanges;
+        Vault *vault = mountVault(filePath, QString::fromUtf8(passwordUtf8));
+        sodium_memzero(passwordUtf8.data(), size_t(passwordUtf8.size()));
+        loadModelFromDocument(vault, &document);
+        if (!fileContent.isEmpty()) {
+            rememberFileContent(vault, fileContent); // Also notices a file replaced while locked
+        }
+        vault->unsavedChanges = unsavedChanges; // Loading the document marked it changed
+    }
+    QList<QStringList> expandedPaths;
+    QStringList selectedPath;
+    in >> expandedPaths >> selectedPath;
+    sodium_memzero(session->data(), size_t(session->size()));
+
+    QStandardItem *root = m_treeModel->invisibleRootItem();
+    for (const auto &vault : m_vaults) {
+        m_treeView->expand(viewIndex(vault->root->index()));
+    }
+    for (const QStringList &path : expandedPaths) {
+        if (QStandardItem *item = itemForNamePath(root, path)) {
+            m_treeView->expand(viewIndex(item->index()));
+        }
+    }
+    if (QStandardItem *item = itemForNamePath(root, selectedPath)) {
+        setCurrentSourceIndex(item->index());
+        m_treeView->scrollTo(viewIndex(item->index()));
+    }
+}
+
+void MainWindow::lockVault()
+{
+    if (m_vaultLocked) {
+        return;
+    }
+    if (m_isModalDialogActive || m_isEditingTreeItem) {
+        m_idleTimer->start(); // Try again after another idle period
+        return;
+    }
+    if (m_vaults.empty()) {
+        return; // Nothing open
+    }
+
+    // The master password of the first saved vault also wraps the session at
+    // full strength, so a used-up quick unlock can still restore it. Without a
+    // PIN it doubles as the quick-unlock secret.
+    const Vault *recoveryVault = nullptr;
+    for (const auto &vault : m_vaults) {
+        if (!vault->masterPassword.isEmpty()) {
+            recoveryVault = vault.get();
+            m_quickUnlockVaultLabel = vaultLabel(recoveryVault);
+            break;
+        }
+    }
+    if (!m_quickUnlockUsesPin) {
+        m_quickUnlock.clear();
+        if (recoveryVault) {
+            QByteArray passwordUtf8 = recoveryVault->masterPassword.toUtf8();
+            m_quickUnlock.setSecret(passwordUtf8);
+            sodium_memzero(passwordUtf8.data(), size_t(passwordUtf8.size()));
+        }
+    }
+    if (m_currentMode == Mode::INSERT) {
+        saveRecord(); // Into the model, where the checks below protect it like any other change
+        if (m_currentMode == Mode::INSERT) {
+            m_idleTimer->start(); // The panel can't be saved as it stands; try again later
+            return;
+        }
+    }
+
+    QStringList filePaths;
+    bool unsaved = false;
+    for (const auto &vault : m_vaults) {
+        if (vault->filePath.isEmpty() || vault->unsavedChanges) {
+            unsaved = true;
+        }
+        if (!vault->filePath.isEmpty()) {
+            filePaths.append(vault->filePath);
+        }
+    }
+    if (!m_quickUnlock.hasSecret() && unsaved) {
+        // Neither a session we could restore nor files holding every change
+        statusBar()->showMessage(tr("Not locked: save every database or set a quick-unlock PIN (Shift+P) first."), 5000);
+        m_idleTimer->start();
+        return;
+    }
+    if (!recoveryVault && unsaved) {
+        // Five wrong PINs would leave nothing to open the session with
+        statusBar()->showMessage(tr("Not locked: save every database first."), 5000);
+        m_idleTimer->start();
+        return;
+    }
+
+    if (m_currentMode == Mode::VISUAL) {
+        exitVisualMode();
+    }
+    clearTreeFilter();
+    m_searchBar->hide();
+    m_searchBar->clear();
+
+    bool resident = false;
+    if (m_quickUnlock.hasSecret()) {
+        QByteArray session = saveSessionState();
+        QByteArray recoveryUtf8 = recoveryVault ? recoveryVault->masterPassword.toUtf8() : QByteArray();
+        resident = m_quickUnlock.lock(session, recoveryUtf8);
+        sodium_memzero(recoveryUtf8.data(), size_t(recoveryUtf8.size()));
+        sodium_memzero(session.data(), size_t(session.size()));
+    }
+    if (!resident && unsaved) {
+        // Reopening the files would lose the changes that are only in memory
+        statusBar()->showMessage(tr("Not locked: the session could not be kept. Save every database first."), 5000);
+        m_idleTimer->start();
+        return;
+    }
+
+    m_lockedVaultPaths = filePaths;
+    unmountAllVaults();
+    m_attachmentTempDir.reset(); // Deletes the decrypted copies of opened attachments
+    m_recordDisplay->setText(resident ? "Vaults locked. Press Enter to unlock."
+                                      : "Vaults locked. Press Enter and give the master passwords to reopen them.");
+    m_vaultLocked = true;
+    m_idleTimer->stop();
+    updateStatusLabel();
+    statusBar()->showMessage(tr("Vaults locked."), 3000);
+}
+
+void MainWindow::unlockVault()
+{
+    if (!m_vaultLocked) {
+        return;
+    }
+
+    if (!m_quickUnlock.isLocked()) {
+        // Nothing resident (or the quick unlock was used up): the full unlock from the files
+        if (openVaults(m_lockedVaultPaths) > 0) {
+            m_lockedVaultPaths.clear();
+            m_vaultLocked = false;
+            updateStatusLabel();
+            loadIdleLockSettings();
+        }
+        return;
+    }
+
+    // Once the quick unlock is used up, the master password opens the session at full KDF strength
+    const bool recovering = m_quickUnlock.isExhausted();
+    bool ok;
+    m_isModalDialogActive = true;
+    QString secret = QInputDialog::getText(this, tr("Unlock"),
+                                           m_quickUnlockUsesPin && !recovering
+                                               ? tr("Enter quick-unlock PIN:")
+                                               : tr("Enter master password of %1:").arg(m_quickUnlockVaultLabel),
+                                           QLineEdit::Password, QString(), &ok);
+    m_isModalDialogActive = false;
+    if (!ok || secret.isEmpty()) {
+        return;
+    }
+
+    QByteArray secretUtf8 = secret.toUtf8();
+    secret.clear();
+    QByteArray session;
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    const QuickUnlock::Result result = recovering ? m_quickUnlock.recover(secretUtf8, &session)
+                                                  : m_quickUnlock.unlock(secretUtf8, &session);
+    QApplication::restoreOverrideCursor();
+    sodium_memzero(secretUtf8.data(), size_t(secretUtf8.size()));
+
+    switch (result) {
+    case QuickUnlock::Result::Unlocked:
+        if (recovering) {
+            m_quickUnlockUsesPin = false; // The PIN is gone with its wrap; set it again with Shift+P
+        }
+        m_lockedVaultPaths.clear();
+        m_vaultLocked = false;
+        restoreSessionState(&session);
+        updateStatusLabel();
+        loadIdleLockSettings();
+        statusBar()->showMessage(tr("Vaults unlocked."), 3000);
+        break;
+    case QuickUnlock::Result::WrongSecret:
+        statusBar()->showMessage(recovering ? tr("Wrong master password.")
+                                            : tr("Wrong secret. %1 attempts left.").arg(m_quickUnlock.attemptsLeft()),
+                                 5000);
+        break;
+    case QuickUnlock::Result::RetryLater:
+        statusBar()->showMessage(tr("Too many attempts. Try again in %1 s.").arg((m_quickUnlock.retryDelayMs() + 999) / 1000), 5000);
+        break;
+    case QuickUnlock::Result::Exhausted:
+        m_quickUnlockUsesPin = false;
+        if (m_quickUnlock.canRecover()) {
+            // Still resident: unsaved changes come back with the master password
+            m_recordDisplay->setText(QString("Vaults locked. Press Enter and give the master password of %1 to unlock.")
+                                         .arg(m_quickUnlockVaultLabel));
+            statusBar()->showMessage(tr("Quick unlock disabled after too many failed attempts; unlock with the master password of %1.")
+                                         .arg(m_quickUnlockVaultLabel), 8000);
+        } else {
+            // Only locked without a recovery wrap when every change was saved
+            m_recordDisplay->setText("Vaults locked. Press Enter and give the master passwords to reopen them.");
+            statusBar()->showMessage(tr("Quick unlock disabled after too many failed attempts."), 8000);
+        }
+        break;
+    }
+}
+
+void MainWindow::setQuickUnlockPin()
+{
+    bool ok;
+    m_isModalDialogActive = true;
+    QString pin = QInputDialog::getText(this, tr("Quick-Unlock PIN"),
+                                        tr("PIN for unlocking after an idle lock (empty: use the master password):"),
+                                        QLineEdit::Password, QString(), &ok);
+    m_isModalDialogActive = false;
+    if (!ok) {
+        return;
+    }
+
+    if (pin.isEmpty()) {
+        m_quickUnlock.clear();
+        m_quickUnlockUsesPin = false;
+        statusBar()->showMessage(tr("Quick unlock uses the master password."), 3000);
+        return;
+    }
+    if (pin.size() < 4) {
+        statusBar()->showMessage(tr("The PIN needs at least 4 characters."), 5000);
+        return;
+    }
+
+    QByteArray pinUtf8 = pin.toUtf8();
+    pin.clear();
+    m_quickUnlockUsesPin = m_quickUnlock.setSecret(pinUtf8);
+    sodium_memzero(pinUtf8.data(), size_t(pinUtf8.size()));
+    statusBar()->showMessage(m_quickUnlockUsesPin ? tr("Quick-unlock PIN set for this session.")
+                                                  : tr("Could not set the quick-unlock PIN."), 3000);
+}
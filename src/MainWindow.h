@@ -10,7 +10,28 @@
 #include <QStandardItemModel> // For the tree view data
 #include <QStackedWidget> // New: For managing stacked widgets
 #include <QCompleter>
+#include <QTableWidget> // Custom field editor
 #include <QStringList> // Required for recent files list
+#include <QTimer> // Idle lock timer
+#include <QSet> // VISUAL mode selection
+#include <QHash> // Search entries by item
+#include <QTemporaryDir> // Decrypted copies of opened attachments
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "RecordSchema.h" // Field table driving the record views
+#include "CustomField.h"
+#include "StringArena.h" // Interned storage for names, usernames and URLs
+#include "QuickUnlock.h" // Resident locked session for idle lock
+#include "FuzzyMatcher.h" // Ranked search and the yank boost
+#include "SearchQuery.h" // Search buffer column layout
+#include "TreeFilterModel.h" // In-place tree filter
+#include "HostIndex.h" // Entries by URL host
+#include "VaultHistory.h" // Undo and redo
+#include "VaultSync.h" // Three-way merge with a shared copy
+#include "BackupStore.h" // Deduplicating backups
+#include "VaultWatcher.h" // Vault files changed by other programs
 
 #include "OpenDbDialog.h" // The new dialog for opening files
 
@@ -23,7 +44,7 @@ public:
         TREE,
         NORMAL,
         INSERT,
-        VISUAL // Visual mode not explicitly requested but useful for future selection
+        VISUAL // Range and multi-selection for batched delete and moves
     };
 
     MainWindow(QWidget *parent = nullptr);
@@ -35,33 +56,121 @@ protected:
 private slots: // New slot section
     void onTreeSelectionChanged(const QModelIndex &current, const QModelIndex &previous);
     void saveRecord(); // New: Slot to save the edited record
-    void newDatabase(); // New: Slot to clear the current database and start a new one
+    void newDatabase(); // New: Slot to mount a new, empty database next to the open ones
     void saveDatabase(); // New: Slot to save the current database
     void saveDatabaseAs(); // New: Slot to save the current database to a new file
     void openDatabase(); // New: Slot to open a database
+    void importFile(); // Import another password manager's export into the current vault
+    void exportItems(); // Export the selected subtree as CSV or JSON
+    void syncVault(); // Merge the current vault with its copy in a shared folder
+    void backupVault(); // Add a backup of the current vault to its backup store
+    void auditPasswords(); // Report reused, weak and stale passwords of the current vault
+    void manageAttachments(); // Add, open, export and remove the files attached to the current entry
+    void showRevisions(); // Earlier versions of the current entry, to restore or copy from
+    void onVaultFileChanged(const QString &filePath); // Decrypt the new file in the background
+    void applyExternalChanges(); // Merge what was read, unless an edit or dialog is open
     void createFolder(); // New: Slot to create a new folder
     void createRecord(); // New: Slot to create a new password record
     void onEditingFinished(); // New: Slot to handle when tree view item editing is finished
     void showSearchBar(); // New: Slot to show and focus the search bar
+    void showFilterBar(); // Show the search bar as a live filter on the tree
     void performSearch(const QString &text); // New: Slot to perform the search
     void jumpToSearchResult(const QModelIndex &index); // New: Slot to jump to a search result
     void onSearchBarReturnPressed(); // New: Slot to handle return key press in search bar
+    void matchClipboardUrl(); // Select the entries for the host of the URL on the clipboard
+    void undoLastChange(); // Undo the last change to the current vault
+    void redoLastChange(); // Redo the change undone last in the current vault
     void copyPasswordToClipboard(); // New: Slot to copy selected password to clipboard
     void showHelpDialog(); // New: Slot to show the help dialog
+    void showMemoryStats(); // Show the memory accounting counters of the open vault
+    void lockVault(); // Wipe the decrypted vault, keeping a quick-unlock session if possible
+    void unlockVault(); // Quick unlock, or the full file unlock if no session is kept
+    void setQuickUnlockPin(); // Choose the secret asked for by the quick unlock
+    void closeCurrentVault(); // Unmount the vault holding the current item
+    void reopenLastSession(); // Mount the vaults that were open last time, unlocking them in parallel
 
 private:
+    struct ExternalChange; // A vault file replaced on disk, decrypted for merging
+
+    // One mounted vault. Each is a top-level item of m_treeModel; its children
+    // are the vault's own top-level items.
+    struct Vault {
+        QString filePath;       // Empty until first saved
+        QString masterPassword; // Empty if opened through the agent and not saved since
+        StringPool strings;     // Shared strings of this vault; released when it is unmounted
+        QStandardItem *root = nullptr;
+        ArcaneLock::SearchBuffer searchText{SearchColumns::kCount}; // Kept in step with each change; rebuilt to compact
+        std::vector<QStandardItem*> searchItems; // Item of each searchText entry; null once removed
+        QHash<const QStandardItem*, std::uint32_t> searchEntries; // Live searchText entry of each entry item
+        HostIndex hosts; // Entries by url host, numbered like searchItems and updated with them
+        VaultHistory history; // Undo steps of this vault's items
+        std::unique_ptr<VaultSync::Tree> syncBase; // The shared copy as of the last sync; null until needed
+        QByteArray syncDigest; // VaultSync::digest of the file syncBase was read from
+        VaultSync::HashCache syncHashes; // Of root's items, so a sync or reload hashes only what changed
+        std::unique_ptr<BackupStore> backupStore; // Opened on the first backup, keeping its keys
+        QByteArray fileContent; // Sealed bytes of filePath as last read or written here; empty if unknown
+        std::shared_ptr<ExternalChange> externalChange; // Being read, or read and waiting to be merged
+        bool externalChangeAgain = false; // The file changed again while it was being read
+        bool searchTextStale = true; // Until first built, and once removed entries pile up
+        bool unsavedChanges = false; // Items changed since filePath was last read or written
+    };
+
     void setMode(Mode newMode);
     void updateStatusLabel(); // Helper to update the status bar text
     void setupEditableRecordView(); // New: Setup the editable fields in the right panel
+    QString fieldEditorText(RecordField field) const; // Text of the INSERT-mode editor for a field
+    void setFieldEditorText(RecordField field, const QString &text);
+    void loadCustomFieldEditor(const CustomFieldList &fields); // Fill the custom field table
+    bool readCustomFieldEditor(CustomFieldList *fields); // Collect the table rows; false if a key is invalid
+    void addCustomFieldRow(const CustomField *field = nullptr); // Append a row, optionally pre-filled
+    void removeCustomFieldRow(); // Remove the row holding the current cell
     void enterInsertMode(const QModelIndex &index); // New: Enter insert mode for a specific record
     void exitInsertMode(); // New: Exit insert mode
-    void saveModelToFile(const QString &filePath, const QString &masterPassword); // New: Helper to save the tree model to a file
-    bool loadModelFromFile(const QString &filePath, const QString &masterPassword); // New: Helper to load the tree model from a file
+    void saveModelToFile(Vault *vault); // New: Helper to save a vault to its file
+    Vault *mountVault(const QString &filePath, const QString &masterPassword, std::unique_ptr<Vault> vault = nullptr); // Add a vault root at the end of the tree, adopting vault if given
+    void loadModelFromDocument(Vault *vault, QByteArray *decryptedPlaintext); // Fill a vault from decrypted V1 text, then wipe it
+    void unmountVault(Vault *vault);
+    void unmountAllVaults();
+    Vault *vaultForItem(const QStandardItem *item) const; // Vault an item belongs to
+    Vault *currentVault(); // Vault of the current item, else the first one; nullptr if none is mounted
+    QString vaultLabel(const Vault *vault) const; // Text of the vault's root item
+    void showMountedVaults(const Vault *focus); // Expand the vault roots and select into focus
+    int openVaults(const QStringList &filePaths, bool isStartup = false); // Unlock in parallel; returns the number mounted
+    void saveSessionVaults(); // Remember the mounted files for reopenLastSession()
+    bool confirmMasterPassword(Vault *vault); // Ask for and verify the vault file's master password
+    QString syncDirectory(const Vault *vault) const; // Shared folder the vault syncs through; empty if none
+    void syncWithSharedCopy(Vault *vault, const QString &directory); // Merge, then save to both places
+    void backUpPlaintext(Vault *vault, const QByteArray &plaintext); // Into the vault's backup store, if it has one
+    void rememberFileContent(Vault *vault, const QByteArray &fileContent); // filePath holds fileContent now
+    static void readExternalChange(ExternalChange *change, const QString &filePath, const QByteArray &passwordUtf8);
+    bool applyExternalChange(Vault *vault); // Merge vault->externalChange into the items; false if it can't be
+    bool mergeExternalChangeBeforeSave(Vault *vault); // Read and merge a change not seen yet; false if unreadable
+    QByteArray saveSessionState(); // Serialized vaults plus tree expansion and selection, for lockVault()
+    void restoreSessionState(QByteArray *session); // Inverse of saveSessionState(); wipes session
+    void loadIdleLockSettings(); // Read the idle timeout and (re)start the idle timer
     void loadRecentFiles(); // New: Load the list of recent files
     void saveRecentFiles(); // New: Save the list of recent files
+    void loadFrecency(); // Yank history from the settings file
+    void saveFrecency();
     void addRecentFile(const QString &filePath); // New: Add a file to the recent files list
-    void loadFile(const QString &filePath, bool isStartup = false); // New: Load a specific file, with optional startup flag
-    QByteArray serializeModelToByteArray(); // New: Helper to serialize the model into a QByteArray
+    bool loadFile(const QString &filePath, bool isStartup = false); // New: Load a specific file, with optional startup flag; true on success
+    QByteArray serializeModelToByteArray(QStandardItem *vaultRoot); // New: Helper to serialize one vault into a QByteArray
+    void applyTreeFilter(const QString &text); // Filter-mode counterpart of performSearch()
+    void clearTreeFilter(); // Show every row again and restore the expansion from before filtering
+    // m_treeView shows m_treeFilter; item code works on m_treeModel indexes
+    QModelIndex currentSourceIndex() const;
+    void setCurrentSourceIndex(const QModelIndex &sourceIndex);
+    QModelIndex viewIndex(const QModelIndex &sourceIndex) const;
+    void markVaultChanged(const QModelIndex &index); // The vault holding index changed
+    void forgetSyncHashes(const QModelIndex &parent, int first, int last); // Rows going in or out of a vault
+    void appendSearchResult(QStandardItem *item, bool nameVault); // One completer row pointing at item
+    void rebuildSearchText(Vault *vault); // Refill the vault's search buffer and host index, compacting them
+    // Keep the search buffer in step with the rows a change touched
+    void indexSearchRows(const QModelIndex &parent, int first, int last); // Inserted rows and their subtrees
+    void unindexSearchRows(const QModelIndex &parent, int first, int last); // Rows about to be removed
+    void reindexSearchRows(const QModelIndex &topLeft, const QModelIndex &bottomRight); // Edited rows
+    void appendSearchEntry(Vault *vault, QStandardItem *item); // No-op unless item is an entry not yet indexed
+    void removeSearchEntry(Vault *vault, const QStandardItem *item); // No-op unless item is indexed
 
     // Tree item manipulation methods
     void moveItemToParentOrRoot();
@@ -69,6 +178,18 @@ private:
     void moveItemUp();
     void moveItemIntoSiblingFolder();
     void deleteSelectedItem(); // New: Delete the currently selected tree item
+    // VISUAL mode: the selection is m_visualBase plus the visible rows from
+    // m_visualAnchor to the cursor. Each batch is one undo step.
+    void enterVisualMode();
+    void exitVisualMode();
+    void startVisualRange(); // Keep what is selected and start a new range at the cursor
+    void toggleVisualItem(); // Add or remove the cursor's item, ending the range
+    void updateVisualSelection();
+    QList<QStandardItem*> visualSelectedItems(Vault **vault); // Outermost selected items in tree order
+    void takeItemRows(const QList<QStandardItem*> &items); // Detach items (tree order), one removeRows per run
+    void deleteVisualSelection();
+    void moveVisualSelection(int delta); // -1 up, +1 down within each folder
+    void moveVisualSelectionToFolder();
     void expandAllNodes();   // New: Expand all tree view nodes
     void collapseAllNodes(); // New: Collapse all tree view nodes
 
@@ -77,25 +198,38 @@ private:
     QStackedWidget *m_rightPanelStackedWidget; // Manages read-only and editable views
     QTextBrowser *m_recordDisplay; // Read-only display of password record (now a child of m_rightPanelStackedWidget)
     QWidget *m_editableRecordView; // Container for editable fields (now a child of m_rightPanelStackedWidget)
-    QLineEdit *m_nameEdit;
-    QLineEdit *m_usernameEdit;
-    QLineEdit *m_passwordEdit;
-    QLineEdit *m_urlEdit;
-    QTextEdit *m_notesEdit;
+    std::array<QWidget*, kRecordFieldCount> m_fieldEditors{}; // QLineEdit or QTextEdit per field, indexed by RecordField
+    QTableWidget *m_customFieldsTable; // Key / type / value rows for custom fields
     QLabel *m_statusLabel; // For mode or status display, similar to the reference
     QLineEdit *m_searchBar; // New: Search bar
     QCompleter *m_searchCompleter; // New: Search completer
     QStandardItemModel *m_searchCompleterModel; // New: Model for search completer
 
     QStandardItemModel *m_treeModel; // Model for the tree view
+    TreeFilterModel *m_treeFilter; // Between m_treeModel and the view; hides rows in filter mode
+    bool m_filterMode = false; // The search bar filters the tree instead of offering results
+    QList<QPersistentModelIndex> m_expandedBeforeFilter; // Source indexes expanded when filtering began
+    QSet<QPersistentModelIndex> m_visualSelection; // Source indexes selected in VISUAL mode
+    QSet<QPersistentModelIndex> m_visualBase;      // Selected before the current range started
+    QPersistentModelIndex m_visualAnchor;          // Start of the current range; invalid if none
     Mode m_currentMode; // Current operational mode of the application
     QStandardItem *m_currentEditedItem; // Pointer to the item currently being edited
     QList<int> m_splitterSizes; // Stores the splitter sizes to restore them
-    QString m_currentFilePath; // Stores the path of the current database file
     bool m_isModalDialogActive = false; // Is a modal dialog like 'Save As' currently active?
     bool m_isEditingTreeItem = false; // Is an item in the tree view being edited?
     QStringList m_recentFiles; // Stores the list of recently opened files
-    QString m_masterPassword; // Stores the master password
+    std::vector<std::unique_ptr<Vault>> m_vaults; // Mounted vaults in tree order of mounting
+    QStringList m_lockedVaultPaths; // Files to reopen when locked without a resident session
+    QTimer *m_idleTimer = nullptr; // Fires lockVault() after the configured idle time
+    QuickUnlock m_quickUnlock; // Wrapped session while locked, wrapping key while unlocked
+    bool m_vaultLocked = false; // Model wiped; only unlock, help and quit are accepted
+    bool m_quickUnlockUsesPin = false; // Secret is a PIN from Shift+P rather than a master password
+    QString m_quickUnlockVaultLabel; // Vault whose master password is the secret when no PIN is set
+    Frecency m_frecency; // Yank history boosting search results, by ItemId; kept in the settings file
+    VaultWatcher *m_vaultWatcher; // Reports mounted files replaced by someone else
+    QTimer *m_externalChangeTimer; // Retries merging external changes held back by an edit
+    std::unique_ptr<QTemporaryDir> m_attachmentTempDir; // Decrypted copies of opened attachments; reset on lock
+    int m_attachmentsOpened = 0; // Numbers a subdirectory per opened attachment, so names never collide
 };
 
 #endif // MAINWINDOW_H
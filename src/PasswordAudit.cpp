@@ -0,0 +1,295 @@
+#include "PasswordAudit.h"
+#include "PasswordRecord.h"
+#include "BreachIndex.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QStringList>
+#include <QtConcurrent/QtConcurrentMap> // Scoring slices of the vault in parallel
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <sodium.h> // Required for crypto_generichash
+
+namespace {
+
+using Fingerprint = std::array<unsigned char, 16>;
+
+struct FingerprintHash {
+    std::size_t operator()(const Fingerprint &fingerprint) const
+    {
+        std::size_t hash; // Already uniformly distributed
+        std::memcpy(&hash, fingerprint.data(), sizeof hash);
+        return hash;
+    }
+};
+
+// Entries per task: enough to amortize the scheduling, small enough to balance
+constexpr std::size_t kSliceSize = 1024;
+
+// Guessers try words like these first. The list is a sample, so a hit is priced
+// as a pick from a much larger dictionary. Longest first, so "password" wins over "pass".
+const char *const kCommonWords[] = {
+    "chocolate", "whatever", "starwars", "sunshine", "iloveyou", "football", "baseball", "superman", "password",
+    "princess", "changeme", "computer", "internet", "trustno", "letmein", "welcome", "freedom", "michael", "charlie",
+    "default", "pokemon", "monkey", "dragon", "master", "shadow", "batman", "secret", "summer", "winter", "spring",
+    "autumn", "qwerty", "jordan", "soccer", "hockey", "killer", "cheese", "flower", "tigger", "purple", "orange",
+    "banana", "family", "admin", "login", "hello", "money", "lucky", "guest", "love", "pass", "test", "user", "root",
+};
+constexpr double kWordBits = 11;    // One of ~2000 common words
+constexpr double kVariantBits = 1;  // Capitals or substitutions inside the word
+constexpr double kYearBits = 7;     // 19xx or 20xx
+constexpr double kPredictableBits = 1; // A repeat, a run or a keyboard neighbour
+
+const char *const kKeyboardRows[] = { "1234567890", "qwertyuiop", "asdfghjkl", "zxcvbnm" };
+
+char16_t lower(char16_t c)
+{
+    return c >= u'A' && c <= u'Z' ? char16_t(c + 32) : c;
+}
+
+// Whether b is what a guesser tries right after a
+bool predictable(char16_t a, char16_t b)
+{
+    a = lower(a);
+    b = lower(b);
+    if (a == b) {
+        return true;
+    }
+    const bool alphanumeric = ((a >= u'a' && a <= u'z') && (b >= u'a' && b <= u'z'))
+                              || ((a >= u'0' && a <= u'9') && (b >= u'0' && b <= u'9'));
+    if (alphanumeric && (b == a + 1 || a == b + 1)) {
+        return true;
+    }
+    if (a == 0 || a >= 128 || b >= 128) {
+        return false;
+    }
+    for (const char *row : kKeyboardRows) {
+        const char *at = std::strchr(row, char(a));
+        if (at && ((at[1] != '\0' && at[1] == char(b)) || (at > row && at[-1] == char(b)))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The password in lowercase ASCII with the usual substitutions undone; '1'
+// stands for 'i' or 'l', so there are two spellings
+void normalize(QStringView password, std::string *asI, std::string *asL)
+{
+    asI->assign(std::size_t(password.size()), '\0');
+    asL->assign(std::size_t(password.size()), '\0');
+    for (qsizetype i = 0; i < password.size(); ++i) {
+        char16_t c = lower(password[i].unicode());
+        char plain = c < 128 ? char(c) : '\0';
+        switch (plain) {
+        case '0': plain = 'o'; break;
+        case '3': plain = 'e'; break;
+        case '4': case '@': plain = 'a'; break;
+        case '5': case '$': plain = 's'; break;
+        case '7': case '+': plain = 't'; break;
+        case '!': plain = 'i'; break;
+        default: break;
+        }
+        (*asI)[std::size_t(i)] = plain == '1' ? 'i' : plain;
+        (*asL)[std::size_t(i)] = plain == '1' ? 'l' : plain;
+    }
+}
+
+QString tr(const char *text)
+{
+    return QCoreApplication::translate("PasswordAudit", text);
+}
+
+} // namespace
+
+namespace PasswordAudit {
+
+double estimateBits(QStringView password)
+{
+    const std::size_t length = std::size_t(password.size());
+    if (length == 0) {
+        return 0;
+    }
+
+    // Alphabet a guesser has to cover for a character with no pattern
+    bool lowerCase = false, upperCase = false, digit = false, symbol = false, other = false;
+    for (QChar c : password) {
+        const char16_t u = c.unicode();
+        if (u >= u'a' && u <= u'z') lowerCase = true;
+        else if (u >= u'A' && u <= u'Z') upperCase = true;
+        else if (u >= u'0' && u <= u'9') digit = true;
+        else if (u < 128) symbol = true;
+        else other = true;
+    }
+    const int alphabet = (lowerCase ? 26 : 0) + (upperCase ? 26 : 0) + (digit ? 10 : 0) + (symbol ? 33 : 0)
+                         + (other ? 100 : 0);
+    const double characterBits = std::log2(double(alphabet));
+
+    std::vector<char> covered(length, 0); // Priced as part of a pattern
+    double bits = 0;
+    const auto cover = [&](std::size_t at, std::size_t count) {
+        for (std::size_t i = at; i < at + count; ++i) {
+            if (covered[i]) return false;
+        }
+        std::memset(covered.data() + at, 1, count);
+        return true;
+    };
+
+    std::string asI, asL;
+    normalize(password, &asI, &asL);
+    for (const char *word : kCommonWords) {
+        const std::size_t wordLength = std::strlen(word);
+        for (const std::string *spelling : {&asI, &asL}) {
+            for (std::size_t at = spelling->find(word); at != std::string::npos; at = spelling->find(word, at + 1)) {
+                if (!cover(at, wordLength)) {
+                    continue;
+                }
+                bool variant = false;
+                for (std::size_t i = at; i < at + wordLength; ++i) {
+                    variant = variant || password[qsizetype(i)].unicode() != char16_t(word[i - at]);
+                }
+                bits += kWordBits + (variant ? kVariantBits : 0);
+            }
+        }
+    }
+
+    for (std::size_t i = 0; i + 4 <= length; ++i) {
+        const QStringView four = password.sliced(qsizetype(i), 4);
+        bool digits = true;
+        for (QChar c : four) {
+            digits = digits && c.isDigit() && c.unicode() < 128;
+        }
+        if (digits && (four.startsWith(u"19") || four.startsWith(u"20")) && cover(i, 4)) {
+            bits += kYearBits;
+        }
+    }
+
+    for (std::size_t i = 0; i < length; ++i) {
+        if (covered[i]) {
+            continue;
+        }
+        const bool follows = i > 0 && !covered[i - 1]
+                             && predictable(password[qsizetype(i - 1)].unicode(), password[qsizetype(i)].unicode());
+        bits += follows ? kPredictableBits : characterBits;
+    }
+    return bits;
+}
+
+int strengthOf(double bits)
+{
+    if (bits < 28) return 0;
+    if (bits < 36) return 1;
+    if (bits < 60) return 2;
+    if (bits < 80) return 3;
+    return 4;
+}
+
+QString strengthName(int strength)
+{
+    static const char *const kNames[] = {
+        QT_TRANSLATE_NOOP("PasswordAudit", "very weak"),
+        QT_TRANSLATE_NOOP("PasswordAudit", "weak"),
+        QT_TRANSLATE_NOOP("PasswordAudit", "fair"),
+        QT_TRANSLATE_NOOP("PasswordAudit", "good"),
+        QT_TRANSLATE_NOOP("PasswordAudit", "strong"),
+    };
+    return tr(kNames[qBound(0, strength, 4)]);
+}
+
+QString describeIssues(unsigned issues)
+{
+    QStringList names;
+    if (issues & Reused) names.append(tr("reused"));
+    if (issues & Weak) names.append(tr("weak"));
+    if (issues & Stale) names.append(tr("stale"));
+    if (issues & Breached) names.append(tr("breached"));
+    return names.join(QLatin1String(", "));
+}
+
+std::vector<Finding> audit(const std::vector<const PasswordRecord *> &records, const Options &options)
+{
+    const std::size_t count = records.size();
+    std::vector<Finding> findings(count);
+    std::vector<Fingerprint> fingerprints(count);
+    std::vector<char> hasPassword(count, 0);
+    const qint64 now = options.now != 0 ? options.now : QDateTime::currentSecsSinceEpoch();
+
+    // Drawn per audit: fingerprints only compare passwords within this run
+    unsigned char key[crypto_generichash_KEYBYTES];
+    randombytes_buf(key, sizeof key);
+
+    std::vector<std::pair<std::size_t, std::size_t>> slices;
+    for (std::size_t begin = 0; begin < count; begin += kSliceSize) {
+        slices.emplace_back(begin, std::min(count, begin + kSliceSize));
+    }
+    // Each task writes only its own slice of the result vectors
+    QtConcurrent::blockingMap(slices, [&](const std::pair<std::size_t, std::size_t> &slice) {
+        for (std::size_t i = slice.first; i < slice.second; ++i) {
+            const PasswordRecord &record = *records[i];
+            const QStringView password = record.view(RecordField::Password);
+            if (password.isEmpty()) {
+                continue;
+            }
+            hasPassword[i] = 1;
+            crypto_generichash(fingerprints[i].data(), fingerprints[i].size(),
+                               reinterpret_cast<const unsigned char *>(password.utf16()),
+                               std::size_t(password.size()) * sizeof(QChar), key, sizeof key);
+            Finding &finding = findings[i];
+            finding.bits = estimateBits(password);
+            finding.strength = strengthOf(finding.bits);
+            if (finding.bits < options.weakBelowBits) {
+                finding.issues |= Weak;
+            }
+            if (record.passwordChanged > 0) {
+                finding.ageDays = int(qMax<qint64>(0, now - record.passwordChanged) / 86400);
+                if (finding.ageDays >= options.staleAfterDays) {
+                    finding.issues |= Stale;
+                }
+            }
+            if (options.breaches && options.breaches->contains(password)) {
+                finding.issues |= Breached;
+            }
+        }
+    });
+    sodium_memzero(key, sizeof key);
+
+    // Reuse: one pass over a hash table, then number only the groups of two or more
+    std::unordered_map<Fingerprint, int, FingerprintHash> groupOf;
+    groupOf.reserve(count);
+    std::vector<int> groupSize;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (!hasPassword[i]) {
+            continue;
+        }
+        const auto inserted = groupOf.try_emplace(fingerprints[i], int(groupSize.size()));
+        if (inserted.second) {
+            groupSize.push_back(0);
+        }
+        findings[i].reuseGroup = inserted.first->second;
+        ++groupSize[std::size_t(inserted.first->second)];
+    }
+    std::vector<int> reusedNumber(groupSize.size(), -1);
+    int reusedGroups = 0;
+    for (Finding &finding : findings) {
+        if (finding.reuseGroup < 0) {
+            continue;
+        }
+        const std::size_t group = std::size_t(finding.reuseGroup);
+        if (groupSize[group] < 2) {
+            finding.reuseGroup = -1;
+            continue;
+        }
+        if (reusedNumber[group] < 0) {
+            reusedNumber[group] = reusedGroups++;
+        }
+        finding.reuseGroup = reusedNumber[group];
+        finding.reuseCount = groupSize[group];
+        finding.issues |= Reused;
+    }
+    return findings;
+}
+
+} // namespace PasswordAudit
@@ -0,0 +1,57 @@
+#ifndef PASSWORDAUDIT_H
+#define PASSWORDAUDIT_H
+
+#include <QString>
+#include <QStringView>
+#include <vector>
+
+struct PasswordRecord;
+class BreachIndex;
+
+// Password health across a vault: reused, weak and stale passwords.
+//
+// Reuse is found by fingerprint: a BLAKE2b of each password keyed with a key
+// drawn for the audit, so equal passwords group in one hash table pass and the
+// fingerprints mean nothing once the audit is over. Strength is an entropy
+// estimate that charges little for what guessers try first: dictionary words
+// (also in leetspeak), years, repeats, runs like "abc" or "123" and keyboard
+// rows. Entries are scored on the global thread pool, which also looks each
+// password up in the breach index when one is given.
+namespace PasswordAudit {
+
+enum Issue : unsigned {
+    Reused = 1u << 0,
+    Weak   = 1u << 1,
+    Stale  = 1u << 2,
+    Breached = 1u << 3,
+};
+
+struct Options {
+    double weakBelowBits = 40;
+    int staleAfterDays = 365; // Since the password was last set; entries without a date are never stale
+    qint64 now = 0; // Seconds since the epoch; 0 for the current time
+    const BreachIndex *breaches = nullptr; // An open index, or nullptr to skip the check
+};
+
+struct Finding {
+    unsigned issues = 0;  // Issue flags
+    double bits = 0;      // Estimated entropy
+    int strength = 0;     // 0 (very weak) to 4 (strong)
+    int reuseGroup = -1;  // Entries with the same password share a group
+    int reuseCount = 0;   // Entries in that group
+    int ageDays = -1;     // -1 if the date is unknown
+};
+
+// One finding per record, in the same order. Records without a password get
+// an empty finding. The records must not change until this returns.
+std::vector<Finding> audit(const std::vector<const PasswordRecord *> &records, const Options &options = Options());
+
+double estimateBits(QStringView password);
+int strengthOf(double bits);
+QString strengthName(int strength);
+QString describeIssues(unsigned issues); // "reused, weak"
+constexpr unsigned kAllIssues = Reused | Weak | Stale | Breached;
+
+} // namespace PasswordAudit
+
+#endif // PASSWORDAUDIT_H
@@ -0,0 +1,65 @@
+#ifndef PASSWORDRECORD_H
+#define PASSWORDRECORD_H
+
+#include <QString>
+#include <QStringView>
+#include <QMetaType>
+#include <array>
+#include "RecordSchema.h"
+#include "Attachment.h"
+#include "CustomField.h"
+#include "SecureString.h"
+
+// Define a simple struct to hold password record data.
+// The fields are described by kRecordFields in RecordSchema.h; the ones flagged
+// FieldSensitive live in secure memory, the rest in ordinary QStrings.
+struct PasswordRecord {
+    std::array<QString, RecordSchema::kPlainFieldCount> plainValues;
+    std::array<SecureString, RecordSchema::kSensitiveFieldCount> sensitiveValues;
+    CustomFieldList customFields; // User-defined fields (TOTP seeds, API keys, ...)
+    AttachmentList attachments; // Files kept in the vault's AttachmentStore
+    SecureString revisions; // Earlier versions as encoded by EntryRevisions; decoded only when needed
+    qint64 passwordChanged = 0; // When the password was last set, in seconds since the epoch; 0 if unknown
+
+    static bool isSensitive(RecordField field) { return RecordSchema::hasFlag(std::size_t(field), FieldSensitive); }
+    static std::size_t slot(RecordField field) { return RecordSchema::storageSlot(std::size_t(field)); }
+
+    // Read-only access without copying secrets out of secure memory
+    QStringView view(RecordField field) const {
+        return isSensitive(field) ? sensitiveValues[slot(field)].view() : QStringView(plainValues[slot(field)]);
+    }
+    // Heap copy, for widgets and the clipboard
+    QString value(RecordField field) const {
+        return isSensitive(field) ? sensitiveValues[slot(field)].toQString() : plainValues[slot(field)];
+    }
+    void setValue(RecordField field, const QString &text) {
+        if (isSensitive(field)) {
+            sensitiveValues[slot(field)] = SecureString::fromString(text);
+        } else {
+            plainValues[slot(field)] = text;
+        }
+    }
+    void setSensitiveValue(RecordField field, const SecureString &text) { sensitiveValues[slot(field)] = text; }
+
+    bool isEmpty() const {
+        for (const QString &fieldValue : plainValues) {
+            if (!fieldValue.isEmpty()) return false;
+        }
+        for (const SecureString &fieldValue : sensitiveValues) {
+            if (!fieldValue.isEmpty()) return false;
+        }
+        return customFields.empty() && attachments.empty() && revisions.isEmpty();
+    }
+
+    const CustomField *customField(FieldKeyId key) const {
+        for (const CustomField &field : customFields) {
+            if (field.key == key) return &field;
+        }
+        return nullptr;
+    }
+};
+
+// Declare the struct as a metatype so it can be stored in QVariant
+Q_DECLARE_METATYPE(PasswordRecord)
+
+#endif // PASSWORDRECORD_H
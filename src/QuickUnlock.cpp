@@ -0,0 +1,228 @@
+#include "QuickUnlock.h"
+#include "VaultFile.h"
+#include "model/SecurePool.hpp"
+#include <sodium.h> // Required for libsodium cryptography
+
+namespace {
+
+constexpr int kKeyBytes = VaultFile::kKeyBytes;
+
+unsigned char *allocateKey()
+{
+    return static_cast<unsigned char *>(ArcaneLock::SecurePool::instance().allocate(kKeyBytes));
+}
+
+void freeKey(unsigned char *key)
+{
+    ArcaneLock::SecurePool::instance().deallocate(key, kKeyBytes); // Zeroed by the pool
+}
+
+bool seal(const QByteArray &plaintext, const unsigned char *key, QByteArray *nonce, QByteArray *ciphertext)
+{
+    nonce->resize(crypto_secretbox_NONCEBYTES);
+    randombytes_buf(nonce->data(), size_t(nonce->size()));
+    ciphertext->resize(plaintext.size() + crypto_secretbox_MACBYTES);
+    return crypto_secretbox_easy(reinterpret_cast<unsigned char*>(ciphertext->data()),
+                                 reinterpret_cast<const unsigned char*>(plaintext.constData()), plaintext.size(),
+                                 reinterpret_cast<const unsigned char*>(nonce->constData()), key) == 0;
+}
+
+bool open(const QByteArray &nonce, const QByteArray &ciphertext, const unsigned char *key, QByteArray *plaintext)
+{
+    plaintext->resize(ciphertext.size() - crypto_secretbox_MACBYTES);
+    return crypto_secretbox_open_easy(reinterpret_cast<unsigned char*>(plaintext->data()),
+                                      reinterpret_cast<const unsigned char*>(ciphertext.constData()), ciphertext.size(),
+                                      reinterpret_cast<const unsigned char*>(nonce.constData()), key) == 0;
+}
+
+void wipe(QByteArray *data)
+{
+    sodium_memzero(data->data(), size_t(data->size()));
+    data->clear();
+}
+
+// As strong as the vault file's own KDF: a master password opens the session
+// without an attempt limit, so guessing it must cost as much as guessing it
+// against the file
+bool deriveRecoveryKey(const QByteArray &secretUtf8, const QByteArray &salt, unsigned char *key)
+{
+    return crypto_pwhash(key, kKeyBytes, secretUtf8.constData(), secretUtf8.size(),
+                         reinterpret_cast<const unsigned char*>(salt.constData()),
+                         crypto_pwhash_OPSLIMIT_MODERATE,
+                         crypto_pwhash_MEMLIMIT_MODERATE,
+                         crypto_pwhash_ALG_ARGON2ID13) == 0;
+}
+
+} // namespace
+
+QuickUnlock::~QuickUnlock()
+{
+    clear();
+}
+
+bool QuickUnlock::deriveKey(const QByteArray &secretUtf8, unsigned char *key) const
+{
+    // The interactive limits: this runs on every unlock, the file's MODERATE KDF doesn't
+    return crypto_pwhash(key, kKeyBytes, secretUtf8.constData(), secretUtf8.size(),
+                         reinterpret_cast<const unsigned char*>(m_salt.constData()),
+                         crypto_pwhash_OPSLIMIT_INTERACTIVE,
+                         crypto_pwhash_MEMLIMIT_INTERACTIVE,
+                         crypto_pwhash_ALG_ARGON2ID13) == 0;
+}
+
+void QuickUnlock::releaseWrappingKey()
+{
+    if (m_wrappingKey) {
+        freeKey(m_wrappingKey);
+        m_wrappingKey = nullptr;
+    }
+}
+
+bool QuickUnlock::setSecret(const QByteArray &secretUtf8)
+{
+    if (sodium_init() < 0 || isLocked()) {
+        return false;
+    }
+    releaseWrappingKey();
+    m_salt.resize(crypto_pwhash_SALTBYTES);
+    randombytes_buf(m_salt.data(), size_t(m_salt.size()));
+    m_wrappingKey = allocateKey();
+    if (!deriveKey(secretUtf8, m_wrappingKey)) {
+        releaseWrappingKey();
+        return false;
+    }
+    return true;
+}
+
+bool QuickUnlock::lock(const QByteArray &session, const QByteArray &recoverySecretUtf8)
+{
+    if (!m_wrappingKey) {
+        return false;
+    }
+    unsigned char *sessionKey = allocateKey();
+    crypto_secretbox_keygen(sessionKey);
+
+    QByteArray keyMaterial(reinterpret_cast<const char*>(sessionKey), kKeyBytes);
+    bool sealed = seal(session, sessionKey, &m_sessionNonce, &m_sessionCiphertext)
+                  && seal(keyMaterial, m_wrappingKey, &m_wrapNonce, &m_wrappedKey);
+    m_recoverySalt.clear();
+    m_recoveryNonce.clear();
+    m_recoveryWrappedKey.clear();
+    if (sealed && !recoverySecretUtf8.isEmpty()) {
+        m_recoverySalt.resize(crypto_pwhash_SALTBYTES);
+        randombytes_buf(m_recoverySalt.data(), size_t(m_recoverySalt.size()));
+        unsigned char *recoveryKey = allocateKey();
+        sealed = deriveRecoveryKey(recoverySecretUtf8, m_recoverySalt, recoveryKey)
+                 && seal(keyMaterial, recoveryKey, &m_recoveryNonce, &m_recoveryWrappedKey);
+        freeKey(recoveryKey);
+    }
+    wipe(&keyMaterial);
+    freeKey(sessionKey);
+    releaseWrappingKey();
+    if (!sealed) {
+        clear();
+        return false;
+    }
+    m_failedAttempts = 0;
+    m_nextAttempt = QDeadlineTimer();
+    return true;
+}
+
+QuickUnlock::Result QuickUnlock::unlock(const QByteArray &secretUtf8, QByteArray *session)
+{
+    if (!isLocked() || isExhausted()) {
+        return Result::Exhausted;
+    }
+    if (!m_nextAttempt.hasExpired()) {
+        return Result::RetryLater;
+    }
+
+    unsigned char *key = allocateKey();
+    QByteArray keyMaterial;
+    const bool unwrapped = deriveKey(secretUtf8, key) && open(m_wrapNonce, m_wrappedKey, key, &keyMaterial);
+    if (!unwrapped) {
+        freeKey(key);
+        wipe(&keyMaterial);
+        if (++m_failedAttempts >= kMaxAttempts) {
+            // The PIN's copy goes; the session stays only if a master password can still open it
+            m_wrappedKey.clear();
+            m_wrapNonce.clear();
+            m_salt.clear();
+            if (!canRecover()) {
+                clear();
+            }
+            m_failedAttempts = 0;
+            m_nextAttempt = QDeadlineTimer();
+            return Result::Exhausted;
+        }
+        backOff();
+        return Result::WrongSecret;
+    }
+
+    if (!openSession(&keyMaterial, session)) {
+        freeKey(key);
+        return Result::Exhausted;
+    }
+    // Same salt and secret, so the key just derived serves the next lock as well
+    m_wrappingKey = key;
+    return Result::Unlocked;
+}
+
+QuickUnlock::Result QuickUnlock::recover(const QByteArray &recoverySecretUtf8, QByteArray *session)
+{
+    if (!isLocked() || !canRecover()) {
+        return Result::Exhausted;
+    }
+    if (!m_nextAttempt.hasExpired()) {
+        return Result::RetryLater;
+    }
+
+    unsigned char *key = allocateKey();
+    QByteArray keyMaterial;
+    const bool unwrapped = deriveRecoveryKey(recoverySecretUtf8, m_recoverySalt, key)
+                           && open(m_recoveryNonce, m_recoveryWrappedKey, key, &keyMaterial);
+    freeKey(key);
+    if (!unwrapped) {
+        wipe(&keyMaterial);
+        ++m_failedAttempts;
+        backOff();
+        return Result::WrongSecret;
+    }
+    // The quick-unlock secret is unknown here; the next lock needs a new one
+    return openSession(&keyMaterial, session) ? Result::Unlocked : Result::Exhausted;
+}
+
+// Decrypts the session with the unwrapped session key (then wiped) and drops
+// every wrapped copy of it; on failure the session is beyond repair
+bool QuickUnlock::openSession(QByteArray *keyMaterial, QByteArray *session)
+{
+    const bool opened = open(m_sessionNonce, m_sessionCiphertext,
+                             reinterpret_cast<const unsigned char*>(keyMaterial->constData()), session);
+    wipe(keyMaterial);
+    const QByteArray salt = m_salt; // Kept with the wrapping key for the next lock
+    clear();
+    if (opened) {
+        m_salt = salt;
+    }
+    return opened;
+}
+
+void QuickUnlock::backOff()
+{
+    m_nextAttempt.setRemainingTime(1000LL << qMin(m_failedAttempts - 1, 6)); // 1 s, 2 s, 4 s, ... 64 s
+}
+
+void QuickUnlock::clear()
+{
+    releaseWrappingKey();
+    m_salt.clear();
+    m_sessionNonce.clear();
+    m_sessionCiphertext.clear();
+    m_wrapNonce.clear();
+    m_wrappedKey.clear();
+    m_recoverySalt.clear();
+    m_recoveryNonce.clear();
+    m_recoveryWrappedKey.clear();
+    m_failedAttempts = 0;
+    m_nextAttempt = QDeadlineTimer();
+}
@@ -0,0 +1,82 @@
+#ifndef QUICKUNLOCK_H
+#define QUICKUNLOCK_H
+
+#include <QByteArray>
+#include <QDeadlineTimer>
+
+// Keeps a locked session resident so unlocking doesn't go back to the file.
+//
+// While the vaults are open, only a wrapping key derived from the quick-unlock
+// secret (a PIN, or a master password) with the light Argon2id parameters is
+// kept, in SecurePool memory. lock() encrypts the session (serialized vaults,
+// their master passwords and the tree state) under a fresh random key and
+// wraps that key under the wrapping key, which is then wiped. unlock() costs
+// one light KDF plus two secretbox opens. Failed attempts back off
+// exponentially, and after kMaxAttempts the wrapping key's copy is destroyed.
+//
+// lock() can also wrap the session key under a recovery key derived from a
+// master password with the file's own (MODERATE) Argon2id parameters. Once the
+// quick unlock is used up, recover() still opens the session with that master
+// password, so changes that were only in memory survive; without a recovery
+// key the session is destroyed too, leaving the full unlock from the file.
+class QuickUnlock
+{
+public:
+    enum class Result {
+        Unlocked,
+        WrongSecret,
+        RetryLater, // Still inside the back-off window of the last failure
+        Exhausted,  // Too many failures; only recover() can open the session, if canRecover()
+    };
+
+    static constexpr int kMaxAttempts = 5;
+
+    QuickUnlock() = default;
+    QuickUnlock(const QuickUnlock &) = delete;
+    QuickUnlock &operator=(const QuickUnlock &) = delete;
+    ~QuickUnlock();
+
+    // Derives and keeps the wrapping key for the next lock()
+    bool setSecret(const QByteArray &secretUtf8);
+    bool hasSecret() const { return m_wrappingKey != nullptr; }
+
+    // Encrypts session and wraps its key. Requires hasSecret(). A non-empty
+    // recoverySecretUtf8 (a master password) adds the recovery wrap; that KDF
+    // runs here, at the strength of a full unlock.
+    bool lock(const QByteArray &session, const QByteArray &recoverySecretUtf8);
+    bool isLocked() const { return !m_sessionCiphertext.isEmpty(); }
+    bool isExhausted() const { return isLocked() && m_wrappedKey.isEmpty(); }
+    bool canRecover() const { return !m_recoveryWrappedKey.isEmpty(); }
+
+    // On success the wrapping key is kept again for the next lock()
+    Result unlock(const QByteArray &secretUtf8, QByteArray *session);
+    // Opens the session with the recovery secret. Failures back off like
+    // unlock() but never use it up: the KDF costs as much as the file's.
+    Result recover(const QByteArray &recoverySecretUtf8, QByteArray *session);
+
+    int attemptsLeft() const { return kMaxAttempts - m_failedAttempts; }
+    qint64 retryDelayMs() const { return m_nextAttempt.remainingTime(); }
+
+    // Forgets the session and the wrapping key
+    void clear();
+
+private:
+    bool deriveKey(const QByteArray &secretUtf8, unsigned char *key) const;
+    void releaseWrappingKey();
+    bool openSession(QByteArray *keyMaterial, QByteArray *session);
+    void backOff();
+
+    unsigned char *m_wrappingKey = nullptr; // SecurePool slot of kKeyBytes while a secret is set
+    QByteArray m_salt;
+    QByteArray m_sessionNonce;
+    QByteArray m_sessionCiphertext;
+    QByteArray m_wrapNonce;
+    QByteArray m_wrappedKey; // Session key under the wrapping key; dropped once used up
+    QByteArray m_recoverySalt;
+    QByteArray m_recoveryNonce;
+    QByteArray m_recoveryWrappedKey; // Session key under the recovery key; empty without one
+    int m_failedAttempts = 0;
+    QDeadlineTimer m_nextAttempt;
+};
+
+#endif // QUICKUNLOCK_H
@@ -0,0 +1,198 @@
+#ifndef RECORDSCHEMA_H
+#define RECORDSCHEMA_H
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+// The fixed fields of a password record. Values index kRecordFields.
+enum class RecordField : unsigned char {
+    Name,
+    Username,
+    Password,
+    Url,
+    Notes,
+};
+
+enum RecordFieldFlag : unsigned {
+    FieldSearchable = 1u << 0, // Matched by the search bar
+    FieldSecret     = 1u << 1, // Masked in the detail view and never searched
+    FieldMultiline  = 1u << 2, // Stored as a "key: |" block, edited in a QTextEdit
+    FieldLink       = 1u << 3, // Rendered as a hyperlink in the detail view
+    FieldShared     = 1u << 4, // Interned in the vault's string arena (values repeat across entries)
+    FieldSensitive  = 1u << 5, // Kept in SecurePool memory (see SecureString) instead of the heap
+};
+
+struct RecordFieldSpec {
+    RecordField id;
+    const char *key;   // Tag in the V1 text format ("name: ...")
+    const char *label; // Label in the detail view and the INSERT-mode panel
+    unsigned flags;
+    int displayOrder;
+    int searchWeight; // Multiplies fuzzy match scores in this field; 0 for fields that aren't searched
+};
+
+// The single description of a record's fields. The serializer, the parser, the
+// search and the detail/editor views are all generated from this table, so a new
+// field only has to be added here (and to RecordField).
+// The declaration order is also the order fields are written to disk.
+inline constexpr RecordFieldSpec kRecordFields[] = {
+    { RecordField::Name,     "name",     "Name",     FieldSearchable | FieldShared,                    0, 4 },
+    { RecordField::Username, "username", "Username", FieldSearchable | FieldShared,                    1, 3 },
+    { RecordField::Password, "password", "Password", FieldSecret | FieldSensitive,                     2, 0 },
+    { RecordField::Url,      "url",      "URL",      FieldSearchable | FieldLink | FieldShared,        3, 2 },
+    { RecordField::Notes,    "notes",    "Notes",    FieldSearchable | FieldMultiline | FieldSensitive, 4, 1 },
+};
+
+inline constexpr std::size_t kRecordFieldCount = std::size(kRecordFields);
+
+namespace RecordSchema {
+
+constexpr const RecordFieldSpec &spec(RecordField field)
+{
+    return kRecordFields[std::size_t(field)];
+}
+
+constexpr bool hasFlag(std::size_t index, unsigned flag)
+{
+    return (kRecordFields[index].flags & flag) != 0;
+}
+
+constexpr bool idsMatchPositions()
+{
+    for (std::size_t i = 0; i < kRecordFieldCount; ++i) {
+        if (std::size_t(kRecordFields[i].id) != i) return false;
+    }
+    return true;
+}
+static_assert(idsMatchPositions(), "kRecordFields must be listed in RecordField order");
+
+constexpr bool sharedFieldsAreNotSensitive()
+{
+    for (std::size_t i = 0; i < kRecordFieldCount; ++i) {
+        if (hasFlag(i, FieldShared) && hasFlag(i, FieldSensitive)) return false;
+    }
+    return true;
+}
+static_assert(sharedFieldsAreNotSensitive(), "Arena-interned fields can't also live in secure memory");
+
+constexpr bool searchWeightsMatchFlags()
+{
+    for (std::size_t i = 0; i < kRecordFieldCount; ++i) {
+        if (hasFlag(i, FieldSearchable) != (kRecordFields[i].searchWeight > 0)) return false;
+    }
+    return true;
+}
+static_assert(searchWeightsMatchFlags(), "Searchable fields need a search weight, other fields none");
+
+// PasswordRecord stores plain and sensitive fields in separate arrays; these map
+// a field index to its slot in the array it belongs to.
+constexpr std::size_t countFields(unsigned flag, bool set)
+{
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < kRecordFieldCount; ++i) {
+        if (hasFlag(i, flag) == set) ++count;
+    }
+    return count;
+}
+inline constexpr std::size_t kSensitiveFieldCount = countFields(FieldSensitive, true);
+inline constexpr std::size_t kPlainFieldCount = countFields(FieldSensitive, false);
+
+constexpr std::size_t storageSlot(std::size_t index)
+{
+    std::size_t slot = 0;
+    for (std::size_t i = 0; i < index; ++i) {
+        if (hasFlag(i, FieldSensitive) == hasFlag(index, FieldSensitive)) ++slot;
+    }
+    return slot;
+}
+
+// Field order for the detail view and the INSERT-mode panel
+constexpr std::array<RecordField, kRecordFieldCount> makeDisplayOrder()
+{
+    std::array<RecordField, kRecordFieldCount> order{};
+    for (std::size_t i = 0; i < kRecordFieldCount; ++i) {
+        std::size_t pos = i;
+        while (pos > 0 && spec(order[pos - 1]).displayOrder > kRecordFields[i].displayOrder) {
+            order[pos] = order[pos - 1];
+            --pos;
+        }
+        order[pos] = kRecordFields[i].id;
+    }
+    return order;
+}
+inline constexpr std::array<RecordField, kRecordFieldCount> kDisplayOrder = makeDisplayOrder();
+
+// Perfect hash over the field tags, so the parser resolves a key with one table
+// probe and a single memcmp instead of a chain of string compares.
+inline constexpr std::size_t kKeyTableSize = 16;
+
+constexpr std::size_t keyHash(const char *key, std::size_t length)
+{
+    return (length * 7u + static_cast<unsigned char>(key[0]) +
+            static_cast<unsigned char>(key[length - 1]) * 3u) % kKeyTableSize;
+}
+
+constexpr std::size_t keyLength(const char *key)
+{
+    std::size_t length = 0;
+    while (key[length] != '\0') ++length;
+    return length;
+}
+
+constexpr std::array<signed char, kKeyTableSize> makeKeyTable()
+{
+    std::array<signed char, kKeyTableSize> table{};
+    for (signed char &slot : table) slot = -1;
+    for (std::size_t i = 0; i < kRecordFieldCount; ++i) {
+        table[keyHash(kRecordFields[i].key, keyLength(kRecordFields[i].key))] = static_cast<signed char>(i);
+    }
+    return table;
+}
+inline constexpr std::array<signed char, kKeyTableSize> kKeyTable = makeKeyTable();
+
+constexpr bool keyHashIsPerfect()
+{
+    for (std::size_t i = 0; i < kRecordFieldCount; ++i) {
+        if (kKeyTable[keyHash(kRecordFields[i].key, keyLength(kRecordFields[i].key))] != static_cast<signed char>(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(keyHashIsPerfect(), "Field tags collide in keyHash(); adjust the hash or kKeyTableSize");
+
+// Returns the index of the field tagged key, or -1 for unknown tags.
+inline int fieldForKey(const char *key, std::size_t length)
+{
+    if (length == 0) return -1;
+    const int index = kKeyTable[keyHash(key, length)];
+    if (index < 0) return -1;
+    const char *candidate = kRecordFields[index].key;
+    if (std::char_traits<char>::length(candidate) != length || std::memcmp(candidate, key, length) != 0) {
+        return -1;
+    }
+    return index;
+}
+
+template <typename Fn, std::size_t... I>
+constexpr void forEachFieldImpl(Fn &fn, std::index_sequence<I...>)
+{
+    (fn(std::integral_constant<std::size_t, I>{}), ...);
+}
+
+// Calls fn(std::integral_constant<std::size_t, I>) for every field, unrolled at
+// compile time so the body can branch on kRecordFields[I] with if constexpr.
+template <typename Fn>
+constexpr void forEachField(Fn &&fn)
+{
+    forEachFieldImpl(fn, std::make_index_sequence<kRecordFieldCount>{});
+}
+
+} // namespace RecordSchema
+
+#endif // RECORDSCHEMA_H
@@ -0,0 +1,99 @@
+#include "RevisionDialog.h"
+#include <QApplication>
+#include <QClipboard> // Required for copying an old password
+#include <QDateTime>
+#include <QHeaderView>
+#include <QKeyEvent> // Required for QKeyEvent
+#include <QLocale>
+#include <QSplitter>
+#include <QVBoxLayout>
+
+RevisionDialog::RevisionDialog(const QString &entryName, std::vector<EntryRevisions::Revision> revisions, QWidget *parent)
+    : QDialog(parent), m_revisions(std::move(revisions))
+{
+    setWindowTitle(tr("History of %1").arg(entryName));
+    setMinimumSize(720, 420);
+
+    m_tableWidget = new QTableWidget(int(m_revisions.size()), 2, this);
+    m_tableWidget->setHorizontalHeaderLabels({tr("Replaced"), tr("Changed then")});
+    m_tableWidget->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_tableWidget->setSelectionMode(QAbstractItemView::SingleSelection);
+    m_tableWidget->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_tableWidget->verticalHeader()->hide();
+    m_tableWidget->horizontalHeader()->setSectionResizeMode(1, QHeaderView::Stretch);
+    for (int row = 0; row < int(m_revisions.size()); ++row) {
+        const EntryRevisions::Revision &revision = m_revisions[std::size_t(row)];
+        const QDateTime replaced = QDateTime::fromSecsSinceEpoch(revision.replaced);
+        m_tableWidget->setItem(row, 0, new QTableWidgetItem(QLocale().toString(replaced, QLocale::ShortFormat)));
+        m_tableWidget->setItem(row, 1, new QTableWidgetItem(revision.changedFields.join(QStringLiteral(", "))));
+    }
+
+    m_detail = new QTextBrowser(this);
+    QSplitter *splitter = new QSplitter(this);
+    splitter->addWidget(m_tableWidget);
+    splitter->addWidget(m_detail);
+
+    m_status = new QLabel(tr("Enter: restore this version   y: copy its password   Esc: close"), this);
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(splitter);
+    layout->addWidget(m_status);
+    setLayout(layout);
+
+    connect(m_tableWidget, &QTableWidget::currentCellChanged, this, [this](int row) { showRevision(row); });
+    connect(m_tableWidget, &QTableWidget::cellDoubleClicked, this, [this](int row) {
+        m_selectedRevision = row;
+        accept();
+    });
+    m_tableWidget->setFocus();
+    m_tableWidget->selectRow(0);
+    showRevision(0);
+}
+
+void RevisionDialog::showRevision(int row)
+{
+    if (row < 0 || row >= int(m_revisions.size())) {
+        m_detail->clear();
+        return;
+    }
+    const PasswordRecord &record = m_revisions[std::size_t(row)].record;
+    QString html;
+    for (RecordField field : RecordSchema::kDisplayOrder) {
+        const RecordFieldSpec &spec = RecordSchema::spec(field);
+        if (record.view(field).isEmpty()) {
+            continue;
+        }
+        QString value = (spec.flags & FieldSecret) ? QString(record.view(field).size(), '*') // Stays in secure memory
+                                                   : record.value(field).toHtmlEscaped();
+        value.replace('\n', "<br>");
+        html += QString("<p><b>%1:</b> %2</p>").arg(QString::fromLatin1(spec.label), value);
+    }
+    for (const CustomField &field : record.customFields) {
+        const QString value = CustomFieldTypes::isSecret(field.type) ? QString(field.text().size(), '*')
+                                                                     : field.text().toString().toHtmlEscaped();
+        html += QString("<p><b>%1:</b> %2</p>").arg(FieldKeyTable::name(field.key), value);
+    }
+    for (const Attachment &attachment : record.attachments) {
+        html += QString("<p><b>%1:</b> %2</p>").arg(tr("Attachment"), attachment.name.toHtmlEscaped());
+    }
+    m_detail->setHtml(html);
+}
+
+void RevisionDialog::keyPressEvent(QKeyEvent *event)
+{
+    const int row = m_tableWidget->currentRow();
+    if (row < 0 || row >= int(m_revisions.size())) {
+        QDialog::keyPressEvent(event);
+        return;
+    }
+    if (event->key() == Qt::Key_Return || event->key() == Qt::Key_Enter) {
+        m_selectedRevision = row;
+        accept();
+    } else if (event->key() == Qt::Key_Y) {
+        const PasswordRecord &record = m_revisions[std::size_t(row)].record;
+        QApplication::clipboard()->setText(record.value(RecordField::Password));
+        m_status->setText(tr("Password of the version replaced %1 copied to clipboard.")
+                              .arg(m_tableWidget->item(row, 0)->text()));
+    } else {
+        QDialog::keyPressEvent(event); // Call base class implementation for other keys
+    }
+}
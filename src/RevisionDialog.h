@@ -0,0 +1,36 @@
+#ifndef REVISIONDIALOG_H
+#define REVISIONDIALOG_H
+
+#include <QDialog>
+#include <QLabel>
+#include <QTableWidget>
+#include <QTextBrowser>
+#include <vector>
+#include "EntryRevisions.h"
+
+// Earlier versions of one entry, newest first, with the fields of the selected
+// one. Enter or a double-click closes it to restore that version; y copies its
+// password to the clipboard.
+class RevisionDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    RevisionDialog(const QString &entryName, std::vector<EntryRevisions::Revision> revisions, QWidget *parent = nullptr);
+    int selectedRevision() const { return m_selectedRevision; } // -1 unless accepted
+
+protected:
+    void keyPressEvent(QKeyEvent *event) override;
+
+private slots:
+    void showRevision(int row);
+
+private:
+    std::vector<EntryRevisions::Revision> m_revisions;
+    QTableWidget *m_tableWidget;
+    QTextBrowser *m_detail;
+    QLabel *m_status;
+    int m_selectedRevision = -1;
+};
+
+#endif // REVISIONDIALOG_H
@@ -0,0 +1,314 @@
+#include "SearchQuery.h"
+#include <QCoreApplication>
+#include <QUrl>
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+constexpr qsizetype kMinFuzzyLength = 3; // Shorter words fuzzy-match nearly everything; they search substrings
+constexpr int kTermScore = 16;           // Score of a non-fuzzy hit, times the field's search weight
+
+struct Token {
+    QString value;
+    bool quoted = false;
+    bool negated = false;
+    qsizetype colon = -1; // First ':' outside quotes
+};
+
+std::vector<Token> tokenize(QStringView text)
+{
+    std::vector<Token> tokens;
+    qsizetype i = 0;
+    while (i < text.size()) {
+        while (i < text.size() && text.at(i).isSpace()) ++i;
+        if (i == text.size()) break;
+
+        Token token;
+        if (text.at(i) == u'-' && i + 1 < text.size() && !text.at(i + 1).isSpace()) {
+            token.negated = true;
+            ++i;
+        }
+        bool inQuotes = false;
+        for (; i < text.size() && (inQuotes || !text.at(i).isSpace()); ++i) {
+            const QChar c = text.at(i);
+            if (c == u'"') {
+                inQuotes = !inQuotes;
+                token.quoted = true;
+            } else {
+                if (c == u':' && !inQuotes && token.colon < 0) token.colon = token.value.size();
+                token.value += c;
+            }
+        }
+        tokens.push_back(token);
+    }
+    return tokens;
+}
+
+// Anchored, case-insensitive: '*' is any run of characters and '?' any one
+QString globToPattern(QStringView glob)
+{
+    QString pattern = QStringLiteral("^");
+    for (QChar c : glob) {
+        if (c == u'*') pattern += QStringLiteral(".*");
+        else if (c == u'?') pattern += u'.';
+        else pattern += QRegularExpression::escape(QString(c));
+    }
+    return pattern + u'$';
+}
+
+std::vector<std::uint32_t> intersect(const std::vector<std::uint32_t> &a, const std::vector<std::uint32_t> &b)
+{
+    std::vector<std::uint32_t> result;
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+    return result;
+}
+
+} // namespace
+
+SearchQuery SearchQuery::parse(QStringView text, QString *error)
+{
+    SearchQuery query;
+    for (Token &token : tokenize(text)) {
+        Term term;
+        term.negated = token.negated;
+        QString value = token.value;
+        bool regex = false;
+
+        if (token.colon > 0) {
+            const QString rawPrefix = value.left(token.colon); // Custom keys keep their case
+            const QString prefix = rawPrefix.toLower();
+            const QString rest = value.mid(token.colon + 1);
+            bool scoped = true;
+            if (prefix == u"re") {
+                regex = true;
+            } else if (prefix == u"folder") {
+                term.scope = Scope::Folder;
+            } else {
+                const QString key = prefix == u"user" ? QStringLiteral("username")
+                                  : prefix == u"title" ? QStringLiteral("name") : prefix;
+                const QByteArray latin1 = key.toLatin1();
+                const int field = RecordSchema::fieldForKey(latin1.constData(), size_t(latin1.size()));
+                if (field >= 0 && RecordSchema::hasFlag(size_t(field), FieldSearchable)) {
+                    term.scope = Scope::Field; // Never the secret fields
+                    term.field = kRecordFields[field].id;
+                } else if (field < 0 && (term.customKey = FieldKeyTable::find(rawPrefix)) != FieldKeyTable::kInvalidKey) {
+                    term.scope = Scope::Custom;
+                } else {
+                    scoped = false; // "https://..." and the like are plain words
+                }
+            }
+            if (scoped) {
+                value = rest;
+                if (!regex && !token.quoted && value.startsWith(u"re:")) {
+                    regex = true;
+                    value = value.mid(3);
+                }
+            }
+        }
+        if (value.isEmpty()) {
+            continue;
+        }
+
+        if (regex) {
+            term.kind = Kind::Regex;
+            term.regex = QRegularExpression(value, QRegularExpression::CaseInsensitiveOption);
+        } else if (!token.quoted && (value.contains(u'*') || value.contains(u'?'))) {
+            term.kind = Kind::Glob;
+            term.regex = QRegularExpression(globToPattern(value), QRegularExpression::CaseInsensitiveOption);
+        } else if (term.scope == Scope::AllFields && !token.quoted && !term.negated && value.size() >= kMinFuzzyLength) {
+            term.kind = Kind::Fuzzy;
+            term.fuzzy.emplace(value);
+        } else {
+            term.kind = Kind::Substring;
+            term.needle = value.toCaseFolded().toUtf8();
+        }
+        term.text = value.toCaseFolded();
+        term.position = int(query.m_terms.size());
+
+        if (term.kind == Kind::Regex || term.kind == Kind::Glob) {
+            if (!term.regex.isValid()) {
+                if (error) {
+                    *error = QCoreApplication::translate("SearchQuery", "Invalid pattern \"%1\": %2")
+                                 .arg(value, term.regex.errorString());
+                }
+                return SearchQuery();
+            }
+            term.regex.optimize(); // Compiles now (JIT where available) instead of on the first entry
+        }
+        query.m_needsFolderPath = query.m_needsFolderPath || term.scope == Scope::Folder;
+        query.m_terms.push_back(std::move(term));
+    }
+
+    // Cheap tests first, so most entries are rejected before a fuzzy score or a regex runs
+    const auto cost = [](const Term &term) {
+        switch (term.kind) {
+        case Kind::Substring: return 0;
+        case Kind::Glob: return 1;
+        case Kind::Fuzzy: return 2;
+        case Kind::Regex: return 3;
+        }
+        return 3;
+    };
+    std::stable_sort(query.m_terms.begin(), query.m_terms.end(),
+                     [&](const Term &a, const Term &b) { return cost(a) < cost(b); });
+    return query;
+}
+
+bool SearchQuery::refines(const SearchQuery &previous) const
+{
+    if (m_terms.size() < previous.m_terms.size()) {
+        return false;
+    }
+    for (const Term &before : previous.m_terms) {
+        const auto it = std::find_if(m_terms.begin(), m_terms.end(),
+                                     [&](const Term &term) { return term.position == before.position; });
+        const Term &after = *it;
+        if (after.scope != before.scope || after.negated != before.negated || after.field != before.field
+            || after.customKey != before.customKey) {
+            return false;
+        }
+        bool narrower = false;
+        if (after.negated) {
+            narrower = after.kind == before.kind && after.text == before.text; // A longer excluded word excludes less
+        } else if (after.kind == Kind::Substring && before.kind == Kind::Substring) {
+            narrower = after.text.contains(before.text);
+        } else if (after.kind == Kind::Fuzzy && before.kind == Kind::Fuzzy) {
+            narrower = after.text.startsWith(before.text);
+        } else if (after.kind == before.kind) {
+            narrower = after.text == before.text; // Globs and regexes only when unchanged
+        }
+        if (!narrower) {
+            return false;
+        }
+    }
+    return true; // Added terms only narrow further
+}
+
+bool SearchQuery::selectCandidates(const ArcaneLock::SearchBuffer &buffer, std::vector<std::uint32_t> *entries) const
+{
+    std::vector<const Term *> included;
+    std::vector<const Term *> excluded;
+    for (const Term &term : m_terms) {
+        if (term.indexable()) {
+            (term.negated ? excluded : included).push_back(&term);
+        }
+    }
+    if (included.empty() && excluded.empty()) {
+        return false;
+    }
+
+    const auto entriesMatching = [&](const Term &term) {
+        std::vector<std::uint32_t> found;
+        const std::string_view needle(term.needle.constData(), size_t(term.needle.size()));
+        if (term.scope == Scope::Field) {
+            buffer.find(size_t(SearchColumns::forField(term.field)), needle, &found);
+        } else {
+            for (std::size_t column = 0; column < SearchColumns::kCount; ++column) {
+                buffer.find(column, needle, &found);
+            }
+            std::sort(found.begin(), found.end());
+            found.erase(std::unique(found.begin(), found.end()), found.end());
+        }
+        return found;
+    };
+
+    // Longer needles tend to be rarer; scanning them first lets an empty result stop early
+    std::stable_sort(included.begin(), included.end(),
+                     [](const Term *a, const Term *b) { return a->needle.size() > b->needle.size(); });
+    std::vector<std::uint32_t> candidates;
+    if (included.empty()) {
+        for (std::uint32_t entry = 0; entry < buffer.entryCount(); ++entry) {
+            if (!buffer.isRemoved(entry)) {
+                candidates.push_back(entry);
+            }
+        }
+    }
+    for (std::size_t i = 0; i < included.size(); ++i) {
+        candidates = i == 0 ? entriesMatching(*included[i]) : intersect(candidates, entriesMatching(*included[i]));
+        if (candidates.empty()) break;
+    }
+    for (const Term *term : excluded) {
+        if (candidates.empty()) break;
+        const std::vector<std::uint32_t> found = entriesMatching(*term);
+        std::vector<std::uint32_t> kept;
+        std::set_difference(candidates.begin(), candidates.end(), found.begin(), found.end(), std::back_inserter(kept));
+        candidates.swap(kept);
+    }
+    entries->swap(candidates);
+    return true;
+}
+
+int SearchQuery::score(const PasswordRecord &record, QStringView folderPath) const
+{
+    int total = 0;
+    for (const Term &term : m_terms) {
+        const int termScore = term.termScore(record, folderPath);
+        if ((termScore >= 0) == term.negated) {
+            return FuzzyMatcher::kNoMatch;
+        }
+        if (!term.negated) {
+            total += termScore;
+        }
+    }
+    return std::max(total, 1); // A plan of only negated terms still ranks its matches above a miss
+}
+
+int SearchQuery::Term::matchText(QStringView value, int weight) const
+{
+    switch (kind) {
+    case Kind::Fuzzy: {
+        const int fuzzyScore = fuzzy->score(value);
+        return fuzzyScore == FuzzyMatcher::kNoMatch ? -1 : fuzzyScore * weight;
+    }
+    case Kind::Substring:
+        return value.contains(text, Qt::CaseInsensitive) ? kTermScore * weight : -1;
+    case Kind::Glob:
+    case Kind::Regex:
+        return regex.match(value).hasMatch() ? kTermScore * weight : -1;
+    }
+    return -1;
+}
+
+int SearchQuery::Term::termScore(const PasswordRecord &record, QStringView folderPath) const
+{
+    switch (scope) {
+    case Scope::AllFields: {
+        if (kind == Kind::Fuzzy) {
+            const int fuzzyScore = fuzzy->score(record);
+            return fuzzyScore == FuzzyMatcher::kNoMatch ? -1 : fuzzyScore;
+        }
+        int best = -1;
+        RecordSchema::forEachField([&](auto field) {
+            if constexpr (RecordSchema::hasFlag(field, FieldSearchable)) {
+                best = std::max(best, matchText(record.view(kRecordFields[field].id), kRecordFields[field].searchWeight));
+            }
+        });
+        for (const CustomField &customField : record.customFields) {
+            if (CustomFieldTypes::isSearchable(customField.type)) {
+                best = std::max(best, matchText(customField.text(), 1));
+            }
+        }
+        return best;
+    }
+    case Scope::Field: {
+        const QStringView value = record.view(field);
+        int result = matchText(value, RecordSchema::spec(field).searchWeight);
+        if (result < 0 && kind == Kind::Glob && field == RecordField::Url) {
+            // "url:*.internal" means the host
+            result = matchText(QUrl::fromUserInput(value.toString()).host(), RecordSchema::spec(field).searchWeight);
+        }
+        return result;
+    }
+    case Scope::Custom: {
+        const CustomField *customField = record.customField(customKey);
+        if (!customField || !CustomFieldTypes::isSearchable(customField->type)) {
+            return -1; // Secret custom fields are never searched
+        }
+        return matchText(customField->text(), 1);
+    }
+    case Scope::Folder:
+        return matchText(folderPath, 1);
+    }
+    return -1;
+}
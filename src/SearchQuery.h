@@ -0,0 +1,106 @@
+#ifndef SEARCHQUERY_H
+#define SEARCHQUERY_H
+
+#include <QByteArray>
+#include <QRegularExpression>
+#include <QString>
+#include <QStringView>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "FuzzyMatcher.h"
+#include "PasswordRecord.h"
+#include "model/SearchBuffer.hpp"
+
+// Column layout of the per-vault SearchBuffer: the searchable schema fields in
+// schema order, then every searchable custom field of an entry, one per line.
+namespace SearchColumns {
+
+inline constexpr std::size_t kCount = RecordSchema::countFields(FieldSearchable, true) + 1;
+inline constexpr std::size_t kCustom = kCount - 1;
+
+constexpr int forField(RecordField field)
+{
+    int column = 0;
+    for (const RecordFieldSpec &spec : kRecordFields) {
+        if (spec.id == field) return (spec.flags & FieldSearchable) ? column : -1;
+        if (spec.flags & FieldSearchable) ++column;
+    }
+    return -1;
+}
+
+constexpr int weight(std::size_t column)
+{
+    std::size_t current = 0;
+    for (const RecordFieldSpec &spec : kRecordFields) {
+        if ((spec.flags & FieldSearchable) && current++ == column) return spec.searchWeight;
+    }
+    return 1; // Custom fields count like notes
+}
+
+} // namespace SearchColumns
+
+// A search bar query compiled into a plan.
+//
+// Grammar, terms separated by spaces:
+//   word           fuzzy match on every searchable field (substring below 3 characters)
+//   "a phrase"     case-insensitive substring on every searchable field
+//   field:value    substring in one field: name (title), username (user), url,
+//                  notes, or the key of a custom field
+//   folder:value   substring in the folder path ("Work/Servers")
+//   *, ?           in a value make it a glob over the whole field; on url it
+//                  may match the host instead ("url:*.internal")
+//   re:pattern     regular expression, bare or after a field ("notes:re:^ssh")
+//   -term          the entry must not match term
+//
+// Substring terms on schema fields are answered from the SearchBuffer first;
+// the rest of the plan only runs on the entries left over.
+class SearchQuery
+{
+public:
+    // The plan of an unparsable query is empty and *error says why
+    static SearchQuery parse(QStringView text, QString *error = nullptr);
+
+    bool isEmpty() const { return m_terms.empty(); }
+
+    // True if everything this query matches is also matched by previous, as
+    // when a word is typed further or a term is added. A filter can then
+    // re-test only what previous matched.
+    bool refines(const SearchQuery &previous) const;
+    bool needsFolderPath() const { return m_needsFolderPath; }
+
+    // Narrows to the entries that satisfy the plan's indexable terms. Returns
+    // false, leaving entries alone, when no term can use the buffer.
+    bool selectCandidates(const ArcaneLock::SearchBuffer &buffer, std::vector<std::uint32_t> *entries) const;
+
+    // Runs every term on one entry; FuzzyMatcher::kNoMatch or a rank score.
+    // folderPath holds the names of the folders above the entry, joined by '/'.
+    int score(const PasswordRecord &record, QStringView folderPath = {}) const;
+
+private:
+    enum class Kind { Fuzzy, Substring, Glob, Regex };
+    enum class Scope { AllFields, Field, Custom, Folder };
+
+    struct Term {
+        Kind kind = Kind::Substring;
+        Scope scope = Scope::AllFields;
+        bool negated = false;
+        RecordField field = RecordField::Name; // Scope::Field
+        FieldKeyId customKey = FieldKeyTable::kInvalidKey; // Scope::Custom
+        int position = 0;                      // Index among the query's terms as typed
+        QString text;                          // Case-folded value
+        QByteArray needle;                     // Same as UTF-8, for the buffer
+        QRegularExpression regex;              // Glob and Regex
+        std::optional<FuzzyMatcher> fuzzy;
+
+        bool indexable() const { return kind == Kind::Substring && (scope == Scope::AllFields || scope == Scope::Field); }
+        int termScore(const PasswordRecord &record, QStringView folderPath) const; // < 0 if the term fails
+        int matchText(QStringView value, int weight) const;
+    };
+
+    std::vector<Term> m_terms; // Cheapest kinds first
+    bool m_needsFolderPath = false;
+};
+
+#endif // SEARCHQUERY_H
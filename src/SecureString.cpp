@@ -0,0 +1,106 @@
+#include "SecureString.h"
+#include "model/SecurePool.hpp"
+#include <QStringDecoder>
+#include <algorithm> // Required for std::copy
+#include <atomic>
+#include <new> // Required for placement new
+#include <utility> // Required for std::swap
+
+struct SecureString::Block {
+    std::atomic<int> refs;
+    int capacity;       // Characters reserved after the header
+    qsizetype length;
+
+    QChar *data() { return reinterpret_cast<QChar *>(this + 1); }
+    static std::size_t bytesFor(qsizetype capacity) { return sizeof(Block) + std::size_t(capacity) * sizeof(QChar); }
+};
+
+SecureString::Block *SecureString::allocateBlock(qsizetype capacity)
+{
+    void *memory = ArcaneLock::SecurePool::instance().allocate(Block::bytesFor(capacity));
+    return new (memory) Block{{1}, int(capacity), 0};
+}
+
+SecureString SecureString::fromUtf8(QByteArrayView utf8)
+{
+    SecureString result;
+    if (utf8.isEmpty()) {
+        return result;
+    }
+    // UTF-8 never needs more UTF-16 units than it has bytes
+    result.m_block = allocateBlock(utf8.size());
+    QStringDecoder decoder(QStringDecoder::Utf8, QStringDecoder::Flag::Stateless);
+    QChar *end = decoder.appendToBuffer(result.m_block->data(), utf8);
+    result.m_block->length = end - result.m_block->data();
+    return result;
+}
+
+SecureString SecureString::fromString(QStringView text)
+{
+    SecureString result;
+    if (text.isEmpty()) {
+        return result;
+    }
+    result.m_block = allocateBlock(text.size());
+    std::copy(text.begin(), text.end(), result.m_block->data());
+    result.m_block->length = text.size();
+    return result;
+}
+
+SecureString::SecureString(const SecureString &other)
+    : m_block(other.m_block)
+{
+    if (m_block) {
+        m_block->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+SecureString::SecureString(SecureString &&other) noexcept
+    : m_block(other.m_block)
+{
+    other.m_block = nullptr;
+}
+
+SecureString &SecureString::operator=(const SecureString &other)
+{
+    if (m_block != other.m_block) {
+        SecureString copy(other);
+        std::swap(m_block, copy.m_block);
+    }
+    return *this;
+}
+
+SecureString &SecureString::operator=(SecureString &&other) noexcept
+{
+    std::swap(m_block, other.m_block);
+    return *this;
+}
+
+SecureString::~SecureString()
+{
+    release();
+}
+
+void SecureString::release()
+{
+    if (m_block && m_block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        // deallocate() zeroes the block, header and text alike
+        ArcaneLock::SecurePool::instance().deallocate(m_block, Block::bytesFor(m_block->capacity));
+    }
+    m_block = nullptr;
+}
+
+QStringView SecureString::view() const
+{
+    return m_block ? QStringView(m_block->data(), m_block->length) : QStringView();
+}
+
+QString SecureString::toQString() const
+{
+    return view().toString();
+}
+
+qsizetype SecureString::size() const
+{
+    return m_block ? m_block->length : 0;
+}
@@ -0,0 +1,42 @@
+#ifndef SECURESTRING_H
+#define SECURESTRING_H
+
+#include <QByteArrayView>
+#include <QString>
+#include <QStringView>
+
+// Immutable UTF-16 string kept in the SecurePool (locked, guarded memory that is
+// zeroed when released). Used for passwords, notes and secret custom fields so
+// the vault's secrets don't end up scattered over the ordinary heap.
+//
+// Copies share the same block through a reference count, which keeps the
+// QVariant round trips of PasswordRecord cheap. toQString() makes an ordinary
+// heap copy; use it only where Qt needs a QString (widgets, the clipboard) and
+// prefer view() everywhere else.
+class SecureString
+{
+public:
+    SecureString() = default;
+    SecureString(const SecureString &other);
+    SecureString(SecureString &&other) noexcept;
+    SecureString &operator=(const SecureString &other);
+    SecureString &operator=(SecureString &&other) noexcept;
+    ~SecureString();
+
+    static SecureString fromUtf8(QByteArrayView utf8); // Decodes straight into secure memory
+    static SecureString fromString(QStringView text);
+
+    QStringView view() const;
+    QString toQString() const;
+    qsizetype size() const;
+    bool isEmpty() const { return size() == 0; }
+
+private:
+    struct Block;
+    static Block *allocateBlock(qsizetype capacity);
+    void release();
+
+    Block *m_block = nullptr;
+};
+
+#endif // SECURESTRING_H
@@ -0,0 +1,151 @@
+#include "StringArena.h"
+#include <QMutexLocker>
+#include <algorithm> // Required for std::copy
+
+namespace {
+
+// Characters per arena block (64 KiB of UTF-16)
+constexpr qsizetype kBlockLength = 32 * 1024;
+// Strings longer than this get a block of their own instead of wasting the
+// tail of the current one
+constexpr qsizetype kLargeStringLength = kBlockLength / 4;
+
+} // namespace
+
+StringArena::Stats &StringArena::Stats::operator+=(const Stats &other)
+{
+    uniqueStrings += other.uniqueStrings;
+    lookups += other.lookups;
+    hits += other.hits;
+    reservedBytes += other.reservedBytes;
+    usedBytes += other.usedBytes;
+    savedBytes += other.savedBytes;
+    return *this;
+}
+
+StringArena::StringArena()
+    : m_decoder(QStringDecoder::Utf8, QStringDecoder::Flag::Stateless)
+{
+}
+
+QChar *StringArena::reserve(qsizetype length)
+{
+    if (m_blockEnd - m_cursor < length) {
+        m_blocks.push_back(std::make_unique<QChar[]>(kBlockLength));
+        m_cursor = m_blocks.back().get();
+        m_blockEnd = m_cursor + kBlockLength;
+        m_stats.reservedBytes += kBlockLength * qsizetype(sizeof(QChar));
+    }
+    return m_cursor;
+}
+
+// Looks up the text just written at data (the free space of the current block)
+// and keeps it only if it isn't interned yet.
+QString StringArena::commit(QChar *data, qsizetype length)
+{
+    const QStringView text(data, length);
+    ++m_stats.lookups;
+
+    auto existing = m_strings.constFind(text);
+    if (existing != m_strings.constEnd()) {
+        ++m_stats.hits;
+        m_stats.savedBytes += length * qsizetype(sizeof(QChar));
+        return QString::fromRawData(existing->data(), existing->size());
+    }
+
+    m_cursor = data + length;
+    m_strings.insert(text);
+    ++m_stats.uniqueStrings;
+    m_stats.usedBytes += length * qsizetype(sizeof(QChar));
+    return QString::fromRawData(data, length);
+}
+
+QString StringArena::internLarge(QStringView text)
+{
+    ++m_stats.lookups;
+    auto existing = m_strings.constFind(text);
+    if (existing != m_strings.constEnd()) {
+        ++m_stats.hits;
+        m_stats.savedBytes += text.size() * qsizetype(sizeof(QChar));
+        return QString::fromRawData(existing->data(), existing->size());
+    }
+
+    m_blocks.push_back(std::make_unique<QChar[]>(text.size()));
+    QChar *data = m_blocks.back().get();
+    std::copy(text.begin(), text.end(), data);
+    m_strings.insert(QStringView(data, text.size()));
+    ++m_stats.uniqueStrings;
+    m_stats.reservedBytes += text.size() * qsizetype(sizeof(QChar));
+    m_stats.usedBytes += text.size() * qsizetype(sizeof(QChar));
+    return QString::fromRawData(data, text.size());
+}
+
+QString StringArena::intern(QStringView text)
+{
+    if (text.isEmpty()) {
+        return QString();
+    }
+    if (text.size() > kLargeStringLength) {
+        return internLarge(text);
+    }
+    QChar *data = reserve(text.size());
+    std::copy(text.begin(), text.end(), data);
+    return commit(data, text.size());
+}
+
+QString StringArena::internUtf8(QByteArrayView utf8)
+{
+    if (utf8.isEmpty()) {
+        return QString();
+    }
+    if (utf8.size() > kLargeStringLength) {
+        return internLarge(QString::fromUtf8(utf8));
+    }
+    // UTF-16 never needs more code units than the UTF-8 input has bytes
+    QChar *data = reserve(utf8.size());
+    QChar *end = m_decoder.appendToBuffer(data, utf8);
+    return commit(data, end - data);
+}
+
+void StringArena::clear()
+{
+    m_strings.clear();
+    m_blocks.clear();
+    m_cursor = nullptr;
+    m_blockEnd = nullptr;
+    m_stats = Stats();
+}
+
+StringArena::Stats StringArena::stats() const
+{
+    return m_stats;
+}
+
+StringArena *StringPool::createArena()
+{
+    QMutexLocker locker(&m_mutex);
+    m_parserArenas.push_back(std::make_unique<StringArena>());
+    return m_parserArenas.back().get();
+}
+
+QString StringPool::intern(QStringView text)
+{
+    return m_mainArena.intern(text);
+}
+
+void StringPool::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_parserArenas.clear();
+    m_mainArena.clear();
+}
+
+StringArena::Stats StringPool::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    StringArena::Stats total = m_mainArena.stats();
+    for (const std::unique_ptr<StringArena> &arena : m_parserArenas) {
+        total += arena->stats();
+    }
+    return total;
+}
@@ -0,0 +1,86 @@
+#ifndef STRINGARENA_H
+#define STRINGARENA_H
+
+#include <QByteArrayView>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <QStringDecoder>
+#include <QStringView>
+#include <memory>
+#include <vector>
+
+// Bump allocator for UTF-16 text with an interning table on top.
+//
+// intern() returns a QString created with QString::fromRawData() that points into
+// the arena, so equal strings share one copy and cost no heap allocation of their
+// own. Those strings stay valid until the arena is cleared or destroyed; anything
+// that may outlive the arena must take a deep copy (QString(view.data(), size)).
+//
+// An arena is not thread-safe; each parser thread gets its own from a StringPool.
+class StringArena
+{
+public:
+    struct Stats {
+        qsizetype uniqueStrings = 0; // Strings stored in the arena
+        qsizetype lookups = 0;       // intern() calls with non-empty text
+        qsizetype hits = 0;          // Lookups answered by an existing string
+        qsizetype reservedBytes = 0; // Memory held by the arena blocks
+        qsizetype usedBytes = 0;     // Bytes of text stored in the blocks
+        qsizetype savedBytes = 0;    // Text bytes not stored again thanks to interning
+
+        Stats &operator+=(const Stats &other);
+    };
+
+    StringArena();
+    StringArena(const StringArena &) = delete;
+    StringArena &operator=(const StringArena &) = delete;
+
+    QString intern(QStringView text);
+    QString internUtf8(QByteArrayView utf8); // Decodes straight into the arena
+
+    void clear();
+    Stats stats() const;
+
+private:
+    QChar *reserve(qsizetype length);
+    QString commit(QChar *data, qsizetype length);
+    QString internLarge(QStringView text);
+
+    std::vector<std::unique_ptr<QChar[]>> m_blocks;
+    QChar *m_cursor = nullptr;   // Next free character in the current block
+    QChar *m_blockEnd = nullptr; // End of the current block
+    QSet<QStringView> m_strings; // Views into the blocks
+    QStringDecoder m_decoder;
+    Stats m_stats;
+};
+
+// The string storage of one open vault: a set of arenas that are released
+// together when the vault is closed or reloaded.
+class StringPool
+{
+public:
+    StringPool() = default;
+    StringPool(const StringPool &) = delete;
+    StringPool &operator=(const StringPool &) = delete;
+
+    // Creates an additional arena owned by the pool. Thread-safe; used to give each
+    // parser thread its own arena. The arena lives until clear().
+    StringArena *createArena();
+
+    // Interns into the pool's main arena. GUI thread only.
+    QString intern(QStringView text);
+
+    // Frees all strings of the vault in one go. Every QString handed out by the pool
+    // must be gone by then (clear the models first).
+    void clear();
+
+    StringArena::Stats stats() const;
+
+private:
+    StringArena m_mainArena;
+    mutable QMutex m_mutex; // Guards m_parserArenas
+    std::vector<std::unique_ptr<StringArena>> m_parserArenas;
+};
+
+#endif // STRINGARENA_H
@@ -0,0 +1,95 @@
+#include "TreeFilterModel.h"
+#include "PasswordRecord.h"
+#include <functional> // Required for std::function for recursive lambda
+
+TreeFilterModel::TreeFilterModel(QObject *parent)
+    : QSortFilterProxyModel(parent)
+{
+    setRecursiveFilteringEnabled(true); // Folders stay visible while something under them matches
+}
+
+void TreeFilterModel::setSourceModel(QAbstractItemModel *sourceModel)
+{
+    m_items = qobject_cast<QStandardItemModel *>(sourceModel);
+    m_matches.clear();
+    // Connected before the base class connects its own handlers, so the cache
+    // is already cleaned when the proxy re-filters the changed rows
+    connect(sourceModel, &QAbstractItemModel::dataChanged, this,
+            [this](const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+                forgetItems(topLeft.parent(), topLeft.row(), bottomRight.row());
+            });
+    connect(sourceModel, &QAbstractItemModel::rowsAboutToBeRemoved, this, &TreeFilterModel::forgetItems);
+    connect(sourceModel, &QAbstractItemModel::modelAboutToBeReset, this, [this]() { m_matches.clear(); });
+    QSortFilterProxyModel::setSourceModel(sourceModel);
+}
+
+void TreeFilterModel::forgetItems(const QModelIndex &parent, int first, int last)
+{
+    if (m_matches.isEmpty() || !m_items) {
+        return;
+    }
+    QStandardItem *parentItem = parent.isValid() ? m_items->itemFromIndex(parent) : m_items->invisibleRootItem();
+    std::function<void(const QStandardItem *)> forget = [&](const QStandardItem *item) {
+        m_matches.remove(item);
+        for (int i = 0; i < item->rowCount(); ++i) {
+            forget(item->child(i));
+        }
+    };
+    for (int row = first; row <= last && parentItem; ++row) {
+        if (const QStandardItem *item = parentItem->child(row)) {
+            forget(item);
+        }
+    }
+}
+
+void TreeFilterModel::setQuery(const SearchQuery &query)
+{
+    if (query.isEmpty() || m_query.isEmpty() || !query.refines(m_query)) {
+        m_matches.clear();
+    } else {
+        // Misses stay misses; only the entries shown so far are tested again
+        for (auto it = m_matches.begin(); it != m_matches.end();) {
+            it = it.value() ? m_matches.erase(it) : std::next(it);
+        }
+    }
+    m_query = query;
+    invalidateFilter();
+}
+
+int TreeFilterModel::matchCount() const
+{
+    int count = 0;
+    for (bool matched : m_matches) {
+        count += matched ? 1 : 0;
+    }
+    return count;
+}
+
+QString TreeFilterModel::folderPath(const QStandardItem *item)
+{
+    QString path;
+    for (const QStandardItem *folder = item->parent(); folder && folder->parent(); folder = folder->parent()) {
+        path.prepend(path.isEmpty() ? folder->text() : folder->text() + u'/');
+    }
+    return path;
+}
+
+bool TreeFilterModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+{
+    if (m_query.isEmpty() || !sourceParent.isValid()) {
+        return true; // No filter, or a vault root
+    }
+    const QStandardItem *item = m_items->itemFromIndex(m_items->index(sourceRow, 0, sourceParent));
+    if (!item || !item->data(Qt::UserRole).canConvert<PasswordRecord>()) {
+        return false; // Folders are shown through their entries
+    }
+    const auto cached = m_matches.constFind(item);
+    if (cached != m_matches.constEnd()) {
+        return cached.value();
+    }
+    const PasswordRecord record = item->data(Qt::UserRole).value<PasswordRecord>();
+    const bool matched = m_query.score(record, m_query.needsFolderPath() ? folderPath(item) : QString())
+                         != FuzzyMatcher::kNoMatch;
+    m_matches.insert(item, matched);
+    return matched;
+}
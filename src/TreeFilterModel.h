@@ -0,0 +1,47 @@
+#ifndef TREEFILTERMODEL_H
+#define TREEFILTERMODEL_H
+
+#include <QHash>
+#include <QSortFilterProxyModel>
+#include <QStandardItem>
+#include <QStandardItemModel>
+
+#include "SearchQuery.h"
+
+// Sits between the vault tree and the view. Without a query every row passes;
+// with one, only the entries the query matches stay visible, together with
+// the folders above them and the vault roots.
+//
+// Whether an entry matches is cached per item. When the new query refines the
+// previous one (SearchQuery::refines), entries that already failed keep
+// failing without being looked at, so typing further only re-tests the rows
+// still shown. Edits drop the cached state of the items they touch.
+class TreeFilterModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+
+public:
+    explicit TreeFilterModel(QObject *parent = nullptr);
+
+    void setSourceModel(QAbstractItemModel *sourceModel) override;
+
+    // An empty query shows everything again
+    void setQuery(const SearchQuery &query);
+    bool isFiltering() const { return !m_query.isEmpty(); }
+    int matchCount() const; // Entries shown by the current query
+
+    // Names of the folders between the vault root and item, joined by '/'
+    static QString folderPath(const QStandardItem *item);
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+
+private:
+    void forgetItems(const QModelIndex &parent, int first, int last);
+
+    QStandardItemModel *m_items = nullptr;
+    SearchQuery m_query;
+    mutable QHash<const QStandardItem *, bool> m_matches; // Entries tested against m_query
+};
+
+#endif // TREEFILTERMODEL_H
@@ -0,0 +1,418 @@
+#include "UnlockAgent.h"
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QtEndian>
+#include <sodium.h> // Required for sodium_memzero
+
+#ifndef Q_OS_WIN
+#include <unistd.h> // Required for getuid
+#endif
+#ifdef Q_OS_LINUX
+#include <sys/socket.h> // Required for SO_PEERCRED
+#endif
+
+namespace {
+
+constexpr int kConnectTimeoutMs = 100; // Local connect; anything slower means no agent
+constexpr int kReplyTimeoutMs = 5000;
+
+QDataStream &setupStream(QDataStream &stream)
+{
+    stream.setVersion(QDataStream::Qt_6_0);
+    return stream;
+}
+
+QByteArray replyPayload(AgentProtocol::Reply reply)
+{
+    return QByteArray(1, char(reply));
+}
+
+void wipe(QByteArray *data)
+{
+    sodium_memzero(data->data(), size_t(data->size()));
+    data->clear();
+}
+
+} // namespace
+
+namespace AgentProtocol {
+
+QString serverName()
+{
+#ifdef Q_OS_WIN
+    return QStringLiteral("arcanelock-agent-") + qEnvironmentVariable("USERNAME");
+#else
+    QString directory = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if (directory.isEmpty()) {
+        return QDir::tempPath() + QStringLiteral("/arcanelock-agent-%1").arg(getuid());
+    }
+    return directory + QStringLiteral("/arcanelock-agent");
+#endif
+}
+
+QByteArray frame(const QByteArray &payload)
+{
+    QByteArray framed(4, Qt::Uninitialized);
+    qToBigEndian(quint32(payload.size()), framed.data());
+    framed.append(payload);
+    return framed;
+}
+
+bool takeFrame(QByteArray *buffer, QByteArray *payload, bool *invalid)
+{
+    *invalid = false;
+    if (buffer->size() < 4) {
+        return false;
+    }
+    const quint32 size = qFromBigEndian<quint32>(buffer->constData());
+    if (size == 0 || size > kMaxFrameSize) {
+        *invalid = true;
+        return false;
+    }
+    if (buffer->size() < 4 + qsizetype(size)) {
+        return false;
+    }
+    *payload = buffer->mid(4, size);
+    buffer->remove(0, 4 + size);
+    return true;
+}
+
+QString normalizedVaultPath(const QString &path)
+{
+    const QString canonical = QFileInfo(path).canonicalFilePath();
+    return canonical.isEmpty() ? QFileInfo(path).absoluteFilePath() : canonical;
+}
+
+} // namespace AgentProtocol
+
+UnlockAgent::UnlockAgent(QObject *parent)
+    : QObject(parent)
+{
+    m_ttlTimer.setSingleShot(true);
+    connect(&m_ttlTimer, &QTimer::timeout, this, &UnlockAgent::lock);
+    connect(&m_server, &QLocalServer::newConnection, this, &UnlockAgent::onNewConnection);
+}
+
+UnlockAgent::~UnlockAgent()
+{
+    m_snapshot.clear();
+}
+
+bool UnlockAgent::start(const QString &vaultPath, QByteArray *document, int ttlSeconds, QString *errorMessage)
+{
+    QString runningVault;
+    qint64 secondsLeft;
+    quint32 entryCount;
+    if (AgentClient::status(&runningVault, &secondsLeft, &entryCount) != AgentProtocol::Reply::NoAgent) {
+        *errorMessage = tr("An agent is already running for %1. Lock it first.").arg(runningVault);
+        wipe(document);
+        return false;
+    }
+
+    m_vaultPath = AgentProtocol::normalizedVaultPath(vaultPath);
+    const QFileInfo info(m_vaultPath);
+    m_vaultSize = info.size();
+    m_vaultModified = info.lastModified();
+    m_snapshot.load(*document);
+    m_document = SecureString::fromUtf8(*document);
+    wipe(document);
+
+    const QString name = AgentProtocol::serverName();
+    QLocalServer::removeServer(name); // Leftover socket of an agent that didn't exit cleanly
+    m_server.setSocketOptions(QLocalServer::UserAccessOption);
+    if (!m_server.listen(name)) {
+        *errorMessage = tr("Cannot listen on %1: %2").arg(name, m_server.errorString());
+        lock();
+        return false;
+    }
+
+    if (ttlSeconds > 0) {
+        m_ttlTimer.start(ttlSeconds * 1000);
+        m_deadline.setRemainingTime(qint64(ttlSeconds) * 1000);
+    } else {
+        m_deadline = QDeadlineTimer(QDeadlineTimer::Forever);
+    }
+    return true;
+}
+
+void UnlockAgent::lock()
+{
+    m_ttlTimer.stop();
+    m_server.close();
+    const QList<QLocalSocket*> sockets = m_buffers.keys();
+    m_buffers.clear();
+    for (QLocalSocket *socket : sockets) {
+        socket->abort();
+    }
+    m_snapshot.clear();
+    m_document = SecureString();
+    emit locked();
+}
+
+bool UnlockAgent::peerIsCurrentUser(QLocalSocket *socket) const
+{
+#if defined(Q_OS_LINUX)
+    // The socket permissions already keep other users out; this also rejects
+    // peers that got hold of a descriptor some other way.
+    ucred credentials;
+    socklen_t length = sizeof credentials;
+    if (getsockopt(int(socket->socketDescriptor()), SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0) {
+        return false;
+    }
+    return credentials.uid == getuid();
+#else
+    Q_UNUSED(socket);
+    return true;
+#endif
+}
+
+void UnlockAgent::onNewConnection()
+{
+    while (QLocalSocket *socket = m_server.nextPendingConnection()) {
+        if (!peerIsCurrentUser(socket)) {
+            socket->abort();
+            socket->deleteLater();
+            continue;
+        }
+        m_buffers.insert(socket, QByteArray());
+        connect(socket, &QLocalSocket::readyRead, this, &UnlockAgent::onReadyRead);
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            m_buffers.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void UnlockAgent::onReadyRead()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket*>(sender());
+    auto buffer = m_buffers.find(socket);
+    if (buffer == m_buffers.end()) {
+        return;
+    }
+    buffer->append(socket->readAll());
+
+    QByteArray request;
+    bool invalid = false;
+    while (AgentProtocol::takeFrame(&*buffer, &request, &invalid)) {
+        const bool lockRequested = !request.isEmpty() && AgentProtocol::Op(request.at(0)) == AgentProtocol::Op::Lock;
+        QByteArray reply = handleRequest(request);
+        socket->write(AgentProtocol::frame(reply));
+        wipe(&reply);
+        if (lockRequested) {
+            socket->flush();
+            lock();
+            return;
+        }
+    }
+    if (invalid) {
+        socket->abort();
+    }
+}
+
+bool UnlockAgent::vaultIsCurrent() const
+{
+    const QFileInfo info(m_vaultPath);
+    return info.size() == m_vaultSize && info.lastModified() == m_vaultModified;
+}
+
+QByteArray UnlockAgent::handleRequest(const QByteArray &request)
+{
+    using AgentProtocol::Op;
+    using AgentProtocol::Reply;
+
+    QDataStream in(request);
+    setupStream(in);
+    quint8 op = 0;
+    in >> op;
+
+    QByteArray reply = replyPayload(Reply::Ok);
+    QDataStream out(&reply, QIODevice::Append);
+    setupStream(out);
+
+    if (Op(op) == Op::Status) {
+        const qint64 secondsLeft = m_deadline.isForever() ? -1 : m_deadline.remainingTime() / 1000;
+        out << m_vaultPath << secondsLeft << quint32(m_snapshot.entries().size());
+        return reply;
+    }
+    if (Op(op) == Op::Lock) {
+        return reply;
+    }
+
+    QString vaultPath;
+    in >> vaultPath;
+    if (in.status() != QDataStream::Ok) {
+        return replyPayload(Reply::BadRequest);
+    }
+    if (AgentProtocol::normalizedVaultPath(vaultPath) != m_vaultPath) {
+        return replyPayload(Reply::WrongVault);
+    }
+    if (!vaultIsCurrent()) {
+        return replyPayload(Reply::Stale);
+    }
+
+    switch (Op(op)) {
+    case Op::Get: {
+        QString entryPath, field;
+        in >> entryPath >> field;
+        const VaultSnapshot::Entry *entry = m_snapshot.entry(entryPath);
+        QString value;
+        if (!entry || !VaultSnapshot::fieldValue(entry->record, field, &value)) {
+            return replyPayload(Reply::NotFound);
+        }
+        out << value;
+        sodium_memzero(value.data(), size_t(value.size()) * sizeof(QChar));
+        return reply;
+    }
+    case Op::Find: {
+        QString text;
+        in >> text;
+        out << m_snapshot.search(text);
+        return reply;
+    }
+    case Op::MatchUrl: {
+        QString url;
+        in >> url;
+        out << m_snapshot.matchUrl(url);
+        return reply;
+    }
+    case Op::Document: {
+        QByteArray document = m_document.view().toUtf8();
+        out << document;
+        wipe(&document);
+        return reply;
+    }
+    default:
+        return replyPayload(Reply::BadRequest);
+    }
+}
+
+AgentProtocol::Reply AgentClient::request(const QByteArray &payload, QByteArray *replyData)
+{
+    QLocalSocket socket;
+    socket.connectToServer(AgentProtocol::serverName());
+    if (!socket.waitForConnected(kConnectTimeoutMs)) {
+        return AgentProtocol::Reply::NoAgent;
+    }
+    socket.write(AgentProtocol::frame(payload));
+    if (!socket.waitForBytesWritten(kReplyTimeoutMs)) {
+        return AgentProtocol::Reply::NoAgent;
+    }
+
+    QByteArray buffer;
+    QByteArray reply;
+    bool invalid = false;
+    while (!AgentProtocol::takeFrame(&buffer, &reply, &invalid)) {
+        if (invalid || !socket.waitForReadyRead(kReplyTimeoutMs)) {
+            return AgentProtocol::Reply::NoAgent;
+        }
+        buffer.append(socket.readAll());
+    }
+    wipe(&buffer);
+    if (reply.isEmpty()) {
+        return AgentProtocol::Reply::BadRequest;
+    }
+    *replyData = reply.mid(1);
+    const AgentProtocol::Reply result = AgentProtocol::Reply(quint8(reply.at(0)));
+    wipe(&reply);
+    return result;
+}
+
+namespace {
+
+QByteArray requestPayload(AgentProtocol::Op op, const QString &vaultPath = QString())
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    setupStream(out);
+    out << quint8(op);
+    if (!vaultPath.isNull()) {
+        out << AgentProtocol::normalizedVaultPath(vaultPath);
+    }
+    return payload;
+}
+
+template <typename... Args>
+QByteArray appendArguments(QByteArray payload, const Args &...args)
+{
+    QDataStream out(&payload, QIODevice::Append);
+    setupStream(out);
+    (out << ... << args);
+    return payload;
+}
+
+} // namespace
+
+AgentProtocol::Reply AgentClient::status(QString *vaultPath, qint64 *secondsLeft, quint32 *entryCount)
+{
+    QByteArray data;
+    const AgentProtocol::Reply reply = request(requestPayload(AgentProtocol::Op::Status), &data);
+    if (reply == AgentProtocol::Reply::Ok) {
+        QDataStream in(data);
+        setupStream(in);
+        in >> *vaultPath >> *secondsLeft >> *entryCount;
+    }
+    return reply;
+}
+
+AgentProtocol::Reply AgentClient::get(const QString &vaultPath, const QString &entryPath, const QString &field, QString *value)
+{
+    QByteArray data;
+    const AgentProtocol::Reply reply =
+        request(appendArguments(requestPayload(AgentProtocol::Op::Get, vaultPath), entryPath, field), &data);
+    if (reply == AgentProtocol::Reply::Ok) {
+        QDataStream in(data);
+        setupStream(in);
+        in >> *value;
+        wipe(&data);
+    }
+    return reply;
+}
+
+AgentProtocol::Reply AgentClient::find(const QString &vaultPath, const QString &text, QStringList *entryPaths)
+{
+    QByteArray data;
+    const AgentProtocol::Reply reply =
+        request(appendArguments(requestPayload(AgentProtocol::Op::Find, vaultPath), text), &data);
+    if (reply == AgentProtocol::Reply::Ok) {
+        QDataStream in(data);
+        setupStream(in);
+        in >> *entryPaths;
+    }
+    return reply;
+}
+
+AgentProtocol::Reply AgentClient::matchUrl(const QString &vaultPath, const QString &url, QStringList *entryPaths)
+{
+    QByteArray data;
+    const AgentProtocol::Reply reply =
+        request(appendArguments(requestPayload(AgentProtocol::Op::MatchUrl, vaultPath), url), &data);
+    if (reply == AgentProtocol::Reply::Ok) {
+        QDataStream in(data);
+        setupStream(in);
+        in >> *entryPaths;
+    }
+    return reply;
+}
+
+AgentProtocol::Reply AgentClient::document(const QString &vaultPath, QByteArray *document)
+{
+    QByteArray data;
+    const AgentProtocol::Reply reply = request(requestPayload(AgentProtocol::Op::Document, vaultPath), &data);
+    if (reply == AgentProtocol::Reply::Ok) {
+        QDataStream in(data);
+        setupStream(in);
+        in >> *document;
+        wipe(&data);
+    }
+    return reply;
+}
+
+AgentProtocol::Reply AgentClient::lock()
+{
+    QByteArray data;
+    return request(requestPayload(AgentProtocol::Op::Lock), &data);
+}
@@ -0,0 +1,112 @@
+#ifndef UNLOCKAGENT_H
+#define UNLOCKAGENT_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QDeadlineTimer>
+#include <QHash>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+#include "SecureString.h"
+#include "VaultSnapshot.h"
+
+// ssh-agent style helper: one process per user keeps a decrypted vault in
+// secure memory and answers lookups over a local socket, so scripts and new
+// GUI windows don't pay for Argon2id on every run.
+//
+// Frames are a big-endian quint32 length followed by the payload. A request
+// payload starts with an Op byte, a reply payload with a Reply byte; the
+// arguments after it are QDataStream-encoded (Qt 6.0 format).
+namespace AgentProtocol {
+
+enum class Op : quint8 {
+    Status = 1,   // -> QString vaultPath, qint64 secondsLeft, quint32 entryCount
+    Get = 2,      // QString vaultPath, QString entryPath, QString field -> QString value
+    Find = 3,     // QString vaultPath, QString text -> QStringList entryPaths
+    Document = 4, // QString vaultPath -> QByteArray decrypted V1 text
+    Lock = 5,     // Wipe the vault and stop the agent
+    MatchUrl = 6, // QString vaultPath, QString url -> QStringList entryPaths
+};
+
+enum class Reply : quint8 {
+    Ok = 0,
+    NotFound = 1,   // No such entry or field
+    WrongVault = 2, // The agent holds a different vault
+    Stale = 3,      // The vault file changed since it was unlocked
+    BadRequest = 4,
+    NoAgent = 255,  // Client side only: no agent could be reached
+};
+
+inline constexpr quint32 kMaxFrameSize = 64 * 1024 * 1024;
+
+// Per-user socket name (in the runtime directory on Unix)
+QString serverName();
+
+QByteArray frame(const QByteArray &payload);
+// Moves the first complete frame of buffer into payload. Returns false if the
+// frame is still incomplete; sets *invalid if the length is out of range.
+bool takeFrame(QByteArray *buffer, QByteArray *payload, bool *invalid);
+
+// Canonical form used to compare vault paths across processes
+QString normalizedVaultPath(const QString &path);
+
+} // namespace AgentProtocol
+
+class UnlockAgent : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit UnlockAgent(QObject *parent = nullptr);
+    ~UnlockAgent() override;
+
+    // Takes over the decrypted document (it is wiped) and starts listening.
+    // ttlSeconds <= 0 keeps the vault until an explicit lock.
+    bool start(const QString &vaultPath, QByteArray *document, int ttlSeconds, QString *errorMessage);
+
+signals:
+    void locked();
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void lock();
+
+private:
+    QByteArray handleRequest(const QByteArray &request);
+    bool vaultIsCurrent() const;
+    bool peerIsCurrentUser(QLocalSocket *socket) const;
+
+    QLocalServer m_server;
+    QHash<QLocalSocket*, QByteArray> m_buffers; // Partial frames per connection
+    QTimer m_ttlTimer;
+    QDeadlineTimer m_deadline;
+    QString m_vaultPath;
+    qint64 m_vaultSize = -1;        // File size and mtime at unlock, to notice saves from elsewhere
+    QDateTime m_vaultModified;
+    SecureString m_document;        // For Document requests (the GUI's open path)
+    VaultSnapshot m_snapshot;       // For Get/Find
+};
+
+// Blocking client used by the command line and the GUI. Every call returns
+// Reply::NoAgent quickly when no agent is running.
+class AgentClient
+{
+public:
+    static AgentProtocol::Reply status(QString *vaultPath, qint64 *secondsLeft, quint32 *entryCount);
+    static AgentProtocol::Reply get(const QString &vaultPath, const QString &entryPath, const QString &field, QString *value);
+    static AgentProtocol::Reply find(const QString &vaultPath, const QString &text, QStringList *entryPaths);
+    static AgentProtocol::Reply matchUrl(const QString &vaultPath, const QString &url, QStringList *entryPaths);
+    static AgentProtocol::Reply document(const QString &vaultPath, QByteArray *document);
+    static AgentProtocol::Reply lock();
+
+private:
+    static AgentProtocol::Reply request(const QByteArray &payload, QByteArray *replyData);
+};
+
+#endif // UNLOCKAGENT_H
@@ -0,0 +1,438 @@
+#include "V1Reader.h"
+#include "ItemId.h"
+#include "PasswordRecord.h"
+#include "StringArena.h"
+#include <QHash>
+#include <QStandardItem>
+#include <QThread>
+#include <QtConcurrent/QtConcurrentMap> // Required for parsing slices on the thread pool
+#include <atomic>
+#include <cstring> // Required for memchr/memcmp
+#include <sodium.h> // Required for sodium_memzero and crypto_generichash
+
+namespace {
+
+// Documents below this size are parsed on the calling thread; handing them to
+// the thread pool would cost more than the parse itself.
+constexpr qsizetype kParallelThreshold = 256 * 1024;
+
+// Number of slices handed to each pool thread, so one slow slice (a folder with
+// huge notes) doesn't leave the other threads idle.
+constexpr int kSlicesPerThread = 4;
+
+struct ByteSpan {
+    const char *begin;
+    const char *end;
+
+    bool isEmpty() const { return begin == end; }
+    qsizetype size() const { return end - begin; }
+};
+
+// Byte length of the whitespace character starting at p, or 0 if there is none.
+// Accepts exactly the code points QChar::isSpace() does, so trimming bytes here
+// gives the same result as QString::trimmed() on the decoded text.
+int spaceLengthAt(const char *p, const char *end)
+{
+    const uchar c = uchar(p[0]);
+    if (c == ' ' || (c >= '\t' && c <= '\r')) {
+        return 1;
+    }
+    if (c < 0xC2 || end - p < 2) {
+        return 0;
+    }
+    const uchar c1 = uchar(p[1]);
+    if (c == 0xC2) { // U+0085, U+00A0
+        return (c1 == 0x85 || c1 == 0xA0) ? 2 : 0;
+    }
+    if (end - p < 3) {
+        return 0;
+    }
+    const uchar c2 = uchar(p[2]);
+    switch (c) {
+        case 0xE1: // U+1680
+            return (c1 == 0x9A && c2 == 0x80) ? 3 : 0;
+        case 0xE2: // U+2000..U+200A, U+2028, U+2029, U+202F, U+205F
+            if (c1 == 0x80) {
+                return ((c2 >= 0x80 && c2 <= 0x8A) || c2 == 0xA8 || c2 == 0xA9 || c2 == 0xAF) ? 3 : 0;
+            }
+            return (c1 == 0x81 && c2 == 0x9F) ? 3 : 0;
+        case 0xE3: // U+3000
+            return (c1 == 0x80 && c2 == 0x80) ? 3 : 0;
+        default:
+            return 0;
+    }
+}
+
+// Byte length of the whitespace character ending right before p, or 0.
+int spaceLengthBefore(const char *begin, const char *p)
+{
+    const uchar c = uchar(p[-1]);
+    if (c < 0x80) {
+        return (c == ' ' || (c >= '\t' && c <= '\r')) ? 1 : 0;
+    }
+    if (c > 0xBF) { // A lead byte can never end a multi-byte character
+        return 0;
+    }
+    for (int length = 2; length <= 3; ++length) {
+        if (p - begin >= length && spaceLengthAt(p - length, p) == length) {
+            return length;
+        }
+    }
+    return 0;
+}
+
+ByteSpan trimmed(ByteSpan s)
+{
+    while (s.begin < s.end) {
+        const int n = spaceLengthAt(s.begin, s.end);
+        if (n == 0) break;
+        s.begin += n;
+    }
+    while (s.end > s.begin) {
+        const int n = spaceLengthBefore(s.begin, s.end);
+        if (n == 0) break;
+        s.end -= n;
+    }
+    return s;
+}
+
+// Indentation only counts plain spaces, like the old QTextStream based parser did.
+int leadingSpaces(ByteSpan s)
+{
+    const char *p = s.begin;
+    while (p < s.end && *p == ' ') {
+        ++p;
+    }
+    return int(p - s.begin);
+}
+
+template <size_t N>
+bool equals(ByteSpan s, const char (&literal)[N])
+{
+    return s.size() == qsizetype(N - 1) && std::memcmp(s.begin, literal, N - 1) == 0;
+}
+
+bool startsWithItemMarker(ByteSpan trimmedLine)
+{
+    return trimmedLine.size() >= 2 && trimmedLine.begin[0] == '-' && trimmedLine.begin[1] == ' ';
+}
+
+QString decode(ByteSpan s)
+{
+    return QString::fromUtf8(s.begin, s.size());
+}
+
+// memchr based line splitter with the same line ending rules as QTextStream::readLine():
+// lines end at '\n', and a '\r' right before it (or at the very end) is dropped.
+class LineReader {
+public:
+    explicit LineReader(ByteSpan data) : m_pos(data.begin), m_end(data.end) {}
+
+    bool atEnd() const { return m_pos == m_end; }
+    const char *pos() const { return m_pos; }
+    void seek(const char *pos) { m_pos = pos; }
+
+    ByteSpan readLine()
+    {
+        const char *newline = static_cast<const char *>(std::memchr(m_pos, '\n', size_t(m_end - m_pos)));
+        ByteSpan line{m_pos, newline ? newline : m_end};
+        m_pos = newline ? newline + 1 : m_end;
+        if (line.end > line.begin && line.end[-1] == '\r') {
+            --line.end;
+        }
+        return line;
+    }
+
+private:
+    const char *m_pos;
+    const char *m_end;
+};
+
+// A line with fewer than two leading spaces can never be part of a notes block,
+// so a "- " item there always resets the parent stack to the root. Slices cut in
+// front of such lines can therefore be parsed independently of each other.
+bool isTopLevelItem(ByteSpan line)
+{
+    return leadingSpaces(line) < 2 && startsWithItemMarker(trimmed(line));
+}
+
+QList<ByteSpan> splitAtTopLevelItems(ByteSpan document, int sliceCount)
+{
+    QList<ByteSpan> slices;
+    const qsizetype targetSize = document.size() / sliceCount;
+    const char *sliceStart = document.begin;
+
+    while (document.end - sliceStart > targetSize) {
+        // Jump ahead by the target size, then look for the next top-level item
+        const char *probe = sliceStart + targetSize;
+        const char *newline = static_cast<const char *>(std::memchr(probe, '\n', size_t(document.end - probe)));
+        if (!newline) break;
+
+        LineReader in(ByteSpan{newline + 1, document.end});
+        const char *cut = nullptr;
+        while (!in.atEnd()) {
+            const char *lineStart = in.pos();
+            if (isTopLevelItem(in.readLine())) {
+                cut = lineStart;
+                break;
+            }
+        }
+        if (!cut) break;
+
+        slices.append(ByteSpan{sliceStart, cut});
+        sliceStart = cut;
+    }
+    slices.append(ByteSpan{sliceStart, document.end});
+    return slices;
+}
+
+// Custom fields are tagged "field.<type>.<key>" and carry a single-line,
+// backslash-escaped value. Malformed tags are skipped like any unknown tag.
+void parseCustomField(ByteSpan key, ByteSpan value, PasswordRecord &record, StringArena *arena)
+{
+    static constexpr char kPrefix[] = "field.";
+    constexpr qsizetype kPrefixLength = sizeof kPrefix - 1;
+    if (key.size() <= kPrefixLength || std::memcmp(key.begin, kPrefix, kPrefixLength) != 0) {
+        return;
+    }
+    const char *typeBegin = key.begin + kPrefixLength;
+    const char *dot = static_cast<const char *>(std::memchr(typeBegin, '.', size_t(key.end - typeBegin)));
+    if (!dot) {
+        return;
+    }
+
+    CustomFieldType type;
+    if (!CustomFieldTypes::fromName(QByteArrayView(typeBegin, dot - typeBegin), &type)) {
+        return;
+    }
+    const FieldKeyId keyId = FieldKeyTable::intern(QByteArrayView(dot + 1, key.end - dot - 1));
+    if (keyId == FieldKeyTable::kInvalidKey) {
+        return;
+    }
+
+    CustomField field{keyId, type, QString(), SecureString()};
+    const QByteArrayView bytes(value.begin, value.size());
+    if (CustomFieldTypes::isSecret(type)) {
+        if (std::memchr(value.begin, '\\', size_t(value.size()))) {
+            QByteArray unescaped = CustomFieldCodec::unescape(bytes);
+            field.secret = SecureString::fromUtf8(unescaped);
+            sodium_memzero(unescaped.data(), size_t(unescaped.size()));
+        } else {
+            field.secret = SecureString::fromUtf8(bytes);
+        }
+    } else if (std::memchr(value.begin, '\\', size_t(value.size()))) {
+        field.value = QString::fromUtf8(CustomFieldCodec::unescape(bytes));
+    } else if (type == CustomFieldType::Text || type == CustomFieldType::Url) {
+        field.value = arena->internUtf8(bytes);
+    } else {
+        field.value = decode(value);
+    }
+    record.customFields.push_back(std::move(field));
+}
+
+void commitRecord(QStandardItem *item, const PasswordRecord &record, std::atomic<bool> *missingIds)
+{
+    if (!record.isEmpty()) {
+        item->setData(QVariant::fromValue(record), Qt::UserRole);
+    }
+    if (ItemId::of(item) == 0) {
+        missingIds->store(true, std::memory_order_relaxed); // Written before ids existed
+    }
+}
+
+quint64 derivedId(quint64 parentId, const QString &name, int occurrence)
+{
+    quint64 id = 0;
+    crypto_generichash_state state;
+    crypto_generichash_init(&state, nullptr, 0, sizeof id);
+    crypto_generichash_update(&state, reinterpret_cast<const unsigned char *>(&parentId), sizeof parentId);
+    crypto_generichash_update(&state, reinterpret_cast<const unsigned char *>(&occurrence), sizeof occurrence);
+    crypto_generichash_update(&state, reinterpret_cast<const unsigned char *>(name.constData()),
+                              std::size_t(name.size()) * sizeof(QChar));
+    crypto_generichash_final(&state, reinterpret_cast<unsigned char *>(&id), sizeof id);
+    return id != 0 ? id : 1;
+}
+
+// Items of files written before ids existed get ids derived from their place in
+// the tree (parent id, name, and how many same-named siblings come before them)
+// instead of random ones, so every parse of the same file gives the same ids.
+// Merging a change on disk depends on that: it compares the tree in memory
+// with a fresh parse of the file the tree was loaded from.
+void deriveMissingIds(const QList<QStandardItem*> &items, quint64 parentId)
+{
+    QHash<QString, int> occurrences;
+    for (QStandardItem *item : items) {
+        const int occurrence = occurrences[item->text()]++;
+        if (ItemId::of(item) == 0) {
+            item->setData(derivedId(parentId, item->text(), occurrence), ItemId::kRole);
+        }
+        QList<QStandardItem*> children;
+        children.reserve(item->rowCount());
+        for (int row = 0; row < item->rowCount(); ++row) {
+            children.append(item->child(row));
+        }
+        deriveMissingIds(children, ItemId::of(item));
+    }
+}
+
+// Parses one slice of the document. Items that the old parser appended to the
+// invisible root item are returned instead, in document order.
+QList<QStandardItem*> parseSlice(const ByteSpan &slice, StringArena *arena, std::atomic<bool> *missingIds)
+{
+    QList<QStandardItem*> topLevelItems;
+    QList<QStandardItem*> parentStack;
+    parentStack.append(nullptr); // nullptr stands for the invisible root item
+
+    QStandardItem *currentItem = nullptr;
+    PasswordRecord currentRecord;
+    LineReader in(slice);
+
+    while (!in.atEnd()) {
+        const ByteSpan line = in.readLine();
+        const ByteSpan trimmedLine = trimmed(line);
+        if (trimmedLine.isEmpty() || trimmedLine.begin[0] == '#') {
+            continue;
+        }
+
+        const int indentation = leadingSpaces(line);
+        const int level = indentation / 2;
+
+        if (startsWithItemMarker(trimmedLine)) {
+            // New item
+            if (currentItem) {
+                commitRecord(currentItem, currentRecord, missingIds);
+                currentRecord = PasswordRecord();
+            }
+
+            currentItem = new QStandardItem(arena->internUtf8(QByteArrayView(trimmedLine.begin + 2, trimmedLine.size() - 2)));
+
+            while (level < parentStack.size() - 1) {
+                parentStack.removeLast();
+            }
+            if (parentStack.last()) {
+                parentStack.last()->appendRow(currentItem);
+            } else {
+                topLevelItems.append(currentItem);
+            }
+            parentStack.append(currentItem);
+
+        } else if (currentItem) {
+            // Part of the current item's record
+            const char *colon = static_cast<const char *>(std::memchr(trimmedLine.begin, ':', size_t(trimmedLine.size())));
+            if (!colon || colon == trimmedLine.begin) {
+                continue;
+            }
+            const ByteSpan key = trimmed(ByteSpan{trimmedLine.begin, colon});
+            const ByteSpan value = trimmed(ByteSpan{colon + 1, trimmedLine.end});
+
+            if (equals(key, "id")) {
+                bool ok = false;
+                const quint64 id = QByteArray::fromRawData(value.begin, value.size()).toULongLong(&ok, 16);
+                if (ok && id != 0) {
+                    currentItem->setData(id, ItemId::kRole);
+                }
+                continue;
+            }
+            if (equals(key, "changed")) {
+                currentRecord.passwordChanged = QByteArray::fromRawData(value.begin, value.size()).toLongLong();
+                continue;
+            }
+            if (equals(key, "history")) {
+                // Kept encoded: revisions are only decoded when an entry's history is shown
+                currentRecord.revisions = SecureString::fromUtf8(QByteArrayView(value.begin, value.size()));
+                continue;
+            }
+            if (equals(key, "attachment")) {
+                Attachment attachment;
+                if (AttachmentCodec::decode(QByteArrayView(value.begin, value.size()), &attachment)) {
+                    currentRecord.attachments.push_back(std::move(attachment));
+                }
+                continue;
+            }
+            const int field = RecordSchema::fieldForKey(key.begin, size_t(key.size()));
+            if (field < 0) {
+                parseCustomField(key, value, currentRecord, arena);
+                continue;
+            }
+
+            const RecordField id = kRecordFields[field].id;
+            if (RecordSchema::hasFlag(size_t(field), FieldShared)) {
+                currentRecord.setValue(id, arena->internUtf8(QByteArrayView(value.begin, value.size())));
+            } else if (!RecordSchema::hasFlag(size_t(field), FieldMultiline)) {
+                if (RecordSchema::hasFlag(size_t(field), FieldSensitive)) {
+                    currentRecord.setSensitiveValue(id, SecureString::fromUtf8(QByteArrayView(value.begin, value.size())));
+                } else {
+                    currentRecord.setValue(id, decode(value));
+                }
+            } else if (equals(value, "|")) {
+                // Block lines must be indented at least one level deeper than the
+                // "key: |" line; the first line that isn't ends the block and is
+                // handed back to the main loop.
+                QByteArray block;
+                bool firstBlockLine = true;
+                while (!in.atEnd()) {
+                    const char *lastPos = in.pos();
+                    const ByteSpan blockLine = in.readLine();
+                    if (leadingSpaces(blockLine) < indentation + 2) {
+                        in.seek(lastPos);
+                        break;
+                    }
+                    if (!firstBlockLine) {
+                        block.append('\n');
+                    }
+                    const ByteSpan blockText = trimmed(blockLine);
+                    block.append(blockText.begin, blockText.size());
+                    firstBlockLine = false;
+                }
+                if (RecordSchema::hasFlag(size_t(field), FieldSensitive)) {
+                    currentRecord.setSensitiveValue(id, SecureString::fromUtf8(block));
+                    sodium_memzero(block.data(), size_t(block.size()));
+                } else {
+                    currentRecord.setValue(id, QString::fromUtf8(block));
+                }
+            }
+        }
+    }
+
+    if (currentItem) {
+        commitRecord(currentItem, currentRecord, missingIds);
+    }
+    return topLevelItems;
+}
+
+} // namespace
+
+QList<QStandardItem*> parseV1Document(const QByteArray &utf8, StringPool *strings)
+{
+    const ByteSpan document{utf8.constData(), utf8.constData() + utf8.size()};
+    std::atomic<bool> missingIds = false;
+    QList<QStandardItem*> topLevelItems;
+    const int threadCount = QThread::idealThreadCount();
+    const QList<ByteSpan> slices = document.size() < kParallelThreshold || threadCount < 2
+                                       ? QList<ByteSpan>{document}
+                                       : splitAtTopLevelItems(document, threadCount * kSlicesPerThread);
+    if (slices.size() == 1) {
+        topLevelItems = parseSlice(document, strings->createArena(), &missingIds);
+    } else {
+        // Each slice interns into an arena of its own so the threads never contend on
+        // a lock; duplicates across slices are rare enough not to matter.
+        const QList<QList<QStandardItem*>> parsedSlices =
+            QtConcurrent::blockingMapped<QList<QList<QStandardItem*>>>(slices, [strings, &missingIds](const ByteSpan &slice) {
+                return parseSlice(slice, strings->createArena(), &missingIds);
+            });
+
+        // Splice the subtrees back together in document order
+        qsizetype total = 0;
+        for (const QList<QStandardItem*> &items : parsedSlices) {
+            total += items.size();
+        }
+        topLevelItems.reserve(total);
+        for (const QList<QStandardItem*> &items : parsedSlices) {
+            topLevelItems.append(items);
+        }
+    }
+    if (missingIds) {
+        deriveMissingIds(topLevelItems, 0); // Needs the whole tree, so after the slices are joined
+    }
+    return topLevelItems;
+}
@@ -0,0 +1,21 @@
+#ifndef V1READER_H
+#define V1READER_H
+
+#include <QByteArray>
+#include <QList>
+
+class QStandardItem;
+class StringPool;
+
+// Parses the decrypted ALOCK_V1 plaintext (the indented "- item" text format)
+// directly from its UTF-8 bytes into detached QStandardItem subtrees.
+//
+// Large documents are cut at top-level "- " items and the slices are parsed on
+// the global thread pool; the resulting subtrees are returned in document order.
+// Item names and the fields marked FieldShared are interned into arenas taken
+// from strings (one per slice), so the returned items must not outlive them.
+// The caller owns the returned items and is expected to hand them to
+// invisibleRootItem()->appendRows() in one go.
+QList<QStandardItem*> parseV1Document(const QByteArray &utf8, StringPool *strings);
+
+#endif // V1READER_H
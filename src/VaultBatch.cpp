@@ -0,0 +1,141 @@
+#include "VaultBatch.h"
+#include "VaultFile.h"
+#include "VaultSnapshot.h"
+#include <QCoreApplication>
+#include <QMutex>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap> // Files side by side on a bounded pool
+#include <algorithm>
+#include <climits>
+#include <sodium.h> // Required for sodium_memzero
+
+namespace {
+
+using VaultBatch::Job;
+using VaultBatch::Operation;
+using VaultBatch::Options;
+
+constexpr qint64 kMemoryUnit = 1024 * 1024; // Semaphore units, so budgets of many GiB fit an int
+
+QString tr(const char *text)
+{
+    return QCoreApplication::translate("VaultBatch", text);
+}
+
+void wipe(QByteArray *data)
+{
+    sodium_memzero(data->data(), size_t(data->size()));
+    data->clear();
+}
+
+void process(Job &job, const Options &options, QSemaphore *memory, int budgetUnits)
+{
+    QByteArray fileContent;
+    VaultFile::Envelope envelope;
+    if (!VaultFile::readFile(job.filePath, &fileContent, &job.detail)
+        || !VaultFile::parse(fileContent, &envelope, &job.detail)) {
+        job.outcome = Job::Failed;
+        return;
+    }
+    const bool rewrite = options.operation == Operation::Rekey
+                         || (options.operation == Operation::Upgrade && (options.force || !VaultFile::isCurrent(envelope)));
+    if (options.operation == Operation::Upgrade && !rewrite) {
+        job.outcome = Job::UpToDate; // Nothing to decrypt
+        return;
+    }
+    const QByteArray &sealPassword = options.operation == Operation::Rekey ? job.newPasswordUtf8 : job.passwordUtf8;
+    if (rewrite && sealPassword.isEmpty()) {
+        job.detail = options.operation == Operation::Rekey ? tr("No new master password given.")
+                                                           : tr("Upgrading needs the master password.");
+        job.outcome = Job::Failed;
+        return;
+    }
+    if (job.document.isEmpty() && job.passwordUtf8.isEmpty()) {
+        job.detail = tr("No master password given, and the unlock agent doesn't hold this vault.");
+        job.outcome = Job::Failed;
+        return;
+    }
+
+    // Opening and sealing run one after the other: the larger of the two is the peak
+    const qint64 need = qMax(job.document.isEmpty() ? VaultFile::kdfMemory(envelope) : 0,
+                             rewrite ? VaultFile::sealKdfMemory() : 0);
+    const int units = memory ? int(std::min<qint64>((need + kMemoryUnit - 1) / kMemoryUnit, budgetUnits)) : 0;
+    if (units > 0) {
+        memory->acquire(units);
+    }
+    const QSemaphoreReleaser releaser(units > 0 ? memory : nullptr, units);
+
+    QByteArray document = std::move(job.document);
+    if (document.isEmpty() && !VaultFile::open(envelope, job.passwordUtf8, &document, &job.detail)) {
+        job.outcome = Job::Failed;
+        return;
+    }
+    if (options.operation == Operation::Verify) {
+        VaultSnapshot snapshot;
+        snapshot.load(document);
+        job.detail = tr("%n entries", nullptr, int(snapshot.entries().size()));
+        job.outcome = Job::Verified;
+    } else {
+        QByteArray sealed;
+        const bool written = VaultFile::seal(document, sealPassword, &sealed, &job.detail)
+                             && VaultFile::write(job.filePath, sealed, &job.detail);
+        job.outcome = !written ? Job::Failed : options.operation == Operation::Rekey ? Job::Rekeyed : Job::Upgraded;
+    }
+    wipe(&document);
+}
+
+} // namespace
+
+namespace VaultBatch {
+
+int run(std::vector<Job> *jobs, const Options &options)
+{
+    QString errorMessage;
+    if (!VaultFile::initCrypto(&errorMessage)) {
+        for (Job &job : *jobs) {
+            job.outcome = Job::Failed;
+            job.detail = errorMessage;
+            wipe(&job.passwordUtf8);
+            wipe(&job.newPasswordUtf8);
+            wipe(&job.document);
+        }
+        return int(jobs->size());
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(options.maxJobs > 0 ? options.maxJobs : QThread::idealThreadCount());
+    const int budgetUnits = options.memoryBudget > 0
+                                ? int(std::clamp<qint64>(options.memoryBudget / kMemoryUnit, 1, INT_MAX))
+                                : 0;
+    QSemaphore memory(budgetUnits);
+    QMutex finishedMutex;
+    int done = 0;
+    QtConcurrent::blockingMap(&pool, *jobs, [&](Job &job) {
+        process(job, options, budgetUnits > 0 ? &memory : nullptr, budgetUnits);
+        wipe(&job.passwordUtf8);
+        wipe(&job.newPasswordUtf8);
+        wipe(&job.document);
+        if (options.finished) {
+            const QMutexLocker locker(&finishedMutex);
+            options.finished(job, ++done);
+        }
+    });
+    return int(std::count_if(jobs->begin(), jobs->end(), [](const Job &job) { return job.outcome == Job::Failed; }));
+}
+
+QString outcomeName(Job::Outcome outcome)
+{
+    switch (outcome) {
+    case Job::Pending: return tr("pending");
+    case Job::Verified: return tr("verified");
+    case Job::Upgraded: return tr("upgraded");
+    case Job::UpToDate: return tr("current");
+    case Job::Rekeyed: return tr("rekeyed");
+    case Job::Failed: return tr("failed");
+    }
+    return QString();
+}
+
+} // namespace VaultBatch
@@ -0,0 +1,52 @@
+#ifndef VAULTBATCH_H
+#define VAULTBATCH_H
+
+#include <QByteArray>
+#include <QString>
+#include <functional>
+#include <vector>
+
+// Verifying, upgrading and re-keying many vault files in one go, for the
+// command line.
+//
+// Each file costs one or two Argon2id runs, which is where both the time and
+// the memory go. Files are processed on a pool of maxJobs threads, and a file
+// only starts once the KDF memory it needs fits into memoryBudget next to the
+// files already running, so a large batch never pushes the machine into swap.
+// Rewritten files replace the old ones atomically (VaultFile::write): an
+// interrupted run leaves each file either as it was or converted.
+namespace VaultBatch {
+
+enum class Operation {
+    Verify,  // Decrypt and parse
+    Upgrade, // Re-seal files whose container or KDF parameters are out of date
+    Rekey,   // Re-seal under a new master password
+};
+
+struct Job {
+    enum Outcome { Pending, Verified, Upgraded, UpToDate, Rekeyed, Failed };
+
+    QString filePath;
+    QByteArray passwordUtf8;    // Master password; may be empty when document is given
+    QByteArray newPasswordUtf8; // Rekey only
+    QByteArray document;        // Decrypted text from the unlock agent, used instead of the password
+    Outcome outcome = Pending;
+    QString detail;             // Entry count, or why it failed
+};
+
+struct Options {
+    Operation operation = Operation::Verify;
+    bool force = false;      // Upgrade files that are current too
+    int maxJobs = 0;         // 0 for the ideal thread count
+    qint64 memoryBudget = 0; // Bytes of KDF memory in use at once; 0 for no limit beyond maxJobs
+    std::function<void(const Job &job, int done)> finished; // Called as each file is done, one call at a time
+};
+
+// Processes every job, wiping its passwords and document. Returns the number that failed.
+int run(std::vector<Job> *jobs, const Options &options);
+
+QString outcomeName(Job::Outcome outcome);
+
+} // namespace VaultBatch
+
+#endif // VAULTBATCH_H
@@ -0,0 +1,227 @@
+#include "VaultFile.h"
+#include <QCoreApplication>
+#include <QFile>
+#include <QSaveFile> // Required for replacing files atomically
+#include <sodium.h> // Required for libsodium cryptography
+
+static_assert(VaultFile::kKeyBytes == crypto_secretbox_KEYBYTES, "kKeyBytes must match crypto_secretbox_KEYBYTES");
+
+namespace {
+
+const char kHeader[] = "ALOCK_V1"; // 8 bytes for header
+constexpr int kHeaderSize = sizeof kHeader - 1;
+
+QString tr(const char *text)
+{
+    return QCoreApplication::translate("VaultFile", text);
+}
+
+void setError(QString *errorMessage, const QString &message)
+{
+    if (errorMessage) {
+        *errorMessage = message;
+    }
+}
+
+} // namespace
+
+namespace VaultFile {
+
+bool initCrypto(QString *errorMessage)
+{
+    if (sodium_init() < 0) {
+        setError(errorMessage, tr("libsodium initialization failed."));
+        return false;
+    }
+    return true;
+}
+
+bool parse(const QByteArray &fileContent, Envelope *envelope, QString *errorMessage)
+{
+    constexpr int kMinimumSize = kHeaderSize + crypto_pwhash_STRBYTES + crypto_pwhash_SALTBYTES
+                                 + crypto_secretbox_NONCEBYTES + crypto_secretbox_MACBYTES;
+    if (!fileContent.startsWith(kHeader) || fileContent.size() < kMinimumSize) {
+        setError(errorMessage, tr("Error: Not a valid ArcaneLock encrypted file (or unknown version)."));
+        return false;
+    }
+    int offset = kHeaderSize;
+    envelope->passwordHash = fileContent.mid(offset, crypto_pwhash_STRBYTES);
+    offset += crypto_pwhash_STRBYTES;
+    envelope->salt = fileContent.mid(offset, crypto_pwhash_SALTBYTES);
+    offset += crypto_pwhash_SALTBYTES;
+    envelope->nonce = fileContent.mid(offset, crypto_secretbox_NONCEBYTES);
+    offset += crypto_secretbox_NONCEBYTES;
+    envelope->ciphertext = fileContent.mid(offset);
+    return true;
+}
+
+bool readFile(const QString &filePath, QByteArray *fileContent, QString *errorMessage)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        setError(errorMessage, tr("Cannot open file %1:\n%2.").arg(filePath, file.errorString()));
+        return false;
+    }
+    *fileContent = file.readAll();
+    return true;
+}
+
+bool read(const QString &filePath, Envelope *envelope, QString *errorMessage)
+{
+    QByteArray fileContent;
+    return readFile(filePath, &fileContent, errorMessage) && parse(fileContent, envelope, errorMessage);
+}
+
+bool verifyPassword(const Envelope &envelope, const QByteArray &passwordUtf8)
+{
+    return crypto_pwhash_str_verify(envelope.passwordHash.constData(),
+                                    passwordUtf8.constData(), passwordUtf8.size()) == 0;
+}
+
+bool isCurrent(const Envelope &envelope)
+{
+    return crypto_pwhash_str_needs_rehash(envelope.passwordHash.constData(), crypto_pwhash_OPSLIMIT_MODERATE,
+                                          crypto_pwhash_MEMLIMIT_MODERATE) == 0;
+}
+
+qint64 kdfMemory(const Envelope &envelope)
+{
+    // The verification hash carries its own cost: "$argon2id$v=19$m=<KiB>,t=<passes>,p=<lanes>$..."
+    const QByteArray hash(envelope.passwordHash.constData());
+    const qsizetype at = hash.indexOf("$m=");
+    const qsizetype end = at >= 0 ? hash.indexOf(',', at) : -1;
+    const qint64 verifyMemory = end > at ? hash.mid(at + 3, end - at - 3).toLongLong() * 1024 : 0;
+    return qMax<qint64>(verifyMemory, crypto_pwhash_MEMLIMIT_MODERATE); // deriveKey() always uses MODERATE
+}
+
+qint64 sealKdfMemory()
+{
+    return crypto_pwhash_MEMLIMIT_MODERATE;
+}
+
+bool deriveKey(const Envelope &envelope, const QByteArray &passwordUtf8, unsigned char *key)
+{
+    return crypto_pwhash(key, kKeyBytes,
+                         passwordUtf8.constData(), passwordUtf8.size(),
+                         reinterpret_cast<const unsigned char*>(envelope.salt.constData()),
+                         crypto_pwhash_OPSLIMIT_MODERATE,
+                         crypto_pwhash_MEMLIMIT_MODERATE,
+                         crypto_pwhash_ALG_ARGON2ID13) == 0;
+}
+
+bool decrypt(const Envelope &envelope, const unsigned char *key, QByteArray *plaintext)
+{
+    plaintext->resize(envelope.ciphertext.size() - crypto_secretbox_MACBYTES);
+    return crypto_secretbox_open_easy(reinterpret_cast<unsigned char*>(plaintext->data()),
+                                      reinterpret_cast<const unsigned char*>(envelope.ciphertext.constData()),
+                                      envelope.ciphertext.size(),
+                                      reinterpret_cast<const unsigned char*>(envelope.nonce.constData()),
+                                      key) == 0;
+}
+
+bool open(const QString &filePath, const QByteArray &passwordUtf8, QByteArray *plaintext, QString *errorMessage)
+{
+    Envelope envelope;
+    if (!initCrypto(errorMessage) || !read(filePath, &envelope, errorMessage)) {
+        return false;
+    }
+    return open(envelope, passwordUtf8, plaintext, errorMessage);
+}
+
+bool open(const Envelope &envelope, const QByteArray &passwordUtf8, QByteArray *plaintext, QString *errorMessage)
+{
+    if (!initCrypto(errorMessage)) {
+        return false;
+    }
+    if (!verifyPassword(envelope, passwordUtf8)) {
+        setError(errorMessage, tr("Incorrect master password."));
+        return false;
+    }
+
+    unsigned char encryptionKey[kKeyBytes];
+    if (!deriveKey(envelope, passwordUtf8, encryptionKey)) {
+        setError(errorMessage, tr("Key derivation failed during decryption."));
+        return false;
+    }
+    const bool decrypted = decrypt(envelope, encryptionKey, plaintext);
+    sodium_memzero(encryptionKey, sizeof encryptionKey);
+    if (!decrypted) {
+        setError(errorMessage, tr("Decryption failed. Data may be corrupted or password incorrect."));
+        return false;
+    }
+    return true;
+}
+
+bool seal(const QByteArray &plaintext, const QByteArray &passwordUtf8, QByteArray *fileContent, QString *errorMessage)
+{
+    if (!initCrypto(errorMessage)) {
+        return false;
+    }
+
+    // 1. Argon2 password hashing for verification (contains its own salt and params)
+    char hashedPasswordStr[crypto_pwhash_STRBYTES];
+    if (crypto_pwhash_str(hashedPasswordStr,
+                          passwordUtf8.constData(), passwordUtf8.size(),
+                          crypto_pwhash_OPSLIMIT_MODERATE,
+                          crypto_pwhash_MEMLIMIT_MODERATE) != 0) {
+        setError(errorMessage, tr("Password hashing for verification failed."));
+        return false;
+    }
+
+    // 2. Generate a separate salt for key derivation
+    Envelope envelope;
+    envelope.passwordHash = QByteArray(hashedPasswordStr, crypto_pwhash_STRBYTES);
+    envelope.salt.resize(crypto_pwhash_SALTBYTES);
+    randombytes_buf(envelope.salt.data(), envelope.salt.size());
+
+    // 3. Derive a raw encryption key from master password and encryption salt
+    unsigned char encryptionKey[kKeyBytes];
+    if (!deriveKey(envelope, passwordUtf8, encryptionKey)) {
+        setError(errorMessage, tr("Key derivation for encryption failed."));
+        return false;
+    }
+
+    // 4. Generate a random nonce
+    envelope.nonce.resize(crypto_secretbox_NONCEBYTES);
+    randombytes_buf(envelope.nonce.data(), envelope.nonce.size());
+
+    // 5. Encrypt the plaintext
+    envelope.ciphertext.resize(plaintext.size() + crypto_secretbox_MACBYTES);
+    const bool encrypted = crypto_secretbox_easy(reinterpret_cast<unsigned char*>(envelope.ciphertext.data()),
+                                                 reinterpret_cast<const unsigned char*>(plaintext.constData()), plaintext.size(),
+                                                 reinterpret_cast<const unsigned char*>(envelope.nonce.constData()),
+                                                 encryptionKey) == 0;
+    sodium_memzero(encryptionKey, sizeof encryptionKey);
+    if (!encrypted) {
+        setError(errorMessage, tr("Encryption failed."));
+        return false;
+    }
+
+    fileContent->clear();
+    fileContent->reserve(kHeaderSize + envelope.passwordHash.size() + envelope.salt.size() + envelope.nonce.size()
+                         + envelope.ciphertext.size());
+    fileContent->append(kHeader, kHeaderSize);
+    fileContent->append(envelope.passwordHash); // Argon2 hash string for verification
+    fileContent->append(envelope.salt);         // Salt for key derivation
+    fileContent->append(envelope.nonce);        // Nonce for encryption
+    fileContent->append(envelope.ciphertext);
+    return true;
+}
+
+bool save(const QString &filePath, const QByteArray &plaintext, const QByteArray &passwordUtf8, QString *errorMessage)
+{
+    QByteArray fileContent;
+    return seal(plaintext, passwordUtf8, &fileContent, errorMessage) && write(filePath, fileContent, errorMessage);
+}
+
+bool write(const QString &filePath, const QByteArray &fileContent, QString *errorMessage)
+{
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(fileContent) != fileContent.size() || !file.commit()) {
+        setError(errorMessage, tr("Cannot write file %1:\n%2.").arg(filePath, file.errorString()));
+        return false;
+    }
+    return true;
+}
+
+} // namespace VaultFile
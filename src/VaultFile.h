@@ -0,0 +1,57 @@
+#ifndef VAULTFILE_H
+#define VAULTFILE_H
+
+#include <QByteArray>
+#include <QString>
+
+// Reading and writing ALOCK_V1 files without any GUI, shared by the main window,
+// the command line and the unlock agent.
+//
+// Layout: "ALOCK_V1" | Argon2id hash string (crypto_pwhash_STRBYTES, used to
+// verify the master password) | KDF salt | secretbox nonce | ciphertext.
+//
+// Functions taking an errorMessage fill it with a translated, user-facing
+// message when they fail.
+namespace VaultFile {
+
+inline constexpr int kKeyBytes = 32; // crypto_secretbox_KEYBYTES
+
+struct Envelope {
+    QByteArray passwordHash; // NUL-padded crypto_pwhash_str() output
+    QByteArray salt;         // Salt of the encryption key derivation
+    QByteArray nonce;
+    QByteArray ciphertext;
+};
+
+bool initCrypto(QString *errorMessage);
+
+bool parse(const QByteArray &fileContent, Envelope *envelope, QString *errorMessage);
+bool readFile(const QString &filePath, QByteArray *fileContent, QString *errorMessage); // The bytes, for parse()
+bool read(const QString &filePath, Envelope *envelope, QString *errorMessage);
+
+// One Argon2id run against the stored hash
+bool verifyPassword(const Envelope &envelope, const QByteArray &passwordUtf8);
+// Whether the stored hash uses the Argon2id parameters seal() uses now
+bool isCurrent(const Envelope &envelope);
+// Peak Argon2id memory in bytes of opening the envelope, and of seal()
+qint64 kdfMemory(const Envelope &envelope);
+qint64 sealKdfMemory();
+// Argon2id with the envelope's salt; key must hold kKeyBytes
+bool deriveKey(const Envelope &envelope, const QByteArray &passwordUtf8, unsigned char *key);
+bool decrypt(const Envelope &envelope, const unsigned char *key, QByteArray *plaintext);
+
+// verifyPassword + deriveKey + decrypt. The caller should wipe plaintext once parsed.
+bool open(const QString &filePath, const QByteArray &passwordUtf8, QByteArray *plaintext, QString *errorMessage);
+bool open(const Envelope &envelope, const QByteArray &passwordUtf8, QByteArray *plaintext, QString *errorMessage);
+
+// Encrypts plaintext under a fresh salt and nonce into the bytes of a file
+bool seal(const QByteArray &plaintext, const QByteArray &passwordUtf8, QByteArray *fileContent, QString *errorMessage);
+// Writes sealed bytes to filePath through a temporary file renamed over it, so
+// the file is always either the old or the new version
+bool write(const QString &filePath, const QByteArray &fileContent, QString *errorMessage);
+// seal() and write() the file.
+bool save(const QString &filePath, const QByteArray &plaintext, const QByteArray &passwordUtf8, QString *errorMessage);
+
+} // namespace VaultFile
+
+#endif // VAULTFILE_H
@@ -0,0 +1,319 @@
+#include "VaultHistory.h"
+#include "ItemId.h"
+#include "PasswordRecord.h"
+#include <QHash>
+#include <algorithm>
+#include <deque>
+
+namespace {
+
+using Tree = VaultHistory::Tree;
+
+// Estimate of the memory a state adds when it is not shared with the model
+// any more: the text and, for entries, the record's field values
+std::size_t stateBytes(const VaultHistory::ItemState &state)
+{
+    std::size_t bytes = std::size_t(state.text.size()) * sizeof(QChar);
+    if (state.record.metaType() == QMetaType::fromType<PasswordRecord>()) {
+        const auto *record = static_cast<const PasswordRecord *>(state.record.constData());
+        bytes += sizeof(PasswordRecord) + record->customFields.size() * sizeof(CustomField);
+        for (const RecordFieldSpec &spec : kRecordFields) {
+            bytes += std::size_t(record->view(spec.id).size()) * sizeof(QChar);
+        }
+    }
+    return bytes;
+}
+
+QStandardItem *materialize(const Tree::Node &node)
+{
+    auto *item = new QStandardItem(node.value.text);
+    if (node.value.record.isValid()) {
+        item->setData(node.value.record, Qt::UserRole);
+    }
+    item->setData(node.value.itemId, ItemId::kRole);
+    if (!node.children.empty()) {
+        QList<QStandardItem *> children;
+        children.reserve(qsizetype(node.children.size()));
+        node.children.forEach([&children](const Tree::NodePtr &child) { children.append(materialize(*child)); });
+        item->appendRows(children);
+    }
+    return item;
+}
+
+// Brings the items under one vault root from one version to another. Subtrees
+// the versions share are skipped without being looked at. Where a folder's
+// children differ, the rows between the common head and tail are taken out
+// and the new ones put back, reusing the taken items by id, so moves don't
+// rebuild what was moved.
+class ItemSync
+{
+public:
+    void run(const Tree::Node &from, const Tree::Node &to, QStandardItem *vaultRoot)
+    {
+        detach(from, to, vaultRoot);
+        while (!m_pending.empty()) {
+            Pending pending = std::move(m_pending.front());
+            m_pending.pop_front();
+            QList<QStandardItem *> rows;
+            rows.reserve(qsizetype(pending.nodes.size()));
+            for (const Tree::NodePtr &node : pending.nodes) {
+                const auto taken = m_taken.find(node->value.id);
+                if (taken == m_taken.end()) {
+                    rows.append(materialize(*node));
+                    continue;
+                }
+                QStandardItem *item = taken->item;
+                const Tree::NodePtr oldNode = taken->node;
+                m_taken.erase(taken);
+                detach(*oldNode, *node, item);
+                rows.append(item);
+            }
+            pending.parent->insertRows(pending.row, rows); // One rowsInserted per folder
+        }
+        for (const Taken &unused : std::as_const(m_taken)) {
+            delete unused.item;
+        }
+        m_taken.clear();
+    }
+
+private:
+    struct Taken {
+        QStandardItem *item;
+        Tree::NodePtr node; // What item shows
+    };
+    struct Pending {
+        QStandardItem *parent;
+        int row;
+        std::vector<Tree::NodePtr> nodes;
+    };
+
+    void detach(const Tree::Node &from, const Tree::Node &to, QStandardItem *item)
+    {
+        if (&from == &to) {
+            return;
+        }
+        if (from.value.revision != to.value.revision) {
+            item->setText(to.value.text);
+            item->setData(to.value.record, Qt::UserRole);
+            item->setData(to.value.itemId, ItemId::kRole);
+        }
+        const Tree::Children &a = from.children;
+        const Tree::Children &b = to.children;
+        if (a.sharesWith(b)) {
+            return;
+        }
+        std::size_t head = 0;
+        while (head < a.size() && head < b.size() && a[head]->value.id == b[head]->value.id) {
+            ++head;
+        }
+        std::size_t tail = 0;
+        while (tail < a.size() - head && tail < b.size() - head
+               && a[a.size() - 1 - tail]->value.id == b[b.size() - 1 - tail]->value.id) {
+            ++tail;
+        }
+        // Rows that keep their place may still have changed further down
+        for (std::size_t i = 0; i < head; ++i) {
+            if (a[i] != b[i]) detach(*a[i], *b[i], item->child(int(i)));
+        }
+        for (std::size_t i = 0; i < tail; ++i) {
+            const std::size_t oldRow = a.size() - 1 - i;
+            const std::size_t newRow = b.size() - 1 - i;
+            if (a[oldRow] != b[newRow]) detach(*a[oldRow], *b[newRow], item->child(int(oldRow)));
+        }
+        for (std::size_t row = a.size() - tail; row-- > head;) {
+            const QList<QStandardItem *> taken = item->takeRow(int(row));
+            m_taken.insert(a[row]->value.id, Taken{taken.first(), a[row]});
+        }
+        if (b.size() - tail > head) {
+            Pending pending{item, int(head), {}};
+            pending.nodes.reserve(b.size() - tail - head);
+            for (std::size_t row = head; row < b.size() - tail; ++row) {
+                pending.nodes.push_back(b[row]);
+            }
+            m_pending.push_back(std::move(pending));
+        }
+    }
+
+    QHash<quint64, Taken> m_taken;
+    std::deque<Pending> m_pending;
+};
+
+} // namespace
+
+VaultHistory::VaultHistory(std::size_t budgetBytes)
+    : m_budgetBytes(budgetBytes)
+{
+}
+
+VaultHistory::Path VaultHistory::pathOf(const QStandardItem *item)
+{
+    Path path;
+    for (; item && item->parent(); item = item->parent()) {
+        path.push_back(std::size_t(item->row()));
+    }
+    if (!path.empty()) {
+        path.pop_back(); // The last row was the vault root's among the vaults
+    }
+    return Path(path.rbegin(), path.rend());
+}
+
+QStandardItem *VaultHistory::itemAt(QStandardItem *vaultRoot, const Path &path)
+{
+    QStandardItem *item = vaultRoot;
+    for (std::size_t row : path) {
+        if (!item->hasChildren()) {
+            break;
+        }
+        item = item->child(int(std::min(row, std::size_t(item->rowCount() - 1))));
+    }
+    return item;
+}
+
+VaultHistory::ItemState VaultHistory::stateOf(const QStandardItem *item)
+{
+    ItemState state;
+    state.id = m_nextId++;
+    state.revision = m_nextRevision++;
+    state.text = item->text();
+    state.record = item->data(Qt::UserRole);
+    state.itemId = item->data(ItemId::kRole);
+    return state;
+}
+
+VaultHistory::Tree::NodePtr VaultHistory::mirror(const QStandardItem *item, std::size_t *bytes)
+{
+    auto node = std::make_shared<Tree::Node>();
+    node->value = stateOf(item);
+    std::vector<Tree::NodePtr> children;
+    children.reserve(std::size_t(item->rowCount()));
+    for (int row = 0; row < item->rowCount(); ++row) {
+        children.push_back(mirror(item->child(row), bytes));
+    }
+    node->children = Tree::Children::fromVector(children, bytes);
+    *bytes += Tree::nodeBytes(*node);
+    return node;
+}
+
+void VaultHistory::prepare(const QStandardItem *vaultRoot)
+{
+    if (!m_versions.empty()) {
+        return;
+    }
+    std::size_t mirrorBytes = 0; // Shared with the model; the steps are what the budget is for
+    m_working = mirror(vaultRoot, &mirrorBytes);
+    m_versions.push_back(Version{m_working, QString(), Path(), Path(), 0});
+    m_position = 0;
+    m_pendingBytes = 0;
+    m_bytes = 0;
+}
+
+void VaultHistory::reset()
+{
+    m_versions.clear();
+    m_working.reset();
+    m_position = 0;
+    m_pendingBytes = 0;
+    m_bytes = 0;
+}
+
+void VaultHistory::updated(const QStandardItem *item)
+{
+    const Path path = pathOf(item);
+    ItemState state = stateOf(item);
+    state.id = Tree::at(m_working, path)->value.id;
+    m_pendingBytes += stateBytes(state);
+    m_working = Tree::update(m_working, path, std::move(state), &m_pendingBytes);
+}
+
+void VaultHistory::inserted(const QStandardItem *item)
+{
+    Path path = pathOf(item);
+    const std::size_t row = path.back();
+    path.pop_back();
+    Tree::NodePtr node = mirror(item, &m_pendingBytes);
+    m_working = Tree::insert(m_working, path, row, std::move(node), &m_pendingBytes);
+}
+
+void VaultHistory::removed(const Path &path)
+{
+    Tree::NodePtr node;
+    m_working = Tree::remove(m_working, path, &node, &m_pendingBytes);
+}
+
+void VaultHistory::moved(const Path &from, const QStandardItem *item)
+{
+    put(take(from), item);
+}
+
+VaultHistory::Subtree VaultHistory::take(const Path &path)
+{
+    Subtree subtree;
+    m_working = Tree::remove(m_working, path, &subtree, &m_pendingBytes);
+    return subtree;
+}
+
+void VaultHistory::put(Subtree subtree, const QStandardItem *item)
+{
+    Path to = pathOf(item);
+    const std::size_t row = to.back();
+    to.pop_back();
+    m_working = Tree::insert(m_working, to, row, std::move(subtree), &m_pendingBytes);
+}
+
+void VaultHistory::commit(const QString &label, const Path &before, const Path &after)
+{
+    if (m_working == m_versions[m_position].root) {
+        return; // Nothing was replayed
+    }
+    // A new step makes the undone ones unreachable
+    for (std::size_t i = m_position + 1; i < m_versions.size(); ++i) {
+        m_bytes -= m_versions[i].bytes;
+    }
+    m_versions.resize(m_position + 1);
+    m_versions.push_back(Version{m_working, label, before, after, m_pendingBytes});
+    m_position = m_versions.size() - 1;
+    m_bytes += m_pendingBytes;
+    m_pendingBytes = 0;
+    trimToBudget();
+}
+
+void VaultHistory::trimToBudget()
+{
+    // Dropping the oldest version frees roughly what the step after it copied
+    while (m_bytes > m_budgetBytes && m_position > 0) {
+        m_bytes -= m_versions[1].bytes;
+        m_versions[1].bytes = 0; // Now the base version
+        m_versions.erase(m_versions.begin());
+        --m_position;
+    }
+}
+
+bool VaultHistory::undo(QStandardItem *vaultRoot, QString *label, Path *focus)
+{
+    if (!canUndo()) {
+        return false;
+    }
+    const Version &step = m_versions[m_position];
+    *label = step.label;
+    *focus = step.before;
+    const Tree::NodePtr current = step.root;
+    --m_position;
+    m_working = m_versions[m_position].root;
+    ItemSync().run(*current, *m_working, vaultRoot);
+    return true;
+}
+
+bool VaultHistory::redo(QStandardItem *vaultRoot, QString *label, Path *focus)
+{
+    if (!canRedo()) {
+        return false;
+    }
+    const Tree::NodePtr current = m_versions[m_position].root;
+    ++m_position;
+    const Version &step = m_versions[m_position];
+    *label = step.label;
+    *focus = step.after;
+    m_working = step.root;
+    ItemSync().run(*current, *m_working, vaultRoot);
+    return true;
+}
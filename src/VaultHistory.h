@@ -0,0 +1,101 @@
+#ifndef VAULTHISTORY_H
+#define VAULTHISTORY_H
+
+#include <QString>
+#include <QStandardItem>
+#include <QVariant>
+#include <cstddef>
+#include <vector>
+
+#include "model/PersistentTree.hpp"
+
+// Undo and redo for one vault.
+//
+// The history mirrors the vault's items in a PersistentTree: every version of
+// the vault is a root, and an edit only copies the nodes on its path plus, at
+// each of them, the chunks of the child list leading to the next one. A step
+// therefore costs O(depth * log fanout) however large the vault and its
+// folders are. Item texts and records are implicitly shared with the model,
+// not duplicated.
+//
+// The main window changes the QStandardItemModel as before and then replays
+// the same change here (updated/inserted/removed/moved), closing the step with
+// commit(). Undo and redo switch to another root and bring the items in line
+// with it, visiting only the subtrees that differ between the two versions.
+//
+// Old steps are dropped once the estimated memory they hold passes the budget,
+// however many steps that is.
+class VaultHistory
+{
+public:
+    struct ItemState {
+        quint64 id = 0;       // Stays with the item through edits and moves
+        quint64 revision = 0; // Changes whenever text or record do
+        QString text;
+        QVariant record;      // PasswordRecord, or invalid for folders
+        QVariant itemId;      // ItemId::kRole, so an undone delete comes back as the same item for sync
+    };
+    using Tree = ArcaneLock::PersistentTree<ItemState>;
+    using Path = Tree::Path; // Rows below the vault root
+    using Subtree = Tree::NodePtr;
+
+    static constexpr std::size_t kDefaultBudgetBytes = 32 * 1024 * 1024;
+
+    explicit VaultHistory(std::size_t budgetBytes = kDefaultBudgetBytes);
+
+    static Path pathOf(const QStandardItem *item);
+    // The item at path, or the nearest one above it that still exists
+    static QStandardItem *itemAt(QStandardItem *vaultRoot, const Path &path);
+
+    // Call before changing the vault; mirrors it the first time
+    void prepare(const QStandardItem *vaultRoot);
+    // Forget all steps, e.g. after the vault was replaced wholesale
+    void reset();
+
+    // Replays of changes already made to the items
+    void updated(const QStandardItem *item);            // Text or record of item
+    void inserted(const QStandardItem *item);           // item, with its children, is new
+    void removed(const Path &path);                     // The item that was at path is gone
+    void moved(const Path &from, const QStandardItem *item); // item was taken from `from`
+    // Moves of several items at once: take them all, last in tree order first,
+    // then put each back in the order of their new positions
+    Subtree take(const Path &path);
+    void put(Subtree subtree, const QStandardItem *item); // item now holds the taken subtree
+    // Ends the step. before/after are where the user was looking before and
+    // after the change; undo and redo return to them.
+    void commit(const QString &label, const Path &before, const Path &after);
+
+    bool canUndo() const { return m_position > 0; }
+    bool canRedo() const { return m_position + 1 < m_versions.size(); }
+    // Bring vaultRoot's items to the previous/next version; *label names the
+    // step and *focus is where to put the cursor
+    bool undo(QStandardItem *vaultRoot, QString *label, Path *focus);
+    bool redo(QStandardItem *vaultRoot, QString *label, Path *focus);
+
+    std::size_t bytes() const { return m_bytes; }
+    std::size_t stepCount() const { return m_versions.empty() ? 0 : m_versions.size() - 1; }
+
+private:
+    struct Version {
+        Tree::NodePtr root;
+        QString label;   // Of the step that led here
+        Path before;     // Focus when undoing that step
+        Path after;      // Focus when redoing it
+        std::size_t bytes = 0; // Nodes and child-list chunks the step copied, plus the values it brought in
+    };
+
+    Tree::NodePtr mirror(const QStandardItem *item, std::size_t *bytes);
+    ItemState stateOf(const QStandardItem *item);
+    void trimToBudget();
+
+    std::size_t m_budgetBytes;
+    std::vector<Version> m_versions; // Oldest first; empty until prepare()
+    std::size_t m_position = 0;      // Index of the version the items show
+    Tree::NodePtr m_working;         // Root including the replays of the open step
+    std::size_t m_pendingBytes = 0;
+    std::size_t m_bytes = 0;         // Sum over the kept steps
+    quint64 m_nextId = 1;
+    quint64 m_nextRevision = 1;
+};
+
+#endif // VAULTHISTORY_H
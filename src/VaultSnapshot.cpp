@@ -0,0 +1,103 @@
+#include "VaultSnapshot.h"
+#include "V1Reader.h"
+#include "SearchQuery.h"
+#include <algorithm>
+#include <QStandardItem>
+#include <functional> // Required for std::function for recursive lambda
+
+void VaultSnapshot::load(const QByteArray &document)
+{
+    clear();
+    const QList<QStandardItem*> topLevelItems = parseV1Document(document, &m_strings);
+
+    std::function<void(QStandardItem *, const QString &)> collect = [&](QStandardItem *item, const QString &parentPath) {
+        const QString path = parentPath.isEmpty() ? item->text() : parentPath + u'/' + item->text();
+        if (item->data(Qt::UserRole).canConvert<PasswordRecord>()) {
+            m_entries.push_back(Entry{path, item->data(Qt::UserRole).value<PasswordRecord>()});
+        }
+        for (int i = 0; i < item->rowCount(); ++i) {
+            collect(item->child(i), path);
+        }
+    };
+    for (QStandardItem *item : topLevelItems) {
+        collect(item, QString());
+        delete item;
+    }
+    for (std::size_t i = 0; i < m_entries.size(); ++i) {
+        m_hosts.insert(std::uint32_t(i), m_entries[i].record.view(RecordField::Url));
+    }
+}
+
+void VaultSnapshot::clear()
+{
+    m_entries.clear();
+    m_hosts.clear();
+    m_strings.clear();
+}
+
+const VaultSnapshot::Entry *VaultSnapshot::entry(QStringView path) const
+{
+    const Entry *byName = nullptr;
+    int nameMatches = 0;
+    for (const Entry &candidate : m_entries) {
+        if (candidate.path == path) {
+            return &candidate;
+        }
+        if (candidate.record.view(RecordField::Name) == path) {
+            byName = &candidate;
+            ++nameMatches;
+        }
+    }
+    return nameMatches == 1 ? byName : nullptr;
+}
+
+QStringList VaultSnapshot::search(QStringView text, QString *error) const
+{
+    const SearchQuery query = SearchQuery::parse(text, error);
+    if (query.isEmpty()) {
+        return {};
+    }
+    std::vector<std::pair<int, const Entry *>> hits;
+    for (const Entry &candidate : m_entries) {
+        const qsizetype slash = candidate.path.lastIndexOf(u'/');
+        const QStringView folderPath = slash < 0 ? QStringView() : QStringView(candidate.path).left(slash);
+        const int score = query.score(candidate.record, folderPath);
+        if (score != FuzzyMatcher::kNoMatch) {
+            hits.emplace_back(score, &candidate);
+        }
+    }
+    // Best first; equal scores keep vault order
+    std::stable_sort(hits.begin(), hits.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+    QStringList paths;
+    paths.reserve(qsizetype(hits.size()));
+    for (const auto &hit : hits) {
+        paths.append(hit.second->path);
+    }
+    return paths;
+}
+
+QStringList VaultSnapshot::matchUrl(QStringView url, HostIndex::Match *match) const
+{
+    QStringList paths;
+    for (std::uint32_t entry : m_hosts.lookup(url, match)) {
+        paths.append(m_entries[entry].path);
+    }
+    return paths;
+}
+
+bool VaultSnapshot::fieldValue(const PasswordRecord &record, QStringView fieldName, QString *value)
+{
+    const QByteArray key = fieldName.toLatin1();
+    const int field = RecordSchema::fieldForKey(key.constData(), size_t(key.size()));
+    if (field >= 0) {
+        *value = record.value(kRecordFields[field].id);
+        return true;
+    }
+    const FieldKeyId keyId = FieldKeyTable::find(fieldName);
+    const CustomField *custom = keyId != FieldKeyTable::kInvalidKey ? record.customField(keyId) : nullptr;
+    if (!custom) {
+        return false;
+    }
+    *value = custom->text().toString();
+    return true;
+}
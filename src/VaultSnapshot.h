@@ -0,0 +1,53 @@
+#ifndef VAULTSNAPSHOT_H
+#define VAULTSNAPSHOT_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include <vector>
+
+#include "HostIndex.h"
+#include "PasswordRecord.h"
+#include "StringArena.h"
+
+// A decrypted vault as a flat list of entries, for the headless users (the
+// command line and the unlock agent) that don't need a QStandardItemModel.
+// Entries are addressed by their path: the item names from the top level down,
+// joined with '/'. Folders are not listed.
+class VaultSnapshot
+{
+public:
+    struct Entry {
+        QString path;
+        PasswordRecord record;
+    };
+
+    VaultSnapshot() = default;
+    VaultSnapshot(const VaultSnapshot &) = delete;
+    VaultSnapshot &operator=(const VaultSnapshot &) = delete;
+
+    void load(const QByteArray &document); // Decrypted V1 text
+    void clear();
+
+    const std::vector<Entry> &entries() const { return m_entries; }
+
+    // Exact path first, then an entry whose name alone equals path if exactly one does
+    const Entry *entry(QStringView path) const;
+    // Paths of the entries matching a search bar query (see SearchQuery), best match first.
+    // An invalid query matches nothing and sets *error.
+    QStringList search(QStringView text, QString *error = nullptr) const;
+    // Paths of the entries whose url is for the host of url, or failing that
+    // a parent host or the same registrable domain (see HostIndex::lookup)
+    QStringList matchUrl(QStringView url, HostIndex::Match *match = nullptr) const;
+
+    // Value of a schema field ("password", "url", ...) or a custom field key
+    static bool fieldValue(const PasswordRecord &record, QStringView fieldName, QString *value);
+
+private:
+    StringPool m_strings; // Declared first so it outlives the entries' interned strings
+    std::vector<Entry> m_entries;
+    HostIndex m_hosts; // Numbered by position in m_entries
+};
+
+#endif // VAULTSNAPSHOT_H
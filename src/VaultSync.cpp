@@ -0,0 +1,593 @@
+#include "VaultSync.h"
+#include "ItemId.h"
+#include "PasswordRecord.h"
+#include "TreeFilterModel.h"
+#include "V1Reader.h"
+#include "VaultFile.h"
+#include "VaultHistory.h"
+#include <QObject>
+#include <QSet>
+#include <QStandardItem>
+#include <algorithm>
+#include <sodium.h> // Required for crypto_generichash and sodium_memzero
+
+namespace {
+
+using VaultSync::Hash;
+using VaultSync::Node;
+using VaultSync::Tree;
+using VaultSync::Conflict;
+
+void hashBytes(crypto_generichash_state *state, const void *data, std::size_t size)
+{
+    crypto_generichash_update(state, static_cast<const unsigned char *>(data), size);
+}
+
+void hashText(crypto_generichash_state *state, QStringView text)
+{
+    const quint64 length = quint64(text.size()); // Keeps "ab"+"c" apart from "a"+"bc"
+    hashBytes(state, &length, sizeof length);
+    hashBytes(state, text.data(), std::size_t(text.size()) * sizeof(QChar));
+}
+
+// Both trees of a merge are hashed in one process, so field key ids can stand
+// in for the key names
+Hash contentHash(const QStandardItem *item)
+{
+    crypto_generichash_state state;
+    crypto_generichash_init(&state, nullptr, 0, sizeof(Hash));
+    hashText(&state, item->text());
+    const QVariant data = item->data(Qt::UserRole);
+    const unsigned char isEntry = data.metaType() == QMetaType::fromType<PasswordRecord>();
+    hashBytes(&state, &isEntry, 1);
+    if (isEntry) {
+        const auto *record = static_cast<const PasswordRecord *>(data.constData());
+        for (const RecordFieldSpec &spec : kRecordFields) {
+            hashText(&state, record->view(spec.id));
+        }
+        for (const CustomField &field : record->customFields) {
+            const unsigned char type = static_cast<unsigned char>(field.type);
+            hashBytes(&state, &field.key, sizeof field.key);
+            hashBytes(&state, &type, 1);
+            hashText(&state, field.text());
+        }
+        for (const Attachment &attachment : record->attachments) {
+            hashText(&state, attachment.name);
+            hashText(&state, attachment.key.view()); // Names the blob; the content hash and size go with it
+        }
+        hashBytes(&state, &record->passwordChanged, sizeof record->passwordChanged);
+        hashText(&state, record->revisions.view());
+    }
+    Hash hash;
+    crypto_generichash_final(&state, hash.data(), hash.size());
+    return hash;
+}
+
+// Copies of the shared copy's strings, which live in a string pool freed after the merge
+QString detached(const QString &text)
+{
+    return QString(text.constData(), text.size());
+}
+
+QVariant detachedRecord(const QVariant &data)
+{
+    if (data.metaType() != QMetaType::fromType<PasswordRecord>()) {
+        return QVariant();
+    }
+    PasswordRecord record = data.value<PasswordRecord>();
+    for (QString &value : record.plainValues) {
+        value = detached(value);
+    }
+    for (CustomField &field : record.customFields) {
+        field.value = detached(field.value);
+    }
+    return QVariant::fromValue(record);
+}
+
+struct Changes {
+    QSet<quint64> edited;    // Text or record differ from the ancestor's
+    QSet<quint64> added;     // Not in the ancestor
+    QSet<quint64> removed;   // Only in the ancestor
+    QSet<quint64> moved;     // Under another parent than in the ancestor
+    QSet<quint64> reordered; // Parents whose rows differ from the ancestor's
+};
+
+// Lists what one side changed since the ancestor, descending only into
+// subtrees whose hashes differ
+class Differ
+{
+public:
+    Differ(const Tree &base, const Tree &side, Changes *changes)
+        : m_base(base), m_side(side), m_changes(changes)
+    {
+    }
+
+    void run() { compare(0); }
+
+private:
+    void compare(quint64 id)
+    {
+        const Node &before = *m_base.node(id);
+        const Node &after = *m_side.node(id);
+        if (before.parent != after.parent) {
+            m_changes->moved.insert(id);
+        }
+        if (before.subtree == after.subtree) {
+            return;
+        }
+        if (before.content != after.content) {
+            m_changes->edited.insert(id);
+        }
+        if (before.children != after.children) {
+            m_changes->reordered.insert(id);
+        }
+        for (quint64 child : after.children) {
+            if (m_base.contains(child)) {
+                compare(child); // Here before, or moved here
+            } else {
+                added(child);
+            }
+        }
+        for (quint64 child : before.children) {
+            if (!m_side.contains(child)) {
+                removed(child); // Not moved elsewhere either
+            }
+        }
+    }
+
+    void added(quint64 id)
+    {
+        m_changes->added.insert(id);
+        for (quint64 child : m_side.node(id)->children) {
+            if (m_base.contains(child)) {
+                compare(child); // Moved into the new folder
+            } else {
+                added(child);
+            }
+        }
+    }
+
+    void removed(quint64 id)
+    {
+        m_changes->removed.insert(id);
+        for (quint64 child : m_base.node(id)->children) {
+            if (!m_side.contains(child)) {
+                removed(child);
+            }
+        }
+    }
+
+    const Tree &m_base;
+    const Tree &m_side;
+    Changes *m_changes;
+};
+
+// Applies the shared copy's changes to the live items. Additions come first so
+// moves and edits find their folders; removals last, after everything that
+// might rescue an item from a removed folder has moved it out.
+class Merger
+{
+public:
+    Merger(QStandardItem *vaultRoot, const Tree &local, const Tree &base, const Tree &remote, VaultHistory *history)
+        : m_root(vaultRoot), m_local(local), m_base(base), m_remote(remote), m_history(history)
+    {
+    }
+
+    VaultSync::Result run()
+    {
+        Differ(m_base, m_local, &m_localChanges).run();
+        Differ(m_base, m_remote, &m_remoteChanges).run();
+        for (quint64 id : std::as_const(m_remoteChanges.added)) {
+            takeAddition(id);
+        }
+        for (quint64 id : std::as_const(m_remoteChanges.edited)) {
+            takeEdit(id);
+        }
+        for (quint64 id : std::as_const(m_remoteChanges.moved)) {
+            takeMove(id);
+        }
+        for (quint64 id : std::as_const(m_remoteChanges.reordered)) {
+            takeOrder(id);
+        }
+        for (quint64 id : std::as_const(m_remoteChanges.removed)) {
+            takeRemoval(id);
+        }
+        return m_result;
+    }
+
+private:
+    // The local item with id, including the ones this merge created or removed
+    QStandardItem *live(quint64 id) const
+    {
+        if (id == 0) {
+            return m_root;
+        }
+        const auto overlay = m_overlay.constFind(id);
+        if (overlay != m_overlay.constEnd()) {
+            return overlay.value();
+        }
+        const Node *node = m_local.node(id);
+        return node ? node->item : nullptr;
+    }
+
+    // The local item with id, created from the shared copy (with the folders
+    // above it) if it isn't here
+    QStandardItem *ensure(quint64 id)
+    {
+        if (QStandardItem *item = live(id)) {
+            return item;
+        }
+        const Node &theirs = *m_remote.node(id);
+        QStandardItem *parent = ensure(theirs.parent);
+        QStandardItem *item = copyOf(*theirs.item, id);
+        parent->insertRow(rowFor(id, parent), item);
+        m_overlay.insert(id, item);
+        m_history->inserted(item);
+        ++m_result.applied;
+        if (m_base.contains(id)) {
+            report(Conflict::DeletedHereEditedThere, item); // Deleted here, but needed for their change
+        }
+        return item;
+    }
+
+    QStandardItem *copyOf(const QStandardItem &source, quint64 id) const
+    {
+        auto *item = new QStandardItem(detached(source.text()));
+        const QVariant record = detachedRecord(source.data(Qt::UserRole));
+        if (record.isValid()) {
+            item->setData(record, Qt::UserRole);
+        }
+        item->setData(id, ItemId::kRole);
+        return item;
+    }
+
+    // After the nearest sibling that precedes id in the shared copy and is here too
+    int rowFor(quint64 id, const QStandardItem *parent) const
+    {
+        const std::vector<quint64> &siblings = m_remote.node(m_remote.node(id)->parent)->children;
+        auto position = std::find(siblings.begin(), siblings.end(), id);
+        while (position != siblings.begin()) {
+            --position;
+            const QStandardItem *sibling = live(*position);
+            if (sibling && sibling->parent() == parent) {
+                return sibling->row() + 1;
+            }
+        }
+        return 0;
+    }
+
+    void report(Conflict::Kind kind, const QStandardItem *item)
+    {
+        const QString folder = TreeFilterModel::folderPath(item);
+        m_result.conflicts.append(Conflict{kind, folder.isEmpty() ? item->text() : folder + u'/' + item->text()});
+    }
+
+    // Both sides changed the item: theirs goes next to ours
+    void keepBoth(QStandardItem *item, const Node &theirs)
+    {
+        if (theirs.item->data(Qt::UserRole).metaType() == QMetaType::fromType<PasswordRecord>()) {
+            const quint64 copyId = ItemId::generate();
+            QStandardItem *copy = copyOf(*theirs.item, copyId);
+            const QString name = QObject::tr("%1 (conflict)").arg(copy->text());
+            PasswordRecord record = copy->data(Qt::UserRole).value<PasswordRecord>();
+            record.setValue(RecordField::Name, name);
+            copy->setText(name);
+            copy->setData(QVariant::fromValue(record), Qt::UserRole);
+            item->parent()->insertRow(item->row() + 1, copy);
+            m_overlay.insert(copyId, copy);
+            m_history->inserted(copy);
+        }
+        report(Conflict::EditedOnBothSides, item); // Folders keep our name
+    }
+
+    void takeAddition(quint64 id)
+    {
+        QStandardItem *item = live(id);
+        if (!item) {
+            ensure(id);
+            return;
+        }
+        // Added on both sides under one id: both synced from another copy before
+        const Node *mine = m_local.node(id);
+        const Node &theirs = *m_remote.node(id);
+        if (mine && mine->content != theirs.content) {
+            keepBoth(item, theirs);
+        }
+    }
+
+    void takeEdit(quint64 id)
+    {
+        QStandardItem *item = live(id);
+        if (!item) {
+            ensure(id); // Deleted here: their version comes back, reported
+            return;
+        }
+        const Node &theirs = *m_remote.node(id);
+        const Node *mine = m_local.node(id);
+        if (m_localChanges.edited.contains(id)) {
+            if (mine && mine->content != theirs.content) {
+                keepBoth(item, theirs);
+            }
+            return;
+        }
+        item->setText(detached(theirs.item->text()));
+        item->setData(detachedRecord(theirs.item->data(Qt::UserRole)), Qt::UserRole);
+        m_history->updated(item);
+        ++m_result.applied;
+    }
+
+    void takeMove(quint64 id)
+    {
+        QStandardItem *item = live(id);
+        if (!item) {
+            return; // Deleted here; a move alone doesn't bring it back
+        }
+        const Node &theirs = *m_remote.node(id);
+        const Node *mine = m_local.node(id);
+        if (m_localChanges.moved.contains(id) && mine && mine->parent != theirs.parent) {
+            report(Conflict::MovedOnBothSides, item);
+            return;
+        }
+        QStandardItem *parent = ensure(theirs.parent);
+        if (item->parent() == parent) {
+            return;
+        }
+        for (const QStandardItem *above = parent; above; above = above->parent()) {
+            if (above == item) {
+                report(Conflict::MovedOnBothSides, item); // Our moves put their target inside it
+                return;
+            }
+        }
+        const VaultHistory::Path from = VaultHistory::pathOf(item);
+        item->parent()->takeRow(item->row());
+        parent->insertRow(rowFor(id, parent), item);
+        m_history->moved(from, item);
+        ++m_result.applied;
+    }
+
+    // Puts the rows both sides have in their order, in the places those rows
+    // take here; rows only we have stay where they are
+    void takeOrder(quint64 id)
+    {
+        QStandardItem *parent = live(id);
+        if (!parent || m_localChanges.reordered.contains(id)) {
+            return; // Both changed this folder's rows: ours stay, their moves were placed above
+        }
+        QHash<quint64, int> rank;
+        const std::vector<quint64> &order = m_remote.node(id)->children;
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            rank.insert(order[i], int(i));
+        }
+        const int count = parent->rowCount();
+        std::vector<QStandardItem *> current(std::size_t(count), nullptr);
+        std::vector<int> slots;
+        std::vector<QStandardItem *> ranked;
+        for (int row = 0; row < count; ++row) {
+            current[std::size_t(row)] = parent->child(row);
+            if (rank.contains(ItemId::of(parent->child(row)))) {
+                slots.push_back(row);
+                ranked.push_back(parent->child(row));
+            }
+        }
+        std::stable_sort(ranked.begin(), ranked.end(), [&rank](const QStandardItem *a, const QStandardItem *b) {
+            return rank.value(ItemId::of(a)) < rank.value(ItemId::of(b));
+        });
+        std::vector<QStandardItem *> wanted = current;
+        for (std::size_t i = 0; i < slots.size(); ++i) {
+            wanted[std::size_t(slots[i])] = ranked[i];
+        }
+        int first = 0;
+        while (first < count && wanted[std::size_t(first)] == current[std::size_t(first)]) {
+            ++first;
+        }
+        if (first == count) {
+            return;
+        }
+        int last = count - 1;
+        while (wanted[std::size_t(last)] == current[std::size_t(last)]) {
+            --last;
+        }
+
+        // Same take-then-put replay as a batched move
+        QHash<const QStandardItem *, VaultHistory::Subtree> subtrees;
+        for (int row = last; row >= first; --row) {
+            subtrees.insert(current[std::size_t(row)], m_history->take(VaultHistory::pathOf(current[std::size_t(row)])));
+        }
+        for (int row = last; row >= first; --row) {
+            parent->takeRow(row);
+        }
+        parent->insertRows(first, QList<QStandardItem *>(wanted.begin() + first, wanted.begin() + last + 1));
+        for (int row = first; row <= last; ++row) {
+            m_history->put(subtrees.value(wanted[std::size_t(row)]), wanted[std::size_t(row)]);
+        }
+        ++m_result.applied;
+    }
+
+    void takeRemoval(quint64 id)
+    {
+        QStandardItem *item = live(id);
+        if (!item) {
+            return; // Deleted here too
+        }
+        const quint64 baseParent = m_base.node(id)->parent;
+        if (m_remoteChanges.removed.contains(baseParent) && live(baseParent) && item->parent() == live(baseParent)) {
+            return; // Goes, or stays, with its folder
+        }
+        if (changedHere(item)) {
+            report(Conflict::EditedHereDeletedThere, item);
+            return;
+        }
+        const VaultHistory::Path path = VaultHistory::pathOf(item);
+        forget(item);
+        item->parent()->removeRow(item->row());
+        m_history->removed(path);
+        ++m_result.applied;
+    }
+
+    // Whether the subtree holds anything changed here (or by this merge) that removing it would lose
+    bool changedHere(const QStandardItem *item) const
+    {
+        const quint64 id = ItemId::of(item);
+        if (m_localChanges.edited.contains(id) || m_localChanges.added.contains(id)
+            || m_localChanges.moved.contains(id) || m_overlay.contains(id)) {
+            return true;
+        }
+        for (int row = 0; row < item->rowCount(); ++row) {
+            if (changedHere(item->child(row))) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void forget(const QStandardItem *item)
+    {
+        m_overlay.insert(ItemId::of(item), nullptr);
+        for (int row = 0; row < item->rowCount(); ++row) {
+            forget(item->child(row));
+        }
+    }
+
+    QStandardItem *m_root;
+    const Tree &m_local;
+    const Tree &m_base;
+    const Tree &m_remote;
+    VaultHistory *m_history;
+    Changes m_localChanges;
+    Changes m_remoteChanges;
+    QHash<quint64, QStandardItem *> m_overlay; // Items created (or removed: nullptr) by this merge
+    VaultSync::Result m_result;
+};
+
+} // namespace
+
+namespace VaultSync {
+
+void HashCache::invalidate(const QStandardItem *item)
+{
+    for (; item; item = item->parent()) {
+        m_entries.remove(item);
+    }
+}
+
+void HashCache::forget(const QStandardItem *item)
+{
+    m_entries.remove(item);
+    for (int row = 0; row < item->rowCount(); ++row) {
+        if (const QStandardItem *child = item->child(row)) {
+            forget(child);
+        }
+    }
+}
+
+Tree Tree::build(QStandardItem *vaultRoot, HashCache *cache)
+{
+    Tree tree;
+    tree.add(vaultRoot, 0, 0, cache);
+    return tree;
+}
+
+Hash Tree::add(QStandardItem *item, quint64 id, quint64 parent, HashCache *cache)
+{
+    Node node;
+    node.parent = parent;
+    node.item = item;
+    HashCache::Entry hashes;
+    bool reused = false;
+    if (cache) {
+        const auto cached = cache->m_entries.constFind(item);
+        reused = cached != cache->m_entries.constEnd();
+        if (reused) {
+            hashes = cached.value();
+        }
+    }
+    if (!reused && id != 0) {
+        hashes.content = contentHash(item); // The vault root's label is not vault data
+    }
+    crypto_generichash_state state;
+    if (!reused) {
+        crypto_generichash_init(&state, nullptr, 0, sizeof(Hash));
+        hashBytes(&state, hashes.content.data(), hashes.content.size());
+    }
+    node.children.reserve(std::size_t(item->rowCount()));
+    for (int row = 0; row < item->rowCount(); ++row) {
+        QStandardItem *child = item->child(row);
+        const quint64 childId = ItemId::of(child);
+        const Hash childHash = add(child, childId, id, cache);
+        node.children.push_back(childId);
+        if (!reused) {
+            hashBytes(&state, &childId, sizeof childId);
+            hashBytes(&state, childHash.data(), childHash.size());
+        }
+    }
+    if (!reused) {
+        crypto_generichash_final(&state, hashes.subtree.data(), hashes.subtree.size());
+        if (cache) {
+            cache->m_entries.insert(item, hashes);
+        }
+    }
+    node.content = hashes.content;
+    node.subtree = hashes.subtree;
+    m_nodes.insert(id, std::move(node));
+    return hashes.subtree;
+}
+
+const Node *Tree::node(quint64 id) const
+{
+    const auto found = m_nodes.constFind(id);
+    return found == m_nodes.constEnd() ? nullptr : &found.value();
+}
+
+Hash Tree::hash() const
+{
+    const Node *root = node(0);
+    return root ? root->subtree : Hash{};
+}
+
+QString describe(const Conflict &conflict)
+{
+    switch (conflict.kind) {
+    case Conflict::EditedOnBothSides:
+        return QObject::tr("%1: changed on both sides; entries got their version as a copy").arg(conflict.path);
+    case Conflict::EditedHereDeletedThere:
+        return QObject::tr("%1: deleted in the shared copy but changed here; kept").arg(conflict.path);
+    case Conflict::DeletedHereEditedThere:
+        return QObject::tr("%1: deleted here but changed in the shared copy; restored").arg(conflict.path);
+    case Conflict::MovedOnBothSides:
+        return QObject::tr("%1: moved on both sides; left where it is here").arg(conflict.path);
+    }
+    return conflict.path;
+}
+
+Result merge(QStandardItem *vaultRoot, const Tree &local, const Tree &base, const Tree &remote, VaultHistory *history)
+{
+    return Merger(vaultRoot, local, base, remote, history).run();
+}
+
+bool readCopy(const QByteArray &fileContent, const QByteArray &passwordUtf8, StringPool *strings,
+              QStandardItem *root, QString *errorMessage)
+{
+    VaultFile::Envelope envelope;
+    QByteArray plaintext;
+    if (!VaultFile::parse(fileContent, &envelope, errorMessage)
+        || !VaultFile::open(envelope, passwordUtf8, &plaintext, errorMessage)) {
+        return false;
+    }
+    const QList<QStandardItem *> items = parseV1Document(plaintext, strings);
+    sodium_memzero(plaintext.data(), size_t(plaintext.size()));
+    if (!items.isEmpty()) {
+        root->appendRows(items);
+    }
+    return true;
+}
+
+QByteArray digest(const QByteArray &fileContent)
+{
+    QByteArray hash(crypto_generichash_BYTES, Qt::Uninitialized);
+    crypto_generichash(reinterpret_cast<unsigned char *>(hash.data()), size_t(hash.size()),
+                       reinterpret_cast<const unsigned char *>(fileContent.constData()), size_t(fileContent.size()),
+                       nullptr, 0);
+    return hash;
+}
+
+} // namespace VaultSync
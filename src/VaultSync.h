@@ -0,0 +1,123 @@
+#ifndef VAULTSYNC_H
+#define VAULTSYNC_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <array>
+#include <vector>
+
+class QStandardItem;
+class StringPool;
+class VaultHistory;
+
+// Three-way merge of a vault with the copy kept in a shared directory.
+//
+// Items are matched by their stable id (see ItemId), not by name or position,
+// between three versions: the local items, the shared copy, and their common
+// ancestor (the shared copy as of the last sync). Each version is summarized
+// as a Merkle tree whose node hash covers the item's own text and record and,
+// in order, the ids and hashes of its children. Diffing a version against the
+// ancestor only descends where hashes differ, so vaults that differ in a few
+// entries cost a few paths, not a walk of every entry. Building the trees does
+// walk every entry: the shared copy and the ancestor are decrypted and hashed
+// whole (the ancestor only when the shared copy changed since the last sync),
+// and the local items are indexed whole but only hashed where they changed
+// since the last build (HashCache).
+//
+// The shared copy's changes are applied to the local items and local changes
+// are kept. Nothing is dropped when both sides touched the same item: the
+// conflict is reported, and for an entry edited on both sides the shared
+// version is added next to the local one.
+namespace VaultSync {
+
+using Hash = std::array<unsigned char, 16>;
+
+struct Node {
+    quint64 parent = 0;            // 0 is the vault root
+    Hash content{};                // Text and record
+    Hash subtree{};                // content, then each child's id and subtree hash
+    std::vector<quint64> children;
+    QStandardItem *item = nullptr; // Built from; only valid while that item is
+};
+
+// Content and subtree hashes of live items, kept from one Tree::build to the
+// next so that only the items that changed since, and the folders above them,
+// are hashed again. Building still walks every item to index it by id; what
+// the cache saves is the hashing of text and records, the bulk of the cost.
+//
+// Its owner reports every change to the items: invalidate() an item whose text
+// or data changed, and the parent of rows inserted or removed; forget() rows
+// as they are inserted or about to be removed, since a freed item's address
+// may come back as another item.
+class HashCache
+{
+public:
+    void invalidate(const QStandardItem *item); // item and the folders above it
+    void forget(const QStandardItem *item);     // item and everything below it
+    void clear() { m_entries.clear(); }
+
+private:
+    friend class Tree;
+
+    struct Entry {
+        Hash content{};
+        Hash subtree{};
+    };
+
+    QHash<const QStandardItem *, Entry> m_entries;
+};
+
+class Tree
+{
+public:
+    // Every item below vaultRoot must have an id (ItemId::kRole).
+    // Hashes found in cache are reused and the others are added to it.
+    static Tree build(QStandardItem *vaultRoot, HashCache *cache = nullptr);
+
+    const Node *node(quint64 id) const; // id 0 is the vault root; nullptr if absent
+    bool contains(quint64 id) const { return m_nodes.contains(id); }
+    Hash hash() const; // Of the whole vault
+    qsizetype size() const { return m_nodes.size(); }
+
+private:
+    Hash add(QStandardItem *item, quint64 id, quint64 parent, HashCache *cache); // Returns the subtree hash
+
+    QHash<quint64, Node> m_nodes;
+};
+
+struct Conflict {
+    enum Kind {
+        EditedOnBothSides,      // Entries: the shared version was added as a copy
+        EditedHereDeletedThere, // Kept here
+        DeletedHereEditedThere, // Restored from the shared copy
+        MovedOnBothSides,       // Left where it is here
+    };
+    Kind kind;
+    QString path; // Where the item is now, '/'-separated
+};
+
+QString describe(const Conflict &conflict);
+
+struct Result {
+    QList<Conflict> conflicts;
+    int applied = 0; // Changes taken over from the shared copy
+};
+
+// Applies the changes remote made since base to the items below vaultRoot,
+// which local describes, replaying each into history (already prepared; the
+// caller commits the step).
+Result merge(QStandardItem *vaultRoot, const Tree &local, const Tree &base, const Tree &remote, VaultHistory *history);
+
+// Decrypts a copy of the vault and appends its items to root. The items intern
+// into strings; merge() copies what it takes out of them.
+bool readCopy(const QByteArray &fileContent, const QByteArray &passwordUtf8, StringPool *strings,
+              QStandardItem *root, QString *errorMessage);
+
+// Identifies the bytes of a shared copy, to notice whether it changed
+QByteArray digest(const QByteArray &fileContent);
+
+} // namespace VaultSync
+
+#endif // VAULTSYNC_H
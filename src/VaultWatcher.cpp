@@ -0,0 +1,149 @@
+#include "VaultWatcher.h"
+#include <QFile>
+#include <QFileInfo>
+#include <utility>
+#include <sodium.h> // Required for crypto_generichash
+
+namespace {
+
+constexpr qint64 kHeaderBytes = 256; // Past the magic, password hash, salt and nonce of an ALOCK_V1 file
+constexpr int kSettleMs = 300;       // Quiet time before a check, for writers still at it
+
+} // namespace
+
+VaultWatcher::VaultWatcher(QObject *parent)
+    : QObject(parent)
+{
+    m_settleTimer.setSingleShot(true);
+    m_settleTimer.setInterval(kSettleMs);
+    connect(&m_watcher, &QFileSystemWatcher::fileChanged, this, &VaultWatcher::onPathChanged);
+    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, &VaultWatcher::onPathChanged);
+    connect(&m_settleTimer, &QTimer::timeout, this, &VaultWatcher::checkPending);
+}
+
+QByteArray VaultWatcher::headerDigest(const QByteArray &bytes)
+{
+    QByteArray digest(16, Qt::Uninitialized);
+    crypto_generichash(reinterpret_cast<unsigned char *>(digest.data()), size_t(digest.size()),
+                       reinterpret_cast<const unsigned char *>(bytes.constData()),
+                       size_t(qMin<qint64>(bytes.size(), kHeaderBytes)), nullptr, 0);
+    return digest;
+}
+
+void VaultWatcher::watch(const QString &filePath, const QByteArray &fileContent)
+{
+    const QString path = QFileInfo(filePath).absoluteFilePath();
+    Stamp &stamp = m_stamps[path];
+    stamp.size = fileContent.size();
+    stamp.header = headerDigest(fileContent);
+    stamp.modified = QDateTime();
+    stamp.reported.clear();
+    rewatch(path);
+    // The first check notes the time the bytes were written with, or reports
+    // that the file changed while it wasn't watched
+    m_pending.insert(path);
+    m_settleTimer.start();
+}
+
+void VaultWatcher::unwatch(const QString &filePath)
+{
+    const QString path = QFileInfo(filePath).absoluteFilePath();
+    if (!m_stamps.remove(path)) {
+        return;
+    }
+    m_pending.remove(path);
+    m_watcher.removePath(path);
+    const QString directory = QFileInfo(path).absolutePath();
+    for (auto it = m_stamps.cbegin(); it != m_stamps.cend(); ++it) {
+        if (QFileInfo(it.key()).absolutePath() == directory) {
+            return; // Still needed for another vault
+        }
+    }
+    m_watcher.removePath(directory);
+}
+
+void VaultWatcher::unwatchAll()
+{
+    m_stamps.clear();
+    m_pending.clear();
+    const QStringList paths = m_watcher.files() + m_watcher.directories();
+    if (!paths.isEmpty()) {
+        m_watcher.removePaths(paths);
+    }
+}
+
+void VaultWatcher::rewatch(const QString &filePath)
+{
+    if (QFileInfo::exists(filePath) && !m_watcher.files().contains(filePath)) {
+        m_watcher.addPath(filePath);
+    }
+    const QString directory = QFileInfo(filePath).absolutePath();
+    if (!m_watcher.directories().contains(directory)) {
+        m_watcher.addPath(directory);
+    }
+}
+
+bool VaultWatcher::isCurrent(const QString &filePath)
+{
+    const auto it = m_stamps.find(QFileInfo(filePath).absoluteFilePath());
+    if (it == m_stamps.end()) {
+        return true;
+    }
+    const QFileInfo info(it.key());
+    if (!info.exists()) {
+        return true; // Deleted or mid-rename: nothing that saving would overwrite
+    }
+    const QDateTime modified = info.lastModified();
+    if (info.size() == it->size && it->modified.isValid() && modified == it->modified) {
+        return true;
+    }
+    QFile file(it.key());
+    if (info.size() != it->size || !file.open(QIODevice::ReadOnly) || headerDigest(file.read(kHeaderBytes)) != it->header) {
+        return false;
+    }
+    it->modified = modified; // The same bytes, touched or copied
+    return true;
+}
+
+void VaultWatcher::onPathChanged(const QString &path)
+{
+    if (m_stamps.contains(path)) {
+        m_pending.insert(path);
+    } else {
+        // A directory: any of its vaults may have been renamed over
+        for (auto it = m_stamps.cbegin(); it != m_stamps.cend(); ++it) {
+            if (QFileInfo(it.key()).absolutePath() == path) {
+                m_pending.insert(it.key());
+            }
+        }
+    }
+    if (!m_pending.isEmpty()) {
+        m_settleTimer.start(); // Restarts: checks once the writes stop
+    }
+}
+
+void VaultWatcher::checkPending()
+{
+    const QSet<QString> pending = std::exchange(m_pending, {});
+    for (const QString &path : pending) {
+        if (!m_stamps.contains(path)) {
+            continue;
+        }
+        rewatch(path);
+        if (isCurrent(path)) {
+            continue;
+        }
+        // Report each version once, however many events it causes
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        const QByteArray version = headerDigest(file.read(kHeaderBytes)) + QByteArray::number(file.size());
+        Stamp &stamp = m_stamps[path];
+        if (version == stamp.reported) {
+            continue;
+        }
+        stamp.reported = version;
+        emit changed(path);
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef VAULTWATCHER_H
+#define VAULTWATCHER_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QTimer>
+
+// Notices when a mounted vault's file is replaced by someone else: a sync
+// client, another instance, a restore.
+//
+// Each watched file carries a stamp of the bytes this process last read or
+// wrote: their size, a digest of the header (password hash, salt and nonce,
+// which are new with every save) and the modification time seen with them.
+// File system events are collected for a moment, since writers often truncate
+// and rewrite or rename a temporary file into place. The check then compares
+// size and time first, and reads just the header when those differ, so our own
+// saves, touches and copies of the same bytes never get as far as a decrypt.
+// The containing directories are watched too, to catch files renamed into place.
+class VaultWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit VaultWatcher(QObject *parent = nullptr);
+
+    // filePath now holds fileContent; call after every read or write of it
+    void watch(const QString &filePath, const QByteArray &fileContent);
+    void unwatch(const QString &filePath);
+    void unwatchAll();
+
+    // Whether filePath still holds what was last passed to watch(); true for
+    // files that aren't watched
+    bool isCurrent(const QString &filePath);
+
+signals:
+    void changed(const QString &filePath); // Holds other bytes than last passed to watch()
+
+private slots:
+    void onPathChanged(const QString &path);
+    void checkPending();
+
+private:
+    struct Stamp {
+        qint64 size = -1;
+        QByteArray header;  // Digest of the first kHeaderBytes
+        QDateTime modified; // Invalid until seen on disk with these bytes
+        QByteArray reported; // Version last passed to changed()
+    };
+
+    static QByteArray headerDigest(const QByteArray &bytes);
+    void rewatch(const QString &filePath); // After a rename the watcher loses the path
+
+    QFileSystemWatcher m_watcher;
+    QHash<QString, Stamp> m_stamps; // By absolute file path
+    QSet<QString> m_pending;        // Changed since the last check
+    QTimer m_settleTimer;
+};
+
+#endif // VAULTWATCHER_H
@@ -1,8 +1,16 @@
 #include <QApplication>
+#include <QCoreApplication>
 #include "MainWindow.h"
+#include "Cli.h" // Command-line mode (agent, get, find, ...)
 
 int main(int argc, char *argv[])
 {
+    if (argc > 1 && Cli::isCommand(argv[1])) {
+        // No GUI: a plain QCoreApplication also works without a display
+        QCoreApplication app(argc, argv);
+        return Cli::run(app.arguments().mid(1));
+    }
+
     QApplication app(argc, argv);
 
     // Set a dark stylesheet for the entire application
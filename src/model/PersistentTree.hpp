@@ -0,0 +1,359 @@
+#ifndef ARCANE_LOCK_PERSISTENT_TREE_HPP
+#define ARCANE_LOCK_PERSISTENT_TREE_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace ArcaneLock {
+
+// An immutable tree whose edits return a new root instead of changing the old
+// one. Only the nodes on the path from the root to the edited node are copied
+// (path copying); every other subtree is shared between the old and the new
+// version. Keeping a list of roots therefore keeps every version of the tree,
+// and switching versions is a pointer swap.
+//
+// A node's children are themselves an immutable B-tree of chunks (Children),
+// so copying a node on the path copies only the chunks leading to the one
+// child that changed, not the whole child list: an edit costs
+// O(depth * log fanout) rather than O(depth * fanout), which matters for
+// folders holding thousands of entries.
+//
+// A node is addressed by its path: the child index at each level below the
+// root. The empty path is the root itself.
+template <typename Value>
+class PersistentTree {
+public:
+    struct Node;
+    using NodePtr = std::shared_ptr<const Node>;
+    using Path = std::vector<std::size_t>;
+
+    // The child list of a node. Each edit returns a new list sharing every
+    // chunk it didn't touch, and adds the size of the chunks it copied to
+    // *copiedBytes.
+    class Children {
+    public:
+        static constexpr std::size_t kChunkSize = 32; // Most entries per chunk
+
+        Children() = default;
+        static Children fromVector(const std::vector<NodePtr> &nodes, std::size_t *copiedBytes);
+
+        std::size_t size() const { return m_root ? m_root->size : 0; }
+        bool empty() const { return !m_root; }
+        const NodePtr &operator[](std::size_t index) const;
+        // Same list by identity; lists that aren't may still hold the same children
+        bool sharesWith(const Children &other) const { return m_root == other.m_root; }
+        template <typename Visit>
+        void forEach(Visit &&visit) const
+        {
+            if (m_root) visitChunk(*m_root, visit);
+        }
+
+        Children set(std::size_t index, NodePtr child, std::size_t *copiedBytes) const;
+        Children insert(std::size_t index, NodePtr child, std::size_t *copiedBytes) const;
+        Children erase(std::size_t index, NodePtr *removed, std::size_t *copiedBytes) const;
+
+    private:
+        struct Chunk;
+        using ChunkPtr = std::shared_ptr<const Chunk>;
+        // Leaf chunks hold children, inner chunks hold chunks; never both
+        struct Chunk {
+            std::size_t size = 0; // Children in this chunk and below it
+            std::vector<NodePtr> nodes;
+            std::vector<ChunkPtr> chunks;
+        };
+
+        static std::size_t chunkBytes(const Chunk &chunk)
+        {
+            return sizeof(Chunk) + chunk.nodes.capacity() * sizeof(NodePtr) + chunk.chunks.capacity() * sizeof(ChunkPtr);
+        }
+        static std::size_t width(const Chunk &chunk) { return chunk.chunks.empty() ? chunk.nodes.size() : chunk.chunks.size(); }
+        // The slot of chunk's inner list holding *index, which becomes the index within that slot.
+        // With atEnd an index one past a slot's last child stays in that slot (for insertion).
+        static std::size_t locate(const Chunk &chunk, std::size_t *index, bool atEnd);
+        static void insertInto(const Chunk &chunk, std::size_t index, NodePtr child,
+                               ChunkPtr *left, ChunkPtr *right, std::size_t *copiedBytes);
+        static ChunkPtr eraseFrom(const Chunk &chunk, std::size_t index, NodePtr *removed, std::size_t *copiedBytes);
+        static ChunkPtr setIn(const Chunk &chunk, std::size_t index, NodePtr child, std::size_t *copiedBytes);
+        template <typename Visit>
+        static void visitChunk(const Chunk &chunk, Visit &visit)
+        {
+            for (const NodePtr &node : chunk.nodes) visit(node);
+            for (const ChunkPtr &below : chunk.chunks) visitChunk(*below, visit);
+        }
+
+        explicit Children(ChunkPtr root) : m_root(std::move(root)) {}
+
+        ChunkPtr m_root; // Null for no children
+    };
+
+    struct Node {
+        Value value;
+        Children children;
+    };
+
+    // Memory held by a node itself, not counting its children or what its value points to
+    static std::size_t nodeBytes(const Node &) { return sizeof(Node); }
+
+    // nullptr if path leads nowhere
+    static const Node *at(const NodePtr &root, const Path &path)
+    {
+        const Node *node = root.get();
+        for (std::size_t row : path) {
+            if (!node || row >= node->children.size()) {
+                return nullptr;
+            }
+            node = node->children[row].get();
+        }
+        return node;
+    }
+
+    // Each edit returns the new root and adds the size of the nodes and chunks it copied to *copiedBytes
+
+    static NodePtr update(const NodePtr &root, const Path &path, Value value, std::size_t *copiedBytes)
+    {
+        return copyPath(*root, path, 0, [&](Node &node) { node.value = std::move(value); }, copiedBytes);
+    }
+
+    static NodePtr insert(const NodePtr &root, const Path &parentPath, std::size_t row, NodePtr child,
+                          std::size_t *copiedBytes)
+    {
+        return copyPath(*root, parentPath, 0, [&](Node &node) {
+            assert(row <= node.children.size());
+            node.children = node.children.insert(row, std::move(child), copiedBytes);
+        }, copiedBytes);
+    }
+
+    // *removed receives the detached subtree, which stays valid on its own
+    static NodePtr remove(const NodePtr &root, const Path &path, NodePtr *removed, std::size_t *copiedBytes)
+    {
+        assert(!path.empty());
+        const Path parentPath(path.begin(), path.end() - 1);
+        return copyPath(*root, parentPath, 0, [&](Node &node) {
+            assert(path.back() < node.children.size());
+            node.children = node.children.erase(path.back(), removed, copiedBytes);
+        }, copiedBytes);
+    }
+
+private:
+    template <typename Edit>
+    static NodePtr copyPath(const Node &node, const Path &path, std::size_t depth, Edit &&edit, std::size_t *copiedBytes)
+    {
+        auto copy = std::make_shared<Node>(node); // Shares the child list until it is edited
+        if (depth == path.size()) {
+            edit(*copy);
+        } else {
+            assert(path[depth] < node.children.size());
+            copy->children = node.children.set(path[depth],
+                                               copyPath(*node.children[path[depth]], path, depth + 1,
+                                                        std::forward<Edit>(edit), copiedBytes),
+                                               copiedBytes);
+        }
+        *copiedBytes += nodeBytes(*copy);
+        return copy;
+    }
+};
+
+template <typename Value>
+typename PersistentTree<Value>::Children
+PersistentTree<Value>::Children::fromVector(const std::vector<NodePtr> &nodes, std::size_t *copiedBytes)
+{
+    if (nodes.empty()) {
+        return Children();
+    }
+    // Full chunks bottom up, so a mirrored folder is as shallow as it can be
+    std::vector<ChunkPtr> level;
+    for (std::size_t first = 0; first < nodes.size(); first += kChunkSize) {
+        auto chunk = std::make_shared<Chunk>();
+        const std::size_t last = std::min(first + kChunkSize, nodes.size());
+        chunk->nodes.assign(nodes.begin() + std::ptrdiff_t(first), nodes.begin() + std::ptrdiff_t(last));
+        chunk->size = chunk->nodes.size();
+        *copiedBytes += chunkBytes(*chunk);
+        level.push_back(std::move(chunk));
+    }
+    while (level.size() > 1) {
+        std::vector<ChunkPtr> above;
+        for (std::size_t first = 0; first < level.size(); first += kChunkSize) {
+            auto chunk = std::make_shared<Chunk>();
+            const std::size_t last = std::min(first + kChunkSize, level.size());
+            chunk->chunks.assign(level.begin() + std::ptrdiff_t(first), level.begin() + std::ptrdiff_t(last));
+            for (const ChunkPtr &below : chunk->chunks) {
+                chunk->size += below->size;
+            }
+            *copiedBytes += chunkBytes(*chunk);
+            above.push_back(std::move(chunk));
+        }
+        level.swap(above);
+    }
+    return Children(std::move(level.front()));
+}
+
+template <typename Value>
+const typename PersistentTree<Value>::NodePtr &PersistentTree<Value>::Children::operator[](std::size_t index) const
+{
+    assert(index < size());
+    const Chunk *chunk = m_root.get();
+    while (!chunk->chunks.empty()) {
+        chunk = chunk->chunks[locate(*chunk, &index, false)].get();
+    }
+    return chunk->nodes[index];
+}
+
+template <typename Value>
+std::size_t PersistentTree<Value>::Children::locate(const Chunk &chunk, std::size_t *index, bool atEnd)
+{
+    std::size_t slot = 0;
+    for (; slot + 1 < chunk.chunks.size(); ++slot) {
+        const std::size_t below = chunk.chunks[slot]->size;
+        if (*index < below || (atEnd && *index == below)) {
+            break;
+        }
+        *index -= below;
+    }
+    return slot;
+}
+
+template <typename Value>
+typename PersistentTree<Value>::Children
+PersistentTree<Value>::Children::set(std::size_t index, NodePtr child, std::size_t *copiedBytes) const
+{
+    assert(index < size());
+    return Children(setIn(*m_root, index, std::move(child), copiedBytes));
+}
+
+template <typename Value>
+typename PersistentTree<Value>::Children::ChunkPtr
+PersistentTree<Value>::Children::setIn(const Chunk &chunk, std::size_t index, NodePtr child, std::size_t *copiedBytes)
+{
+    auto copy = std::make_shared<Chunk>(chunk);
+    if (copy->chunks.empty()) {
+        copy->nodes[index] = std::move(child);
+    } else {
+        const std::size_t slot = locate(chunk, &index, false);
+        copy->chunks[slot] = setIn(*chunk.chunks[slot], index, std::move(child), copiedBytes);
+    }
+    *copiedBytes += chunkBytes(*copy);
+    return copy;
+}
+
+template <typename Value>
+typename PersistentTree<Value>::Children
+PersistentTree<Value>::Children::insert(std::size_t index, NodePtr child, std::size_t *copiedBytes) const
+{
+    assert(index <= size());
+    if (!m_root) {
+        auto leaf = std::make_shared<Chunk>();
+        leaf->nodes.push_back(std::move(child));
+        leaf->size = 1;
+        *copiedBytes += chunkBytes(*leaf);
+        return Children(std::move(leaf));
+    }
+    ChunkPtr left;
+    ChunkPtr right;
+    insertInto(*m_root, index, std::move(child), &left, &right, copiedBytes);
+    if (!right) {
+        return Children(std::move(left));
+    }
+    // The root split: the list grows one level
+    auto root = std::make_shared<Chunk>();
+    root->size = left->size + right->size;
+    root->chunks = {std::move(left), std::move(right)};
+    *copiedBytes += chunkBytes(*root);
+    return Children(std::move(root));
+}
+
+template <typename Value>
+void PersistentTree<Value>::Children::insertInto(const Chunk &chunk, std::size_t index, NodePtr child,
+                                                 ChunkPtr *left, ChunkPtr *right, std::size_t *copiedBytes)
+{
+    auto copy = std::make_shared<Chunk>(chunk);
+    if (copy->chunks.empty()) {
+        copy->nodes.insert(copy->nodes.begin() + std::ptrdiff_t(index), std::move(child));
+    } else {
+        const std::size_t slot = locate(chunk, &index, true);
+        ChunkPtr below;
+        ChunkPtr split;
+        insertInto(*chunk.chunks[slot], index, std::move(child), &below, &split, copiedBytes);
+        copy->chunks[slot] = std::move(below);
+        if (split) {
+            copy->chunks.insert(copy->chunks.begin() + std::ptrdiff_t(slot) + 1, std::move(split));
+        }
+    }
+    ++copy->size;
+    if (width(*copy) <= kChunkSize) {
+        *copiedBytes += chunkBytes(*copy);
+        *left = std::move(copy);
+        right->reset();
+        return;
+    }
+    // Full: the upper half moves to a new chunk beside this one
+    auto upper = std::make_shared<Chunk>();
+    if (copy->chunks.empty()) {
+        const auto half = copy->nodes.begin() + std::ptrdiff_t(copy->nodes.size() / 2);
+        upper->nodes.assign(half, copy->nodes.end());
+        copy->nodes.erase(half, copy->nodes.end());
+        upper->size = upper->nodes.size();
+    } else {
+        const auto half = copy->chunks.begin() + std::ptrdiff_t(copy->chunks.size() / 2);
+        upper->chunks.assign(half, copy->chunks.end());
+        copy->chunks.erase(half, copy->chunks.end());
+        for (const ChunkPtr &below : upper->chunks) {
+            upper->size += below->size;
+        }
+    }
+    copy->size -= upper->size;
+    *copiedBytes += chunkBytes(*copy) + chunkBytes(*upper);
+    *left = std::move(copy);
+    *right = std::move(upper);
+}
+
+template <typename Value>
+typename PersistentTree<Value>::Children
+PersistentTree<Value>::Children::erase(std::size_t index, NodePtr *removed, std::size_t *copiedBytes) const
+{
+    assert(index < size());
+    ChunkPtr root = eraseFrom(*m_root, index, removed, copiedBytes);
+    // An inner root left with one chunk hands the list down a level
+    while (root && root->chunks.size() == 1) {
+        root = root->chunks.front();
+    }
+    return Children(std::move(root));
+}
+
+template <typename Value>
+typename PersistentTree<Value>::Children::ChunkPtr
+PersistentTree<Value>::Children::eraseFrom(const Chunk &chunk, std::size_t index, NodePtr *removed,
+                                           std::size_t *copiedBytes)
+{
+    if (chunk.size == 1) {
+        const Chunk *leaf = &chunk;
+        while (!leaf->chunks.empty()) {
+            leaf = leaf->chunks.front().get();
+        }
+        *removed = leaf->nodes.front();
+        return nullptr; // Emptied; the caller drops it
+    }
+    auto copy = std::make_shared<Chunk>(chunk);
+    if (copy->chunks.empty()) {
+        *removed = std::move(copy->nodes[index]);
+        copy->nodes.erase(copy->nodes.begin() + std::ptrdiff_t(index));
+    } else {
+        const std::size_t slot = locate(chunk, &index, false);
+        ChunkPtr below = eraseFrom(*chunk.chunks[slot], index, removed, copiedBytes);
+        if (below) {
+            copy->chunks[slot] = std::move(below);
+        } else {
+            copy->chunks.erase(copy->chunks.begin() + std::ptrdiff_t(slot));
+        }
+    }
+    --copy->size;
+    *copiedBytes += chunkBytes(*copy);
+    return copy;
+}
+
+} // namespace ArcaneLock
+
+#endif // ARCANE_LOCK_PERSISTENT_TREE_HPP
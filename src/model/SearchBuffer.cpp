@@ -0,0 +1,289 @@
+#include "model/SearchBuffer.hpp"
+#include "model/SecurePool.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define ARCANE_LOCK_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define ARCANE_LOCK_TARGET_AVX2
+#else
+#define ARCANE_LOCK_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ARCANE_LOCK_SSE2 1
+#endif
+#endif
+
+namespace ArcaneLock {
+
+namespace {
+
+// Returns the index of the first occurrence of needle in text[from, size), or size
+using FindKernel = std::size_t (*)(const unsigned char *text, std::size_t size, std::size_t from,
+                                   const unsigned char *needle, std::size_t length);
+
+std::size_t findScalar(const unsigned char *text, std::size_t size, std::size_t from,
+                       const unsigned char *needle, std::size_t length)
+{
+    while (from + length <= size) {
+        const void *hit = std::memchr(text + from, needle[0], size - from - length + 1);
+        if (!hit) {
+            break;
+        }
+        const std::size_t position = std::size_t(static_cast<const unsigned char *>(hit) - text);
+        if (std::memcmp(text + position + 1, needle + 1, length - 1) == 0) {
+            return position;
+        }
+        from = position + 1;
+    }
+    return size;
+}
+
+#ifdef ARCANE_LOCK_X86
+
+inline unsigned countTrailingZeros(std::uint32_t mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return unsigned(index);
+#else
+    return unsigned(__builtin_ctz(mask));
+#endif
+}
+
+// Both kernels test the needle's first and last byte at every position of a
+// block at once and only memcmp the candidates where both agree, which on text
+// is rare enough that the loop runs at load speed.
+
+#ifdef ARCANE_LOCK_SSE2
+std::size_t findSse2(const unsigned char *text, std::size_t size, std::size_t from,
+                     const unsigned char *needle, std::size_t length)
+{
+    const __m128i first = _mm_set1_epi8(char(needle[0]));
+    const __m128i last = _mm_set1_epi8(char(needle[length - 1]));
+    std::size_t i = from;
+    for (; i + length - 1 + 16 <= size; i += 16) {
+        const __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i));
+        const __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i + length - 1));
+        std::uint32_t mask = std::uint32_t(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, last))));
+        while (mask != 0) {
+            const std::size_t position = i + countTrailingZeros(mask);
+            if (length <= 2 || std::memcmp(text + position + 1, needle + 1, length - 2) == 0) {
+                return position;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return findScalar(text, size, i, needle, length);
+}
+#endif
+
+ARCANE_LOCK_TARGET_AVX2
+std::size_t findAvx2(const unsigned char *text, std::size_t size, std::size_t from,
+                     const unsigned char *needle, std::size_t length)
+{
+    const __m256i first = _mm256_set1_epi8(char(needle[0]));
+    const __m256i last = _mm256_set1_epi8(char(needle[length - 1]));
+    std::size_t i = from;
+    for (; i + length - 1 + 32 <= size; i += 32) {
+        const __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i));
+        const __m256i blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i + length - 1));
+        std::uint32_t mask = std::uint32_t(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, first), _mm256_cmpeq_epi8(blockLast, last))));
+        while (mask != 0) {
+            const std::size_t position = i + countTrailingZeros(mask);
+            if (length <= 2 || std::memcmp(text + position + 1, needle + 1, length - 2) == 0) {
+                return position;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return findScalar(text, size, i, needle, length);
+}
+
+bool cpuHasAvx2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    const bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+    __cpuidex(info, 7, 0);
+    return osSavesYmm && (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // ARCANE_LOCK_X86
+
+struct Kernel {
+    FindKernel find;
+    const char *name;
+};
+
+Kernel pickKernel()
+{
+#ifdef ARCANE_LOCK_X86
+    if (cpuHasAvx2()) {
+        return {findAvx2, "avx2"};
+    }
+#ifdef ARCANE_LOCK_SSE2
+    return {findSse2, "sse2"};
+#endif
+#endif
+    return {findScalar, "scalar"};
+}
+
+const Kernel &kernel()
+{
+    static const Kernel picked = pickKernel();
+    return picked;
+}
+
+} // namespace
+
+SearchBuffer::SearchBuffer(std::size_t columnCount)
+    : m_columns(columnCount)
+{
+    for (Column &column : m_columns) {
+        column.offsets.push_back(0);
+    }
+}
+
+SearchBuffer::~SearchBuffer()
+{
+    for (Column &column : m_columns) {
+        release(column);
+    }
+}
+
+void SearchBuffer::setColumnSensitive(std::size_t column, bool sensitive)
+{
+    m_columns[column].sensitive = sensitive;
+}
+
+void SearchBuffer::reserve(Column &column, std::size_t size)
+{
+    if (size <= column.capacity) {
+        return;
+    }
+    const std::size_t capacity = std::max({size, column.capacity * 2, std::size_t(4096)});
+    auto *data = static_cast<unsigned char *>(column.sensitive ? SecurePool::instance().allocate(capacity)
+                                                               : ::operator new(capacity));
+    if (column.size != 0) {
+        std::memcpy(data, column.data, column.size);
+    }
+    const std::size_t used = column.size;
+    release(column);
+    column.data = data;
+    column.size = used;
+    column.capacity = capacity;
+}
+
+void SearchBuffer::release(Column &column)
+{
+    if (column.data) {
+        if (column.sensitive) {
+            SecurePool::instance().deallocate(column.data, column.capacity); // Zeroes the slot
+        } else {
+            ::operator delete(column.data);
+        }
+    }
+    column.data = nullptr;
+    column.size = 0;
+    column.capacity = 0;
+}
+
+std::uint32_t SearchBuffer::appendEntry(const std::string_view *fields)
+{
+    for (std::size_t c = 0; c < m_columns.size(); ++c) {
+        Column &column = m_columns[c];
+        reserve(column, column.size + fields[c].size() + 1);
+        if (!fields[c].empty()) {
+            std::memcpy(column.data + column.size, fields[c].data(), fields[c].size());
+        }
+        column.size += fields[c].size();
+        column.data[column.size++] = 0;
+        column.offsets.push_back(std::uint32_t(column.size));
+    }
+    m_removed.push_back(false);
+    return std::uint32_t(m_entryCount++);
+}
+
+void SearchBuffer::removeEntry(std::uint32_t entry)
+{
+    if (m_removed[entry]) {
+        return;
+    }
+    for (Column &column : m_columns) {
+        // Keeps the terminating NUL; the zeroed bytes before it can't match a needle
+        const std::uint32_t begin = column.offsets[entry];
+        const std::uint32_t end = column.offsets[entry + 1] - 1;
+        std::memset(column.data + begin, 0, end - begin);
+    }
+    m_removed[entry] = true;
+    ++m_removedCount;
+}
+
+void SearchBuffer::clear()
+{
+    for (Column &column : m_columns) {
+        release(column);
+        column.offsets.assign(1, 0);
+    }
+    m_removed.clear();
+    m_entryCount = 0;
+    m_removedCount = 0;
+}
+
+std::size_t SearchBuffer::bytes() const
+{
+    std::size_t total = 0;
+    for (const Column &column : m_columns) {
+        total += column.size;
+    }
+    return total;
+}
+
+void SearchBuffer::find(std::size_t column, std::string_view needle, std::vector<std::uint32_t> *entries) const
+{
+    if (needle.empty()) {
+        for (std::uint32_t entry = 0; entry < m_entryCount; ++entry) {
+            if (!m_removed[entry]) {
+                entries->push_back(entry);
+            }
+        }
+        return;
+    }
+    const Column &scanned = m_columns[column];
+    const auto *pattern = reinterpret_cast<const unsigned char *>(needle.data());
+    const FindKernel find = kernel().find;
+    std::size_t position = 0;
+    while (position < scanned.size) {
+        const std::size_t hit = find(scanned.data, scanned.size, position, pattern, needle.size());
+        if (hit >= scanned.size) {
+            break;
+        }
+        const auto next = std::upper_bound(scanned.offsets.begin(), scanned.offsets.end(), std::uint32_t(hit));
+        entries->push_back(std::uint32_t(next - scanned.offsets.begin() - 1));
+        position = *next; // One hit per entry is enough; resume at the next one
+    }
+}
+
+const char *SearchBuffer::kernelName()
+{
+    return kernel().name;
+}
+
+} // namespace ArcaneLock
@@ -0,0 +1,78 @@
+#ifndef ARCANE_LOCK_SEARCH_BUFFER_HPP
+#define ARCANE_LOCK_SEARCH_BUFFER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace ArcaneLock {
+
+// Searchable text of a vault laid out column by column for brute-force
+// substring scans.
+//
+// Each column holds one field of every entry as case-folded UTF-8 (the caller
+// folds; this class only compares bytes), the entries back to back and each
+// terminated by a NUL so a match can't straddle two entries. A per-column
+// offset table maps a hit back to its entry. Scanning a column is then one
+// linear pass over contiguous memory, using AVX2 or SSE2 where the CPU has
+// them (picked once at run time) and a memchr-based loop elsewhere.
+//
+// An edited entry is removed and appended again: removeEntry() zeroes its
+// bytes, which no needle can match, and leaves its number unused until the
+// owner compacts by rebuilding (see removedCount()).
+//
+// Columns marked sensitive live in SecurePool memory, since notes are copied
+// in here in the clear. Not thread-safe for writing; concurrent find() calls
+// are fine.
+class SearchBuffer {
+public:
+    explicit SearchBuffer(std::size_t columnCount);
+    SearchBuffer(const SearchBuffer &) = delete;
+    SearchBuffer &operator=(const SearchBuffer &) = delete;
+    ~SearchBuffer();
+
+    // Must be called while the buffer is empty
+    void setColumnSensitive(std::size_t column, bool sensitive);
+
+    // fields holds columnCount() case-folded UTF-8 values; none may contain NUL.
+    // Returns the new entry's index.
+    std::uint32_t appendEntry(const std::string_view *fields);
+    // Wipes the entry's text; find() no longer returns it
+    void removeEntry(std::uint32_t entry);
+    void clear();
+
+    std::size_t columnCount() const { return m_columns.size(); }
+    std::size_t entryCount() const { return m_entryCount; } // Removed entries included
+    std::size_t removedCount() const { return m_removedCount; }
+    bool isRemoved(std::uint32_t entry) const { return m_removed[entry]; }
+    std::size_t bytes() const; // Text bytes held over all columns
+
+    // Appends the indices of the entries whose column contains needle (already
+    // case-folded), in ascending order. An empty needle matches every entry.
+    void find(std::size_t column, std::string_view needle, std::vector<std::uint32_t> *entries) const;
+
+    // "avx2", "sse2" or "scalar": the kernel find() runs on this machine
+    static const char *kernelName();
+
+private:
+    struct Column {
+        unsigned char *data = nullptr;
+        std::size_t size = 0;
+        std::size_t capacity = 0;
+        bool sensitive = false;
+        std::vector<std::uint32_t> offsets; // Start of each entry, plus the end
+    };
+
+    static void reserve(Column &column, std::size_t size);
+    static void release(Column &column);
+
+    std::vector<Column> m_columns;
+    std::vector<bool> m_removed; // Per entry
+    std::size_t m_entryCount = 0;
+    std::size_t m_removedCount = 0;
+};
+
+} // namespace ArcaneLock
+
+#endif // ARCANE_LOCK_SEARCH_BUFFER_HPP
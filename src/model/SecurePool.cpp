@@ -0,0 +1,224 @@
+#include "model/SecurePool.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace ArcaneLock {
+
+void secureZero(void *data, std::size_t size)
+{
+    // Calling memset through a volatile pointer keeps it from being elided as a dead store
+    static void *(*const volatile zeroMemory)(void *, int, std::size_t) = std::memset;
+    zeroMemory(data, 0, size);
+}
+
+SecurePool &SecurePool::instance()
+{
+    // Deliberately leaked: records stored in static QVariants may be released after
+    // static destructors have run.
+    static SecurePool *pool = new SecurePool;
+    return *pool;
+}
+
+SecurePool::SecurePool()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    m_pageSize = info.dwPageSize;
+#else
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    if (pageSize > 0) {
+        m_pageSize = std::size_t(pageSize);
+    }
+    rlimit limit;
+    if (getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+        m_stats.memlockLimit = std::size_t(limit.rlim_cur);
+    }
+#endif
+}
+
+std::size_t SecurePool::sizeClassFor(std::size_t size)
+{
+    std::size_t sizeClass = 0;
+    while (slotSize(sizeClass) < size) {
+        ++sizeClass;
+    }
+    return sizeClass;
+}
+
+// Maps size bytes (a multiple of the page size) with an inaccessible guard page on
+// either side, locked and excluded from core dumps where possible. *locked
+// tells whether the lock took.
+unsigned char *SecurePool::mapGuarded(std::size_t size, bool *locked)
+{
+    const std::size_t total = size + 2 * m_pageSize;
+#ifdef _WIN32
+    auto *base = static_cast<unsigned char *>(VirtualAlloc(nullptr, total, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+    if (!base) {
+        throw std::bad_alloc();
+    }
+    DWORD oldProtection;
+    VirtualProtect(base, m_pageSize, PAGE_NOACCESS, &oldProtection);
+    VirtualProtect(base + m_pageSize + size, m_pageSize, PAGE_NOACCESS, &oldProtection);
+#else
+    void *mapping = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    auto *base = static_cast<unsigned char *>(mapping);
+    mprotect(base, m_pageSize, PROT_NONE);
+    mprotect(base + m_pageSize + size, m_pageSize, PROT_NONE);
+#ifdef MADV_DONTDUMP
+    madvise(base + m_pageSize, size, MADV_DONTDUMP);
+#endif
+#endif
+    unsigned char *data = base + m_pageSize;
+    *locked = lockRegion(data, size);
+    ++m_stats.regions;
+    m_stats.mappedBytes += size;
+    return data;
+}
+
+bool SecurePool::lockRegion(unsigned char *data, std::size_t size)
+{
+    // Stay within RLIMIT_MEMLOCK instead of letting mlock fail region after region
+    if (m_stats.memlockLimit != 0 && m_stats.lockedBytes + size > m_stats.memlockLimit) {
+        m_stats.unlockedBytes += size;
+        return false;
+    }
+#ifdef _WIN32
+    const bool locked = VirtualLock(data, size) != 0;
+#else
+    const bool locked = mlock(data, size) == 0;
+#endif
+    if (locked) {
+        m_stats.lockedBytes += size;
+    } else {
+        m_stats.unlockedBytes += size;
+    }
+    return locked;
+}
+
+void SecurePool::unmapGuarded(unsigned char *data, std::size_t size, bool locked)
+{
+    secureZero(data, size);
+    unsigned char *base = data - m_pageSize;
+#ifdef _WIN32
+    VirtualFree(base, 0, MEM_RELEASE);
+#else
+    munmap(base, size + 2 * m_pageSize);
+#endif
+    // Unlocking happens implicitly with the unmap
+    if (locked) {
+        m_stats.lockedBytes -= size;
+    } else {
+        m_stats.unlockedBytes -= size;
+    }
+    --m_stats.regions;
+    m_stats.mappedBytes -= size;
+}
+
+unsigned char *SecurePool::takeSlab()
+{
+    if (m_regionCursor == m_regionEnd) {
+        bool locked; // Regions stay mapped, so nothing needs to remember it
+        m_regionCursor = mapGuarded(kRegionSize, &locked);
+        m_regionEnd = m_regionCursor + kRegionSize;
+    }
+    unsigned char *slab = m_regionCursor;
+    m_regionCursor += kSlabSize;
+    return slab;
+}
+
+void *SecurePool::allocate(std::size_t size)
+{
+    if (size == 0) {
+        size = 1;
+    }
+    std::lock_guard<std::mutex> locker(m_mutex);
+
+    void *pointer;
+    std::size_t reserved;
+    if (size > kMaxSlotSize) {
+        reserved = (size + m_pageSize - 1) / m_pageSize * m_pageSize;
+        bool locked;
+        pointer = mapGuarded(reserved, &locked);
+        m_largeAllocations.emplace(pointer, LargeMapping{reserved, locked});
+    } else {
+        const std::size_t sizeClass = sizeClassFor(size);
+        SizeClass &slots = m_classes[sizeClass];
+        reserved = slotSize(sizeClass);
+        if (slots.freeList) {
+            FreeSlot *slot = slots.freeList;
+            slots.freeList = slot->next;
+            slot->next = nullptr; // Slots are handed out zeroed
+            pointer = slot;
+        } else {
+            if (slots.bumpCursor == slots.bumpEnd) {
+                slots.bumpCursor = takeSlab();
+                slots.bumpEnd = slots.bumpCursor + kSlabSize;
+            }
+            pointer = slots.bumpCursor;
+            slots.bumpCursor += reserved;
+        }
+    }
+
+    ++m_stats.liveAllocations;
+    ++m_stats.totalAllocations;
+    m_stats.requestedBytes += size;
+    m_stats.bytesInUse += reserved;
+    m_stats.peakBytesInUse = std::max(m_stats.peakBytesInUse, m_stats.bytesInUse);
+    return pointer;
+}
+
+void SecurePool::deallocate(void *pointer, std::size_t size)
+{
+    if (!pointer) {
+        return;
+    }
+    if (size == 0) {
+        size = 1;
+    }
+    std::lock_guard<std::mutex> locker(m_mutex);
+
+    std::size_t reserved;
+    if (size > kMaxSlotSize) {
+        auto it = m_largeAllocations.find(pointer);
+        if (it == m_largeAllocations.end()) {
+            return;
+        }
+        reserved = it->second.size;
+        const bool locked = it->second.locked;
+        m_largeAllocations.erase(it);
+        unmapGuarded(static_cast<unsigned char *>(pointer), reserved, locked);
+    } else {
+        const std::size_t sizeClass = sizeClassFor(size);
+        reserved = slotSize(sizeClass);
+        secureZero(pointer, reserved);
+        FreeSlot *slot = static_cast<FreeSlot *>(pointer);
+        slot->next = m_classes[sizeClass].freeList;
+        m_classes[sizeClass].freeList = slot;
+    }
+
+    --m_stats.liveAllocations;
+    m_stats.requestedBytes -= size;
+    m_stats.bytesInUse -= reserved;
+}
+
+SecurePool::Stats SecurePool::stats() const
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    return m_stats;
+}
+
+} // namespace ArcaneLock
@@ -0,0 +1,96 @@
+#ifndef ARCANE_LOCK_SECURE_POOL_HPP
+#define ARCANE_LOCK_SECURE_POOL_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace ArcaneLock {
+
+// Overwrites size bytes at data in a way the compiler can't optimise away.
+void secureZero(void *data, std::size_t size);
+
+// Slab allocator for secret data (passwords, notes, secret custom fields).
+//
+// Memory comes from a few large regions that are mlock'd (as far as
+// RLIMIT_MEMLOCK allows), excluded from core dumps and surrounded by
+// inaccessible guard pages. Each region is cut into slabs serving one size
+// class, so an allocation is a free-list pop instead of the mmap + mprotect a
+// sodium_malloc() call costs. Freed slots are zeroed before they are reused.
+// Requests above the largest size class get a guarded mapping of their own.
+//
+// Thread-safe. Use SecurePool::instance(); the pool is never destroyed, so
+// secrets held by static objects stay valid until the process exits.
+class SecurePool {
+public:
+    struct Stats {
+        std::size_t regions = 0;           // Regions and large mappings currently mapped
+        std::size_t mappedBytes = 0;       // Usable bytes mapped (guard pages excluded)
+        std::size_t lockedBytes = 0;       // Bytes successfully mlock'd
+        std::size_t unlockedBytes = 0;     // Bytes that couldn't be locked (limit reached or mlock failed)
+        std::size_t memlockLimit = 0;      // RLIMIT_MEMLOCK soft limit, 0 if unknown/unlimited
+        std::size_t liveAllocations = 0;
+        std::size_t requestedBytes = 0;    // Sum of the sizes asked for by live allocations
+        std::size_t bytesInUse = 0;        // Sum of the slot sizes of live allocations
+        std::size_t peakBytesInUse = 0;
+        std::size_t totalAllocations = 0;  // Since start-up
+    };
+
+    static SecurePool &instance();
+
+    void *allocate(std::size_t size);
+    // size must be the value passed to allocate(). The memory is zeroed.
+    void deallocate(void *pointer, std::size_t size);
+
+    Stats stats() const;
+
+    static constexpr std::size_t kMaxSlotSize = 4096;
+
+private:
+    SecurePool();
+    SecurePool(const SecurePool &) = delete;
+    SecurePool &operator=(const SecurePool &) = delete;
+
+    static constexpr std::size_t kMinSlotSize = 16;
+    static constexpr std::size_t kSizeClassCount = 9; // 16, 32, ..., 4096
+    static constexpr std::size_t kSlabSize = 64 * 1024;
+    static constexpr std::size_t kRegionSize = 1024 * 1024;
+
+    struct FreeSlot {
+        FreeSlot *next;
+    };
+
+    struct LargeMapping {
+        std::size_t size;  // Mapped bytes, guard pages excluded
+        bool locked;       // Counted in lockedBytes rather than unlockedBytes
+    };
+
+    struct SizeClass {
+        FreeSlot *freeList = nullptr;
+        unsigned char *bumpCursor = nullptr; // Unused tail of the class's newest slab
+        unsigned char *bumpEnd = nullptr;
+    };
+
+    static std::size_t sizeClassFor(std::size_t size);
+    static std::size_t slotSize(std::size_t sizeClass) { return kMinSlotSize << sizeClass; }
+
+    unsigned char *takeSlab();
+    unsigned char *mapGuarded(std::size_t size, bool *locked);
+    void unmapGuarded(unsigned char *data, std::size_t size, bool locked);
+    bool lockRegion(unsigned char *data, std::size_t size);
+
+    mutable std::mutex m_mutex;
+    std::array<SizeClass, kSizeClassCount> m_classes{};
+    unsigned char *m_regionCursor = nullptr; // Next unassigned slab of the newest region
+    unsigned char *m_regionEnd = nullptr;
+    std::unordered_map<void *, LargeMapping> m_largeAllocations; // pointer -> its mapping
+    std::size_t m_pageSize = 4096;
+    Stats m_stats;
+};
+
+} // namespace ArcaneLock
+
+#endif // ARCANE_LOCK_SECURE_POOL_HPP
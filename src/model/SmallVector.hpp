@@ -0,0 +1,181 @@
+#ifndef ARCANE_LOCK_SMALL_VECTOR_HPP
+#define ARCANE_LOCK_SMALL_VECTOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace ArcaneLock {
+
+// A vector that keeps its first N elements inside the object itself and only
+// goes to the heap once it grows past that. Most entries have no or only a
+// couple of custom fields, so they never pay for a separate allocation.
+template <typename T, std::size_t N>
+class SmallVector {
+    static_assert(N > 0, "SmallVector needs at least one inline slot");
+    static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "Over-aligned element types are not supported");
+
+public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using iterator = T *;
+    using const_iterator = const T *;
+
+    SmallVector() noexcept = default;
+
+    SmallVector(std::initializer_list<T> values)
+    {
+        reserve(values.size());
+        for (const T &value : values) {
+            push_back(value);
+        }
+    }
+
+    SmallVector(const SmallVector &other)
+    {
+        reserve(other.size());
+        for (const T &value : other) {
+            ::new (static_cast<void *>(m_data + m_size)) T(value);
+            ++m_size;
+        }
+    }
+
+    SmallVector(SmallVector &&other) noexcept(std::is_nothrow_move_constructible_v<T>)
+    {
+        takeFrom(std::move(other));
+    }
+
+    ~SmallVector()
+    {
+        clear();
+        releaseHeap();
+    }
+
+    SmallVector &operator=(const SmallVector &other)
+    {
+        if (this != &other) {
+            SmallVector copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    SmallVector &operator=(SmallVector &&other) noexcept(std::is_nothrow_move_constructible_v<T>)
+    {
+        if (this != &other) {
+            clear();
+            releaseHeap();
+            takeFrom(std::move(other));
+        }
+        return *this;
+    }
+
+    iterator begin() noexcept { return m_data; }
+    iterator end() noexcept { return m_data + m_size; }
+    const_iterator begin() const noexcept { return m_data; }
+    const_iterator end() const noexcept { return m_data + m_size; }
+
+    T &operator[](size_type index) { return m_data[index]; }
+    const T &operator[](size_type index) const { return m_data[index]; }
+
+    size_type size() const noexcept { return m_size; }
+    size_type capacity() const noexcept { return m_capacity; }
+    bool empty() const noexcept { return m_size == 0; }
+    bool isInline() const noexcept { return m_data == inlineData(); }
+
+    void reserve(size_type capacity)
+    {
+        if (capacity > m_capacity) {
+            grow(capacity);
+        }
+    }
+
+    template <typename... Args>
+    T &emplace_back(Args &&...args)
+    {
+        if (m_size == m_capacity) {
+            grow(m_capacity * 2);
+        }
+        T *slot = ::new (static_cast<void *>(m_data + m_size)) T(std::forward<Args>(args)...);
+        ++m_size;
+        return *slot;
+    }
+
+    void push_back(const T &value) { emplace_back(value); }
+    void push_back(T &&value) { emplace_back(std::move(value)); }
+
+    iterator erase(const_iterator position)
+    {
+        T *target = m_data + (position - m_data);
+        std::move(target + 1, end(), target);
+        --m_size;
+        m_data[m_size].~T();
+        return target;
+    }
+
+    void clear() noexcept
+    {
+        for (size_type i = 0; i < m_size; ++i) {
+            m_data[i].~T();
+        }
+        m_size = 0;
+    }
+
+private:
+    T *inlineData() noexcept { return std::launder(reinterpret_cast<T *>(m_inline)); }
+    const T *inlineData() const noexcept { return std::launder(reinterpret_cast<const T *>(m_inline)); }
+
+    void grow(size_type capacity)
+    {
+        T *buffer = static_cast<T *>(::operator new(capacity * sizeof(T)));
+        for (size_type i = 0; i < m_size; ++i) {
+            ::new (static_cast<void *>(buffer + i)) T(std::move(m_data[i]));
+            m_data[i].~T();
+        }
+        releaseHeap();
+        m_data = buffer;
+        m_capacity = capacity;
+    }
+
+    void releaseHeap() noexcept
+    {
+        if (!isInline()) {
+            ::operator delete(m_data);
+            m_data = inlineData();
+            m_capacity = N;
+        }
+    }
+
+    // Expects *this to be empty and inline
+    void takeFrom(SmallVector &&other)
+    {
+        if (other.isInline()) {
+            for (size_type i = 0; i < other.m_size; ++i) {
+                ::new (static_cast<void *>(m_data + i)) T(std::move(other.m_data[i]));
+            }
+            m_size = other.m_size;
+            other.clear();
+        } else {
+            // Steal the heap buffer
+            m_data = other.m_data;
+            m_size = other.m_size;
+            m_capacity = other.m_capacity;
+            other.m_data = other.inlineData();
+            other.m_size = 0;
+            other.m_capacity = N;
+        }
+    }
+
+    alignas(T) unsigned char m_inline[N * sizeof(T)];
+    T *m_data = inlineData();
+    size_type m_size = 0;
+    size_type m_capacity = N;
+};
+
+} // namespace ArcaneLock
+
+#endif // ARCANE_LOCK_SMALL_VECTOR_HPP